@@ -19,10 +19,9 @@
  */
 
 #include <command.h>
+#include <commandmatcher.h>
 #include <keyparser.h>
 
-#include <QRegExp>
-
 using namespace KateVi;
 
 Command::Command(NormalViMode *parent, QString pattern, bool (NormalViMode::*commandMethod)(),
@@ -36,27 +35,28 @@ Command::Command(NormalViMode *parent, QString pattern, bool (NormalViMode::*com
   m_pattern = KeyParser::self()->encodeKeySequence(pattern);
   m_flags = flags;
   m_ptr2commandMethod = commandMethod;
+
+  if (m_flags & REGEX_PATTERN) {
+    m_regex = CommandMatcher::compileRegex(m_pattern);
+  }
 }
 
 Command::~Command() {}
 
 bool Command::execute() const { return (m_parent->*m_ptr2commandMethod)(); }
 
-bool Command::matches(const QString &pattern) const {
+bool Command::matches(const QString &keys, int from) const {
   if (!(m_flags & REGEX_PATTERN)) {
-    return m_pattern.startsWith(pattern);
+    return CommandMatcher::literalMatches(m_pattern, keys, from);
   } else {
-    QRegExp re(m_pattern);
-    re.exactMatch(pattern);
-    return (re.matchedLength() == pattern.length());
+    return CommandMatcher::regexMatches(m_regex, keys, from);
   }
 }
 
-bool Command::matchesExact(const QString &pattern) const {
+bool Command::matchesExact(const QString &keys, int from) const {
   if (!(m_flags & REGEX_PATTERN)) {
-    return (m_pattern == pattern);
+    return CommandMatcher::literalMatchesExact(m_pattern, keys, from);
   } else {
-    QRegExp re(m_pattern);
-    return re.exactMatch(pattern);
+    return CommandMatcher::regexMatchesExact(m_regex, keys, from);
   }
 }
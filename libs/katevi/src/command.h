@@ -22,6 +22,7 @@
 #ifndef KATEVI_COMMAND_H
 #define KATEVI_COMMAND_H
 
+#include <QRegularExpression>
 #include <QString>
 
 #include <modes/normalvimode.h>
@@ -45,8 +46,9 @@ public:
           unsigned int flags = 0);
   ~Command();
 
-  bool matches(const QString &pattern) const;
-  bool matchesExact(const QString &pattern) const;
+  // Whether @keys from @from could be extended to match this command.
+  bool matches(const QString &keys, int from = 0) const;
+  bool matchesExact(const QString &keys, int from = 0) const;
   bool execute() const;
   const QString pattern() const { return m_pattern; }
   bool isRegexPattern() const { return m_flags & REGEX_PATTERN; }
@@ -62,6 +64,8 @@ protected:
   NormalViMode *m_parent;
   QString m_pattern;
   unsigned int m_flags;
+  // Compiled once for REGEX_PATTERN.
+  QRegularExpression m_regex;
   bool (NormalViMode::*m_ptr2commandMethod)();
   KeyParser *m_keyParser;
 };
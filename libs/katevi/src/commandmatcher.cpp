@@ -0,0 +1,170 @@
+#include "commandmatcher.h"
+
+#include <algorithm>
+
+using namespace KateVi;
+
+// Whether @pattern has an alternation at any level, which makes no prefix literal.
+static bool hasAlternation(const QString &pattern) {
+  bool inClass = false;
+  for (int i = 0; i < pattern.size(); ++i) {
+    const QChar ch = pattern.at(i);
+    if (ch == QLatin1Char('\\')) {
+      // Skip the escaped one.
+      ++i;
+    } else if (inClass) {
+      inClass = ch != QLatin1Char(']');
+    } else if (ch == QLatin1Char('[')) {
+      inClass = true;
+      // A leading ] is literal in a class.
+      if (i + 1 < pattern.size() && pattern.at(i + 1) == QLatin1Char(']')) {
+        ++i;
+      }
+    } else if (ch == QLatin1Char('|')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Length of the leading part of @pattern which any keys matching it must start with.
+static int literalPrefixLength(const QString &pattern) {
+  if (hasAlternation(pattern)) {
+    return 0;
+  }
+
+  static const QString specialChars = QStringLiteral("\\.[](){}*+?^$|");
+  for (int i = 0; i < pattern.size(); ++i) {
+    const QChar ch = pattern.at(i);
+    if (specialChars.contains(ch)) {
+      // These quantifiers may make the previous character optional.
+      if (ch == QLatin1Char('*') || ch == QLatin1Char('?') || ch == QLatin1Char('{')) {
+        return qMax(i - 1, 0);
+      }
+      return i;
+    }
+  }
+  return pattern.size();
+}
+
+void CommandMatcher::addPattern(const QString &pattern, bool isRegex) {
+  if (m_nodes.isEmpty()) {
+    m_nodes.append(Node());
+  }
+
+  const int index = m_patterns.size();
+  m_patterns.append(pattern);
+  m_regexes.append(isRegex ? compileRegex(pattern) : QRegularExpression());
+
+  const int prefixLength = isRegex ? literalPrefixLength(pattern) : pattern.size();
+  int node = 0;
+  m_nodes[node].patterns.append(index);
+  for (int i = 0; i < prefixLength; ++i) {
+    const QChar key = pattern.at(i);
+    int child = findChild(node, key);
+    if (child == -1) {
+      child = m_nodes.size();
+      m_nodes.append(Node());
+
+      auto &children = m_nodes[node].children;
+      auto it = std::lower_bound(
+          children.begin(), children.end(), key,
+          [](const QPair<QChar, int> &entry, QChar value) { return entry.first < value; });
+      children.insert(it, qMakePair(key, child));
+    }
+
+    node = child;
+    m_nodes[node].patterns.append(index);
+  }
+
+  if (isRegex) {
+    m_nodes[node].regexPatterns.append(index);
+  }
+}
+
+void CommandMatcher::clear() {
+  m_nodes.clear();
+  m_patterns.clear();
+  m_regexes.clear();
+}
+
+void CommandMatcher::match(const QString &keys, int from, QVector<int> &indexes) const {
+  indexes.resize(0);
+  if (m_nodes.isEmpty()) {
+    return;
+  }
+
+  bool needSort = false;
+  int node = 0;
+  for (int i = from; i < keys.size(); ++i) {
+    // Keys go beyond the literal prefixes of these patterns.
+    for (const int index : m_nodes[node].regexPatterns) {
+      if (regexMatches(m_regexes[index], keys, from)) {
+        indexes.append(index);
+        needSort = true;
+      }
+    }
+
+    node = findChild(node, keys.at(i));
+    if (node == -1) {
+      break;
+    }
+  }
+
+  if (node != -1) {
+    // Keys are prefixes of the literal prefixes of all the patterns within this subtree.
+    indexes += m_nodes[node].patterns;
+  }
+
+  if (needSort) {
+    std::sort(indexes.begin(), indexes.end());
+  }
+}
+
+bool CommandMatcher::matchesExact(int index, const QString &keys, int from) const {
+  const auto &regex = m_regexes[index];
+  if (!regex.pattern().isEmpty()) {
+    return regexMatchesExact(regex, keys, from);
+  }
+  return literalMatchesExact(m_patterns[index], keys, from);
+}
+
+int CommandMatcher::findChild(int node, QChar key) const {
+  const auto &children = m_nodes[node].children;
+  auto it = std::lower_bound(
+      children.begin(), children.end(), key,
+      [](const QPair<QChar, int> &entry, QChar value) { return entry.first < value; });
+  if (it != children.end() && it->first == key) {
+    return it->second;
+  }
+  return -1;
+}
+
+QRegularExpression CommandMatcher::compileRegex(const QString &pattern) {
+  // \G anchors at the offset to match from.
+  QRegularExpression regex(QStringLiteral("\\G(?:%1)\\z").arg(pattern),
+                           QRegularExpression::DotMatchesEverythingOption);
+  regex.optimize();
+  return regex;
+}
+
+bool CommandMatcher::regexMatches(const QRegularExpression &regex, const QString &keys, int from) {
+  // A partial match means the keys could be extended to match.
+  const auto match = regex.match(keys, from, QRegularExpression::PartialPreferCompleteMatch);
+  return match.hasMatch() || match.hasPartialMatch();
+}
+
+bool CommandMatcher::regexMatchesExact(const QRegularExpression &regex, const QString &keys,
+                                       int from) {
+  return regex.match(keys, from).hasMatch();
+}
+
+bool CommandMatcher::literalMatches(const QString &pattern, const QString &keys, int from) {
+  const int len = keys.size() - from;
+  return len <= pattern.size() && std::equal(keys.constBegin() + from, keys.constEnd(),
+                                             pattern.constBegin());
+}
+
+bool CommandMatcher::literalMatchesExact(const QString &pattern, const QString &keys, int from) {
+  return keys.size() - from == pattern.size() && literalMatches(pattern, keys, from);
+}
@@ -0,0 +1,86 @@
+#ifndef KATEVI_COMMANDMATCHER_H
+#define KATEVI_COMMANDMATCHER_H
+
+#include <QPair>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+namespace KateVi {
+
+/**
+ * Dispatch pending keys to the patterns of commands or motions.
+ *
+ * Patterns are kept in a prefix tree by their literal prefixes. The rest of a
+ * regular expression pattern is compiled once and checked only when the keys
+ * get through its literal prefix, so matching keys against all the literal
+ * patterns is O(length of keys) without allocation.
+ */
+class CommandMatcher {
+public:
+  /**
+   * Add encoded @p pattern, which is indexed by the order of adding.
+   */
+  void addPattern(const QString &pattern, bool isRegex);
+
+  void clear();
+
+  int size() const { return m_patterns.size(); }
+
+  /**
+   * Get the indexes in ascending order of the patterns which @p keys from
+   * @p from could be extended to match.
+   * @p indexes will be emptied first but keep its capacity.
+   */
+  void match(const QString &keys, int from, QVector<int> &indexes) const;
+
+  /**
+   * Whether @p keys from @p from matches pattern @p index exactly.
+   */
+  bool matchesExact(int index, const QString &keys, int from) const;
+
+  /**
+   * Compile a regular expression pattern to match the keys from a given
+   * offset to the end.
+   */
+  static QRegularExpression compileRegex(const QString &pattern);
+
+  /**
+   * Whether @p keys from @p from could be extended to match @p regex, which is
+   * compiled by compileRegex().
+   */
+  static bool regexMatches(const QRegularExpression &regex, const QString &keys, int from);
+
+  static bool regexMatchesExact(const QRegularExpression &regex, const QString &keys, int from);
+
+  static bool literalMatches(const QString &pattern, const QString &keys, int from);
+
+  static bool literalMatchesExact(const QString &pattern, const QString &keys, int from);
+
+private:
+  struct Node {
+    // Sorted by key.
+    QVector<QPair<QChar, int>> children;
+
+    // Patterns within this subtree in ascending order.
+    QVector<int> patterns;
+
+    // Regular expression patterns whose literal prefixes end here.
+    QVector<int> regexPatterns;
+  };
+
+  // Return -1 if not found.
+  int findChild(int node, QChar key) const;
+
+  // The first one is the root if not empty.
+  QVector<Node> m_nodes;
+
+  QVector<QString> m_patterns;
+
+  // Invalid for literal patterns.
+  QVector<QRegularExpression> m_regexes;
+};
+
+} // namespace KateVi
+
+#endif // KATEVI_COMMANDMATCHER_H
@@ -26,10 +26,46 @@
 #include "registers.h"
 #include <katevi/globalstate.h>
 
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QTimer>
 
 using namespace KateVi;
 
+namespace {
+const quint32 StoreMagic = 0x4b565354; // KVST
+const quint32 StoreVersion = 1;
+
+bool writeStoreFile(const QString &filePath, const QByteArray &data) {
+  QDir().mkpath(QFileInfo(filePath).absolutePath());
+  QSaveFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "failed to open vi store file" << filePath;
+    return false;
+  }
+  file.write(data);
+  return file.commit();
+}
+
+class WriteStoreFileTask : public QRunnable {
+public:
+  WriteStoreFileTask(const QString &filePath, const QByteArray &data)
+      : m_filePath(filePath), m_data(data) {}
+
+  void run() override { writeStoreFile(m_filePath, m_data); }
+
+private:
+  QString m_filePath;
+  QByteArray m_data;
+};
+} // namespace
+
 GlobalState::GlobalState() {
   m_macros = new Macros();
   m_mappings = new Mappings();
@@ -38,12 +74,32 @@ GlobalState::GlobalState() {
   m_replaceHistory = new History();
   m_commandHistory = new History();
 
-  readConfig();
+  m_writeTimer = new QTimer();
+  m_writeTimer->setSingleShot(true);
+  m_writeTimer->setInterval(1000);
+  QObject::connect(m_writeTimer, &QTimer::timeout, [this]() {
+    // Serialize here and write the file in background.
+    m_dirty = false;
+    m_writePool->start(new WriteStoreFileTask(m_storeFile, serialize()));
+  });
+
+  m_writePool = new QThreadPool();
+  m_writePool->setMaxThreadCount(1);
+
+  const auto changedHandler = [this]() { scheduleWrite(); };
+  m_macros->setChangedHandler(changedHandler);
+  m_registers->setChangedHandler(changedHandler);
+  m_searchHistory->setChangedHandler(changedHandler);
+  m_replaceHistory->setChangedHandler(changedHandler);
+  m_commandHistory->setChangedHandler(changedHandler);
 }
 
 GlobalState::~GlobalState() {
   writeConfig();
 
+  delete m_writeTimer;
+  delete m_writePool;
+
   delete m_searchHistory;
   delete m_replaceHistory;
   delete m_commandHistory;
@@ -53,24 +109,157 @@ GlobalState::~GlobalState() {
 }
 
 void GlobalState::writeConfig() const {
-  qDebug() << "Not implemented yet";
-  /*
-  // FIXME: use own groups instead of one big group!
-  KConfigGroup config(configFile, "Kate Vi Input Mode Settings");
-  m_macros->writeConfig(config);
-  m_mappings->writeConfig(config);
-  m_registers->writeConfig(config);
-  */
+  m_writeTimer->stop();
+  m_writePool->waitForDone();
+
+  // Do not overwrite the file before reading it or if it could not be parsed.
+  if (m_storeFile.isEmpty() || !m_loaded || !m_storeWritable || !m_dirty) {
+    return;
+  }
+
+  // Mappings are not stored since they are set up by the user config.
+  m_dirty = false;
+  writeStoreFile(m_storeFile, serialize());
 }
 
 void GlobalState::readConfig() {
-  qDebug() << "Not implemented yet";
-  /*
-  // FIXME: use own groups instead of one big group!
-  const KConfigGroup config(configFile, "Kate Vi Input Mode Settings");
-
-  m_macros->readConfig(config);
-  m_mappings->readConfig(config);
-  m_registers->readConfig(config);
-  */
+  if (m_storeFile.isEmpty()) {
+    m_loaded = true;
+    return;
+  }
+
+  QFile file(m_storeFile);
+  if (!file.exists()) {
+    m_loaded = true;
+    m_storeWritable = true;
+    return;
+  }
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "failed to read vi store file" << m_storeFile;
+    m_loaded = true;
+    m_storeWritable = false;
+    return;
+  }
+
+  const auto data = file.readAll();
+  file.close();
+
+  // Validate the whole file on throwaway states first so that an invalid file
+  // leaves no partial state behind.
+  {
+    Macros macros;
+    Registers registers;
+    History searchHistory;
+    History commandHistory;
+    History replaceHistory;
+    if (!deserialize(data, &macros, &registers, &searchHistory, &commandHistory,
+                     &replaceHistory)) {
+      // Keep the file untouched for a newer version or a manual fix.
+      qWarning() << "invalid vi store file, will not overwrite it" << m_storeFile;
+      m_loaded = true;
+      m_storeWritable = false;
+      return;
+    }
+  }
+
+  m_loading = true;
+  deserialize(data, m_macros, m_registers, m_searchHistory, m_commandHistory,
+              m_replaceHistory);
+  m_loading = false;
+
+  m_loaded = true;
+  m_storeWritable = true;
+}
+
+bool GlobalState::deserialize(const QByteArray &data, Macros *macros, Registers *registers,
+                              History *searchHistory, History *commandHistory,
+                              History *replaceHistory) {
+  QDataStream stream(data);
+  stream.setVersion(QDataStream::Qt_5_12);
+  quint32 magic = 0;
+  quint32 version = 0;
+  stream >> magic >> version;
+  if (stream.status() != QDataStream::Ok || magic != StoreMagic || version != StoreVersion) {
+    return false;
+  }
+
+  macros->readConfig(stream);
+  registers->readConfig(stream);
+  searchHistory->readConfig(stream);
+  commandHistory->readConfig(stream);
+  replaceHistory->readConfig(stream);
+  return stream.status() == QDataStream::Ok && stream.atEnd();
+}
+
+void GlobalState::setStoreFile(const QString &filePath) {
+  if (m_storeFile == filePath) {
+    return;
+  }
+
+  if (m_writeTimer->isActive()) {
+    // Flush pending changes to the old file.
+    writeConfig();
+  }
+
+  m_storeFile = filePath;
+  m_loaded = m_storeFile.isEmpty();
+  m_storeWritable = false;
+  m_dirty = false;
+}
+
+Macros *GlobalState::macros() const {
+  ensureLoaded();
+  return m_macros;
+}
+
+Registers *GlobalState::registers() const {
+  ensureLoaded();
+  return m_registers;
+}
+
+History *GlobalState::searchHistory() const {
+  ensureLoaded();
+  return m_searchHistory;
+}
+
+History *GlobalState::commandHistory() const {
+  ensureLoaded();
+  return m_commandHistory;
+}
+
+History *GlobalState::replaceHistory() const {
+  ensureLoaded();
+  return m_replaceHistory;
+}
+
+void GlobalState::ensureLoaded() const {
+  if (!m_loaded) {
+    // Loading lazily does not change the logical state.
+    const_cast<GlobalState *>(this)->readConfig();
+  }
+}
+
+QByteArray GlobalState::serialize() const {
+  QByteArray data;
+  QDataStream stream(&data, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_5_12);
+  stream << StoreMagic << StoreVersion;
+  m_macros->writeConfig(stream);
+  m_registers->writeConfig(stream);
+  m_searchHistory->writeConfig(stream);
+  m_commandHistory->writeConfig(stream);
+  m_replaceHistory->writeConfig(stream);
+  return data;
+}
+
+void GlobalState::scheduleWrite() {
+  if (m_loading || m_storeFile.isEmpty() || !m_storeWritable) {
+    return;
+  }
+
+  m_dirty = true;
+  if (!m_writeTimer->isActive()) {
+    m_writeTimer->start();
+  }
 }
@@ -19,6 +19,8 @@
 
 #include "history.h"
 
+#include <QDataStream>
+
 using namespace KateVi;
 
 namespace {
@@ -37,6 +39,32 @@ void History::append(const QString &historyItem) {
   }
 
   m_items.append(historyItem);
+  notifyChanged();
+}
+
+void History::clear() {
+  m_items.clear();
+  notifyChanged();
 }
 
-void History::clear() { m_items.clear(); }
+void History::writeConfig(QDataStream &stream) const { stream << m_items; }
+
+void History::readConfig(QDataStream &stream) {
+  QStringList items;
+  stream >> items;
+  if (stream.status() != QDataStream::Ok) {
+    return;
+  }
+
+  m_items = items.mid(qMax(items.size() - HISTORY_SIZE_LIMIT, 0));
+}
+
+void History::setChangedHandler(const std::function<void()> &handler) {
+  m_changedHandler = handler;
+}
+
+void History::notifyChanged() const {
+  if (m_changedHandler) {
+    m_changedHandler();
+  }
+}
@@ -23,6 +23,10 @@
 #include <QStringList>
 #include <katevi/katevi_export.h>
 
+#include <functional>
+
+class QDataStream;
+
 namespace KateVi {
 
 class KATEVI_EXPORT History {
@@ -36,8 +40,18 @@ public:
   void clear();
   inline bool isEmpty() { return m_items.isEmpty(); }
 
+  void writeConfig(QDataStream &stream) const;
+  void readConfig(QDataStream &stream);
+
+  // @handler will be called when items are changed.
+  void setChangedHandler(const std::function<void()> &handler);
+
 private:
+  void notifyChanged() const;
+
   QStringList m_items;
+
+  std::function<void()> m_changedHandler;
 };
 } // namespace KateVi
 
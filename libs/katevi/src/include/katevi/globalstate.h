@@ -25,6 +25,12 @@
 
 #include <katevi/katevi_export.h>
 
+#include <QByteArray>
+#include <QString>
+
+class QThreadPool;
+class QTimer;
+
 namespace KateVi {
 class History;
 class Macros;
@@ -41,15 +47,56 @@ public:
   void writeConfig() const;
   void readConfig();
 
-  inline Macros *macros() const { return m_macros; }
+  /**
+   * Set the file to store macros, registers and histories across sessions.
+   * The file is read lazily on first use and written asynchronously on change.
+   * Empty to disable.
+   */
+  void setStoreFile(const QString &filePath);
+
+  Macros *macros() const;
   inline Mappings *mappings() const { return m_mappings; }
-  inline Registers *registers() const { return m_registers; }
+  Registers *registers() const;
 
-  inline History *searchHistory() const { return m_searchHistory; }
-  inline History *commandHistory() const { return m_commandHistory; }
-  inline History *replaceHistory() const { return m_replaceHistory; }
+  History *searchHistory() const;
+  History *commandHistory() const;
+  History *replaceHistory() const;
 
 private:
+  // Read the store file if not yet.
+  void ensureLoaded() const;
+
+  // Compact binary snapshot of the stored states.
+  QByteArray serialize() const;
+
+  // Read a snapshot into given states. Return false if it is not complete and valid.
+  static bool deserialize(const QByteArray &data, Macros *macros, Registers *registers,
+                          History *searchHistory, History *commandHistory,
+                          History *replaceHistory);
+
+  // Schedule writing the store file after changes.
+  void scheduleWrite();
+
+  QString m_storeFile;
+
+  // Nothing to load without a store file.
+  bool m_loaded = true;
+
+  // Changes from loading should not be written back.
+  bool m_loading = false;
+
+  // False if the store file exists but could not be parsed, which is kept untouched.
+  bool m_storeWritable = false;
+
+  // Changed since last write.
+  mutable bool m_dirty = false;
+
+  // Coalesce changes within a short time into one write.
+  QTimer *m_writeTimer = nullptr;
+
+  // Write files in order in background.
+  QThreadPool *m_writePool = nullptr;
+
   Macros *m_macros;
   Mappings *m_mappings;
   Registers *m_registers;
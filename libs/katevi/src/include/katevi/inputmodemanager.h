@@ -26,6 +26,7 @@
 #include <QKeyEvent>
 #include <QScopedPointer>
 #include <QStack>
+#include <QVector>
 #include <katevi/katevi_export.h>
 
 #include <katevi/completion.h>
@@ -55,6 +56,7 @@ class VisualViMode;
 class ReplaceViMode;
 class KeyParser;
 class KeyMapper;
+struct KeyEvent;
 
 class KATEVI_EXPORT InputModeManager {
 public:
@@ -75,6 +77,11 @@ public:
    */
   void feedKeyPresses(const QString &keyPresses) const;
 
+  /**
+   * feed the given decoded key presses, which skips decoding each key
+   */
+  void feedKeyEvents(const QVector<KeyEvent> &keyEvents) const;
+
   /**
    * Determines whether we are currently processing a Vi keypress
    * @return true if we are still in a call to handleKeyPress, false otherwise
@@ -232,6 +239,8 @@ public:
   void amendCursorPosition();
 
 private:
+  void sendKeyPress(int key, Qt::KeyboardModifiers mods, const QString &text) const;
+
   QScopedPointer<NormalViMode> m_viNormalMode;
 
   QScopedPointer<InsertViMode> m_viInsertMode;
@@ -1,6 +1,7 @@
 #ifndef KATEVICONFIG_H
 #define KATEVICONFIG_H
 
+#include <QString>
 #include <Qt>
 
 #include <katevi/katevi_export.h>
@@ -24,6 +25,11 @@ public:
 
   void skipKey(int p_key, Qt::KeyboardModifiers p_modifiers);
 
+  // File to store macros, registers and histories across sessions.
+  const QString &storeFile() const;
+
+  void setStoreFile(const QString &p_file);
+
   KateViConfig &operator=(const KateViConfig &p_other) = default;
 
 private:
@@ -56,6 +62,8 @@ private:
 
   bool m_stealShortcut = false;
 
+  QString m_storeFile;
+
   // Keys to skip in Vi Normal/Visual mode.
   std::unordered_set<Key, KeyHashFunc> m_skippedKeys;
 };
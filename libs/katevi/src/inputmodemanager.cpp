@@ -166,83 +166,41 @@ void InputModeManager::feedKeyPresses(const QString &keyPresses) const {
   QString text;
 
   for (const QChar &keyc : keyPresses) {
-    QString decoded = KeyParser::self()->decodeKeySequence(QString(keyc));
-    key = -1;
-    mods = Qt::NoModifier;
-    text.clear();
-
-    if (decoded.length() > 1) { // special key
-
-      // remove the angle brackets
-      decoded.remove(0, 1);
-      decoded.remove(decoded.indexOf(QLatin1Char('>')), 1);
-
-      // check if one or more modifier keys where used
-      if (decoded.indexOf(QLatin1String("s-")) != -1 ||
-          decoded.indexOf(QLatin1String("c-")) != -1 ||
-          decoded.indexOf(QLatin1String("m-")) != -1 ||
-          decoded.indexOf(QLatin1String("a-")) != -1) {
-        int s = decoded.indexOf(QLatin1String("s-"));
-        if (s != -1) {
-          mods |= Qt::ShiftModifier;
-          decoded.remove(s, 2);
-        }
-
-        int c = decoded.indexOf(QLatin1String("c-"));
-        if (c != -1) {
-          mods |= Qt::ControlModifier;
-          decoded.remove(c, 2);
-        }
-
-        int a = decoded.indexOf(QLatin1String("a-"));
-        if (a != -1) {
-          mods |= Qt::AltModifier;
-          decoded.remove(a, 2);
-        }
-
-        int m = decoded.indexOf(QLatin1String("m-"));
-        if (m != -1) {
-          mods |= Qt::MetaModifier;
-          decoded.remove(m, 2);
-        }
-
-        if (decoded.length() > 1) {
-          key = KeyParser::self()->vi2qt(decoded);
-        } else if (decoded.length() == 1) {
-          key = int(decoded.at(0).toUpper().toLatin1());
-          text = decoded.at(0);
-        }
-      } else { // no modifiers
-        key = KeyParser::self()->vi2qt(decoded);
-      }
-    } else {
-      key = decoded.at(0).unicode();
-      text = decoded.at(0);
+    if (!KeyParser::self()->decodeKeyPress(keyc, key, mods, text)) {
+      continue;
     }
 
-    if (key == -1)
-      continue;
+    sendKeyPress(key, mods, text);
+  }
+}
 
-    // We have to be clever about which widget we dispatch to, as we can trigger
-    // shortcuts if we're not careful (even if Vim mode is configured to steal
-    // shortcuts).
-    QKeyEvent k(QEvent::KeyPress, key, mods, text);
-    QWidget *destWidget = nullptr;
-    if (QApplication::activePopupWidget()) {
-      // According to the docs, the activePopupWidget, if present, takes all
-      // events.
-      destWidget = QApplication::activePopupWidget();
-    } else if (QApplication::focusWidget()) {
-      if (QApplication::focusWidget()->focusProxy()) {
-        destWidget = QApplication::focusWidget()->focusProxy();
-      } else {
-        destWidget = QApplication::focusWidget();
-      }
+void InputModeManager::feedKeyEvents(const QVector<KeyEvent> &keyEvents) const {
+  for (const auto &keyEvent : keyEvents) {
+    sendKeyPress(keyEvent.key, keyEvent.modifiers, keyEvent.text);
+  }
+}
+
+void InputModeManager::sendKeyPress(int key, Qt::KeyboardModifiers mods,
+                                    const QString &text) const {
+  // We have to be clever about which widget we dispatch to, as we can trigger
+  // shortcuts if we're not careful (even if Vim mode is configured to steal
+  // shortcuts).
+  QKeyEvent k(QEvent::KeyPress, key, mods, text);
+  QWidget *destWidget = nullptr;
+  if (QApplication::activePopupWidget()) {
+    // According to the docs, the activePopupWidget, if present, takes all
+    // events.
+    destWidget = QApplication::activePopupWidget();
+  } else if (QApplication::focusWidget()) {
+    if (QApplication::focusWidget()->focusProxy()) {
+      destWidget = QApplication::focusWidget()->focusProxy();
     } else {
-      destWidget = m_interface->focusProxy();
+      destWidget = QApplication::focusWidget();
     }
-    QApplication::sendEvent(destWidget, &k);
+  } else {
+    destWidget = m_interface->focusProxy();
   }
+  QApplication::sendEvent(destWidget, &k);
 }
 
 bool InputModeManager::isHandlingKeyPress() const { return m_insideHandlingKeyPressCount > 0; }
@@ -47,6 +47,10 @@ bool KateViConfig::wordCompletionRemoveTail() const { return m_wordCompletionRem
 
 bool KateViConfig::stealShortcut() const { return m_stealShortcut; }
 
+const QString &KateViConfig::storeFile() const { return m_storeFile; }
+
+void KateViConfig::setStoreFile(const QString &p_file) { m_storeFile = p_file; }
+
 bool KateViConfig::shouldSkipKey(int p_key, Qt::KeyboardModifiers p_modifiers) const {
   if (m_skippedKeys.find(Key(p_key, p_modifiers)) != m_skippedKeys.end()) {
     return true;
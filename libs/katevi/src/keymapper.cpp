@@ -91,16 +91,9 @@ bool KeyMapper::handleKeyPress(QChar key) {
     const auto mappings = m_viInputModeManager->globalState()->mappings();
     const auto mappingMode =
         Mappings::mappingModeForCurrentViMode(m_viInputModeManager->inputAdapter());
-    const auto allMappings = mappings->getAll(mappingMode, false, true);
-    for (const QString &mapping : allMappings) {
-      if (mapping.startsWith(m_mappingKeys)) {
-        if (mapping == m_mappingKeys) {
-          isFullMapping = true;
-          m_fullMappingMatch = mapping;
-        } else {
-          isPartialMapping = true;
-        }
-      }
+    mappings->match(mappingMode, m_mappingKeys, isFullMapping, isPartialMapping);
+    if (isFullMapping) {
+      m_fullMappingMatch = m_mappingKeys;
     }
 
     if (isFullMapping && !isPartialMapping) {
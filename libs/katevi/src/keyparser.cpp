@@ -659,6 +659,65 @@ const QString KeyParser::decodeKeySequence(const QString &keys) const {
   return ret;
 }
 
+bool KeyParser::decodeKeyPress(QChar encodedKey, int &key, Qt::KeyboardModifiers &mods,
+                               QString &text) const {
+  QString decoded = decodeKeySequence(QString(encodedKey));
+  key = -1;
+  mods = Qt::NoModifier;
+  text.clear();
+
+  if (decoded.length() > 1) { // special key
+
+    // remove the angle brackets
+    decoded.remove(0, 1);
+    decoded.remove(decoded.indexOf(QLatin1Char('>')), 1);
+
+    // check if one or more modifier keys where used
+    if (decoded.indexOf(QLatin1String("s-")) != -1 ||
+        decoded.indexOf(QLatin1String("c-")) != -1 ||
+        decoded.indexOf(QLatin1String("m-")) != -1 ||
+        decoded.indexOf(QLatin1String("a-")) != -1) {
+      int s = decoded.indexOf(QLatin1String("s-"));
+      if (s != -1) {
+        mods |= Qt::ShiftModifier;
+        decoded.remove(s, 2);
+      }
+
+      int c = decoded.indexOf(QLatin1String("c-"));
+      if (c != -1) {
+        mods |= Qt::ControlModifier;
+        decoded.remove(c, 2);
+      }
+
+      int a = decoded.indexOf(QLatin1String("a-"));
+      if (a != -1) {
+        mods |= Qt::AltModifier;
+        decoded.remove(a, 2);
+      }
+
+      int m = decoded.indexOf(QLatin1String("m-"));
+      if (m != -1) {
+        mods |= Qt::MetaModifier;
+        decoded.remove(m, 2);
+      }
+
+      if (decoded.length() > 1) {
+        key = vi2qt(decoded);
+      } else if (decoded.length() == 1) {
+        key = int(decoded.at(0).toUpper().toLatin1());
+        text = decoded.at(0);
+      }
+    } else { // no modifiers
+      key = vi2qt(decoded);
+    }
+  } else {
+    key = decoded.at(0).unicode();
+    text = decoded.at(0);
+  }
+
+  return key != -1;
+}
+
 const QChar KeyParser::KeyEventToQChar(const QKeyEvent &keyEvent) {
   const int keyCode = keyEvent.key();
   const QString &text = keyEvent.text();
@@ -50,6 +50,14 @@ public:
   QString qt2vi(int key) const;
   int vi2qt(const QString &keypress) const;
   int encoded2qt(const QString &keypress) const;
+
+  /**
+   * Decode one key of an encoded key sequence into the key, modifiers and
+   * text of a key press.
+   * @return false if it is not a valid key
+   */
+  bool decodeKeyPress(QChar encodedKey, int &key, Qt::KeyboardModifiers &mods,
+                      QString &text) const;
   const QChar KeyEventToQChar(const QKeyEvent &keyEvent);
 
 private:
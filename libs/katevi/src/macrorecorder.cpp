@@ -77,7 +77,8 @@ void MacroRecorder::replay(const QChar &macroRegister) {
   const QChar reg =
       (macroRegister == LastPlayedRegister) ? m_lastPlayedMacroRegister : macroRegister;
   m_lastPlayedMacroRegister = reg;
-  const QString macroAsFeedableKeypresses = m_viInputModeManager->globalState()->macros()->get(reg);
+  // Decoded key events are cached to avoid parsing the macro on each replay.
+  const auto keyEvents = m_viInputModeManager->globalState()->macros()->getKeyEvents(reg);
 
   QSharedPointer<KeyMapper> mapper(
       new KeyMapper(m_viInputModeManager, m_viInputModeManager->editorInterface()));
@@ -86,7 +87,7 @@ void MacroRecorder::replay(const QChar &macroRegister) {
   m_macrosBeingReplayedCount++;
   m_viInputModeManager->completionReplayer()->start(completions);
   m_viInputModeManager->pushKeyMapper(mapper);
-  m_viInputModeManager->feedKeyPresses(macroAsFeedableKeypresses);
+  m_viInputModeManager->feedKeyEvents(keyEvents);
   m_viInputModeManager->popKeyMapper();
   m_viInputModeManager->completionReplayer()->stop();
   m_macrosBeingReplayedCount--;
@@ -19,6 +19,7 @@
 #include "macros.h"
 #include "keyparser.h"
 
+#include <QDataStream>
 #include <QDebug>
 
 using namespace KateVi;
@@ -31,53 +32,62 @@ Macros::Macros() {}
 
 Macros::~Macros() {}
 
-void Macros::writeConfig() const {
-  qDebug() << "Not implemented yet";
-  /*
+void Macros::writeConfig(QDataStream &stream) const {
   const auto macroKeys = m_macros.keys();
   QStringList macroRegisters;
   for (const QChar macroRegister : macroKeys) {
-      macroRegisters.append(macroRegister);
+    macroRegisters.append(macroRegister);
   }
   QStringList macroContents;
   for (const QChar macroRegister : macroKeys) {
-      macroContents.append(KeyParser::self()->decodeKeySequence(m_macros[macroRegister]));
+    macroContents.append(KeyParser::self()->decodeKeySequence(m_macros[macroRegister]));
   }
   QStringList macroCompletions;
   for (const QChar macroRegister : macroKeys) {
-      macroCompletions.append(QString::number(m_completions[macroRegister].length()));
-      for (const Completion &completionForMacro : m_completions[macroRegister])
-  { macroCompletions.append(encodeMacroCompletionForConfig(completionForMacro));
-      }
+    const auto completions = m_completions.value(macroRegister);
+    macroCompletions.append(QString::number(completions.length()));
+    for (const Completion &completionForMacro : completions) {
+      macroCompletions.append(encodeMacroCompletionForConfig(completionForMacro));
+    }
   }
-  config.writeEntry("Macro Registers", macroRegisters);
-  config.writeEntry("Macro Contents", macroContents);
-  config.writeEntry("Macro Completions", macroCompletions);
-  */
+  stream << macroRegisters << macroContents << macroCompletions;
 }
 
-void Macros::readConfig() {
-  qDebug() << "Not implemented yet";
-  /*
-  const QStringList macroRegisters = config.readEntry("Macro Registers",
-  QStringList()); const QStringList macroContents = config.readEntry("Macro
-  Contents", QStringList()); const QStringList macroCompletions =
-  config.readEntry("Macro Completions", QStringList()); int
-  macroCompletionsIndex = 0; if (macroRegisters.length() ==
-  macroContents.length()) { for (int macroIndex = 0; macroIndex <
-  macroRegisters.length(); macroIndex++) { const QChar macroRegister =
-  macroRegisters[macroIndex].at(0); m_macros[macroRegister] =
-  KeyParser::self()->encodeKeySequence(macroContents[macroIndex]);
-          macroCompletionsIndex = readMacroCompletions(macroRegister,
-  macroCompletions, macroCompletionsIndex);
+void Macros::readConfig(QDataStream &stream) {
+  QStringList macroRegisters;
+  QStringList macroContents;
+  QStringList macroCompletions;
+  stream >> macroRegisters >> macroContents >> macroCompletions;
+  if (stream.status() != QDataStream::Ok) {
+    return;
+  }
+
+  int macroCompletionsIndex = 0;
+  if (macroRegisters.length() == macroContents.length()) {
+    for (int macroIndex = 0; macroIndex < macroRegisters.length(); macroIndex++) {
+      if (macroRegisters[macroIndex].isEmpty()) {
+        continue;
       }
+      const QChar macroRegister = macroRegisters[macroIndex].at(0);
+      m_macros[macroRegister] = KeyParser::self()->encodeKeySequence(macroContents[macroIndex]);
+      m_keyEvents.remove(macroRegister);
+      macroCompletionsIndex =
+          readMacroCompletions(macroRegister, macroCompletions, macroCompletionsIndex);
+    }
   }
-  */
 }
 
-void Macros::clear() { m_macros.clear(); }
+void Macros::clear() {
+  m_macros.clear();
+  m_keyEvents.clear();
+  notifyChanged();
+}
 
-void Macros::remove(const QChar &reg) { m_macros.remove(reg); }
+void Macros::remove(const QChar &reg) {
+  m_macros.remove(reg);
+  m_keyEvents.remove(reg);
+  notifyChanged();
+}
 
 void Macros::store(const QChar &reg, const QList<KeyEvent> &macroKeyEventLog,
                    const CompletionList &completions) {
@@ -89,12 +99,47 @@ void Macros::store(const QChar &reg, const QList<KeyEvent> &macroKeyEventLog,
     m_macros[reg].append(keyEvent.toChar);
   }
   m_completions[reg] = completions;
+  m_keyEvents.remove(reg);
+  notifyChanged();
 }
 
 QString Macros::get(const QChar &reg) const {
   return m_macros.contains(reg) ? m_macros[reg] : QString();
 }
 
+QVector<KeyEvent> Macros::getKeyEvents(const QChar &reg) const {
+  auto it = m_keyEvents.constFind(reg);
+  if (it != m_keyEvents.constEnd()) {
+    return it.value();
+  }
+
+  // Decode once and replay it many times.
+  QVector<KeyEvent> keyEvents;
+  const QString macro = get(reg);
+  keyEvents.reserve(macro.size());
+  for (const QChar encodedKey : macro) {
+    KeyEvent keyEvent;
+    if (KeyParser::self()->decodeKeyPress(encodedKey, keyEvent.key, keyEvent.modifiers,
+                                          keyEvent.text)) {
+      keyEvent.type = QEvent::KeyPress;
+      keyEvent.toChar = encodedKey;
+      keyEvents.append(keyEvent);
+    }
+  }
+  m_keyEvents.insert(reg, keyEvents);
+  return keyEvents;
+}
+
+void Macros::setChangedHandler(const std::function<void()> &handler) {
+  m_changedHandler = handler;
+}
+
+void Macros::notifyChanged() const {
+  if (m_changedHandler) {
+    m_changedHandler();
+  }
+}
+
 CompletionList Macros::getCompletions(const QChar &reg) const {
   return m_completions.contains(reg) ? m_completions[reg] : CompletionList();
 }
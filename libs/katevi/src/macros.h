@@ -23,6 +23,11 @@
 #include <katevi/katevi_export.h>
 
 #include <QKeyEvent>
+#include <QVector>
+
+#include <functional>
+
+class QDataStream;
 
 namespace KateVi {
 
@@ -43,8 +48,8 @@ public:
   explicit Macros();
   ~Macros();
 
-  void writeConfig() const;
-  void readConfig();
+  void writeConfig(QDataStream &stream) const;
+  void readConfig(QDataStream &stream);
 
   void store(const QChar &reg, const QList<KeyEvent> &macroKeyEventLog,
              const CompletionList &completions);
@@ -52,9 +57,17 @@ public:
   void clear();
 
   QString get(const QChar &reg) const;
+
+  // Decoded key presses of the macro, cached for replay.
+  QVector<KeyEvent> getKeyEvents(const QChar &reg) const;
   CompletionList getCompletions(const QChar &reg) const;
 
+  // @handler will be called when macros are changed.
+  void setChangedHandler(const std::function<void()> &handler);
+
 private:
+  void notifyChanged() const;
+
   int readMacroCompletions(const QChar &reg, const QStringList &encodedMacroCompletions,
                            int macroCompletionIndex);
   QString encodeMacroCompletionForConfig(const Completion &completionForMacro) const;
@@ -63,6 +76,8 @@ private:
 private:
   QHash<QChar, QString> m_macros;
   QHash<QChar, QList<Completion>> m_completions;
+  mutable QHash<QChar, QVector<KeyEvent>> m_keyEvents;
+  std::function<void()> m_changedHandler;
 };
 
 } // namespace KateVi
@@ -18,6 +18,8 @@
 
 #include "mappings.h"
 
+#include <algorithm>
+
 #include <QDebug>
 
 #include "keyparser.h"
@@ -110,7 +112,7 @@ void Mappings::add(MappingMode mode, const QString &from, const QString &to,
   Mapping mapping = {encodedTo, (recursion == Recursive), false};
 
   // Add this mapping as is.
-  m_mappings[mode][encodedMapping] = mapping;
+  addMapping(mode, encodedMapping, mapping);
 
   // In normal mode replace the <leader> with its value.
   if (mode == NormalModeMapping) {
@@ -119,17 +121,30 @@ void Mappings::add(MappingMode mode, const QString &from, const QString &to,
     other = KeyParser::self()->encodeKeySequence(other);
     if (other != encodedMapping) {
       mapping.temporary = true;
-      m_mappings[mode][other] = mapping;
+      addMapping(mode, other, mapping);
     }
   }
 }
 
+void Mappings::addMapping(MappingMode mode, const QString &encodedFrom, const Mapping &mapping) {
+  auto &mappings = m_mappings[mode];
+  if (!mappings.contains(encodedFrom)) {
+    m_tries[mode].insert(encodedFrom);
+  }
+  mappings[encodedFrom] = mapping;
+}
+
 void Mappings::remove(MappingMode mode, const QString &from) {
   const QString &encodedMapping = KeyParser::self()->encodeKeySequence(from);
-  m_mappings[mode].remove(encodedMapping);
+  if (m_mappings[mode].remove(encodedMapping) > 0) {
+    m_tries[mode].remove(encodedMapping);
+  }
 }
 
-void Mappings::clear(MappingMode mode) { m_mappings[mode].clear(); }
+void Mappings::clear(MappingMode mode) {
+  m_mappings[mode].clear();
+  m_tries[mode].clear();
+}
 
 QString Mappings::get(MappingMode mode, const QString &from, bool decode,
                       bool includeTemporary) const {
@@ -176,8 +191,93 @@ bool Mappings::isRecursive(MappingMode mode, const QString &from) const {
   return m_mappings[mode][from].recursive;
 }
 
+void Mappings::match(MappingMode mode, const QString &keys, bool &isFullMapping,
+                     bool &isPartialMapping) const {
+  m_tries[mode].match(keys, isFullMapping, isPartialMapping);
+}
+
 void Mappings::setLeader(const QChar &leader) { m_leader = leader; }
 
+void Mappings::MappingTrie::insert(const QString &keys) {
+  if (m_nodes.isEmpty()) {
+    m_nodes.append(Node());
+  }
+
+  int node = 0;
+  ++m_nodes[node].count;
+  for (const QChar key : keys) {
+    int child = findChild(node, key);
+    if (child == -1) {
+      child = m_nodes.size();
+      m_nodes.append(Node());
+
+      auto &children = m_nodes[node].children;
+      auto it = std::lower_bound(
+          children.begin(), children.end(), key,
+          [](const QPair<QChar, int> &entry, QChar value) { return entry.first < value; });
+      children.insert(it, qMakePair(key, child));
+    }
+
+    node = child;
+    ++m_nodes[node].count;
+  }
+
+  m_nodes[node].isMapping = true;
+}
+
+void Mappings::MappingTrie::remove(const QString &keys) {
+  // Check it first to keep counts consistent.
+  bool isFullMapping = false;
+  bool isPartialMapping = false;
+  match(keys, isFullMapping, isPartialMapping);
+  if (!isFullMapping) {
+    return;
+  }
+
+  int node = 0;
+  --m_nodes[node].count;
+  for (const QChar key : keys) {
+    node = findChild(node, key);
+    --m_nodes[node].count;
+  }
+
+  m_nodes[node].isMapping = false;
+}
+
+void Mappings::MappingTrie::clear() { m_nodes.clear(); }
+
+void Mappings::MappingTrie::match(const QString &keys, bool &isFullMapping,
+                                  bool &isPartialMapping) const {
+  isFullMapping = false;
+  isPartialMapping = false;
+  if (m_nodes.isEmpty()) {
+    return;
+  }
+
+  int node = 0;
+  for (const QChar key : keys) {
+    node = findChild(node, key);
+    if (node == -1 || m_nodes[node].count == 0) {
+      return;
+    }
+  }
+
+  const auto &matched = m_nodes[node];
+  isFullMapping = matched.isMapping;
+  isPartialMapping = matched.count > (matched.isMapping ? 1 : 0);
+}
+
+int Mappings::MappingTrie::findChild(int node, QChar key) const {
+  const auto &children = m_nodes[node].children;
+  auto it = std::lower_bound(
+      children.begin(), children.end(), key,
+      [](const QPair<QChar, int> &entry, QChar value) { return entry.first < value; });
+  if (it != children.end() && it->first == key) {
+    return it->second;
+  }
+  return -1;
+}
+
 Mappings::MappingMode Mappings::mappingModeForCurrentViMode(KateViI::KateViInputMode *viInputMode) {
   return NormalModeMapping;
   /*
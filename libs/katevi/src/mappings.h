@@ -20,6 +20,8 @@
 #define KATEVI_MAPPINGS_H
 
 #include <QHash>
+#include <QPair>
+#include <QVector>
 #include <katevi/katevi_export.h>
 
 namespace KateViI {
@@ -52,6 +54,14 @@ public:
   QStringList getAll(MappingMode mode, bool decode = false, bool includeTemporary = false) const;
   bool isRecursive(MappingMode mode, const QString &from) const;
 
+  /**
+   * Check whether encoded @p keys is a mapping (including temporary ones) and
+   * whether it is a prefix of any longer mapping, in O(length of @p keys)
+   * without allocation.
+   */
+  void match(MappingMode mode, const QString &keys, bool &isFullMapping,
+             bool &isPartialMapping) const;
+
   void setLeader(const QChar &leader);
 
 public:
@@ -82,7 +92,38 @@ private:
   } Mapping;
   typedef QHash<QString, Mapping> MappingList;
 
+  // Prefix tree of the encoded keys of mappings.
+  class MappingTrie {
+  public:
+    void insert(const QString &keys);
+    void remove(const QString &keys);
+    void clear();
+
+    void match(const QString &keys, bool &isFullMapping, bool &isPartialMapping) const;
+
+  private:
+    struct Node {
+      // Sorted by key.
+      QVector<QPair<QChar, int>> children;
+
+      // Number of mappings within this subtree. Nodes are kept after removal
+      // with a count of 0.
+      int count = 0;
+
+      bool isMapping = false;
+    };
+
+    // Return -1 if not found.
+    int findChild(int node, QChar key) const;
+
+    // The first one is the root if not empty.
+    QVector<Node> m_nodes;
+  };
+
+  void addMapping(MappingMode mode, const QString &encodedFrom, const Mapping &mapping);
+
   MappingList m_mappings[4];
+  MappingTrie m_tries[4];
   QChar m_leader;
 };
 
@@ -3193,231 +3193,23 @@ Range NormalViMode::textObjectAComma() { return textObjectComma(false); }
 
 Range NormalViMode::textObjectInnerComma() { return textObjectComma(true); }
 
-// Add commands.
-// When adding commands here, remember to add them to visual mode too (if
-// applicable).
+// Add commands listed in normalvimodecommands.h.
 void NormalViMode::initializeCommands() {
-  ADDCMD("a", commandEnterInsertModeAppend, IS_CHANGE);
-  ADDCMD("A", commandEnterInsertModeAppendEOL, IS_CHANGE);
-  ADDCMD("i", commandEnterInsertMode, IS_CHANGE);
-  ADDCMD("<insert>", commandEnterInsertMode, IS_CHANGE);
-  ADDCMD("I", commandEnterInsertModeBeforeFirstNonBlankInLine, IS_CHANGE);
-  ADDCMD("gi", commandEnterInsertModeLast, IS_CHANGE);
-  ADDCMD("v", commandEnterVisualMode, 0);
-  ADDCMD("V", commandEnterVisualLineMode, 0);
-  /*
-  ADDCMD("<c-v>", commandEnterVisualBlockMode, 0);
-  ADDCMD("gv", commandReselectVisual, SHOULD_NOT_RESET);
-  */
-  ADDCMD("o", commandOpenNewLineUnder, IS_CHANGE);
-  ADDCMD("O", commandOpenNewLineOver, IS_CHANGE);
-  ADDCMD("J", commandJoinLines, IS_CHANGE);
-  ADDCMD("c", commandChange, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("C", commandChangeToEOL, IS_CHANGE);
-  ADDCMD("cc", commandChangeLine, IS_CHANGE);
-  ADDCMD("s", commandSubstituteChar, IS_CHANGE);
-  ADDCMD("S", commandSubstituteLine, IS_CHANGE);
-  ADDCMD("dd", commandDeleteLine, IS_CHANGE);
-  ADDCMD("d", commandDelete, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("D", commandDeleteToEOL, IS_CHANGE);
-  ADDCMD("x", commandDeleteChar, IS_CHANGE);
-  ADDCMD("<delete>", commandDeleteChar, IS_CHANGE);
-  ADDCMD("X", commandDeleteCharBackward, IS_CHANGE);
-  ADDCMD("gu", commandMakeLowercase, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("guu", commandMakeLowercaseLine, IS_CHANGE);
-  ADDCMD("gU", commandMakeUppercase, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("gUU", commandMakeUppercaseLine, IS_CHANGE);
-  ADDCMD("y", commandYank, NEEDS_MOTION);
-  ADDCMD("yy", commandYankLine, 0);
-  // TODO: Different from Vi: Y should yank lines instead of yank to the end of
-  // the line.
-  ADDCMD("Y", commandYankToEOL, 0);
-  ADDCMD("p", commandPaste, IS_CHANGE);
-  ADDCMD("P", commandPasteBefore, IS_CHANGE);
-  ADDCMD("gp", commandgPaste, IS_CHANGE);
-  ADDCMD("gP", commandgPasteBefore, IS_CHANGE);
-  ADDCMD("]p", commandIndentedPaste, IS_CHANGE);
-  ADDCMD("[p", commandIndentedPasteBefore, IS_CHANGE);
-  ADDCMD("r.", commandReplaceCharacter, IS_CHANGE | REGEX_PATTERN);
-  ADDCMD("R", commandEnterReplaceMode, IS_CHANGE);
-  ADDCMD(":", commandSwitchToCmdLine, 0);
-  ADDCMD("u", commandUndo, 0);
-  ADDCMD("<c-r>", commandRedo, 0);
-  // TODO: U in Vi is undo all changes in one line. Do not support it for now.
-  // ADDCMD("U", commandRedo, 0);
-  ADDCMD("m.", commandSetMark, REGEX_PATTERN);
-  ADDCMD(">>", commandIndentLine, IS_CHANGE);
-  ADDCMD("<<", commandUnindentLine, IS_CHANGE);
-  ADDCMD(">", commandIndentLines, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("<", commandUnindentLines, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("<c-f>", commandScrollPageDown, 0);
-  ADDCMD("<pagedown>", commandScrollPageDown, 0);
-  ADDCMD("<c-b>", commandScrollPageUp, 0);
-  ADDCMD("<pageup>", commandScrollPageUp, 0);
-  ADDCMD("<c-u>", commandScrollHalfPageUp, 0);
-  ADDCMD("<c-d>", commandScrollHalfPageDown, 0);
-  ADDCMD("z.", commandCenterViewOnNonBlank, 0);
-  ADDCMD("zz", commandCenterViewOnCursor, 0);
-  ADDCMD("z<return>", commandTopViewOnNonBlank, 0);
-  ADDCMD("zt", commandTopViewOnCursor, 0);
-  ADDCMD("z-", commandBottomViewOnNonBlank, 0);
-  ADDCMD("zb", commandBottomViewOnCursor, 0);
-  /*
-  ADDCMD("ga", commandPrintCharacterCode, SHOULD_NOT_RESET);
-  */
-  ADDCMD(".", commandRepeatLastChange, 0);
-  ADDCMD("==", commandAlignLine, IS_CHANGE);
-  ADDCMD("=", commandAlignLines, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("~", commandChangeCase, IS_CHANGE);
-  ADDCMD("g~", commandChangeCaseRange, IS_CHANGE | NEEDS_MOTION);
-  ADDCMD("g~~", commandChangeCaseLine, IS_CHANGE);
-  ADDCMD("<c-a>", commandAddToNumber, IS_CHANGE);
-  ADDCMD("<c-x>", commandSubtractFromNumber, IS_CHANGE);
-  ADDCMD("<c-o>", commandGoToPrevJump, 0);
-  ADDCMD("<c-i>", commandGoToNextJump, 0);
-
-  ADDCMD("<c-w>h", commandSwitchToLeftView, 0);
-  ADDCMD("<c-w><c-h>", commandSwitchToLeftView, 0);
-  ADDCMD("<c-w><left>", commandSwitchToLeftView, 0);
-  ADDCMD("<c-w>j", commandSwitchToDownView, 0);
-  ADDCMD("<c-w><c-j>", commandSwitchToDownView, 0);
-  ADDCMD("<c-w><down>", commandSwitchToDownView, 0);
-  ADDCMD("<c-w>k", commandSwitchToUpView, 0);
-  ADDCMD("<c-w><c-k>", commandSwitchToUpView, 0);
-  ADDCMD("<c-w><up>", commandSwitchToUpView, 0);
-  ADDCMD("<c-w>l", commandSwitchToRightView, 0);
-  ADDCMD("<c-w><c-l>", commandSwitchToRightView, 0);
-  ADDCMD("<c-w><right>", commandSwitchToRightView, 0);
-  ADDCMD("<c-w>w", commandSwitchToNextView, 0);
-  ADDCMD("<c-w><c-w>", commandSwitchToNextView, 0);
-
-  ADDCMD("<c-w>s", commandSplitHoriz, 0);
-  ADDCMD("<c-w>S", commandSplitHoriz, 0);
-  ADDCMD("<c-w><c-s>", commandSplitHoriz, 0);
-  ADDCMD("<c-w>v", commandSplitVert, 0);
-  ADDCMD("<c-w><c-v>", commandSplitVert, 0);
-  ADDCMD("<c-w>c", commandCloseView, 0);
-
-  ADDCMD("gt", commandSwitchToNextTab, 0);
-  ADDCMD("gT", commandSwitchToPrevTab, 0);
+#include "normalvimodecommands.h"
 
-  /*
-  ADDCMD("gqq", commandFormatLine, IS_CHANGE);
-  ADDCMD("gq", commandFormatLines, IS_CHANGE | NEEDS_MOTION);
-
-  ADDCMD("zo", commandExpandLocal, 0);
-  ADDCMD("zc", commandCollapseLocal, 0);
-  ADDCMD("za", commandToggleRegionVisibility, 0);
-  ADDCMD("zr", commandExpandAll, 0);
-  ADDCMD("zm", commandCollapseToplevelNodes, 0);
-  */
+  initializeCommandMatchers();
+}
 
-  ADDCMD("q.", commandStartRecordingMacro, REGEX_PATTERN);
-  ADDCMD("@.", commandReplayMacro, REGEX_PATTERN);
-
-  ADDCMD("ZZ", commandCloseWrite, 0);
-  ADDCMD("ZQ", commandCloseNocheck, 0);
-
-  // regular motions
-  ADDMOTION("h", motionLeft, 0);
-  ADDMOTION("<left>", motionLeft, 0);
-  ADDMOTION("<backspace>", motionLeft, 0);
-  ADDMOTION("j", motionDown, 0);
-  ADDMOTION("<down>", motionDown, 0);
-  ADDMOTION("<enter>", motionDownToFirstNonBlank, 0);
-  ADDMOTION("<return>", motionDownToFirstNonBlank, 0);
-  ADDMOTION("k", motionUp, 0);
-  ADDMOTION("<up>", motionUp, 0);
-  ADDMOTION("-", motionUpToFirstNonBlank, 0);
-  ADDMOTION("l", motionRight, 0);
-  ADDMOTION("<right>", motionRight, 0);
-  ADDMOTION(" ", motionRight, 0);
-  ADDMOTION("$", motionToEOL, 0);
-  ADDMOTION("<end>", motionToEOL, 0);
-  ADDMOTION("0", motionToColumn0, 0);
-  ADDMOTION("<home>", motionToColumn0, 0);
-  ADDMOTION("^", motionToFirstCharacterOfLine, 0);
-  ADDMOTION("f.", motionFindChar, REGEX_PATTERN);
-  ADDMOTION("F.", motionFindCharBackward, REGEX_PATTERN);
-  ADDMOTION("t.", motionToChar, REGEX_PATTERN);
-  ADDMOTION("T.", motionToCharBackward, REGEX_PATTERN);
-  ADDMOTION(";", motionRepeatlastTF, 0);
-  ADDMOTION(",", motionRepeatlastTFBackward, 0);
-  /*
-  ADDMOTION("n", motionFindNext, 0);
-  ADDMOTION("N", motionFindPrev, 0);
-  */
-  ADDMOTION("gg", motionToLineFirst, 0);
-  ADDMOTION("G", motionToLineLast, 0);
-  ADDMOTION("w", motionWordForward, IS_NOT_LINEWISE);
-  ADDMOTION("W", motionWORDForward, IS_NOT_LINEWISE);
-  ADDMOTION("<c-right>", motionWordForward, IS_NOT_LINEWISE);
-  ADDMOTION("<c-left>", motionWordBackward, IS_NOT_LINEWISE);
-  ADDMOTION("b", motionWordBackward, 0);
-  ADDMOTION("B", motionWORDBackward, 0);
-  ADDMOTION("e", motionToEndOfWord, 0);
-  ADDMOTION("E", motionToEndOfWORD, 0);
-  ADDMOTION("ge", motionToEndOfPrevWord, 0);
-  ADDMOTION("gE", motionToEndOfPrevWORD, 0);
-  ADDMOTION("|", motionToScreenColumn, 0);
-  ADDMOTION("%", motionToMatchingItem, IS_NOT_LINEWISE);
-  /*
-  ADDMOTION("`[a-zA-Z^><\\.\\[\\]]", motionToMark, REGEX_PATTERN);
-  ADDMOTION("'[a-zA-Z^><]", motionToMarkLine, REGEX_PATTERN);
-  */
-  ADDMOTION("[[", motionToPreviousBraceBlockStart, IS_NOT_LINEWISE);
-  ADDMOTION("]]", motionToNextBraceBlockStart, IS_NOT_LINEWISE);
-  ADDMOTION("[]", motionToPreviousBraceBlockEnd, IS_NOT_LINEWISE);
-  ADDMOTION("][", motionToNextBraceBlockEnd, IS_NOT_LINEWISE);
-  /*
-  ADDMOTION("*", motionToNextOccurrence, 0);
-  ADDMOTION("#", motionToPrevOccurrence, 0);
-  */
-  ADDMOTION("H", motionToFirstLineOfWindow, 0);
-  ADDMOTION("M", motionToMiddleLineOfWindow, 0);
-  ADDMOTION("L", motionToLastLineOfWindow, 0);
-  ADDMOTION("gj", motionToNextVisualLine, 0);
-  ADDMOTION("gk", motionToPrevVisualLine, 0);
-  ADDMOTION("(", motionToPreviousSentence, 0);
-  ADDMOTION(")", motionToNextSentence, 0);
-  ADDMOTION("{", motionToBeforeParagraph, 0);
-  ADDMOTION("}", motionToAfterParagraph, 0);
-
-  // text objects
-  ADDMOTION("iw", textObjectInnerWord, 0);
-  ADDMOTION("aw", textObjectAWord, IS_NOT_LINEWISE);
-  ADDMOTION("iW", textObjectInnerWORD, 0);
-  ADDMOTION("aW", textObjectAWORD, IS_NOT_LINEWISE);
-  ADDMOTION("is", textObjectInnerSentence, IS_NOT_LINEWISE);
-  ADDMOTION("as", textObjectASentence, IS_NOT_LINEWISE);
-  ADDMOTION("ip", textObjectInnerParagraph, IS_NOT_LINEWISE);
-  ADDMOTION("ap", textObjectAParagraph, IS_NOT_LINEWISE);
-  ADDMOTION("i\"", textObjectInnerQuoteDouble, IS_NOT_LINEWISE);
-  ADDMOTION("a\"", textObjectAQuoteDouble, IS_NOT_LINEWISE);
-  ADDMOTION("i'", textObjectInnerQuoteSingle, IS_NOT_LINEWISE);
-  ADDMOTION("a'", textObjectAQuoteSingle, IS_NOT_LINEWISE);
-  ADDMOTION("i`", textObjectInnerBackQuote, IS_NOT_LINEWISE);
-  ADDMOTION("a`", textObjectABackQuote, IS_NOT_LINEWISE);
-  // TODO: Support repeat to (){}<>[].
-  ADDMOTION("i[()b]", textObjectInnerParen, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("a[()b]", textObjectAParen, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("i[{}B]", textObjectInnerCurlyBracket, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("a[{}B]", textObjectACurlyBracket, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("i[><]", textObjectInnerInequalitySign, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("a[><]", textObjectAInequalitySign, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("i[\\[\\]]", textObjectInnerBracket, REGEX_PATTERN | IS_NOT_LINEWISE);
-  ADDMOTION("a[\\[\\]]", textObjectABracket, REGEX_PATTERN | IS_NOT_LINEWISE);
-  // Not supported by Vim.
-  // FIXME: Comment it out since the implementation has some bugs.
-  /*
-  ADDMOTION("i,", textObjectInnerComma, IS_NOT_LINEWISE);
-  ADDMOTION("a,", textObjectAComma, IS_NOT_LINEWISE);
-  */
+void NormalViMode::initializeCommandMatchers() {
+  m_commandMatcher.clear();
+  for (const auto cmd : qAsConst(m_commands)) {
+    m_commandMatcher.addPattern(cmd->pattern(), cmd->isRegexPattern());
+  }
 
-  /*
-  ADDMOTION("/<enter>", motionToIncrementalSearchMatch, IS_NOT_LINEWISE);
-  ADDMOTION("?<enter>", motionToIncrementalSearchMatch, IS_NOT_LINEWISE);
-  */
+  m_motionMatcher.clear();
+  for (const auto motion : qAsConst(m_motions)) {
+    m_motionMatcher.addPattern(motion->pattern(), motion->isRegexPattern());
+  }
 }
 
 QRegularExpression NormalViMode::generateMatchingItemRegex() const {
@@ -3916,14 +3708,12 @@ void NormalViMode::updateMatchingCommands() {
       }
     }
   } else {
-    // Go through all registered commands and get possible matches.
-    for (int i = 0; i < m_commands.size(); i++) {
-      if (m_commands.at(i)->matches(m_keys)) {
-        m_matchingCommands.push_back(i);
-        if (m_commands.at(i)->needsMotion() &&
-            m_commands.at(i)->pattern().length() == m_keys.size()) {
-          m_awaitingMotionOrTextObject.push(m_keys.size());
-        }
+    // Get possible matches from all registered commands.
+    m_commandMatcher.match(m_keys, 0, m_matchingCommands);
+    for (const int idx : qAsConst(m_matchingCommands)) {
+      if (m_commands.at(idx)->needsMotion() &&
+          m_commands.at(idx)->pattern().length() == m_keys.size()) {
+        m_awaitingMotionOrTextObject.push(m_keys.size());
       }
     }
   }
@@ -3933,22 +3723,23 @@ bool NormalViMode::updateMatchingMotions(int p_checkFrom) {
   // FIXME: if p_checkFrom hasn't changed, only motions whose index is in
   // m_matchingMotions should be checked.
   if (p_checkFrom < m_keys.size()) {
-    const auto subKeys = m_keys.mid(p_checkFrom);
-    for (int i = 0; i < m_motions.size(); i++) {
-      if (m_motions.at(i)->matches(subKeys)) {
-        m_lastMotionWasLinewiseInnerBlock = false;
-        m_matchingMotions.push_back(i);
-
-        // If it matches exactly, we have found the motion command to execute.
-        if (m_motions.at(i)->matchesExact(subKeys)) {
-          m_currentMotionWasVisualLineUpOrDown = false;
-          if (p_checkFrom == 0) {
-            executeMotionWithoutCommand(m_motions.at(i));
-          } else {
-            executeMotionWithCommand(m_motions.at(i));
-          }
-          return true;
+    m_motionMatcher.match(m_keys, p_checkFrom, m_matchingMotions);
+    if (!m_matchingMotions.isEmpty()) {
+      m_lastMotionWasLinewiseInnerBlock = false;
+    }
+
+    for (int i = 0; i < m_matchingMotions.size(); i++) {
+      // If it matches exactly, we have found the motion command to execute.
+      const int idx = m_matchingMotions.at(i);
+      if (m_motionMatcher.matchesExact(idx, m_keys, p_checkFrom)) {
+        m_matchingMotions.resize(i + 1);
+        m_currentMotionWasVisualLineUpOrDown = false;
+        if (p_checkFrom == 0) {
+          executeMotionWithoutCommand(m_motions.at(idx));
+        } else {
+          executeMotionWithCommand(m_motions.at(idx));
         }
+        return true;
       }
     }
   }
@@ -24,6 +24,7 @@
 #ifndef KATEVI_NORMAL_VI_MODE_H
 #define KATEVI_NORMAL_VI_MODE_H
 
+#include <commandmatcher.h>
 #include <modes/modebase.h>
 #include <range.h>
 
@@ -320,6 +321,9 @@ protected:
 
   void initializeCommands();
 
+  // Build the matchers after m_commands and m_motions are initialized.
+  void initializeCommandMatchers();
+
   QRegularExpression generateMatchingItemRegex() const;
 
   void executeCommand(const Command *cmd);
@@ -394,6 +398,10 @@ protected:
   // Index in m_motions of possible matched motions (matching m_keys) so far.
   QVector<int> m_matchingMotions;
 
+  // Dispatch keys to m_commands and m_motions.
+  CommandMatcher m_commandMatcher;
+  CommandMatcher m_motionMatcher;
+
   // Index in m_keys which splits the operator keys and motion.
   // That is, we could look for a motion command from that position.
   QStack<int> m_awaitingMotionOrTextObject;
@@ -415,4 +415,6 @@ void VisualViMode::initializeCommands() {
   ADDMOTION("/<enter>", motionToIncrementalSearchMatch, 0);
   ADDMOTION("?<enter>", motionToIncrementalSearchMatch, 0);
   */
+
+  initializeCommandMatchers();
 }
@@ -22,6 +22,7 @@
 
 #include <QApplication>
 #include <QClipboard>
+#include <QDataStream>
 #include <QDebug>
 
 using namespace KateVi;
@@ -30,52 +31,61 @@ Registers::Registers() {}
 
 Registers::~Registers() {}
 
-void Registers::readConfig() {
-  KATEVI_NIY;
-  /*
-  const QStringList names = config.readEntry("ViRegisterNames", QStringList());
-  const QStringList contents = config.readEntry("ViRegisterContents",
-  QStringList()); const QList<int> flags = config.readEntry("ViRegisterFlags",
-  QList<int>());
-
-  if (names.size() != contents.size() || contents.size() != flags.size()) {
-      return;
+void Registers::readConfig(QDataStream &stream) {
+  QStringList names, contents;
+  QList<int> flags;
+  QStringList numberedContents;
+  QList<int> numberedFlags;
+  stream >> names >> contents >> flags >> numberedContents >> numberedFlags;
+  if (stream.status() != QDataStream::Ok) {
+    return;
   }
 
-  for (int i = 0; i < names.size(); i++) {
+  if (names.size() == contents.size() && contents.size() == flags.size()) {
+    for (int i = 0; i < names.size(); i++) {
       if (!names.at(i).isEmpty()) {
-          set(names.at(i).at(0), contents.at(i), (OperationMode)(flags.at(i)));
+        set(names.at(i).at(0), contents.at(i), (OperationMode)(flags.at(i)));
       }
+    }
   }
-  */
-}
 
-void Registers::writeConfig() const {
-  if (m_registers.isEmpty()) {
-    return;
+  if (numberedContents.size() == numberedFlags.size()) {
+    m_numbered.clear();
+    for (int i = 0; i < numberedContents.size() && i < 9; i++) {
+      m_numbered.append(Register(numberedContents.at(i), (OperationMode)(numberedFlags.at(i))));
+    }
   }
+}
+
+void Registers::writeConfig(QDataStream &stream) const {
+  // Skip registers with long contents to keep the store compact.
+  const int maxLength = 1000;
 
-  KATEVI_NIY;
-  /*
   QStringList names, contents;
   QList<int> flags;
   QMap<QChar, Register>::const_iterator i;
   for (i = m_registers.constBegin(); i != m_registers.constEnd(); ++i) {
-      if (i.value().first.length() <= 1000) {
-          names << i.key();
-          contents << i.value().first;
-          flags << int(i.value().second);
-      } else {
-          qCDebug(LOG_KTE) << "Did not save contents of register " << i.key() <<
-  ": contents too long ("
-          << i.value().first.length() << " characters)";
-      }
+    if (i.value().first.length() <= maxLength) {
+      names << i.key();
+      contents << i.value().first;
+      flags << int(i.value().second);
+    }
+  }
+
+  QStringList numberedContents;
+  QList<int> numberedFlags;
+  for (const auto &reg : m_numbered) {
+    if (reg.first.length() <= maxLength) {
+      numberedContents << reg.first;
+      numberedFlags << int(reg.second);
+    }
   }
 
-  config.writeEntry("ViRegisterNames", names);
-  config.writeEntry("ViRegisterContents", contents);
-  config.writeEntry("ViRegisterFlags", flags);
-  */
+  stream << names << contents << flags << numberedContents << numberedFlags;
+}
+
+void Registers::setChangedHandler(const std::function<void()> &handler) {
+  m_changedHandler = handler;
 }
 
 void Registers::setInsertStopped(const QString &text) { set(InsertStoppedRegister, text); }
@@ -86,7 +96,7 @@ void Registers::set(const QChar &reg, const QString &text, OperationMode flag) {
   }
 
   if (reg >= FirstNumberedRegister && reg <= LastNumberedRegister) { // "kill ring" registers
-    setNumberedRegister(text);
+    setNumberedRegister(text, flag);
   } else if (reg == SystemClipboardRegister) {
     QApplication::clipboard()->setText(text, QClipboard::Clipboard);
   } else if (reg == SystemSelectionRegister) {
@@ -98,6 +108,10 @@ void Registers::set(const QChar &reg, const QString &text, OperationMode flag) {
   if (reg == ZeroRegister || reg == FirstNumberedRegister || reg == SmallDeleteRegister) {
     m_default = reg;
   }
+
+  if (m_changedHandler && reg != SystemClipboardRegister && reg != SystemSelectionRegister) {
+    m_changedHandler();
+  }
 }
 
 QString Registers::getContent(const QChar &reg) const { return getRegister(reg).first; }
@@ -26,6 +26,10 @@
 #include <QMap>
 #include <QString>
 
+#include <functional>
+
+class QDataStream;
+
 namespace KateVi {
 
 const QChar BlackHoleRegister = QLatin1Char('_');
@@ -43,8 +47,11 @@ public:
   explicit Registers();
   ~Registers();
 
-  void writeConfig() const;
-  void readConfig();
+  void writeConfig(QDataStream &stream) const;
+  void readConfig(QDataStream &stream);
+
+  // @handler will be called when registers are changed.
+  void setChangedHandler(const std::function<void()> &handler);
 
   void setInsertStopped(const QString &text);
 
@@ -63,6 +70,7 @@ private:
   QList<Register> m_numbered;
   QMap<QChar, Register> m_registers;
   QChar m_default;
+  std::function<void()> m_changedHandler;
 };
 
 } // namespace KateVi
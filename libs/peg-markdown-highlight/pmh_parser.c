@@ -56,6 +56,109 @@ char *strdup_or_null(char *s)
 }
 
 
+
+// Bump allocator owning all the memory of one parse:
+typedef struct pmh_ArenaChunk
+{
+    struct pmh_ArenaChunk *prev;
+    size_t size;
+    size_t used;
+} pmh_arena_chunk;
+
+struct pmh_Arena
+{
+    pmh_arena_chunk *head;
+    size_t total_size;
+};
+
+#define pmh_ARENA_ALIGNMENT         16
+#define pmh_ARENA_MIN_CHUNK_SIZE    (64 * 1024)
+#define pmh_ARENA_MAX_CHUNK_SIZE    (1024 * 1024)
+#define pmh_ARENA_ALIGN(x)          (((x) + pmh_ARENA_ALIGNMENT - 1) \
+                                     & ~((size_t)pmh_ARENA_ALIGNMENT - 1))
+#define pmh_ARENA_CHUNK_HEADER_SIZE pmh_ARENA_ALIGN(sizeof(pmh_arena_chunk))
+
+pmh_arena *pmh_arena_new()
+{
+    pmh_arena *arena = (pmh_arena *)malloc(sizeof(pmh_arena));
+    arena->head = NULL;
+    arena->total_size = 0;
+    return arena;
+}
+
+void *pmh_arena_alloc(pmh_arena *arena, size_t size)
+{
+    size = pmh_ARENA_ALIGN(size == 0 ? 1 : size);
+    pmh_arena_chunk *chunk = arena->head;
+    if (chunk == NULL || chunk->size - chunk->used < size)
+    {
+        // Grow the chunk size geometrically to keep the number of chunks small:
+        size_t chunk_size = (chunk == NULL) ? pmh_ARENA_MIN_CHUNK_SIZE
+                                            : chunk->size * 2;
+        if (chunk_size > pmh_ARENA_MAX_CHUNK_SIZE)
+            chunk_size = pmh_ARENA_MAX_CHUNK_SIZE;
+        if (chunk_size < size)
+            chunk_size = size;
+        
+        chunk = (pmh_arena_chunk *)malloc(pmh_ARENA_CHUNK_HEADER_SIZE + chunk_size);
+        chunk->prev = arena->head;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->head = chunk;
+        arena->total_size += chunk_size;
+    }
+    
+    void *ret = (char *)chunk + pmh_ARENA_CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+    return ret;
+}
+
+size_t pmh_arena_size(pmh_arena *arena)
+{
+    return arena->total_size;
+}
+
+void pmh_arena_free(pmh_arena *arena)
+{
+    if (arena == NULL)
+        return;
+    
+    pmh_arena_chunk *chunk = arena->head;
+    while (chunk != NULL) {
+        pmh_arena_chunk *prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+    free(arena);
+}
+
+// Allocate from `arena` if not NULL, or from the heap otherwise:
+static void *pmh_alloc(pmh_arena *arena, size_t size)
+{
+    return (arena != NULL) ? pmh_arena_alloc(arena, size) : malloc(size);
+}
+
+// Memory allocated from an arena is released with the arena as a whole:
+static void pmh_release(pmh_arena *arena, void *ptr)
+{
+    if (arena == NULL)
+        free(ptr);
+}
+
+static char *pmh_strdup(pmh_arena *arena, char *s)
+{
+    if (arena == NULL)
+        return strdup_or_null(s);
+    if (s == NULL)
+        return NULL;
+    
+    size_t len = strlen(s);
+    char *ret = (char *)pmh_arena_alloc(arena, len + 1);
+    memcpy(ret, s, len + 1);
+    return ret;
+}
+
+
 // Internal language element occurrence structure, containing
 // both public and private members:
 struct pmh_RealElement
@@ -101,6 +204,11 @@ typedef struct
     unsigned long *strip_positions;
     size_t strip_positions_len;
     
+    /* The original UTF-16 input, or NULL if parsing UTF-8 input. */
+    /* Offsets in charbuf map 1:1 to code units of it: */
+    const unsigned short *original_input_utf16;
+    size_t original_input_utf16_len;
+    
     /* Buffer of characters to be parsed: */
     char *charbuf;
     
@@ -124,9 +232,16 @@ typedef struct
     
     /* List of reference elements: */
     pmh_realelement *references;
+    
+    /* Arena owning all the allocations, or NULL to use the heap: */
+    pmh_arena *arena;
+    
+    /* Number of display formula raw opening: */
+    unsigned char nr_dfr;
 } parser_data;
 
-static parser_data *mk_parser_data(char *original_input,
+static parser_data *mk_parser_data(pmh_arena *arena,
+                                   char *original_input,
                                    unsigned long *strip_positions,
                                    size_t strip_positions_len,
                                    char *charbuf,
@@ -136,21 +251,25 @@ static parser_data *mk_parser_data(char *original_input,
                                    pmh_realelement **head_elems,
                                    pmh_realelement *references)
 {
-    parser_data *p_data = (parser_data *)malloc(sizeof(parser_data));
+    parser_data *p_data = (parser_data *)pmh_alloc(arena, sizeof(parser_data));
+    p_data->arena = arena;
     p_data->extensions = extensions;
     p_data->original_input = original_input;
     p_data->strip_positions = strip_positions;
     p_data->strip_positions_len = strip_positions_len;
+    p_data->original_input_utf16 = NULL;
+    p_data->original_input_utf16_len = 0;
     p_data->charbuf = charbuf;
     p_data->offset = offset;
     p_data->elem_head = p_data->current_elem = parsing_elems;
     p_data->references = references;
     p_data->parsing_only_references = false;
+    p_data->nr_dfr = 0;
     if (head_elems != NULL)
         p_data->head_elems = head_elems;
     else {
         p_data->head_elems = (pmh_realelement **)
-                             malloc(sizeof(pmh_realelement *) * pmh_NUM_TYPES);
+                             pmh_alloc(arena, sizeof(pmh_realelement *) * pmh_NUM_TYPES);
         int i;
         for (i = 0; i < pmh_NUM_TYPES; i++)
             p_data->head_elems[i] = NULL;
@@ -167,49 +286,45 @@ static void parse_references(parser_data *p_data);
 
 
 
+// Initialized statically so that it is safe to use from multiple threads:
+static char *elem_type_names[pmh_NUM_LANG_TYPES] = {
+    [pmh_LINK] = "LINK",
+    [pmh_AUTO_LINK_URL] = "AUTO_LINK_URL",
+    [pmh_AUTO_LINK_EMAIL] = "AUTO_LINK_EMAIL",
+    [pmh_IMAGE] = "IMAGE",
+    [pmh_CODE] = "CODE",
+    [pmh_HTML] = "HTML",
+    [pmh_HTML_ENTITY] = "HTML_ENTITY",
+    [pmh_EMPH] = "EMPH",
+    [pmh_STRONG] = "STRONG",
+    [pmh_LIST_BULLET] = "LIST_BULLET",
+    [pmh_LIST_ENUMERATOR] = "LIST_ENUMERATOR",
+    [pmh_COMMENT] = "COMMENT",
+    [pmh_H1] = "H1",
+    [pmh_H2] = "H2",
+    [pmh_H3] = "H3",
+    [pmh_H4] = "H4",
+    [pmh_H5] = "H5",
+    [pmh_H6] = "H6",
+    [pmh_BLOCKQUOTE] = "BLOCKQUOTE",
+    [pmh_VERBATIM] = "VERBATIM",
+    [pmh_HTMLBLOCK] = "HTMLBLOCK",
+    [pmh_HRULE] = "HRULE",
+    [pmh_REFERENCE] = "REFERENCE",
+    [pmh_FENCEDCODEBLOCK] = "FENCEDCODEBLOCK",
+    [pmh_NOTE] = "NOTE",
+    [pmh_STRIKE] = "STRIKE",
+    [pmh_FRONTMATTER] = "FRONTMATTER",
+    [pmh_DISPLAYFORMULA] = "DISPLAYFORMULA",
+    [pmh_INLINEEQUATION] = "INLINEEQUATION",
+    [pmh_MARK] = "MARK",
+    [pmh_TABLE] = "TABLE",
+    [pmh_TABLEHEADER] = "TABLEHEADER",
+    [pmh_TABLEBORDER] = "TABLEBORDER",
+};
+
 static char **get_element_type_names()
 {
-    static char **elem_type_names = NULL;
-    if (elem_type_names == NULL)
-    {
-        elem_type_names = (char **)malloc(sizeof(char*) * pmh_NUM_LANG_TYPES);
-        int i;
-        for (i = 0; i < pmh_NUM_LANG_TYPES; i++)
-            elem_type_names[i] = NULL;
-        elem_type_names[pmh_LINK] = "LINK";
-        elem_type_names[pmh_AUTO_LINK_URL] = "AUTO_LINK_URL";
-        elem_type_names[pmh_AUTO_LINK_EMAIL] = "AUTO_LINK_EMAIL";
-        elem_type_names[pmh_IMAGE] = "IMAGE";
-        elem_type_names[pmh_CODE] = "CODE";
-        elem_type_names[pmh_HTML] = "HTML";
-        elem_type_names[pmh_HTML_ENTITY] = "HTML_ENTITY";
-        elem_type_names[pmh_EMPH] = "EMPH";
-        elem_type_names[pmh_STRONG] = "STRONG";
-        elem_type_names[pmh_LIST_BULLET] = "LIST_BULLET";
-        elem_type_names[pmh_LIST_ENUMERATOR] = "LIST_ENUMERATOR";
-        elem_type_names[pmh_COMMENT] = "COMMENT";
-        elem_type_names[pmh_H1] = "H1";
-        elem_type_names[pmh_H2] = "H2";
-        elem_type_names[pmh_H3] = "H3";
-        elem_type_names[pmh_H4] = "H4";
-        elem_type_names[pmh_H5] = "H5";
-        elem_type_names[pmh_H6] = "H6";
-        elem_type_names[pmh_BLOCKQUOTE] = "BLOCKQUOTE";
-        elem_type_names[pmh_VERBATIM] = "VERBATIM";
-        elem_type_names[pmh_HTMLBLOCK] = "HTMLBLOCK";
-        elem_type_names[pmh_HRULE] = "HRULE";
-        elem_type_names[pmh_REFERENCE] = "REFERENCE";
-        elem_type_names[pmh_FENCEDCODEBLOCK] = "FENCEDCODEBLOCK";
-        elem_type_names[pmh_NOTE] = "NOTE";
-        elem_type_names[pmh_STRIKE] = "STRIKE";
-        elem_type_names[pmh_FRONTMATTER] = "FRONTMATTER";
-        elem_type_names[pmh_DISPLAYFORMULA] = "DISPLAYFORMULA";
-        elem_type_names[pmh_INLINEEQUATION] = "INLINEEQUATION";
-        elem_type_names[pmh_MARK] = "MARK";
-        elem_type_names[pmh_TABLE] = "TABLE";
-        elem_type_names[pmh_TABLEHEADER] = "TABLEHEADER";
-        elem_type_names[pmh_TABLEBORDER] = "TABLEBORDER";
-    }
     return elem_type_names;
 }
 
@@ -369,6 +484,7 @@ static void process_raw_blocks(parser_data *p_data)
                 
                 // Process subspan_list:
                 parser_data *raw_p_data = mk_parser_data(
+                    p_data->arena,
                     p_data->original_input,
                     p_data->strip_positions,
                     p_data->strip_positions_len,
@@ -379,8 +495,10 @@ static void process_raw_blocks(parser_data *p_data)
                     p_data->head_elems,
                     p_data->references
                 );
+                raw_p_data->original_input_utf16 = p_data->original_input_utf16;
+                raw_p_data->original_input_utf16_len = p_data->original_input_utf16_len;
                 parse_markdown(raw_p_data);
-                free(raw_p_data);
+                pmh_release(p_data->arena, raw_p_data);
                 
                 pmh_PRINTF("parse over\n");
             }
@@ -442,12 +560,12 @@ void pmh_free_elements(pmh_element **elems)
     if (strip_positions_size <= strip_positions_pos) { \
         size_t new_size = strip_positions_size * 2; \
         unsigned long *new_arr = (unsigned long *) \
-                                 calloc(new_size, \
-                                        sizeof(unsigned long)); \
+                                 pmh_alloc(arena, new_size \
+                                           * sizeof(unsigned long)); \
         memcpy(new_arr, strip_positions, \
                (sizeof(unsigned long) * strip_positions_size)); \
         strip_positions_size = new_size; \
-        free(strip_positions); \
+        pmh_release(arena, strip_positions); \
         strip_positions = new_arr; \
     } \
     strip_positions[strip_positions_pos] = x; \
@@ -460,19 +578,19 @@ Copy `str` to `out`, while doing the following:
   - append two newlines to the end (like peg-markdown does)
   - keep track of which bytes we have stripped (in strip_positions)
 */
-static int strcpy_preformat(char *str, char **out,
+static int strcpy_preformat(pmh_arena *arena, char *str, char **out,
                             unsigned long **out_strip_positions,
                             size_t *out_strip_positions_len)
 {
     size_t strip_positions_size = 1024;
     size_t strip_positions_pos = 0;
     unsigned long *strip_positions = (unsigned long *)
-                                     calloc(strip_positions_size,
-                                            sizeof(unsigned long));
+                                     pmh_alloc(arena, strip_positions_size
+                                               * sizeof(unsigned long));
     
     
     // +2 in the following is due to the "\n\n" suffix:
-    char *new_str = (char *)malloc(sizeof(char) * strlen(str) + 1 + 2);
+    char *new_str = (char *)pmh_alloc(arena, sizeof(char) * strlen(str) + 1 + 2);
     char *c = str;
     int i = 0;
     
@@ -503,25 +621,72 @@ static int strcpy_preformat(char *str, char **out,
     return i;
 }
 
+/*
+Copy UTF-16 `str` of `len` code units into `out`, one byte per code unit:
+  - keep ASCII characters as they are
+  - replace every other code unit (including each half of a surrogate pair)
+    with the lead byte of its UTF-8 encoding, which the grammar treats the
+    same way as a whole UTF-8 sequence
+  - add "\n\n" to the end
+Hence offsets in `out` are offsets in `str` without any remapping.
+*/
+static int strcpy_preformat_utf16(pmh_arena *arena,
+                                  const unsigned short *str, size_t len,
+                                  char **out)
+{
+    // +2 in the following is due to the "\n\n" suffix:
+    char *new_str = (char *)pmh_alloc(arena, sizeof(char) * len + 1 + 2);
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        unsigned short c = str[i];
+        if (c == 0)
+            new_str[i] = ' ';
+        else if (c < 0x80)
+            new_str[i] = (char)c;
+        else if (c < 0x800)
+            new_str[i] = (char)(0xC0 | (c >> 6));
+        else
+            new_str[i] = (char)(0xE0 | (c >> 12));
+    }
+    
+    new_str[i++] = '\n';
+    new_str[i++] = '\n';
+    new_str[i] = '\0';
+    
+    *out = new_str;
+    return (int)i;
+}
 
 
-void pmh_markdown_to_elements(char *text, int extensions,
-                              pmh_element **out_result[])
+
+static void markdown_to_elements(pmh_arena *arena, char *text,
+                                 const unsigned short *text_utf16,
+                                 size_t text_utf16_len,
+                                 int extensions,
+                                 pmh_element **out_result[])
 {
     char *text_copy = NULL;
     unsigned long *strip_positions = NULL;
     size_t strip_positions_len = 0;
-    int text_copy_len = strcpy_preformat(text, &text_copy, &strip_positions,
+    int text_copy_len = 0;
+    if (text_utf16 != NULL)
+        text_copy_len = strcpy_preformat_utf16(arena, text_utf16,
+                                               text_utf16_len, &text_copy);
+    else
+        text_copy_len = strcpy_preformat(arena, text, &text_copy,
+                                         &strip_positions,
                                          &strip_positions_len);
     
     pmh_realelement *parsing_elem = (pmh_realelement *)
-                                    malloc(sizeof(pmh_realelement));
+                                    pmh_alloc(arena, sizeof(pmh_realelement));
     parsing_elem->type = pmh_RAW;
     parsing_elem->pos = 0;
     parsing_elem->end = text_copy_len;
     parsing_elem->next = NULL;
     
     parser_data *p_data = mk_parser_data(
+        arena,
         text,
         strip_positions,
         strip_positions_len,
@@ -532,6 +697,8 @@ void pmh_markdown_to_elements(char *text, int extensions,
         NULL,
         NULL
     );
+    p_data->original_input_utf16 = text_utf16;
+    p_data->original_input_utf16_len = text_utf16_len;
     pmh_realelement **result = p_data->head_elems;
     
     if (*text_copy != '\0')
@@ -553,14 +720,37 @@ void pmh_markdown_to_elements(char *text, int extensions,
         process_raw_blocks(p_data);
     }
     
-    free(strip_positions);
-    free(p_data);
-    free(parsing_elem);
-    free(text_copy);
+    pmh_release(arena, strip_positions);
+    pmh_release(arena, p_data);
+    pmh_release(arena, parsing_elem);
+    pmh_release(arena, text_copy);
     
     *out_result = (pmh_element**)result;
 }
 
+void pmh_markdown_to_elements(char *text, int extensions,
+                              pmh_element **out_result[])
+{
+    markdown_to_elements(NULL, text, NULL, 0, extensions, out_result);
+}
+
+void pmh_markdown_to_elements_in_arena(char *text, int extensions,
+                                       pmh_arena *arena,
+                                       pmh_element **out_result[])
+{
+    assert(arena != NULL);
+    markdown_to_elements(arena, text, NULL, 0, extensions, out_result);
+}
+
+void pmh_utf16_markdown_to_elements_in_arena(const unsigned short *text,
+                                             size_t len, int extensions,
+                                             pmh_arena *arena,
+                                             pmh_element **out_result[])
+{
+    assert(arena != NULL);
+    markdown_to_elements(arena, NULL, text, len, extensions, out_result);
+}
+
 
 
 /*
@@ -715,7 +905,8 @@ static pmh_realelement *reverse(pmh_realelement *list)
 static pmh_realelement *mk_element(parser_data *p_data, pmh_element_type type,
                                    long pos, long end)
 {
-    pmh_realelement *result = (pmh_realelement *)malloc(sizeof(pmh_realelement));
+    pmh_realelement *result = (pmh_realelement *)pmh_alloc(p_data->arena,
+                                                           sizeof(pmh_realelement));
     memset(result, 0, sizeof(*result));
     result->type = type;
     result->pos = pos;
@@ -733,9 +924,9 @@ static pmh_realelement *mk_element(parser_data *p_data, pmh_element_type type,
 static pmh_realelement *copy_element(parser_data *p_data, pmh_realelement *elem)
 {
     pmh_realelement *result = mk_element(p_data, elem->type, elem->pos, elem->end);
-    result->label = strdup_or_null(elem->label);
-    result->text = strdup_or_null(elem->text);
-    result->address = strdup_or_null(elem->address);
+    result->label = pmh_strdup(p_data->arena, elem->label);
+    result->text = pmh_strdup(p_data->arena, elem->text);
+    result->address = pmh_strdup(p_data->arena, elem->address);
     return result;
 }
 
@@ -745,7 +936,7 @@ static pmh_realelement *mk_etext(parser_data *p_data, char *string)
     pmh_realelement *result;
     assert(string != NULL);
     result = mk_element(p_data, pmh_EXTRA_TEXT, 0,0);
-    result->text = strdup_or_null(string);
+    result->text = pmh_strdup(p_data->arena, string);
     return result;
 }
 
@@ -883,6 +1074,44 @@ static void add(parser_data *p_data, pmh_realelement *elem)
 }
 
 
+// Encode `len` UTF-16 code units of `str` into a new UTF-8 string:
+static char *utf16_span_to_utf8(pmh_arena *arena,
+                                const unsigned short *str, size_t len)
+{
+    // At most 3 bytes per code unit (a surrogate pair takes 4 bytes):
+    char *ret = (char *)pmh_alloc(arena, sizeof(char) * len * 3 + 1);
+    char *c = ret;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        unsigned long cp = str[i];
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < len
+            && str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF)
+        {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+            i++;
+        }
+        
+        if (cp < 0x80)
+            *c++ = (char)cp;
+        else if (cp < 0x800) {
+            *c++ = (char)(0xC0 | (cp >> 6));
+            *c++ = (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *c++ = (char)(0xE0 | (cp >> 12));
+            *c++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *c++ = (char)(0x80 | (cp & 0x3F));
+        } else {
+            *c++ = (char)(0xF0 | (cp >> 18));
+            *c++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+            *c++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *c++ = (char)(0x80 | (cp & 0x3F));
+        }
+    }
+    *c = '\0';
+    return ret;
+}
+
 // Given a range in the list of spans we use for parsing (pos, end), return
 // a copy of the corresponding section in the original input, with all of
 // the UTF-8 bytes intact:
@@ -906,41 +1135,56 @@ static char *copy_input_span(parser_data *p_data,
             continue;
         }
         
-        // Adjust cursor's span to take bytes stripped from the original
-        // input into account (i.e. match the corresponding span in
-        // p_data->original_input):
-        unsigned long adjusted_pos = cursor->pos;
-        unsigned long adjusted_end = cursor->end;
-        size_t i;
-        for (i = 0; i < p_data->strip_positions_len; i++)
+        char *str = NULL;
+        if (p_data->original_input_utf16 != NULL)
         {
-            unsigned long strip_position = p_data->strip_positions[i];
-            if (strip_position <= adjusted_pos)
-                adjusted_pos++;
-            if (strip_position <= adjusted_end)
-                adjusted_end++;
-            else
-                break;
+            // Offsets match the UTF-16 input so just encode the span,
+            // excluding the "\n\n" suffix which is not in the input:
+            unsigned long end = cursor->end;
+            if (end > p_data->original_input_utf16_len)
+                end = p_data->original_input_utf16_len;
+            str = utf16_span_to_utf8(p_data->arena,
+                                     p_data->original_input_utf16 + cursor->pos,
+                                     end > cursor->pos ? end - cursor->pos : 0);
+        }
+        else
+        {
+            // Adjust cursor's span to take bytes stripped from the original
+            // input into account (i.e. match the corresponding span in
+            // p_data->original_input):
+            unsigned long adjusted_pos = cursor->pos;
+            unsigned long adjusted_end = cursor->end;
+            size_t i;
+            for (i = 0; i < p_data->strip_positions_len; i++)
+            {
+                unsigned long strip_position = p_data->strip_positions[i];
+                if (strip_position <= adjusted_pos)
+                    adjusted_pos++;
+                if (strip_position <= adjusted_end)
+                    adjusted_end++;
+                else
+                    break;
+            }
+            
+            // Copy span from original input:
+            size_t adjusted_len = adjusted_end - adjusted_pos;
+            str = (char *)pmh_alloc(p_data->arena, sizeof(char)*adjusted_len + 1);
+            *str = '\0';
+            strncat(str, (p_data->original_input + adjusted_pos), adjusted_len);
         }
-        
-        // Copy span from original input:
-        size_t adjusted_len = adjusted_end - adjusted_pos;
-        char *str = (char *)malloc(sizeof(char)*adjusted_len + 1);
-        *str = '\0';
-        strncat(str, (p_data->original_input + adjusted_pos), adjusted_len);
         
         if (ret == NULL)
             ret = str;
         else
         {
             // append str to ret:
-            char *new_ret = (char *)malloc(sizeof(char)
-                                           *(strlen(str) + strlen(ret)) + 1);
+            char *new_ret = (char *)pmh_alloc(p_data->arena, sizeof(char)
+                                              *(strlen(str) + strlen(ret)) + 1);
             *new_ret = '\0';
             strcat(new_ret, ret);
             strcat(new_ret, str);
-            free(ret);
-            free(str);
+            pmh_release(p_data->arena, ret);
+            pmh_release(p_data->arena, str);
             ret = new_ret;
         }
         
@@ -1023,8 +1267,9 @@ static void yy_input_func(char *buf, int *result, int max_size,
 #define REF_EXISTS(x) reference_exists((parser_data *)G->data, x)
 #define GET_REF(x)  get_reference((parser_data *)G->data, x)
 #define PARSING_REFERENCES ((parser_data *)G->data)->parsing_only_references
-#define FREE_LABEL(l) { free(l->label); l->label = NULL; }
-#define FREE_ADDRESS(l) { free(l->address); l->address = NULL; }
+#define STRDUP(x)   pmh_strdup(((parser_data *)G->data)->arena, x)
+#define FREE_LABEL(l) { pmh_release(((parser_data *)G->data)->arena, l->label); l->label = NULL; }
+#define FREE_ADDRESS(l) { pmh_release(((parser_data *)G->data)->arena, l->address); l->address = NULL; }
 
 // This gives us the text matched with < > as it appears in the original input:
 #define COPY_YYTEXT_ORIG() copy_input_span((parser_data *)G->data, thunk->begin, thunk->end)
@@ -1060,32 +1305,36 @@ bool strike_predict_post(char *buf, int pos)
 
 #define STRIKE_POST     strike_predict_post(G->buf, G->pos)
 
-// Number of display formula raw opening
-unsigned char nr_dfr = 0;
-
-bool start_dfr()
+// Number of display formula raw opening is kept in parser_data to keep
+// concurrent parses independent
+bool start_dfr(parser_data *p_data)
 {
-    nr_dfr = 1;
+    p_data->nr_dfr = 1;
     return true;
 }
 
-bool inc_dfr()
+bool inc_dfr(parser_data *p_data)
 {
-    ++nr_dfr;
+    ++p_data->nr_dfr;
     return true;
 }
 
-bool dec_dfr()
+bool dec_dfr(parser_data *p_data)
 {
-    --nr_dfr;
+    --p_data->nr_dfr;
     return true;
 }
 
-bool nested_dfr()
+bool nested_dfr(parser_data *p_data)
 {
-    return nr_dfr > 1;
+    return p_data->nr_dfr > 1;
 }
 
+#define START_DFR       start_dfr((parser_data *)G->data)
+#define INC_DFR         inc_dfr((parser_data *)G->data)
+#define DEC_DFR         dec_dfr((parser_data *)G->data)
+#define NESTED_DFR      nested_dfr((parser_data *)G->data)
+
 
 #ifndef YY_ALLOC
 #define YY_ALLOC(N, D) malloc(N)
@@ -1732,8 +1981,8 @@ YY_ACTION(void) yy_1_Reference(GREG *G, char *yytext, int yyleng, yythunk *thunk
   yyprintf((stderr, "do yy_1_Reference\n"));
   
                 pmh_realelement *el = elem_s(pmh_REFERENCE);
-                el->label = strdup_or_null(l->label);
-                el->address = strdup_or_null(r->address);
+                el->label = STRDUP(l->label);
+                el->address = STRDUP(r->address);
                 ADD(el);
                 FREE_LABEL(l);
                 FREE_ADDRESS(r);
@@ -1813,7 +2062,7 @@ YY_ACTION(void) yy_1_ExplicitLinkSize(GREG *G, char *yytext, int yyleng, yythunk
   
                         yy = elem_s(pmh_LINK);
                         if (l->address != NULL)
-                            yy->address = strdup_or_null(l->address);
+                            yy->address = STRDUP(l->address);
                         FREE_LABEL(s);
                         FREE_ADDRESS(l);
                     ;
@@ -1828,7 +2077,7 @@ YY_ACTION(void) yy_1_ExplicitLink(GREG *G, char *yytext, int yyleng, yythunk *th
   
                     yy = elem_s(pmh_LINK);
                     if (l->address != NULL)
-                        yy->address = strdup_or_null(l->address);
+                        yy->address = STRDUP(l->address);
                     FREE_LABEL(s);
                     FREE_ADDRESS(l);
                 ;
@@ -1843,8 +2092,8 @@ YY_ACTION(void) yy_1_ReferenceLinkSingle(GREG *G, char *yytext, int yyleng, yyth
                         	pmh_realelement *reference = GET_REF(s->label);
                             if (reference) {
                                 yy = elem_s(pmh_LINK);
-                                yy->label = strdup_or_null(s->label);
-                                yy->address = strdup_or_null(reference->address);
+                                yy->label = STRDUP(s->label);
+                                yy->address = STRDUP(reference->address);
                             } else
                                 yy = NULL;
                             FREE_LABEL(s);
@@ -1860,8 +2109,8 @@ YY_ACTION(void) yy_1_ReferenceLinkDouble(GREG *G, char *yytext, int yyleng, yyth
                         	pmh_realelement *reference = GET_REF(l->label);
                             if (reference) {
                                 yy = elem_s(pmh_LINK);
-                                yy->label = strdup_or_null(l->label);
-                                yy->address = strdup_or_null(reference->address);
+                                yy->label = STRDUP(l->label);
+                                yy->address = STRDUP(reference->address);
                             } else
                                 yy = NULL;
                             FREE_LABEL(s);
@@ -6459,11 +6708,11 @@ YY_RULE(int) yy_DisplayFormulaDollarMark(GREG *G)
 }
 YY_RULE(int) yy_DisplayFormulaRaw(GREG *G)
 {  int yypos0= G->pos, yythunkpos0= G->thunkpos;
-  yyprintf((stderr, "%s\n", "DisplayFormulaRaw"));  yyText(G, G->begin, G->end);  if (!( EXT(pmh_EXT_MATH_RAW) )) goto l1396;  if (!yy_NonindentSpace(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!(YY_BEGIN)) goto l1396;  if (!yy_DisplayFormulaRawStart(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!( start_dfr() )) goto l1396;  if (!yy_Spnl(G)) { goto l1396; }
+  yyprintf((stderr, "%s\n", "DisplayFormulaRaw"));  yyText(G, G->begin, G->end);  if (!( EXT(pmh_EXT_MATH_RAW) )) goto l1396;  if (!yy_NonindentSpace(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!(YY_BEGIN)) goto l1396;  if (!yy_DisplayFormulaRawStart(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!( START_DFR )) goto l1396;  if (!yy_Spnl(G)) { goto l1396; }
   l1397:;	
   {  int yypos1398= G->pos, yythunkpos1398= G->thunkpos;
-  {  int yypos1399= G->pos, yythunkpos1399= G->thunkpos;  if (!yy_DisplayFormulaRawStart(G)) { goto l1400; }  yyText(G, G->begin, G->end);  if (!( inc_dfr() )) goto l1400;  goto l1399;
-  l1400:;	  G->pos= yypos1399; G->thunkpos= yythunkpos1399;  yyText(G, G->begin, G->end);  if (!( nested_dfr() )) goto l1401;  if (!yy_DisplayFormulaRawEnd(G)) { goto l1401; }  yyText(G, G->begin, G->end);  if (!( dec_dfr() )) goto l1401;  goto l1399;
+  {  int yypos1399= G->pos, yythunkpos1399= G->thunkpos;  if (!yy_DisplayFormulaRawStart(G)) { goto l1400; }  yyText(G, G->begin, G->end);  if (!( INC_DFR )) goto l1400;  goto l1399;
+  l1400:;	  G->pos= yypos1399; G->thunkpos= yythunkpos1399;  yyText(G, G->begin, G->end);  if (!( NESTED_DFR )) goto l1401;  if (!yy_DisplayFormulaRawEnd(G)) { goto l1401; }  yyText(G, G->begin, G->end);  if (!( DEC_DFR )) goto l1401;  goto l1399;
   l1401:;	  G->pos= yypos1399; G->thunkpos= yythunkpos1399;
   {  int yypos1402= G->pos, yythunkpos1402= G->thunkpos;  if (!yy_DisplayFormulaRawEnd(G)) { goto l1402; }  goto l1398;
   l1402:;	  G->pos= yypos1402; G->thunkpos= yythunkpos1402;
@@ -6481,7 +6730,7 @@ YY_RULE(int) yy_DisplayFormulaRaw(GREG *G)
   }
   l1399:;	  goto l1397;
   l1398:;	  G->pos= yypos1398; G->thunkpos= yythunkpos1398;
-  }  yyText(G, G->begin, G->end);  if (!( !nested_dfr() )) goto l1396;  if (!yy_DisplayFormulaRawEnd(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!( dec_dfr() )) goto l1396;  yyText(G, G->begin, G->end);  if (!(YY_END)) goto l1396;  if (!yy_Sp(G)) { goto l1396; }  if (!yy_Newline(G)) { goto l1396; }  yyDo(G, yy_1_DisplayFormulaRaw, G->begin, G->end);
+  }  yyText(G, G->begin, G->end);  if (!( !NESTED_DFR )) goto l1396;  if (!yy_DisplayFormulaRawEnd(G)) { goto l1396; }  yyText(G, G->begin, G->end);  if (!( DEC_DFR )) goto l1396;  yyText(G, G->begin, G->end);  if (!(YY_END)) goto l1396;  if (!yy_Sp(G)) { goto l1396; }  if (!yy_Newline(G)) { goto l1396; }  yyDo(G, yy_1_DisplayFormulaRaw, G->begin, G->end);
   yyprintf((stderr, "  ok   %s @ %s\n", "DisplayFormulaRaw", G->buf+G->pos));
   return 1;
   l1396:;	  G->pos= yypos0; G->thunkpos= yythunkpos0;
@@ -39,6 +39,89 @@
 void pmh_markdown_to_elements(char *text, int extensions,
                               pmh_element **out_result[]);
 
+/**
+* \brief Arena owning the memory of parse results
+* 
+* Allocations from an arena are bump-allocated from large chunks and are
+* released all at once by pmh_arena_free().
+* 
+* \sa pmh_markdown_to_elements_in_arena
+*/
+typedef struct pmh_Arena pmh_arena;
+
+/**
+* \brief Create an empty arena
+* 
+* \return A new arena. You must pass this to pmh_arena_free() when it's
+*         not needed anymore.
+*/
+pmh_arena *pmh_arena_new();
+
+/**
+* \brief Allocate memory from an arena
+* 
+* \param[in]  arena  The arena to allocate from.
+* \param[in]  size   Number of bytes to allocate.
+* 
+* \return Memory aligned to 16 bytes, valid until the arena is freed.
+*/
+void *pmh_arena_alloc(pmh_arena *arena, size_t size);
+
+/**
+* \brief Get the number of bytes reserved by an arena
+*/
+size_t pmh_arena_size(pmh_arena *arena);
+
+/**
+* \brief Free an arena and everything allocated from it
+* 
+* \param[in]  arena  The arena to free. May be NULL.
+*/
+void pmh_arena_free(pmh_arena *arena);
+
+/**
+* \brief Parse Markdown text into an arena, return elements
+* 
+* Same as pmh_markdown_to_elements() except that all the elements and the
+* returned array are allocated from the given arena. The result must NOT be
+* passed to pmh_free_elements(); it is valid until the arena is freed.
+* 
+* \param[in]  text        The Markdown text to parse for highlighting.
+* \param[in]  extensions  The extensions to use in parsing (a bitfield
+*                         of pmh_extensions values).
+* \param[in]  arena       The arena to allocate the results from.
+* \param[out] out_result  A pmh_element array, indexed by type, containing
+*                         the results of the parsing (linked lists of elements).
+* 
+* \sa pmh_markdown_to_elements
+*/
+void pmh_markdown_to_elements_in_arena(char *text, int extensions,
+                                       pmh_arena *arena,
+                                       pmh_element **out_result[]);
+
+/**
+* \brief Parse UTF-16 Markdown text into an arena, return elements
+* 
+* Same as pmh_markdown_to_elements_in_arena() except that the input is
+* UTF-16 and is read in place. Offsets of the resulting elements are in
+* UTF-16 code units, so a surrogate pair counts as two.
+* 
+* \param[in]  text        The UTF-16 Markdown text to parse for highlighting.
+*                         It must be kept alive during the parsing.
+* \param[in]  len         Number of code units of text.
+* \param[in]  extensions  The extensions to use in parsing (a bitfield
+*                         of pmh_extensions values).
+* \param[in]  arena       The arena to allocate the results from.
+* \param[out] out_result  A pmh_element array, indexed by type, containing
+*                         the results of the parsing (linked lists of elements).
+* 
+* \sa pmh_markdown_to_elements_in_arena
+*/
+void pmh_utf16_markdown_to_elements_in_arena(const unsigned short *text,
+                                             size_t len, int extensions,
+                                             pmh_arena *arena,
+                                             pmh_element **out_result[]);
+
 /**
 * \brief Sort elements in list by start offset.
 * 
@@ -2,9 +2,9 @@
 #define CODEBLOCKHIGHLIGHTER_H
 
 #include <QObject>
+#include <QPair>
 
 #include <vtextedit/global.h>
-#include <vtextedit/lrucache.h>
 #include <vtextedit/pegmarkdownhighlighterdata.h>
 
 namespace vte {
@@ -37,25 +37,26 @@ public:
     HighlightStyles m_highlights;
   };
 
-  struct CacheEntry {
-    CacheEntry() = default;
-
-    CacheEntry(TimeStamp p_timeStamp, const HighlightStyles &p_highlights)
-        : m_timeStamp(p_timeStamp), m_highlights(p_highlights) {}
-
-    bool isNull() const { return m_timeStamp == 0; }
-
-    TimeStamp m_timeStamp = 0;
-    HighlightStyles m_highlights;
-  };
-
   explicit CodeBlockHighlighter(QObject *p_parent);
 
   virtual ~CodeBlockHighlighter() {}
 
-  void highlight(TimeStamp p_timeStamp, const QVector<peg::FencedCodeBlock> &p_codeBlocks);
+  // @p_priorityBlocks: code blocks crossing this block range are handled first, inclusive.
+  void highlight(TimeStamp p_timeStamp, const QVector<peg::FencedCodeBlock> &p_codeBlocks,
+                 const QPair<int, int> &p_priorityBlocks = qMakePair(-1, -1));
+
+  // Set the file to keep highlight results shared by all the highlighters across sessions.
+  // Empty to keep them in memory only. It should be called after QCoreApplication is created.
+  static void setCacheFile(const QString &p_filePath);
 
 protected:
+  // Called before a new highlight, which could cancel the one in progress.
+  virtual void cancelHighlight() {}
+
+  // Identify the highlighter and its styles in the cache shared by all the highlighters.
+  // Defaults to the class name. Override it if the styles differ between instances.
+  virtual QString cacheScope() const;
+
   // @p_idx Index in m_codeBlocks.
   virtual void highlightInternal(int p_idx) = 0;
 
@@ -71,7 +72,8 @@ signals:
 private:
   void addToCache(const HighlightResult &p_result);
 
-  LruCache<QString, CacheEntry> m_cache;
+  // cacheScope() of current highlight.
+  QString m_cacheScope;
 };
 } // namespace vte
 
@@ -1,59 +1,71 @@
 #ifndef LRUCACHE_H
 #define LRUCACHE_H
 
+#include <functional>
+#include <utility>
+
 #include <QHash>
-#include <QLinkedList>
+#include <QVector>
 
 namespace vte {
+// Nodes live in a vector with the LRU list linked by their indexes, and the hash maps keys to
+// the indexes. Touching an entry only relinks it, and the slots of evicted entries are reused.
+// Entries are evicted by count, or by cost in bytes once a memory budget is set.
 template <typename _Key, typename _Val> class LruCache {
 public:
+  typedef std::function<void(const _Key &, const _Val &)> EvictionHandler;
+
+  // Return the estimated memory in bytes of an entry.
+  typedef std::function<qint64(const _Key &, const _Val &)> CostFunction;
+
   LruCache(int p_capacity, const _Val &p_dummyValue)
       : m_capacity(p_capacity), m_dummyValue(p_dummyValue) {}
 
-  size_t size() const {
-    Q_ASSERT(m_hash.size() == m_list.size());
-    return m_hash.size();
-  }
+  size_t size() const { return m_indexes.size(); }
+
+  bool contains(const _Key &p_key) const { return m_indexes.contains(p_key); }
 
   _Val &get(const _Key &p_key) {
-    auto iter = m_hash.find(p_key);
-    if (iter == m_hash.end()) {
+    auto iter = m_indexes.constFind(p_key);
+    if (iter == m_indexes.constEnd()) {
       return m_dummyValue;
     }
-    iter.value() = moveBackOfList(iter.value());
-    return iter.value()->m_value;
+
+    const int idx = iter.value();
+    moveToBack(idx);
+    return m_nodes[idx].m_value;
   }
 
-  void set(const _Key &p_key, const _Val &p_val) {
-    auto iter = m_hash.find(p_key);
-    if (iter != m_hash.end()) {
+  template <typename _V> void set(const _Key &p_key, _V &&p_val) {
+    auto iter = m_indexes.constFind(p_key);
+    if (iter != m_indexes.constEnd()) {
       // Replace it.
-      auto nodeIter = moveBackOfList(iter.value());
-      nodeIter->m_value = p_val;
-      iter.value() = nodeIter;
+      const int idx = iter.value();
+      auto &node = m_nodes[idx];
+      node.m_value = std::forward<_V>(p_val);
+      updateCost(node);
+      moveToBack(idx);
+      shrink(idx);
       return;
     }
 
-    if (static_cast<size_t>(m_capacity) <= size()) {
-      // Use the LRU node for the new value.
-      auto nodeIter = m_list.begin();
-      auto iter = m_hash.find(nodeIter->m_key);
-      nodeIter = moveBackOfList(nodeIter);
-      nodeIter->m_key = p_key;
-      nodeIter->m_value = p_val;
-
-      m_hash.erase(iter);
-      m_hash.insert(p_key, nodeIter);
-      return;
-    }
-
-    // Simply insert.
-    auto nodeIter = m_list.insert(m_list.end(), Node(p_key, p_val));
-    m_hash.insert(p_key, nodeIter);
+    const int idx = allocateNode();
+    auto &node = m_nodes[idx];
+    node.m_key = p_key;
+    node.m_value = std::forward<_V>(p_val);
+    updateCost(node);
+    linkBack(idx);
+    m_indexes.insert(p_key, idx);
+    shrink(idx);
   }
 
   // Set hints about capacity.
+  // Ignored with a memory budget.
   void setCapacityHint(int p_capacity) {
+    if (m_budget > 0) {
+      return;
+    }
+
     if (p_capacity < m_capacity / 2) {
       if (++m_numOfReduce == 5) {
         m_numOfReduce = 0;
@@ -66,36 +78,137 @@ public:
       }
     }
 
-    shrink();
+    shrink(-1);
+  }
+
+  int capacity() const { return m_capacity; }
+
+  // Evict entries by the total cost of @p_costFunc instead of count once @p_bytes is positive.
+  // The most recently used entry is kept even if it exceeds @p_bytes alone.
+  void setMemoryBudget(qint64 p_bytes, const CostFunction &p_costFunc) {
+    m_budget = p_bytes;
+    m_costFunc = p_costFunc;
+
+    m_totalCost = 0;
+    for (int idx = m_head; idx != -1; idx = m_nodes[idx].m_next) {
+      updateCost(m_nodes[idx]);
+    }
+
+    shrink(m_tail);
   }
 
+  qint64 totalCost() const { return m_totalCost; }
+
   void clear() {
-    m_hash.clear();
-    m_list.clear();
+    m_indexes.clear();
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_head = m_tail = -1;
+    m_totalCost = 0;
+  }
+
+  // @p_handler will be called with each entry evicted to make room. It should not access this
+  // cache.
+  void setEvictionHandler(const EvictionHandler &p_handler) { m_evictionHandler = p_handler; }
+
+  // Call @p_func with the key and value of each entry from the least recently used one.
+  template <typename _Func> void forEach(_Func p_func) const {
+    for (int idx = m_head; idx != -1; idx = m_nodes[idx].m_next) {
+      const auto &node = m_nodes[idx];
+      p_func(node.m_key, node.m_value);
+    }
   }
 
 private:
   struct Node {
-    Node(const _Key &p_key, const _Val &p_val) : m_key(p_key), m_value(p_val) {}
-
     _Key m_key;
     _Val m_value;
+
+    qint64 m_cost = 0;
+
+    // Indexes of the neighbours in the LRU list, -1 for none.
+    int m_prev = -1;
+    int m_next = -1;
   };
 
-  typedef typename QLinkedList<Node>::iterator _Iterator;
+  int allocateNode() {
+    if (!m_freeNodes.isEmpty()) {
+      return m_freeNodes.takeLast();
+    }
+
+    m_nodes.push_back(Node());
+    return m_nodes.size() - 1;
+  }
 
-  _Iterator moveBackOfList(_Iterator p_node) {
-    Node node = *p_node;
-    m_list.erase(p_node);
-    return m_list.insert(m_list.end(), node);
+  void updateCost(Node &p_node) {
+    m_totalCost -= p_node.m_cost;
+    p_node.m_cost = m_costFunc ? m_costFunc(p_node.m_key, p_node.m_value) : 0;
+    m_totalCost += p_node.m_cost;
   }
 
-  void shrink() {
-    while (m_list.size() > m_capacity) {
-      auto nodeIter = m_list.begin();
-      auto iter = m_hash.find(nodeIter->m_key);
-      m_hash.erase(iter);
-      m_list.erase(nodeIter);
+  void unlink(int p_idx) {
+    auto &node = m_nodes[p_idx];
+    if (node.m_prev != -1) {
+      m_nodes[node.m_prev].m_next = node.m_next;
+    } else {
+      m_head = node.m_next;
+    }
+
+    if (node.m_next != -1) {
+      m_nodes[node.m_next].m_prev = node.m_prev;
+    } else {
+      m_tail = node.m_prev;
+    }
+
+    node.m_prev = node.m_next = -1;
+  }
+
+  void linkBack(int p_idx) {
+    auto &node = m_nodes[p_idx];
+    node.m_prev = m_tail;
+    node.m_next = -1;
+    if (m_tail != -1) {
+      m_nodes[m_tail].m_next = p_idx;
+    } else {
+      m_head = p_idx;
+    }
+    m_tail = p_idx;
+  }
+
+  void moveToBack(int p_idx) {
+    if (p_idx == m_tail) {
+      return;
+    }
+
+    unlink(p_idx);
+    linkBack(p_idx);
+  }
+
+  bool isOverLimit() const {
+    if (m_budget > 0) {
+      return m_totalCost > m_budget;
+    }
+    return m_indexes.size() > m_capacity;
+  }
+
+  // Evict from the LRU one until within the limit, except @p_keepIdx.
+  void shrink(int p_keepIdx) {
+    while (m_head != -1 && m_head != p_keepIdx && isOverLimit()) {
+      const int idx = m_head;
+      auto &node = m_nodes[idx];
+      if (m_evictionHandler) {
+        m_evictionHandler(node.m_key, node.m_value);
+      }
+
+      m_indexes.remove(node.m_key);
+      unlink(idx);
+      m_totalCost -= node.m_cost;
+
+      // Release the memory held now.
+      node.m_key = _Key();
+      node.m_value = _Val();
+      node.m_cost = 0;
+      m_freeNodes.push_back(idx);
     }
   }
 
@@ -103,11 +216,27 @@ private:
 
   int m_numOfReduce = 0;
 
+  // Memory budget in bytes, 0 to limit by m_capacity.
+  qint64 m_budget = 0;
+
+  qint64 m_totalCost = 0;
+
+  CostFunction m_costFunc;
+
   _Val m_dummyValue;
 
-  QHash<_Key, _Iterator> m_hash;
+  QHash<_Key, int> m_indexes;
+
+  QVector<Node> m_nodes;
+
+  // Indexes of unused slots in m_nodes.
+  QVector<int> m_freeNodes;
+
+  // The least and most recently used nodes.
+  int m_head = -1;
+  int m_tail = -1;
 
-  QLinkedList<Node> m_list;
+  EvictionHandler m_evictionHandler;
 };
 } // namespace vte
 
@@ -28,6 +28,14 @@ public:
   // block syntax highlight.
   bool m_webCodeBlockHighlighterEnabled = true;
 
+  // Number of threads of KSyntaxCodeBlockHighlighter to highlight code blocks concurrently.
+  // 0 to highlight them on the GUI thread.
+  int m_codeBlockHighlightWorkerCount = 2;
+
+  // Whether layout blocks far from the viewport lazily with estimated heights, which speeds up
+  // opening large documents at the cost of a scroll bar that is adjusted while scrolling.
+  bool m_lazyLayoutEnabled = false;
+
 private:
   void overrideTextStyle();
 };
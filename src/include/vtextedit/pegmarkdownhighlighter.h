@@ -1,7 +1,10 @@
 #ifndef PEGMARKDOWNHIGHLIGHTER_H
 #define PEGMARKDOWNHIGHLIGHTER_H
 
+#include <climits>
+
 #include <QElapsedTimer>
+#include <QScopedPointer>
 #include <QTextCharFormat>
 
 #include <vtextedit/codeblockhighlighter.h>
@@ -20,6 +23,7 @@ class PegHighlighterResult;
 class PegHighlighterFastResult;
 class Theme;
 class PegHighlightBlockData;
+class EditJournal;
 
 class PegMarkdownHighlighterInterface {
 public:
@@ -49,6 +53,8 @@ public:
                          CodeBlockHighlighter *p_codeBlockHighlighter,
                          const QSharedPointer<peg::HighlighterConfig> &p_config);
 
+  ~PegMarkdownHighlighter();
+
   void setTheme(const QSharedPointer<Theme> &p_theme);
 
   const QSet<int> &getPossiblePreviewBlocks() const;
@@ -77,6 +83,7 @@ public slots:
   void updateHighlight();
 
 signals:
+  // Emitted when a parse result has been applied to all the blocks.
   void highlightCompleted();
 
   // QVector is implicitly shared.
@@ -102,10 +109,15 @@ private slots:
 
   void startParse();
 
+  void startFullParse();
+
   void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
 
   void handleCodeBlockHighlightResult(const CodeBlockHighlighter::HighlightResult &p_result);
 
+  // Apply a progressive m_result to the rest blocks for a time slice.
+  void continueProgressiveHighlight();
+
 private:
   // To avoid line height jitter and code block mess.
   bool preHighlightSingleFormatBlock(const QVector<QVector<peg::HLUnit>> &p_highlights,
@@ -122,14 +134,18 @@ private:
 
   TimeStamp nextCodeBlockTimeStamp();
 
-  void appendSingleFormatBlocks(const QVector<QVector<peg::HLUnit>> &p_highlights);
+  void appendSingleFormatBlocks(const QVector<QVector<peg::HLUnit>> &p_highlights,
+                                int p_first = 0, int p_last = INT_MAX);
 
-  void clearAllBlocksUserDataAndState(const QSharedPointer<PegHighlighterResult> &p_result);
+  // Handle blocks within [p_first, p_last].
+  void clearBlocksUserDataAndState(const QSharedPointer<PegHighlighterResult> &p_result,
+                                   int p_first, int p_last);
 
   void clearBlockUserData(const QSharedPointer<PegHighlighterResult> &p_result,
                           QTextBlock &p_block);
 
-  void updateAllBlocksUserDataAndState(const QSharedPointer<PegHighlighterResult> &p_result);
+  void updateBlocksUserDataAndState(const QSharedPointer<PegHighlighterResult> &p_result,
+                                    int p_first, int p_last);
 
   void updateCodeBlocks(const QSharedPointer<PegHighlighterResult> &p_result);
 
@@ -143,6 +159,32 @@ private:
 
   bool isMathEnabled() const;
 
+  // Visible blocks with some extra blocks around.
+  QPair<int, int> sensitiveBlockRange() const;
+
+  // Return the blocks to handle first if @p_result should be applied progressively.
+  // Return [-1, -1] otherwise.
+  QPair<int, int> progressiveBlockRange(const QSharedPointer<peg::PegParseResult> &p_result) const;
+
+  // Re-parse only the top-level blocks affected by changes since m_parseResult.
+  // Return false if incremental parse is not applicable.
+  bool startIncrementalParse();
+
+  // Expand [p_firstBlock, p_lastBlock] to cover elements of m_parseResult crossing it.
+  // Return false if the range is not suitable for an incremental parse.
+  bool expandIncrementalParseBlockRange(QTextBlock &p_firstBlock, QTextBlock &p_lastBlock) const;
+
+  // Fetch the text of reference definitions of m_parseResult out of the range.
+  QString fetchReferenceDefinitions(int p_start, int p_baseEnd, int p_delta) const;
+
+  // Rebase @p_result of a stale @p_parseResult onto the current document, which is the
+  // document of @p_parseResult with @p_change applied. Blocks touched by @p_change are left to
+  // a fast parse.
+  // Return false if @p_result could not be rebased.
+  bool rebaseResult(const QSharedPointer<PegHighlighterResult> &p_result,
+                    const QSharedPointer<peg::PegParseResult> &p_parseResult,
+                    const ContentsChange &p_change);
+
   void startFastParse(int p_position, int p_charsRemoved, int p_charsAdded);
 
   void getFastParseBlockRange(int p_position, int p_charsRemoved, int p_charsAdded,
@@ -194,6 +236,15 @@ private:
 
   QSharedPointer<PegHighlighterResult> m_result;
 
+  // The latest matched parse result, which is the base of incremental parse.
+  QSharedPointer<peg::PegParseResult> m_parseResult;
+
+  // Merged contents change since m_parseResult.
+  ContentsChange m_parseResultChange;
+
+  // Contents changes since m_parseResult to rebase stale parse results.
+  QScopedPointer<EditJournal> m_editJournal;
+
   QSharedPointer<PegHighlighterFastResult> m_fastResult;
 
   // Block range of fast parse, inclusive.
@@ -219,6 +270,13 @@ private:
   // Managed by QObject.
   QTimer *m_scrollRehighlightTimer = nullptr;
 
+  // Timer to continue applying a progressive result.
+  // Managed by QObject.
+  QTimer *m_progressiveTimer = nullptr;
+
+  // Next block to apply a progressive result.
+  int m_nextProgressiveBlock = 0;
+
   // Block number of those blocks which possible contains previewed image.
   QSet<int> m_possiblePreviewBlocks;
 
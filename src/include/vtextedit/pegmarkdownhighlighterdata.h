@@ -15,6 +15,13 @@ public:
 
   // Whether enable code block syntax highlight.
   bool m_codeBlockHighlightEnabled = true;
+
+  // Number of worker threads of the markdown parser.
+  int m_parserWorkerCount = 2;
+
+  // Whether apply a new parse result to visible blocks first and then to the rest
+  // blocks piece by piece for large documents.
+  bool m_progressiveHighlightEnabled = true;
 };
 
 enum HighlightBlockState {
@@ -156,6 +163,17 @@ struct VTEXTEDIT_EXPORT FencedCodeBlock {
     return m_highlights[p_blockNumber - m_startBlock];
   }
 
+  // 64-bit FNV-1a hash of the UTF-16 units of @p_text.
+  static quint64 hashText(const QString &p_text) {
+    quint64 hash = 14695981039346656037ULL;
+    const ushort *data = p_text.utf16();
+    for (int i = 0; i < p_text.size(); ++i) {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
   // Global position of the start.
   int m_startPos = 0;
 
@@ -167,6 +185,10 @@ struct VTEXTEDIT_EXPORT FencedCodeBlock {
 
   QString m_text;
 
+  // Hash of m_text via hashText(), which is calculated along with m_text off the GUI thread.
+  // 0 if not calculated.
+  quint64 m_textHash = 0;
+
   // Highlights for [m_startBlock, m_endBlock].
   QVector<QVector<HLUnitStyle>> m_highlights;
 };
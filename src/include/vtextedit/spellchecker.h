@@ -4,6 +4,7 @@
 #include <vtextedit/vtextedit_export.h>
 
 #include <QMap>
+#include <QMutex>
 #include <QScopedPointer>
 #include <QStringList>
 
@@ -42,6 +43,11 @@ public:
 
   void addToDictionary(const QString &p_word);
 
+  // Return the words ignored or added to dictionary in this session, starting from @p_from.
+  // Spell check workers use their own spellers and catch up with these words.
+  // Thread-safe.
+  QStringList acceptedWords(int p_from) const;
+
   QStringList suggest(const QString &p_word, bool p_autoDetectEnabled);
 
   static void addDictionaryCustomSearchPaths(const QStringList &p_dirs);
@@ -58,6 +64,11 @@ private:
   QScopedPointer<Sonnet::WordTokenizer> m_wordTokenizer;
 
   QMap<QString, QString> m_dictionaries;
+
+  // Guard m_acceptedWords.
+  mutable QMutex m_acceptedWordsMutex;
+
+  QStringList m_acceptedWords;
 };
 } // namespace vte
 
@@ -3,6 +3,7 @@
 
 #include <QJsonObject>
 #include <QSharedPointer>
+#include <QString>
 
 #include "vtextedit_export.h"
 
@@ -21,6 +22,9 @@ public:
   QSharedPointer<KateViI::KateViConfig> toKateViConfig() const;
 
   bool m_controlCToCopy = false;
+
+  // File to store macros, registers and histories across sessions. Empty to disable.
+  QString m_storeFile;
 };
 } // namespace vte
 
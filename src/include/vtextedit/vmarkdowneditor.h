@@ -51,6 +51,10 @@ public:
 
   static void setExternalCodeBlockHighlihgtStyles(const ExternalCodeBlockHighlightStyles &p_styles);
 
+  // Set the file to keep code block highlight results across sessions. Empty to keep them in
+  // memory only. Defaults to a file in the cache location once the first editor is created.
+  static void setCodeBlockHighlightCacheFile(const QString &p_filePath);
+
 public slots:
   // Used when using WebCodeBlockHighlighter.
   void handleExternalCodeBlockHighlightData(int p_idx, TimeStamp p_timeStamp,
@@ -66,6 +70,9 @@ protected:
 private:
   void setupDocumentLayout();
 
+  // Tell the document layout the viewport of m_textEdit.
+  void updateDocumentLayoutViewport();
+
   void setupSyntaxHighlighter();
 
   void setupPreviewMgr();
@@ -102,6 +109,8 @@ private:
 
   // Managed by QObject.
   WebCodeBlockHighlighter *m_webCodeBlockHighlighter = nullptr;
+
+  static bool s_codeBlockHighlightCacheFileSet;
 };
 } // namespace vte
 
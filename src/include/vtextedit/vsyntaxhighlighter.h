@@ -6,6 +6,7 @@
 
 namespace vte {
 struct BlockSpellCheckData;
+class SpellCheckWorker;
 
 class VSyntaxHighlighter : public QSyntaxHighlighter {
   Q_OBJECT
@@ -18,18 +19,51 @@ public:
 
   void setAutoDetectLanguageEnabled(bool p_enabled);
 
+  // Default language of the spell check worker.
+  void setSpellCheckLanguage(const QString &p_lang);
+
   virtual bool isSyntaxFoldingEnabled() const;
 
+  // Return the number of the block closing the syntax folding starting on @p_blockNumber.
+  // Return -1 if there is no syntax folding starting on it.
+  // Return the block count if the folding spans to the end of the document.
+  virtual int findSyntaxFoldingEnd(int p_blockNumber);
+
   void refreshSpellCheck();
 
   void refreshBlockSpellCheck(const QTextBlock &p_block);
 
+  // Blocks within [@p_first, @p_last] will be spell checked first, mainly visible blocks.
+  void setSpellCheckPriorityBlockRange(int p_first, int p_last);
+
 protected:
   void highlightMisspell(const QSharedPointer<BlockSpellCheckData> &p_data);
 
+  // Highlight misspelled words of current block if spell check is enabled.
+  // Spell check is done in background and the block will be rehighlighted once
+  // the result is ready.
+  void highlightSpellCheck(const QString &p_text);
+
   bool m_spellCheckEnabled = false;
 
   bool m_autoDetectLanguageEnabled = false;
+
+  QString m_spellCheckLanguage;
+
+private:
+  SpellCheckWorker *spellCheckWorker();
+
+  void handleSpellCheckResults();
+
+  void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+  // Managed by QObject.
+  SpellCheckWorker *m_spellCheckWorker = nullptr;
+
+  QPair<int, int> m_spellCheckPriorityBlocks = {-1, -1};
+
+  // Block count of the document before the latest change.
+  int m_blockCount = 0;
 };
 } // namespace vte
 
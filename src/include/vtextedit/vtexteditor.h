@@ -32,6 +32,7 @@ class AbstractInputMode;
 class EditorCompleter;
 class Completer;
 class StatusIndicator;
+class FindWorker;
 
 class VTEXTEDIT_EXPORT VTextEditor : public QWidget {
   Q_OBJECT
@@ -50,6 +51,10 @@ public:
     int m_currentMatchIndex = -1;
 
     bool m_wrapped = false;
+
+    // Whether matches are still being found in background.
+    // findResultUpdated() will be emitted when more matches are found.
+    bool m_searching = false;
   };
 
   VTextEditor(const QSharedPointer<TextEditorConfig> &p_config,
@@ -168,6 +173,9 @@ signals:
 
   void topLineChanged();
 
+  // Emitted when more matches of last findText() are found in background.
+  void findResultUpdated(const VTextEditor::FindResult &p_result);
+
 protected:
   void focusInEvent(QFocusEvent *p_event) Q_DECL_OVERRIDE;
 
@@ -179,6 +187,9 @@ protected:
 
   void updateSpellCheck();
 
+  // Let visible blocks be spell checked first.
+  void updateSpellCheckPriorityBlocks();
+
 private slots:
   void updateCursorOfStatusWidget();
 
@@ -190,6 +201,14 @@ private slots:
 
   void clearFindResultCache();
 
+  // Update matches of m_findResultCache incrementally on contents change.
+  void updateFindResultCache(int p_position, int p_charsRemoved, int p_charsAdded);
+
+  void handleFindWorkerResult();
+
+  // Update search highlights of visible matches.
+  void updateSearchHighlight();
+
 private:
   void setupUI();
 
@@ -221,16 +240,31 @@ private:
 
   void setFontAndPaletteByStyleSheet(const QFont &p_font, const QPalette &p_palette);
 
-  const QList<QTextCursor> &findAllText(const QStringList &p_texts, FindFlags p_flags, int p_start,
-                                        int p_end);
+  // Find all matches into m_findResultCache.
+  // @p_sync: whether wait for all the matches. Otherwise, large document will be searched in
+  // background.
+  void findAllText(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end,
+                   bool p_sync);
+
+  // Highlight matches of m_findResultCache. Cursors are created for visible matches only.
+  void highlightSearch();
+
+  // Make the @p_idx match of m_findResultCache current and highlight it.
+  // Return the cursor of it.
+  QTextCursor setCurrentMatch(int p_idx);
 
-  void highlightSearch(const QList<QTextCursor> &p_results, int p_currentIdx);
+  FindWorker *findWorker();
 
   // @p_skipCurrent: if current cursor locates right at a match, whether skip
   // it.
-  // @p_cursor: pass in current cursor and get the cursor of current match.
+  // @p_cursor: pass in current cursor and get the cursor of current match, which will be null
+  // if current match is not located yet.
+  // @p_sync: whether wait for all the matches.
   VTextEditor::FindResult findTextHelper(const QStringList &p_texts, FindFlags p_flags, int p_start,
-                                         int p_end, bool p_skipCurrent, QTextCursor &p_cursor);
+                                         int p_end, bool p_skipCurrent, QTextCursor &p_cursor,
+                                         bool p_sync);
+
+  VTextEditor::FindResult currentFindResult() const;
 
   void updateInputMethodEnabled();
 
@@ -241,14 +275,6 @@ private:
   static QString resolveBackReferenceInReplaceText(const QString &p_replaceText, QString p_text,
                                                    const QRegularExpression &p_regExp);
 
-  // @p_cursors is in ascending order.
-  // If @p_forward is true, find the smallest cursor whose selection start is
-  // greater than @p_pos or the first cursor if wrapped. Otherwise, find the
-  // largest cursor whose selection start is smaller than @p_pos or the last
-  // cursor if wrapped.
-  static int selectCursor(const QList<QTextCursor> &p_cursors, int p_pos, bool p_skipCurrent,
-                          bool p_forward, bool &p_isWrapped);
-
 protected:
   // Managed by QObject.
   VTextEdit *m_textEdit = nullptr;
@@ -257,24 +283,8 @@ protected:
   VSyntaxHighlighter *m_highlighter = nullptr;
 
 private:
-  struct FindResultCache {
-    void clear();
-
-    bool matched(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end) const;
-
-    void update(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end,
-                const QList<QTextCursor> &p_result);
-
-    // Find range [m_start, m_end).
-    int m_start = -1;
-    int m_end = -1;
-
-    QStringList m_texts;
-
-    FindFlags m_flags = FindFlag::None;
-
-    QList<QTextCursor> m_result;
-  };
+  // Matches are kept as offsets to avoid tracking tons of QTextCursor.
+  struct FindResultCache;
 
   QSharedPointer<TextEditorConfig> m_config;
 
@@ -319,7 +329,10 @@ private:
   // Used to indicate current font point size of editor.
   int m_editorFontPointSize = 0;
 
-  FindResultCache m_findResultCache;
+  QScopedPointer<FindResultCache> m_findResultCache;
+
+  // Managed by QObject.
+  FindWorker *m_findWorker = nullptr;
 
   // When using style sheet, m_textEdit->font() and palette() won't return the
   // actual ones. We store them on our own.
@@ -28,4 +28,5 @@ void ViInputModeFactory::updateViConfig(const QSharedPointer<KateViI::KateViConf
     return;
   }
   *m_viConfig = *p_config;
+  m_viGlobal->setStoreFile(m_viConfig->storeFile());
 }
@@ -0,0 +1,122 @@
+#include "blockheightindex.h"
+
+using namespace vte;
+
+void BlockHeightIndex::reset(int p_count) {
+  m_heights.clear();
+  m_heights.resize(qMax(p_count, 0));
+  invalidate(0);
+}
+
+void BlockHeightIndex::insert(int p_index, int p_count) {
+  if (p_count <= 0) {
+    return;
+  }
+
+  p_index = qBound(0, p_index, m_heights.size());
+  m_heights.insert(p_index, p_count, 0);
+  invalidate(p_index);
+}
+
+void BlockHeightIndex::remove(int p_index, int p_count) {
+  if (p_index < 0 || p_index >= m_heights.size()) {
+    return;
+  }
+
+  p_count = qMin(p_count, m_heights.size() - p_index);
+  if (p_count <= 0) {
+    return;
+  }
+
+  m_heights.remove(p_index, p_count);
+  invalidate(p_index);
+}
+
+void BlockHeightIndex::setHeight(int p_index, qreal p_height) {
+  Q_ASSERT(p_index >= 0 && p_index < m_heights.size());
+  const qreal delta = p_height - m_heights[p_index];
+  if (delta == 0) {
+    return;
+  }
+
+  m_heights[p_index] = p_height;
+  // Invalid nodes will be rebuilt from m_heights.
+  for (int i = p_index + 1; i <= m_validNodes; i += i & (-i)) {
+    m_tree[i] += delta;
+  }
+}
+
+qreal BlockHeightIndex::offset(int p_index) const {
+  ensureTree();
+  qreal sum = 0;
+  for (int i = qMin(p_index, m_heights.size()); i > 0; i -= i & (-i)) {
+    sum += m_tree[i];
+  }
+  return sum;
+}
+
+int BlockHeightIndex::findIndex(qreal p_offset) const {
+  const int n = m_heights.size();
+  if (n == 0) {
+    return -1;
+  }
+
+  ensureTree();
+
+  // Find the maximum number of leading blocks whose total height is not greater than
+  // @p_offset, which is exactly the index of the block containing @p_offset.
+  int idx = 0;
+  qreal rest = p_offset;
+  for (int step = m_highestBit; step > 0; step >>= 1) {
+    const int next = idx + step;
+    if (next <= n && m_tree[next] <= rest) {
+      idx = next;
+      rest -= m_tree[next];
+    }
+  }
+
+  return qMin(idx, n - 1);
+}
+
+void BlockHeightIndex::invalidate(int p_index) {
+  m_validNodes = qMin(m_validNodes, p_index);
+}
+
+void BlockHeightIndex::ensureTree() const {
+  const int n = m_heights.size();
+  const int valid = qMin(m_validNodes, n);
+  if (valid == n && m_tree.size() == n + 1) {
+    return;
+  }
+
+  m_tree.resize(n + 1);
+  m_tree[0] = 0;
+  for (int i = valid + 1; i <= n; ++i) {
+    m_tree[i] = m_heights[i - 1];
+  }
+
+  // Linear construction by pushing each node to its parent. The valid nodes pushed to invalid
+  // parents are exactly those on the query path of the valid ones.
+  for (int i = valid; i > 0; i -= i & (-i)) {
+    const int parent = i + (i & (-i));
+    if (parent <= n) {
+      m_tree[parent] += m_tree[i];
+    }
+  }
+  for (int i = valid + 1; i <= n; ++i) {
+    const int parent = i + (i & (-i));
+    if (parent <= n) {
+      m_tree[parent] += m_tree[i];
+    }
+  }
+
+  m_validNodes = n;
+
+  m_highestBit = 0;
+  if (n > 0) {
+    m_highestBit = 1;
+    while (m_highestBit <= n / 2) {
+      m_highestBit <<= 1;
+    }
+  }
+}
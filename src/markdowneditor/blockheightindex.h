@@ -0,0 +1,61 @@
+#ifndef BLOCKHEIGHTINDEX_H
+#define BLOCKHEIGHTINDEX_H
+
+#include <QVector>
+
+namespace vte {
+// Heights of blocks indexed by a Fenwick tree, so that updating the height of a block,
+// querying the offset of a block and finding the block at an offset are all O(log n).
+// Inserting or removing blocks only invalidates the tree after them, which is rebuilt on the next
+// query, so a batch of edits costs one rebuild of the part after the first edited block.
+class BlockHeightIndex {
+public:
+  int size() const { return m_heights.size(); }
+
+  bool isEmpty() const { return m_heights.isEmpty(); }
+
+  // Reset to @p_count blocks of height 0.
+  void reset(int p_count);
+
+  // Insert @p_count blocks of height 0 before block @p_index.
+  void insert(int p_index, int p_count);
+
+  // Remove @p_count blocks starting from block @p_index.
+  void remove(int p_index, int p_count);
+
+  qreal height(int p_index) const { return m_heights[p_index]; }
+
+  void setHeight(int p_index, qreal p_height);
+
+  // Return the total height of blocks before @p_index.
+  qreal offset(int p_index) const;
+
+  qreal totalHeight() const { return offset(m_heights.size()); }
+
+  // Return the block at @p_offset, that is offset(i) <= @p_offset < offset(i + 1).
+  // If @p_offset is at the border, returns the block below.
+  // Return 0 if @p_offset is before the first block, size() - 1 if it is after the last
+  // block, and -1 if there is no block.
+  int findIndex(qreal p_offset) const;
+
+private:
+  // Mark the tree nodes covering blocks from @p_index invalid.
+  void invalidate(int p_index);
+
+  // Rebuild the invalid tree nodes if there is any.
+  void ensureTree() const;
+
+  QVector<qreal> m_heights;
+
+  // One-based Fenwick tree of m_heights. Nodes after m_validNodes are invalid.
+  mutable QVector<qreal> m_tree;
+
+  // Number of valid leading nodes of m_tree, which cover blocks before it only.
+  mutable int m_validNodes = 0;
+
+  // Highest power of two not greater than size().
+  mutable int m_highestBit = 0;
+};
+} // namespace vte
+
+#endif // BLOCKHEIGHTINDEX_H
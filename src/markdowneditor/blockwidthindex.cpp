@@ -0,0 +1,72 @@
+#include "blockwidthindex.h"
+
+using namespace vte;
+
+void BlockWidthIndex::reset(int p_count) {
+  m_widths.clear();
+  m_widths.resize(qMax(p_count, 0));
+  rebuild();
+}
+
+void BlockWidthIndex::insert(int p_index, int p_count) {
+  if (p_count <= 0) {
+    return;
+  }
+
+  p_index = qBound(0, p_index, m_widths.size());
+  m_widths.insert(p_index, p_count, 0);
+  rebuild();
+}
+
+void BlockWidthIndex::remove(int p_index, int p_count) {
+  if (p_index < 0 || p_index >= m_widths.size()) {
+    return;
+  }
+
+  p_count = qMin(p_count, m_widths.size() - p_index);
+  if (p_count <= 0) {
+    return;
+  }
+
+  m_widths.remove(p_index, p_count);
+  rebuild();
+}
+
+void BlockWidthIndex::setWidth(int p_index, qreal p_width) {
+  Q_ASSERT(p_index >= 0 && p_index < m_widths.size());
+  if (m_widths[p_index] == p_width) {
+    return;
+  }
+
+  m_widths[p_index] = p_width;
+  for (int node = (m_leafBase + p_index) >> 1; node > 0; node >>= 1) {
+    m_tree[node] = wider(m_tree[node << 1], m_tree[(node << 1) + 1]);
+  }
+}
+
+int BlockWidthIndex::wider(int p_a, int p_b) const {
+  if (p_a == -1) {
+    return p_b;
+  } else if (p_b == -1) {
+    return p_a;
+  }
+
+  return m_widths[p_b] > m_widths[p_a] ? p_b : p_a;
+}
+
+void BlockWidthIndex::rebuild() {
+  const int n = m_widths.size();
+  m_leafBase = 1;
+  while (m_leafBase < n) {
+    m_leafBase <<= 1;
+  }
+
+  m_tree.resize(m_leafBase * 2);
+  for (int i = 0; i < m_leafBase; ++i) {
+    m_tree[m_leafBase + i] = i < n ? i : -1;
+  }
+
+  for (int node = m_leafBase - 1; node > 0; --node) {
+    m_tree[node] = wider(m_tree[node << 1], m_tree[(node << 1) + 1]);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef BLOCKWIDTHINDEX_H
+#define BLOCKWIDTHINDEX_H
+
+#include <QVector>
+
+namespace vte {
+// Widths of blocks indexed by a segment tree of maximum, so that updating the width of a
+// block is O(log n) and querying the widest block is O(1).
+class BlockWidthIndex {
+public:
+  int size() const { return m_widths.size(); }
+
+  // Reset to @p_count blocks of width 0.
+  void reset(int p_count);
+
+  // Insert @p_count blocks of width 0 before block @p_index.
+  // O(n) since the tree is rebuilt.
+  void insert(int p_index, int p_count);
+
+  // Remove @p_count blocks starting from block @p_index.
+  // O(n) since the tree is rebuilt.
+  void remove(int p_index, int p_count);
+
+  qreal width(int p_index) const { return m_widths[p_index]; }
+
+  void setWidth(int p_index, qreal p_width);
+
+  // Return the first block with the maximum width, or -1 if there is no block.
+  int maximumWidthIndex() const { return m_widths.isEmpty() ? -1 : m_tree[1]; }
+
+  qreal maximumWidth() const { return m_widths.isEmpty() ? 0 : m_widths[m_tree[1]]; }
+
+private:
+  void rebuild();
+
+  // Return the one of block @p_a and @p_b with larger width, or the former one if equal.
+  // -1 for none.
+  int wider(int p_a, int p_b) const;
+
+  QVector<qreal> m_widths;
+
+  // One-based segment tree with m_leafBase leaves, each node holds the index of the
+  // widest block within it.
+  QVector<int> m_tree;
+
+  int m_leafBase = 1;
+};
+} // namespace vte
+
+#endif // BLOCKWIDTHINDEX_H
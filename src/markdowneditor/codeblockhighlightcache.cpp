@@ -0,0 +1,307 @@
+#include "codeblockhighlightcache.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+
+using namespace vte;
+
+static const quint32 c_spillFileMagic = 0x56434248; // VCBH
+
+static const quint32 c_spillFileVersion = 1;
+
+// Start a new spill file once it exceeds this size instead of compacting it.
+static const qint64 c_maxSpillFileSize = 64 * 1024 * 1024;
+
+// Memory of the entries kept in memory.
+static const qint64 c_memoryBudget = 16 * 1024 * 1024;
+
+uint vte::qHash(const CodeBlockHighlightCache::Key &p_key, uint p_seed) {
+  return ::qHash(p_key.m_textHash, p_seed) ^ ::qHash(p_key.m_lang, p_seed) ^
+         ::qHash(p_key.m_scope, p_seed);
+}
+
+namespace vte {
+namespace peg {
+static QDataStream &operator<<(QDataStream &p_stream, const HLUnitStyle &p_unit) {
+  p_stream << static_cast<qint32>(p_unit.start) << static_cast<qint32>(p_unit.length)
+           << p_unit.format;
+  return p_stream;
+}
+
+static QDataStream &operator>>(QDataStream &p_stream, HLUnitStyle &p_unit) {
+  qint32 start = 0, length = 0;
+  p_stream >> start >> length >> p_unit.format;
+  p_unit.start = start;
+  p_unit.length = length;
+  return p_stream;
+}
+} // namespace peg
+} // namespace vte
+
+namespace {
+class FunctionTask : public QRunnable {
+public:
+  explicit FunctionTask(const std::function<void()> &p_func) : m_func(p_func) {}
+
+  void run() Q_DECL_OVERRIDE { m_func(); }
+
+private:
+  std::function<void()> m_func;
+};
+} // namespace
+
+CodeBlockHighlightCache &CodeBlockHighlightCache::getInst() {
+  static CodeBlockHighlightCache inst;
+  return inst;
+}
+
+static qint64 entryCost(const CodeBlockHighlightCache::Key &p_key,
+                        const CodeBlockHighlightCache::HighlightStyles &p_highlights) {
+  qint64 cost = sizeof(p_key) + (p_key.m_lang.size() + p_key.m_scope.size()) * sizeof(QChar) +
+                sizeof(p_highlights);
+  for (const auto &line : p_highlights) {
+    // Formats are shared.
+    cost += sizeof(line) + line.size() * sizeof(peg::HLUnitStyle);
+  }
+  return cost;
+}
+
+CodeBlockHighlightCache::CodeBlockHighlightCache() : m_cache(50, HighlightStyles()) {
+  m_ioThreadPool.setMaxThreadCount(1);
+
+  m_cache.setMemoryBudget(c_memoryBudget, entryCost);
+  m_cache.setEvictionHandler([this](const Key &p_key, const HighlightStyles &p_highlights) {
+    if (!m_spillFilePath.isEmpty()) {
+      runInBackground([this, p_key, p_highlights]() { spill(p_key, p_highlights); });
+    }
+  });
+
+  // Formats could not be serialized once the application is gone, which is before the
+  // destruction of this static instance.
+  if (auto app = QCoreApplication::instance()) {
+    QObject::connect(app, &QCoreApplication::aboutToQuit, [this]() { flush(); });
+  }
+}
+
+bool CodeBlockHighlightCache::get(const Key &p_key, HighlightStyles &p_highlights) {
+  if (!m_cache.contains(p_key)) {
+    return false;
+  }
+
+  p_highlights = m_cache.get(p_key);
+  return true;
+}
+
+bool CodeBlockHighlightCache::load(const Key &p_key, QObject *p_context,
+                                   const LoadCallback &p_callback) {
+  {
+    QMutexLocker locker(&m_spillIndexMutex);
+    if (!m_spillIndex.contains(p_key)) {
+      return false;
+    }
+  }
+
+  runInBackground([this, p_key, p_context, p_callback]() {
+    HighlightStyles highlights;
+    const bool ok = loadSpilled(p_key, highlights);
+    QMetaObject::invokeMethod(
+        p_context,
+        [this, p_key, p_callback, ok, highlights]() {
+          if (ok) {
+            m_cache.set(p_key, highlights);
+          }
+          p_callback(ok, highlights);
+        },
+        Qt::QueuedConnection);
+  });
+  return true;
+}
+
+void CodeBlockHighlightCache::runInBackground(const std::function<void()> &p_func) {
+  m_ioThreadPool.start(new FunctionTask(p_func));
+}
+
+void CodeBlockHighlightCache::set(const Key &p_key, const HighlightStyles &p_highlights) {
+  m_cache.set(p_key, p_highlights);
+}
+
+void CodeBlockHighlightCache::setSpillFile(const QString &p_filePath) {
+  if (m_spillFilePath == p_filePath) {
+    return;
+  }
+
+  // Keep the entries in memory in the previous file.
+  spillAll();
+
+  m_spillFilePath = p_filePath;
+  runInBackground([this, p_filePath]() {
+    if (m_spillFile.isOpen()) {
+      m_spillFile.close();
+    }
+
+    {
+      QMutexLocker locker(&m_spillIndexMutex);
+      m_spillIndex.clear();
+    }
+
+    m_spillFile.setFileName(p_filePath);
+    if (!p_filePath.isEmpty()) {
+      openSpillFile();
+    }
+  });
+}
+
+void CodeBlockHighlightCache::spillAll() {
+  if (m_spillFilePath.isEmpty()) {
+    return;
+  }
+
+  QVector<QPair<Key, HighlightStyles>> entries;
+  m_cache.forEach([&entries](const Key &p_key, const HighlightStyles &p_highlights) {
+    entries.push_back(qMakePair(p_key, p_highlights));
+  });
+  runInBackground([this, entries]() {
+    for (const auto &entry : entries) {
+      spill(entry.first, entry.second);
+    }
+    m_spillFile.flush();
+  });
+}
+
+void CodeBlockHighlightCache::flush() {
+  spillAll();
+  m_ioThreadPool.waitForDone();
+}
+
+void CodeBlockHighlightCache::setMemoryBudget(qint64 p_bytes) {
+  m_cache.setMemoryBudget(p_bytes, entryCost);
+}
+
+void CodeBlockHighlightCache::openSpillFile() {
+  QDir().mkpath(QFileInfo(m_spillFile.fileName()).absolutePath());
+  if (!m_spillFile.open(QIODevice::ReadWrite)) {
+    qWarning() << "failed to open code block highlight cache file" << m_spillFile.fileName()
+               << m_spillFile.errorString();
+    return;
+  }
+
+  if (m_spillFile.size() > c_maxSpillFileSize) {
+    resetSpillFile();
+    return;
+  }
+
+  QDataStream stream(&m_spillFile);
+  stream.setVersion(QDataStream::Qt_5_12);
+  quint32 magic = 0;
+  quint32 version = 0;
+  stream >> magic >> version;
+  if (stream.status() != QDataStream::Ok || magic != c_spillFileMagic ||
+      version != c_spillFileVersion) {
+    resetSpillFile();
+    return;
+  }
+
+  // Each record is the key followed by the serialized highlights in a QByteArray.
+  while (!stream.atEnd()) {
+    const qint64 recordStart = m_spillFile.pos();
+    Key key;
+    quint32 len = 0;
+    stream >> key.m_textHash >> key.m_lang >> key.m_scope;
+    const qint64 offset = m_spillFile.pos();
+    stream >> len;
+    if (stream.status() != QDataStream::Ok || len == 0xFFFFFFFF ||
+        stream.skipRawData(static_cast<int>(len)) != static_cast<int>(len)) {
+      // Drop the broken tail.
+      m_spillFile.resize(recordStart);
+      break;
+    }
+
+    QMutexLocker locker(&m_spillIndexMutex);
+    m_spillIndex.insert(key, offset);
+  }
+}
+
+bool CodeBlockHighlightCache::resetSpillFile() {
+  {
+    QMutexLocker locker(&m_spillIndexMutex);
+    m_spillIndex.clear();
+  }
+  if (!m_spillFile.resize(0) || !m_spillFile.seek(0)) {
+    qWarning() << "failed to reset code block highlight cache file" << m_spillFile.fileName();
+    m_spillFile.close();
+    return false;
+  }
+
+  QDataStream stream(&m_spillFile);
+  stream.setVersion(QDataStream::Qt_5_12);
+  stream << c_spillFileMagic << c_spillFileVersion;
+  return stream.status() == QDataStream::Ok;
+}
+
+void CodeBlockHighlightCache::spill(const Key &p_key, const HighlightStyles &p_highlights) {
+  if (!m_spillFile.isOpen()) {
+    return;
+  }
+
+  {
+    // The same key always has the same highlights.
+    QMutexLocker locker(&m_spillIndexMutex);
+    if (m_spillIndex.contains(p_key)) {
+      return;
+    }
+  }
+
+  if (m_spillFile.size() > c_maxSpillFileSize && !resetSpillFile()) {
+    return;
+  }
+
+  QByteArray data;
+  {
+    QDataStream dataStream(&data, QIODevice::WriteOnly);
+    dataStream.setVersion(QDataStream::Qt_5_12);
+    dataStream << p_highlights;
+  }
+
+  m_spillFile.seek(m_spillFile.size());
+  QDataStream stream(&m_spillFile);
+  stream.setVersion(QDataStream::Qt_5_12);
+  stream << p_key.m_textHash << p_key.m_lang << p_key.m_scope;
+  const qint64 offset = m_spillFile.pos();
+  stream << data;
+  if (stream.status() == QDataStream::Ok) {
+    QMutexLocker locker(&m_spillIndexMutex);
+    m_spillIndex.insert(p_key, offset);
+  }
+}
+
+bool CodeBlockHighlightCache::loadSpilled(const Key &p_key, HighlightStyles &p_highlights) {
+  qint64 offset = -1;
+  {
+    QMutexLocker locker(&m_spillIndexMutex);
+    offset = m_spillIndex.value(p_key, -1);
+  }
+  if (offset < 0 || !m_spillFile.seek(offset)) {
+    return false;
+  }
+
+  QDataStream stream(&m_spillFile);
+  stream.setVersion(QDataStream::Qt_5_12);
+  QByteArray data;
+  stream >> data;
+
+  QDataStream dataStream(data);
+  dataStream.setVersion(QDataStream::Qt_5_12);
+  HighlightStyles highlights;
+  dataStream >> highlights;
+  if (stream.status() != QDataStream::Ok || dataStream.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  p_highlights = highlights;
+  return true;
+}
@@ -0,0 +1,109 @@
+#ifndef CODEBLOCKHIGHLIGHTCACHE_H
+#define CODEBLOCKHIGHLIGHTCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+
+#include <vtextedit/codeblockhighlighter.h>
+#include <vtextedit/lrucache.h>
+
+namespace vte {
+// Highlight results of code blocks shared by all the CodeBlockHighlighters in the process, keyed
+// by the hash of the code block text and its language.
+// Entries are kept in memory within a budget in bytes. Those evicted are spilled to an optional
+// file and loaded back on demand, which also keeps them across sessions.
+// It should be accessed on the GUI thread only, while the file is read and written by a
+// background thread.
+class CodeBlockHighlightCache {
+public:
+  typedef CodeBlockHighlighter::HighlightStyles HighlightStyles;
+
+  // @p_ok: whether the entry is loaded into @p_highlights.
+  typedef std::function<void(bool p_ok, const HighlightStyles &p_highlights)> LoadCallback;
+
+  struct Key {
+    bool operator==(const Key &p_other) const {
+      return m_textHash == p_other.m_textHash && m_lang == p_other.m_lang &&
+             m_scope == p_other.m_scope;
+    }
+
+    quint64 m_textHash = 0;
+
+    QString m_lang;
+
+    // Identify the highlighter and its theme, which the styles depend on.
+    QString m_scope;
+  };
+
+  static CodeBlockHighlightCache &getInst();
+
+  // Return true if found in memory and fill @p_highlights.
+  bool get(const Key &p_key, HighlightStyles &p_highlights);
+
+  // Load the entry spilled to the file in the background, which is then put in memory and
+  // passed to @p_callback on the GUI thread unless @p_context is destroyed.
+  // Return false if @p_key is not spilled.
+  bool load(const Key &p_key, QObject *p_context, const LoadCallback &p_callback);
+
+  void set(const Key &p_key, const HighlightStyles &p_highlights);
+
+  // Empty @p_filePath to disable spilling. The file is opened in the background.
+  void setSpillFile(const QString &p_filePath);
+
+  // Spill all the entries in memory and wait for the file to be written.
+  // Called on QCoreApplication::aboutToQuit() since the cache outlives the application.
+  void flush();
+
+  // Spill entries once the total memory of those in memory exceeds @p_bytes.
+  void setMemoryBudget(qint64 p_bytes);
+
+private:
+  CodeBlockHighlightCache();
+
+  // Run @p_func on m_ioThreadPool in order.
+  void runInBackground(const std::function<void()> &p_func);
+
+  // Spill all the entries in memory in the background.
+  void spillAll();
+
+  // Called in the background.
+  // Open m_spillFile and index its records. Start a new one if it is invalid or too large.
+  void openSpillFile();
+
+  // Called in the background.
+  // Truncate m_spillFile and write the header.
+  bool resetSpillFile();
+
+  // Called in the background.
+  void spill(const Key &p_key, const HighlightStyles &p_highlights);
+
+  // Called in the background.
+  bool loadSpilled(const Key &p_key, HighlightStyles &p_highlights);
+
+  LruCache<Key, HighlightStyles> m_cache;
+
+  // Spill file set on the GUI thread.
+  QString m_spillFilePath;
+
+  // Used in the background only.
+  QFile m_spillFile;
+
+  // Offset of each record's highlights in m_spillFile.
+  // Written in the background and looked up on the GUI thread.
+  QHash<Key, qint64> m_spillIndex;
+
+  QMutex m_spillIndexMutex;
+
+  // One thread to access m_spillFile in the order of requests.
+  QThreadPool m_ioThreadPool;
+};
+
+uint qHash(const CodeBlockHighlightCache::Key &p_key, uint p_seed = 0);
+} // namespace vte
+
+#endif // CODEBLOCKHIGHLIGHTCACHE_H
@@ -1,26 +1,83 @@
 #include <vtextedit/codeblockhighlighter.h>
 
+#include "codeblockhighlightcache.h"
+
 using namespace vte;
 
-CodeBlockHighlighter::CodeBlockHighlighter(QObject *p_parent)
-    : QObject(p_parent), m_cache(50, CacheEntry()) {}
+static CodeBlockHighlightCache::Key cacheKey(const peg::FencedCodeBlock &p_block,
+                                             const QString &p_scope) {
+  CodeBlockHighlightCache::Key key;
+  key.m_textHash =
+      p_block.m_textHash ? p_block.m_textHash : peg::FencedCodeBlock::hashText(p_block.m_text);
+  key.m_lang = p_block.m_lang;
+  key.m_scope = p_scope;
+  return key;
+}
+
+CodeBlockHighlighter::CodeBlockHighlighter(QObject *p_parent) : QObject(p_parent) {}
+
+void CodeBlockHighlighter::setCacheFile(const QString &p_filePath) {
+  CodeBlockHighlightCache::getInst().setSpillFile(p_filePath);
+}
+
+QString CodeBlockHighlighter::cacheScope() const {
+  return QString::fromLatin1(metaObject()->className());
+}
 
 void CodeBlockHighlighter::highlight(TimeStamp p_timeStamp,
-                                     const QVector<peg::FencedCodeBlock> &p_codeBlocks) {
+                                     const QVector<peg::FencedCodeBlock> &p_codeBlocks,
+                                     const QPair<int, int> &p_priorityBlocks) {
+  cancelHighlight();
+
   m_timeStamp = p_timeStamp;
   // It is OK since QVector is implicitly shared.
   m_codeBlocks = p_codeBlocks;
 
-  m_cache.setCapacityHint(m_codeBlocks.size());
+  // Code blocks crossing @p_priorityBlocks first.
+  auto isPriority = [&p_priorityBlocks](const peg::FencedCodeBlock &p_block) {
+    return p_block.m_endBlock >= p_priorityBlocks.first &&
+           p_block.m_startBlock <= p_priorityBlocks.second;
+  };
+  QVector<int> indexes;
+  indexes.reserve(m_codeBlocks.size());
   for (int idx = 0; idx < m_codeBlocks.size(); ++idx) {
-    auto &entry = m_cache.get(m_codeBlocks[idx].m_text);
-    if (!entry.isNull()) {
+    if (isPriority(m_codeBlocks[idx])) {
+      indexes.push_back(idx);
+    }
+  }
+  for (int idx = 0; idx < m_codeBlocks.size(); ++idx) {
+    if (!isPriority(m_codeBlocks[idx])) {
+      indexes.push_back(idx);
+    }
+  }
+
+  m_cacheScope = cacheScope();
+  auto &cache = CodeBlockHighlightCache::getInst();
+  for (int idx : indexes) {
+    const auto key = cacheKey(m_codeBlocks[idx], m_cacheScope);
+    HighlightResult result(m_timeStamp, idx);
+    if (cache.get(key, result.m_highlights)) {
       // Cache hits.
-      entry.m_timeStamp = m_timeStamp;
-      HighlightResult result(m_timeStamp, idx);
-      result.m_highlights = entry.m_highlights;
       emit codeBlockHighlightCompleted(result);
-    } else {
+      continue;
+    }
+
+    const auto timeStamp = m_timeStamp;
+    auto loaded = [this, timeStamp, idx](bool p_ok, const HighlightStyles &p_highlights) {
+      if (timeStamp != m_timeStamp) {
+        // Obsolete.
+        return;
+      }
+
+      if (p_ok) {
+        HighlightResult result(timeStamp, idx);
+        result.m_highlights = p_highlights;
+        emit codeBlockHighlightCompleted(result);
+      } else {
+        highlightInternal(idx);
+      }
+    };
+    if (!cache.load(key, this, loaded)) {
       highlightInternal(idx);
     }
   }
@@ -33,6 +90,6 @@ void CodeBlockHighlighter::finishHighlightOne(const HighlightResult &p_result) {
 }
 
 void CodeBlockHighlighter::addToCache(const HighlightResult &p_result) {
-  m_cache.set(m_codeBlocks[p_result.m_index].m_text,
-              CacheEntry(p_result.m_timeStamp, p_result.m_highlights));
+  CodeBlockHighlightCache::getInst().set(cacheKey(m_codeBlocks[p_result.m_index], m_cacheScope),
+                                         p_result.m_highlights);
 }
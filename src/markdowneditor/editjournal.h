@@ -0,0 +1,70 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QMap>
+
+#include <vtextedit/pegmarkdownhighlighter.h>
+
+namespace vte {
+// Contents changes keyed by the time stamp each one leads to, which is used to map a result of
+// an earlier time stamp onto the current document.
+class EditJournal {
+public:
+  static bool isEmpty(const ContentsChange &p_change) {
+    return p_change.m_charsRemoved == 0 && p_change.m_charsAdded == 0;
+  }
+
+  // Merge a later change @p_later into @p_change so that the result covers both.
+  static void merge(ContentsChange &p_change, const ContentsChange &p_later) {
+    if (isEmpty(p_change)) {
+      p_change = p_later;
+      return;
+    }
+
+    // End of the changed range in the document between the two changes.
+    const int midEnd = qMax(p_change.m_position + p_change.m_charsAdded,
+                            p_later.m_position + p_later.m_charsRemoved);
+    const int oldEnd = midEnd - (p_change.m_charsAdded - p_change.m_charsRemoved);
+    const int newEnd = midEnd + (p_later.m_charsAdded - p_later.m_charsRemoved);
+    p_change.m_position = qMin(p_change.m_position, p_later.m_position);
+    p_change.m_charsRemoved = oldEnd - p_change.m_position;
+    p_change.m_charsAdded = newEnd - p_change.m_position;
+  }
+
+  void append(TimeStamp p_timeStamp, const ContentsChange &p_change) {
+    m_changes.insert(p_timeStamp, p_change);
+    while (m_changes.size() > c_maxSize) {
+      m_changes.erase(m_changes.begin());
+    }
+  }
+
+  // Merge changes within (@p_from, @p_to] into @p_change.
+  // Return false if any of them is not in the journal.
+  bool changeSince(TimeStamp p_from, TimeStamp p_to, ContentsChange &p_change) const {
+    p_change = ContentsChange();
+    TimeStamp expected = p_from + 1;
+    for (auto it = m_changes.upperBound(p_from); it != m_changes.end() && it.key() <= p_to;
+         ++it, ++expected) {
+      if (it.key() != expected) {
+        return false;
+      }
+      merge(p_change, it.value());
+    }
+    return expected == p_to + 1;
+  }
+
+  // Drop changes up to @p_timeStamp, inclusive.
+  void trim(TimeStamp p_timeStamp) {
+    while (!m_changes.isEmpty() && m_changes.firstKey() <= p_timeStamp) {
+      m_changes.erase(m_changes.begin());
+    }
+  }
+
+private:
+  static const int c_maxSize = 512;
+
+  QMap<TimeStamp, ContentsChange> m_changes;
+};
+} // namespace vte
+
+#endif // EDITJOURNAL_H
@@ -5,6 +5,13 @@
 #include <Repository>
 #include <State>
 
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QThreadStorage>
+
 #include <texteditor/ksyntaxhighlighterwrapper.h>
 #include <utils/utils.h>
 #include <vtextedit/markdownutils.h>
@@ -16,23 +23,105 @@ QHash<QString, QString> KSyntaxCodeBlockHighlighter::s_extraLangs;
 
 QSet<QString> KSyntaxCodeBlockHighlighter::s_excludedLangs;
 
-KSyntaxCodeBlockHighlighter::KSyntaxCodeBlockHighlighter(const QString &p_theme, QObject *p_parent)
-    : CodeBlockHighlighter(p_parent) {
-  initExtraAndExcludedLangs();
+QPointer<QThreadPool> KSyntaxCodeBlockHighlighter::s_threadPool;
 
-  auto formatFunctor = [this](int p_offset, int p_length,
-                              const KSyntaxHighlighting::Format &p_format) {
-    applyFormat(p_offset, p_length, p_format);
-  };
+struct KSyntaxCodeBlockHighlighter::Context {
+  bool isCancelled(TimeStamp p_timeStamp) const {
+    return m_latestTimeStamp.loadAcquire() != p_timeStamp;
+  }
 
-  auto foldingFunctor = [](int p_offset, int p_length,
-                           KSyntaxHighlighting::FoldingRegion p_region) {
-    Q_UNUSED(p_offset);
-    Q_UNUSED(p_length);
-    Q_UNUSED(p_region);
-  };
+  // Deliver @p_result to the highlighter on the GUI thread if it is still alive.
+  void deliver(const HighlightResult &p_result) {
+    QMutexLocker locker(&m_mutex);
+    auto highlighter = m_highlighter;
+    if (!highlighter) {
+      return;
+    }
+
+    // Pending calls are dropped once the highlighter is destroyed.
+    QMetaObject::invokeMethod(
+        highlighter, [highlighter, p_result]() { highlighter->handleTaskResult(p_result); },
+        Qt::QueuedConnection);
+  }
+
+  KSyntaxHighlighting::Theme m_theme;
+
+  // Time stamp of the latest highlight, to cancel the tasks of previous ones.
+  QAtomicInteger<TimeStamp> m_latestTimeStamp;
+
+  // Guard m_highlighter, which is reset when the highlighter is destroyed.
+  QMutex m_mutex;
+
+  KSyntaxCodeBlockHighlighter *m_highlighter = nullptr;
+};
+
+struct KSyntaxCodeBlockHighlighter::ThreadData {
+  ~ThreadData() {
+    // Workers refer to the definitions of the repository.
+    m_workers.clear();
+    delete m_repository;
+  }
+
+  Worker *worker(const KSyntaxHighlighting::Theme &p_theme) {
+    auto &worker = m_workers[p_theme.name()];
+    if (!worker) {
+      worker.reset(createWorker(p_theme));
+    }
+    return worker.data();
+  }
+
+  // Own repository of this thread, whose lazily loaded data is not thread-safe.
+  KSyntaxHighlighting::Repository *m_repository = nullptr;
+
+  // Workers by theme name, shared by the highlighters of the same theme.
+  QHash<QString, QSharedPointer<Worker>> m_workers;
+};
+
+// Highlight one code block in a thread of the pool.
+class KSyntaxCodeBlockHighlighter::HighlightTask : public QRunnable {
+public:
+  HighlightTask(const QSharedPointer<Context> &p_context, const QString &p_defName,
+                TimeStamp p_timeStamp, int p_idx, const peg::FencedCodeBlock &p_block)
+      : m_context(p_context), m_defName(p_defName), m_timeStamp(p_timeStamp), m_idx(p_idx),
+        m_block(p_block) {}
+
+  void run() Q_DECL_OVERRIDE {
+    if (m_context->isCancelled(m_timeStamp)) {
+      return;
+    }
+
+    auto data = threadData();
+    auto worker = data->worker(m_context->m_theme);
+    const auto def = data->m_repository->definitionForName(m_defName);
+    HighlightResult result(m_timeStamp, m_idx);
+    if (def.isValid() &&
+        !highlightOne(worker, def, *m_context, m_timeStamp, m_idx, m_block, result)) {
+      return;
+    }
+
+    m_context->deliver(result);
+  }
+
+private:
+  QSharedPointer<Context> m_context;
 
-  m_syntaxHighlighter = new KSyntaxHighlighterWrapper(formatFunctor, foldingFunctor, this);
+  QString m_defName;
+
+  TimeStamp m_timeStamp = 0;
+
+  int m_idx = -1;
+
+  peg::FencedCodeBlock m_block;
+};
+
+KSyntaxCodeBlockHighlighter::Worker::~Worker() { delete m_syntaxHighlighter; }
+
+KSyntaxCodeBlockHighlighter::KSyntaxCodeBlockHighlighter(const QString &p_theme, int p_workerCount,
+                                                         QObject *p_parent)
+    : CodeBlockHighlighter(p_parent), m_context(QSharedPointer<Context>::create()) {
+  initExtraAndExcludedLangs();
+
+  m_context->m_highlighter = this;
 
   KSyntaxHighlighting::Theme th;
   if (!p_theme.isEmpty()) {
@@ -45,7 +134,63 @@ KSyntaxCodeBlockHighlighter::KSyntaxCodeBlockHighlighter(const QString &p_theme,
   if (!th.isValid()) {
     th = KSyntaxHighlighterWrapper::repository()->defaultTheme();
   }
-  m_syntaxHighlighter->setTheme(th);
+
+  m_themeName = th.name();
+  m_context->m_theme = th;
+
+  m_worker.reset(createWorker(th));
+
+  if (p_workerCount > 0) {
+    m_asyncEnabled = true;
+    if (!s_threadPool) {
+      s_threadPool = new QThreadPool(QCoreApplication::instance());
+      s_threadPool->setMaxThreadCount(p_workerCount);
+      // Keep the threads along with their repositories.
+      s_threadPool->setExpiryTimeout(-1);
+    } else if (s_threadPool->maxThreadCount() < p_workerCount) {
+      s_threadPool->setMaxThreadCount(p_workerCount);
+    }
+  }
+}
+
+KSyntaxCodeBlockHighlighter::~KSyntaxCodeBlockHighlighter() {
+  cancelHighlight();
+
+  // Running tasks stop at the next line and their results are dropped.
+  QMutexLocker locker(&m_context->m_mutex);
+  m_context->m_highlighter = nullptr;
+}
+
+KSyntaxCodeBlockHighlighter::Worker *
+KSyntaxCodeBlockHighlighter::createWorker(const KSyntaxHighlighting::Theme &p_theme) {
+  auto worker = new Worker();
+
+  auto formatFunctor = [worker](int p_offset, int p_length,
+                                const KSyntaxHighlighting::Format &p_format) {
+    applyFormat(worker, p_offset, p_length, p_format);
+  };
+
+  auto foldingFunctor = [](int p_offset, int p_length,
+                           KSyntaxHighlighting::FoldingRegion p_region) {
+    Q_UNUSED(p_offset);
+    Q_UNUSED(p_length);
+    Q_UNUSED(p_region);
+  };
+
+  // Not managed by QObject since it may be used in other threads.
+  worker->m_syntaxHighlighter = new KSyntaxHighlighterWrapper(formatFunctor, foldingFunctor);
+  worker->m_syntaxHighlighter->setTheme(p_theme);
+  return worker;
+}
+
+void KSyntaxCodeBlockHighlighter::cancelHighlight() {
+  // Tasks in s_threadPool, which may belong to other highlighters, are kept and will return
+  // once started.
+  m_context->m_latestTimeStamp.storeRelease(0);
+}
+
+QString KSyntaxCodeBlockHighlighter::cacheScope() const {
+  return QStringLiteral("ksyntax:") + m_themeName;
 }
 
 void KSyntaxCodeBlockHighlighter::highlightInternal(int p_idx) {
@@ -73,51 +218,95 @@ void KSyntaxCodeBlockHighlighter::highlightInternal(int p_idx) {
     return;
   }
 
-  auto lines = block.m_text.split(QLatin1Char('\n'));
+  m_context->m_latestTimeStamp.storeRelease(m_timeStamp);
+
+  if (!m_asyncEnabled) {
+    HighlightResult result;
+    highlightOne(m_worker.data(), def, *m_context, m_timeStamp, p_idx, block, result);
+    finishHighlightOne(result);
+    return;
+  }
+
+  s_threadPool->start(new HighlightTask(m_context, def.name(), m_timeStamp, p_idx, block));
+}
+
+bool KSyntaxCodeBlockHighlighter::highlightOne(Worker *p_worker,
+                                               const KSyntaxHighlighting::Definition &p_def,
+                                               const Context &p_context, TimeStamp p_timeStamp,
+                                               int p_idx, const peg::FencedCodeBlock &p_block,
+                                               HighlightResult &p_result) {
+  p_result = HighlightResult(p_timeStamp, p_idx);
+
+  auto lines = p_block.m_text.split(QLatin1Char('\n'));
   if (lines.size() < 3) {
     // Empty code block.
-    finishHighlightOne(HighlightResult(m_timeStamp, p_idx));
-    return;
+    return true;
   }
 
-  m_currentInfo.startNewHighlight(p_idx, lines.size());
+  auto &info = p_worker->m_currentInfo;
+  info.startNewHighlight(p_idx, lines.size());
 
   // Get the indentation of the code block.
   Q_ASSERT(MarkdownUtils::isFencedCodeBlockStartMark(lines[0]));
   int blockIndentation = TextUtils::fetchIndentation(lines[0]);
 
-  m_syntaxHighlighter->setDefinition(def);
+  p_worker->m_syntaxHighlighter->setDefinition(p_def);
   KSyntaxHighlighting::State state;
   for (int i = 1; i < lines.size() - 1; ++i) {
-    m_currentInfo.m_lineIndex = i;
+    if (p_context.isCancelled(p_timeStamp)) {
+      return false;
+    }
+
+    info.m_lineIndex = i;
     auto text = TextUtils::unindentText(lines[i], blockIndentation);
-    m_currentInfo.m_indentation = lines[i].size() - text.size();
-    state = m_syntaxHighlighter->highlightLine(text, state);
+    info.m_indentation = lines[i].size() - text.size();
+    state = p_worker->m_syntaxHighlighter->highlightLine(text, state);
+  }
+
+  p_result.m_highlights = info.m_highlights;
+  return true;
+}
+
+void KSyntaxCodeBlockHighlighter::handleTaskResult(const HighlightResult &p_result) {
+  if (p_result.m_timeStamp != m_timeStamp) {
+    // Outdated.
+    return;
   }
 
-  HighlightResult result(m_timeStamp, p_idx);
-  result.m_highlights = m_currentInfo.m_highlights;
-  finishHighlightOne(result);
+  finishHighlightOne(p_result);
 }
 
-void KSyntaxCodeBlockHighlighter::applyFormat(int p_offset, int p_length,
+void KSyntaxCodeBlockHighlighter::applyFormat(Worker *p_worker, int p_offset, int p_length,
                                               const KSyntaxHighlighting::Format &p_format) {
   if (p_length == 0) {
     return;
   }
 
   peg::HLUnitStyle unit;
-  unit.start = p_offset + m_currentInfo.m_indentation;
+  unit.start = p_offset + p_worker->m_currentInfo.m_indentation;
   unit.length = p_length;
-  if (m_formatCache.contains(p_format.id())) {
-    unit.format = m_formatCache.get(p_format.id());
+
+  auto &formatCache = p_worker->m_formatCache;
+  if (formatCache.contains(p_format.id())) {
+    unit.format = formatCache.get(p_format.id());
   } else {
-    unit.format =
-        KSyntaxHighlighterWrapper::toTextCharFormat(m_syntaxHighlighter->theme(), p_format);
-    m_formatCache.insert(p_format.id(), unit.format);
+    unit.format = KSyntaxHighlighterWrapper::toTextCharFormat(
+        p_worker->m_syntaxHighlighter->theme(), p_format);
+    formatCache.insert(p_format.id(), unit.format);
   }
 
-  m_currentInfo.addHighlightUnit(unit);
+  p_worker->m_currentInfo.addHighlightUnit(unit);
+}
+
+KSyntaxCodeBlockHighlighter::ThreadData *KSyntaxCodeBlockHighlighter::threadData() {
+  // Deleted when the thread exits.
+  static QThreadStorage<ThreadData *> s_threadData;
+  if (!s_threadData.hasLocalData()) {
+    auto data = new ThreadData();
+    data->m_repository = KSyntaxHighlighterWrapper::createRepository();
+    s_threadData.setLocalData(data);
+  }
+  return s_threadData.localData();
 }
 
 void KSyntaxCodeBlockHighlighter::initExtraAndExcludedLangs() {
@@ -3,13 +3,20 @@
 
 #include <vtextedit/codeblockhighlighter.h>
 
+#include <QPointer>
 #include <QSet>
+#include <QSharedPointer>
 
 #include <texteditor/formatcache.h>
 
+class QThreadPool;
+
 namespace KSyntaxHighlighting {
+class Definition;
 class Format;
 class FoldingRegion;
+class Repository;
+class Theme;
 } // namespace KSyntaxHighlighting
 
 namespace vte {
@@ -19,7 +26,16 @@ class KSyntaxCodeBlockHighlighter : public CodeBlockHighlighter {
   Q_OBJECT
 public:
   // @p_theme: a theme file path or a theme name.
-  KSyntaxCodeBlockHighlighter(const QString &p_theme, QObject *p_parent);
+  // @p_workerCount: number of threads to highlight code blocks concurrently, or 0 to highlight
+  // them synchronously. The threads are shared by all the highlighters of the process.
+  KSyntaxCodeBlockHighlighter(const QString &p_theme, int p_workerCount, QObject *p_parent);
+
+  ~KSyntaxCodeBlockHighlighter();
+
+protected:
+  void cancelHighlight() Q_DECL_OVERRIDE;
+
+  QString cacheScope() const Q_DECL_OVERRIDE;
 
 private:
   struct HighlightInfo {
@@ -63,18 +79,60 @@ private:
     HighlightStyles m_highlights;
   };
 
+  // A syntax highlighter of one theme with its highlight info, used by one thread.
+  struct Worker {
+    ~Worker();
+
+    KSyntaxHighlighterWrapper *m_syntaxHighlighter = nullptr;
+
+    // Format ids are unique within one repository.
+    FormatCache m_formatCache;
+
+    HighlightInfo m_currentInfo;
+  };
+
+  // State shared with the tasks, which may outlive the highlighter.
+  struct Context;
+
+  // Repository and workers of one thread of s_threadPool.
+  struct ThreadData;
+
+  class HighlightTask;
+
   void initExtraAndExcludedLangs();
 
   void highlightInternal(int p_idx) Q_DECL_OVERRIDE;
 
-  void applyFormat(int p_offset, int p_length, const KSyntaxHighlighting::Format &p_format);
+  static Worker *createWorker(const KSyntaxHighlighting::Theme &p_theme);
+
+  // Highlight @p_block of index @p_idx with @p_worker.
+  // Return false if cancelled by a newer time stamp of @p_context.
+  static bool highlightOne(Worker *p_worker, const KSyntaxHighlighting::Definition &p_def,
+                           const Context &p_context, TimeStamp p_timeStamp, int p_idx,
+                           const peg::FencedCodeBlock &p_block, HighlightResult &p_result);
+
+  // Called on the GUI thread.
+  void handleTaskResult(const HighlightResult &p_result);
+
+  static void applyFormat(Worker *p_worker, int p_offset, int p_length,
+                          const KSyntaxHighlighting::Format &p_format);
+
+  // Data of current thread of s_threadPool, created on its first use.
+  static ThreadData *threadData();
+
+  QString m_themeName;
+
+  // Used on the GUI thread.
+  QSharedPointer<Worker> m_worker;
 
-  // Managed by QObject.
-  KSyntaxHighlighterWrapper *m_syntaxHighlighter = nullptr;
+  QSharedPointer<Context> m_context;
 
-  HighlightInfo m_currentInfo;
+  // Whether highlight via s_threadPool.
+  bool m_asyncEnabled = false;
 
-  FormatCache m_formatCache;
+  // Threads shared by all the highlighters, each of which has its own repository.
+  // Managed by QCoreApplication.
+  static QPointer<QThreadPool> s_threadPool;
 
   // To minimize the gap between read mode and edit mode syntax highlighting.
   static QHash<QString, QString> s_extraLangs;
@@ -16,29 +16,34 @@ PegHighlighterFastResult::PegHighlighterFastResult(
   PegHighlighterResult::parseBlocksHighlights(m_blocksHighlights, p_peg, p_result);
 }
 
-PegHighlighterResult::PegHighlighterResult(const PegMarkdownHighlighter *p_peg,
-                                           const QSharedPointer<peg::PegParseResult> &p_result,
-                                           TimeStamp p_curTimeStamp,
-                                           const ContentsChange &p_lastContentsChange)
+PegHighlighterResult::PegHighlighterResult(const QSharedPointer<peg::PegParseResult> &p_result)
     : m_timeStamp(p_result->m_timeStamp), m_numOfBlocks(p_result->m_numOfBlocks) {
-  // TODO: use @p_curTimeStamp and @p_lastContentsChange to fix the position of
-  // results. Now we will ignore unmatched results in PegMarkdownHighlighter to
-  // avoid blinking.
-  Q_UNUSED(p_curTimeStamp);
-  Q_UNUSED(p_lastContentsChange);
+  if (!p_result->hasBlockPositions()) {
+    // Not matched with the document.
+    m_blocksHighlights.resize(m_numOfBlocks);
+    return;
+  }
 
-  parseBlocksHighlights(m_blocksHighlights, p_peg, p_result);
+  if (p_result->isEmpty()) {
+    m_blocksHighlights.resize(m_numOfBlocks);
+  } else {
+    p_result->parseBlocksHighlights(m_blocksHighlights);
+  }
 
+  parseRegions(p_result);
+}
+
+void PegHighlighterResult::parseRegions(const QSharedPointer<peg::PegParseResult> &p_result) {
   // Implicit sharing.
   m_imageRegions = p_result->m_imageRegions;
   m_headerRegions = p_result->m_headerRegions;
 
-  parseFencedCodeBlocks(p_peg, p_result);
+  parseFencedCodeBlocks(p_result);
 
-  parseMathBlock(p_peg, p_result);
+  parseMathBlock(p_result);
 
   // ATTENTION: if we want to handle HRule blocks specificly, uncomment this
-  // line to fill the m_hruleBlocks. parseHRuleBlocks(p_peg, p_result);
+  // line to fill the m_hruleBlocks. parseHRuleBlocks(p_result);
 
   parseTableBlocks(p_result);
 }
@@ -52,25 +57,19 @@ void PegHighlighterResult::parseBlocksHighlights(
     return;
   }
 
+  if (p_result->hasBlockPositions()) {
+    p_result->parseBlocksHighlights(p_blocksHighlights);
+    return;
+  }
+
   p_blocksHighlights.resize(p_result->m_numOfBlocks);
 
-  int offset = p_result->m_offset;
   const auto doc = p_peg->document();
-  auto pmhResult = p_result->m_pmhElements;
   const auto numOfStyles = peg::PegParser::getNumberOfStyles();
   for (int i = 0; i < numOfStyles; ++i) {
-    pmh_element *elem_cursor = pmhResult[i];
-    while (elem_cursor != NULL) {
-      // elem_cursor->pos and elem_cursor->end is the start
-      // and end position of the element in document.
-      if (elem_cursor->end <= elem_cursor->pos) {
-        elem_cursor = elem_cursor->next;
-        continue;
-      }
-
-      parseBlocksHighlightOne(p_blocksHighlights, doc, offset + elem_cursor->pos,
-                              offset + elem_cursor->end, i);
-      elem_cursor = elem_cursor->next;
+    // Elements are in the coordinates of the document.
+    for (const auto &elem : p_result->m_elements[i]) {
+      parseBlocksHighlightOne(p_blocksHighlights, doc, elem.m_startPos, elem.m_endPos, i);
     }
   }
 
@@ -179,31 +178,26 @@ void PegHighlighterResult::parseBlocksElementRegionOne(QHash<int, QVector<VEleme
 #endif
 
 void PegHighlighterResult::parseFencedCodeBlocks(
-    const PegMarkdownHighlighter *p_peg, const QSharedPointer<peg::PegParseResult> &p_result) {
+    const QSharedPointer<peg::PegParseResult> &p_result) {
   const auto &regs = p_result->m_codeBlockRegions;
   QRegularExpression codeBlockStartExp(MarkdownUtils::c_fencedCodeBlockStartRegExp);
   QRegularExpression codeBlockEndExp(MarkdownUtils::c_fencedCodeBlockEndRegExp);
 
   Q_ASSERT(m_codeBlocks.isEmpty());
-  const auto doc = p_peg->document();
   peg::FencedCodeBlock item;
   bool inBlock = false;
   QString marker;
-  for (auto it = regs.begin(); it != regs.end(); ++it) {
-    QTextBlock block = doc->findBlock(it.value().m_startPos);
-    int lastBlock = doc->findBlock(it.value().m_endPos - 1).blockNumber();
+  int hint = -1;
+  for (const auto &reg : regs) {
+    hint = p_result->findBlockIndex(reg.m_startPos, hint);
+    int lastBlock = p_result->findBlockIndex(reg.m_endPos - 1, hint);
     if (lastBlock >= p_result->m_numOfBlocks) {
       lastBlock = p_result->m_numOfBlocks - 1;
     }
 
-    while (block.isValid()) {
-      int blockNumber = block.blockNumber();
-      if (blockNumber > lastBlock) {
-        break;
-      }
-
+    for (int blockNumber = hint; blockNumber <= lastBlock; ++blockNumber) {
       peg::HighlightBlockState state = peg::HighlightBlockState::Normal;
-      QString text = block.text();
+      QString text = p_result->blockText(blockNumber);
       if (inBlock) {
         item.m_text = item.m_text + "\n" + text;
         auto match = codeBlockEndExp.match(text);
@@ -214,6 +208,7 @@ void PegHighlighterResult::parseFencedCodeBlocks(
 
           state = peg::HighlightBlockState::CodeBlockEnd;
           item.m_endBlock = blockNumber;
+          item.m_textHash = peg::FencedCodeBlock::hashText(item.m_text);
           m_codeBlocks.append(item);
         } else {
           // Within code block.
@@ -228,7 +223,7 @@ void PegHighlighterResult::parseFencedCodeBlocks(
 
           state = peg::HighlightBlockState::CodeBlockStart;
           item.m_startBlock = blockNumber;
-          item.m_startPos = block.position();
+          item.m_startPos = p_result->m_blockPositions[blockNumber];
           item.m_text = text;
           item.m_lang = match.captured(3).trimmed();
         }
@@ -237,8 +232,6 @@ void PegHighlighterResult::parseFencedCodeBlocks(
       if (state != peg::HighlightBlockState::Normal) {
         m_codeBlocksState.insert(blockNumber, state);
       }
-
-      block = block.next();
     }
   }
 }
@@ -310,31 +303,34 @@ static bool isDisplayFormulaRawEnd(const QString &p_text) {
   return false;
 }
 
-void PegHighlighterResult::parseMathBlock(const PegMarkdownHighlighter *p_peg,
-                                          const QSharedPointer<peg::PegParseResult> &p_result) {
-  const QTextDocument *doc = p_peg->document();
+void PegHighlighterResult::parseMathBlock(const QSharedPointer<peg::PegParseResult> &p_result) {
+  const auto &positions = p_result->m_blockPositions;
 
   // Inline equations.
   const auto &inlineRegs = p_result->m_inlineEquationRegions;
 
+  int hint = -1;
   for (auto it = inlineRegs.begin(); it != inlineRegs.end(); ++it) {
     const auto &r = *it;
-    QTextBlock block = doc->findBlock(r.m_startPos);
-    if (!block.isValid()) {
+    if (r.m_startPos >= positions.last()) {
       continue;
     }
 
+    const int blockNum = p_result->findBlockIndex(r.m_startPos, hint);
+    hint = blockNum;
+    const int blockPos = positions[blockNum];
+
     // Inline equation MUST in one block.
-    if (r.m_endPos - block.position() > block.length()) {
+    if (r.m_endPos - blockPos > positions[blockNum + 1] - blockPos) {
       continue;
     }
 
     peg::MathBlock item;
-    item.m_blockNumber = block.blockNumber();
+    item.m_blockNumber = blockNum;
     item.m_previewedAsBlock = false;
-    item.m_index = r.m_startPos - block.position();
+    item.m_index = r.m_startPos - blockPos;
     item.m_length = r.m_endPos - r.m_startPos;
-    item.m_text = block.text().mid(item.m_index, item.m_length);
+    item.m_text = p_result->blockText(blockNum).mid(item.m_index, item.m_length);
     m_mathBlocks.append(item);
   }
 
@@ -345,23 +341,25 @@ void PegHighlighterResult::parseMathBlock(const PegMarkdownHighlighter *p_peg,
   bool inBlock = false;
   QString marker("$$");
   QString rawMarkerStart("\\begin{");
+  hint = -1;
   for (auto it = formulaRegs.begin(); it != formulaRegs.end(); ++it) {
     const auto &r = *it;
-    QTextBlock block = doc->findBlock(r.m_startPos);
-    int lastBlock = doc->findBlock(r.m_endPos - 1).blockNumber();
+    if (r.m_startPos >= positions.last()) {
+      continue;
+    }
+
+    hint = p_result->findBlockIndex(r.m_startPos, hint);
+    int lastBlock = p_result->findBlockIndex(r.m_endPos - 1, hint);
     if (lastBlock >= p_result->m_numOfBlocks) {
       lastBlock = p_result->m_numOfBlocks - 1;
     }
 
-    while (block.isValid()) {
-      int blockNum = block.blockNumber();
-      if (blockNum > lastBlock) {
-        break;
-      }
-
-      int pib = qMax(r.m_startPos - block.position(), 0);
-      int length = qMin(r.m_endPos - block.position() - pib, block.length() - 1);
-      QString text = block.text().mid(pib, length);
+    for (int blockNum = hint; blockNum <= lastBlock; ++blockNum) {
+      const int blockPos = positions[blockNum];
+      const int blockLength = positions[blockNum + 1] - blockPos;
+      int pib = qMax(r.m_startPos - blockPos, 0);
+      int length = qMin(r.m_endPos - blockPos - pib, blockLength - 1);
+      QString text = p_result->blockText(blockNum).mid(pib, length);
       if (inBlock) {
         item.m_text = item.m_text + "\n" + text;
         if (text.endsWith(marker) || (blockNum == lastBlock && isDisplayFormulaRawEnd(text))) {
@@ -392,33 +390,23 @@ void PegHighlighterResult::parseMathBlock(const PegMarkdownHighlighter *p_peg,
           item.m_text = text;
         }
       }
-
-      block = block.next();
     }
   }
 }
 
-void PegHighlighterResult::parseHRuleBlocks(const PegMarkdownHighlighter *p_peg,
-                                            const QSharedPointer<peg::PegParseResult> &p_result) {
-  const QTextDocument *doc = p_peg->document();
+void PegHighlighterResult::parseHRuleBlocks(const QSharedPointer<peg::PegParseResult> &p_result) {
   const auto &regs = p_result->m_hruleRegions;
 
+  int hint = -1;
   for (auto it = regs.begin(); it != regs.end(); ++it) {
-    QTextBlock block = doc->findBlock(it->m_startPos);
-    int lastBlock = doc->findBlock(it->m_endPos - 1).blockNumber();
+    hint = p_result->findBlockIndex(it->m_startPos, hint);
+    int lastBlock = p_result->findBlockIndex(it->m_endPos - 1, hint);
     if (lastBlock >= p_result->m_numOfBlocks) {
       lastBlock = p_result->m_numOfBlocks - 1;
     }
 
-    while (block.isValid()) {
-      int blockNumber = block.blockNumber();
-      if (blockNumber > lastBlock) {
-        break;
-      }
-
+    for (int blockNumber = hint; blockNumber <= lastBlock; ++blockNumber) {
       m_hruleBlocks.insert(blockNumber);
-
-      block = block.next();
     }
   }
 }
@@ -456,6 +444,115 @@ PegHighlighterResult::getCodeBlockHighlight(int p_blockNumber) const {
   return m_dummyHighlight;
 }
 
+static bool isRegionsIntersected(const QVector<peg::ElementRegion> &p_regions, int p_start,
+                                 int p_end) {
+  for (const auto &reg : p_regions) {
+    if (reg.intersect(p_start, p_end)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void shiftRegions(QVector<peg::ElementRegion> &p_regions, int p_pos, int p_delta) {
+  for (auto &reg : p_regions) {
+    if (reg.m_startPos >= p_pos) {
+      reg.m_startPos += p_delta;
+      reg.m_endPos += p_delta;
+    }
+  }
+}
+
+bool PegHighlighterResult::rebase(const QSharedPointer<peg::PegParseResult> &p_result,
+                                  const ContentsChange &p_change, TimeStamp p_timeStamp,
+                                  int p_numOfBlocks, QPair<int, int> &p_dirtyBlocks) {
+  if (!p_result->hasBlockPositions() || m_blocksHighlights.size() != p_result->m_numOfBlocks) {
+    return false;
+  }
+
+  // Blocks touched by the change in the document of @p_result.
+  const int firstBlock = p_result->findBlockIndex(p_change.m_position);
+  const int lastBlock =
+      p_result->findBlockIndex(p_change.m_position + p_change.m_charsRemoved, firstBlock);
+  const int blockDelta = p_numOfBlocks - p_result->m_numOfBlocks;
+  if (lastBlock + blockDelta < firstBlock) {
+    return false;
+  }
+
+  // Regions crossing blocks or being tracked outside could not be shifted piecewise.
+  const int start = p_result->m_blockPositions[firstBlock];
+  const int end = p_result->m_blockPositions[lastBlock + 1];
+  if (isRegionsIntersected(p_result->m_imageRegions, start, end) ||
+      isRegionsIntersected(p_result->m_headerRegions, start, end) ||
+      isRegionsIntersected(p_result->m_inlineEquationRegions, start, end) ||
+      isRegionsIntersected(p_result->m_displayFormulaRegions, start, end) ||
+      isRegionsIntersected(p_result->m_tableRegions, start, end)) {
+    return false;
+  }
+  for (const auto &reg : p_result->m_codeBlockRegions) {
+    if (reg.intersect(start, end)) {
+      return false;
+    }
+  }
+
+  const int charDelta = p_change.m_charsAdded - p_change.m_charsRemoved;
+
+  // Highlights are relative to the block so they are just moved along.
+  QVector<QVector<peg::HLUnit>> blocksHighlights(p_numOfBlocks);
+  for (int i = 0; i < firstBlock; ++i) {
+    blocksHighlights[i] = m_blocksHighlights[i];
+  }
+  for (int i = lastBlock + 1; i < m_blocksHighlights.size(); ++i) {
+    blocksHighlights[i + blockDelta] = m_blocksHighlights[i];
+  }
+  m_blocksHighlights = blocksHighlights;
+
+  shiftRegions(m_imageRegions, p_change.m_position, charDelta);
+  shiftRegions(m_headerRegions, p_change.m_position, charDelta);
+
+  for (auto &block : m_codeBlocks) {
+    if (block.m_startBlock > lastBlock) {
+      block.m_startPos += charDelta;
+      block.m_startBlock += blockDelta;
+      block.m_endBlock += blockDelta;
+    }
+  }
+
+  QHash<int, peg::HighlightBlockState> codeBlocksState;
+  for (auto it = m_codeBlocksState.constBegin(); it != m_codeBlocksState.constEnd(); ++it) {
+    codeBlocksState.insert(it.key() > lastBlock ? it.key() + blockDelta : it.key(), it.value());
+  }
+  m_codeBlocksState = codeBlocksState;
+
+  for (auto &block : m_mathBlocks) {
+    if (block.m_blockNumber > lastBlock) {
+      block.m_blockNumber += blockDelta;
+    }
+  }
+
+  QSet<int> hruleBlocks;
+  for (int blockNumber : m_hruleBlocks) {
+    hruleBlocks.insert(blockNumber > lastBlock ? blockNumber + blockDelta : blockNumber);
+  }
+  m_hruleBlocks = hruleBlocks;
+
+  for (auto &block : m_tableBlocks) {
+    if (block.m_startPos >= p_change.m_position) {
+      block.m_startPos += charDelta;
+      block.m_endPos += charDelta;
+      for (auto &border : block.m_borders) {
+        border += charDelta;
+      }
+    }
+  }
+
+  m_timeStamp = p_timeStamp;
+  m_numOfBlocks = p_numOfBlocks;
+  p_dirtyBlocks.first = firstBlock;
+  p_dirtyBlocks.second = lastBlock + blockDelta;
+  return true;
+}
+
 void PegHighlighterResult::setCodeBlockHighlights(
     int p_index, const QVector<QVector<peg::HLUnitStyle>> &p_highlights) {
   Q_ASSERT(p_index >= 0 && p_index < m_codeBlocks.size());
@@ -1,6 +1,7 @@
 #ifndef PEGHIGHLIGHTERRESULT_H
 #define PEGHIGHLIGHTERRESULT_H
 
+#include <QPair>
 #include <QSet>
 #include <QVector>
 
@@ -36,20 +37,32 @@ class PegHighlighterResult {
 public:
   PegHighlighterResult() = default;
 
+  // Build from the block positions and text snapshot of @p_result without accessing the
+  // document, so it could be done on the parser worker.
   // TODO: handle p_result->m_offset which is 0 for now.
-  PegHighlighterResult(const PegMarkdownHighlighter *p_peg,
-                       const QSharedPointer<peg::PegParseResult> &p_result,
-                       TimeStamp p_curTimeStamp, const ContentsChange &p_lastContentsChange);
+  explicit PegHighlighterResult(const QSharedPointer<peg::PegParseResult> &p_result);
 
   bool matched(TimeStamp p_timeStamp) const { return m_timeStamp == p_timeStamp; }
 
   bool isCodeBlockHighlightEmpty() const;
 
+  // Whether it is applied to blocks progressively starting from m_priorityBlocks.
+  bool isProgressive() const { return m_priorityBlocks.first > -1; }
+
   const QVector<peg::HLUnitStyle> &getCodeBlockHighlight(int p_blockNumber) const;
 
   void setCodeBlockHighlights(int p_index, const QVector<QVector<peg::HLUnitStyle>> &p_highlights);
 
+  // Rebase this result built from @p_result onto a later document with @p_numOfBlocks blocks,
+  // which is the document of @p_result with @p_change applied.
+  // Blocks and regions after @p_change are shifted, while blocks touched by @p_change lose their
+  // highlights and are returned via @p_dirtyBlocks, inclusive.
+  // Return false if any region of @p_result lies in the touched blocks.
+  bool rebase(const QSharedPointer<peg::PegParseResult> &p_result, const ContentsChange &p_change,
+              TimeStamp p_timeStamp, int p_numOfBlocks, QPair<int, int> &p_dirtyBlocks);
+
   // Parse highlight elements for all the blocks from parse results.
+  // Block positions of @p_result are used if available, or @p_peg's document is searched.
   static void parseBlocksHighlights(QVector<QVector<peg::HLUnit>> &p_blocksHighlights,
                                     const PegMarkdownHighlighter *p_peg,
                                     const QSharedPointer<peg::PegParseResult> &p_result);
@@ -93,6 +106,9 @@ public:
 
   QVector<peg::HLUnitStyle> m_dummyHighlight;
 
+  // Blocks applied first in a progressive result, inclusive.
+  QPair<int, int> m_priorityBlocks = {-1, -1};
+
 private:
   // Parse highlight elements for blocks from one parse result.
   static void parseBlocksHighlightOne(QVector<QVector<peg::HLUnit>> &p_blocksHighlights,
@@ -100,20 +116,19 @@ private:
                                       unsigned long p_end, int p_styleIndex);
 
   // Parse fenced code blocks from parse results.
-  void parseFencedCodeBlocks(const PegMarkdownHighlighter *p_peg,
-                             const QSharedPointer<peg::PegParseResult> &p_result);
+  void parseFencedCodeBlocks(const QSharedPointer<peg::PegParseResult> &p_result);
 
   // Parse math blocks from parse results.
-  void parseMathBlock(const PegMarkdownHighlighter *p_peg,
-                      const QSharedPointer<peg::PegParseResult> &p_result);
+  void parseMathBlock(const QSharedPointer<peg::PegParseResult> &p_result);
 
   // Parse HRule blocks from parse results.
-  void parseHRuleBlocks(const PegMarkdownHighlighter *p_peg,
-                        const QSharedPointer<peg::PegParseResult> &p_result);
+  void parseHRuleBlocks(const QSharedPointer<peg::PegParseResult> &p_result);
 
   // Parse table blocks from parse results.
   void parseTableBlocks(const QSharedPointer<peg::PegParseResult> &p_result);
 
+  void parseRegions(const QSharedPointer<peg::PegParseResult> &p_result);
+
 #if 0
         void parseBlocksElementRegionOne(QHash<int, QVector<peg::ElementRegion>> &p_regs,
                                          const QTextDocument *p_doc,
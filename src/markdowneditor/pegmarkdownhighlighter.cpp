@@ -1,26 +1,45 @@
 #include <vtextedit/pegmarkdownhighlighter.h>
 
+#include <climits>
+
 #include <QDebug>
 #include <QScrollBar>
 #include <QTextDocument>
 #include <QTimer>
 
-#include <spellcheck/spellcheckhighlighthelper.h>
-#include <texteditor/blockspellcheckdata.h>
+#include <vtextedit/orderedintset.h>
 #include <vtextedit/previewdata.h>
 #include <vtextedit/textblockdata.h>
 #include <vtextedit/texteditutils.h>
 #include <vtextedit/textutils.h>
 #include <vtextedit/theme.h>
 
+#include "editjournal.h"
 #include "peghighlightblockdata.h"
 #include "peghighlighterresult.h"
 #include "pegparser.h"
 
 #define LARGE_BLOCK_NUMBER 1000
 
+// Max number of elements or blocks to handle at a time for a progressive result.
+#define PROGRESSIVE_CHUNK_SIZE 512
+
+// Time in ms to handle a progressive result before yielding to the event loop.
+#define PROGRESSIVE_TIME_SLICE 8
+
 using namespace vte;
 
+// Second stage of the parser worker.
+static QSharedPointer<PegHighlighterResult>
+buildHighlighterResult(const QSharedPointer<peg::PegParseResult> &p_result) {
+  if (!p_result->hasBlockPositions()) {
+    // Will be built on the GUI thread.
+    return nullptr;
+  }
+
+  return QSharedPointer<PegHighlighterResult>::create(p_result);
+}
+
 PegMarkdownHighlighter::PegMarkdownHighlighter(
     PegMarkdownHighlighterInterface *p_interface, QTextDocument *p_doc,
     const QSharedPointer<Theme> &p_theme, CodeBlockHighlighter *p_codeBlockHighlighter,
@@ -35,12 +54,13 @@ PegMarkdownHighlighter::PegMarkdownHighlighter(
     m_parserExts |= (pmh_EXT_MATH | pmh_EXT_MATH_RAW);
   }
 
-  m_parser = new peg::PegParser(this);
+  m_parser = new peg::PegParser(p_config->m_parserWorkerCount, this);
   connect(m_parser, &peg::PegParser::parseResultReady, this,
           &PegMarkdownHighlighter::handleParseResult);
 
   m_result.reset(new PegHighlighterResult());
   m_fastResult.reset(new PegHighlighterFastResult());
+  m_editJournal.reset(new EditJournal());
 
   m_parseTimer = new QTimer(this);
   m_parseTimer->setSingleShot(true);
@@ -71,14 +91,24 @@ PegMarkdownHighlighter::PegMarkdownHighlighter(
   connect(m_interface->verticalScrollBar(), &QScrollBar::valueChanged, m_scrollRehighlightTimer,
           static_cast<void (QTimer::*)()>(&QTimer::start));
 
+  m_progressiveTimer = new QTimer(this);
+  m_progressiveTimer->setSingleShot(true);
+  m_progressiveTimer->setInterval(0);
+  connect(m_progressiveTimer, &QTimer::timeout, this,
+          &PegMarkdownHighlighter::continueProgressiveHighlight);
+
   m_contentChangeTime.start();
   connect(document(), &QTextDocument::contentsChange, this,
           &PegMarkdownHighlighter::handleContentsChange);
 
-  connect(m_codeBlockHighlighter, &CodeBlockHighlighter::codeBlockHighlightCompleted, this,
-          &PegMarkdownHighlighter::handleCodeBlockHighlightResult);
+  if (m_codeBlockHighlighter) {
+    connect(m_codeBlockHighlighter, &CodeBlockHighlighter::codeBlockHighlightCompleted, this,
+            &PegMarkdownHighlighter::handleCodeBlockHighlightResult);
+  }
 }
 
+PegMarkdownHighlighter::~PegMarkdownHighlighter() {}
+
 // Just use parse results to highlight block.
 // Do not maintain block data and state here.
 void PegMarkdownHighlighter::highlightBlock(const QString &p_text) {
@@ -159,16 +189,8 @@ void PegMarkdownHighlighter::highlightBlock(const QString &p_text) {
   const bool needSpellCheck = cstate != peg::HighlightBlockState::CodeBlockStart &&
                               cstate != peg::HighlightBlockState::CodeBlock &&
                               cstate != peg::HighlightBlockState::CodeBlockEnd;
-  if (needSpellCheck && !p_text.isEmpty() && m_spellCheckEnabled) {
-    auto data = TextBlockData::get(block);
-    bool ret = SpellCheckHighlightHelper::checkBlock(block, p_text, m_autoDetectLanguageEnabled);
-    if (ret) {
-      // Further check and highlight.
-      auto spellData = data->getBlockSpellCheckData();
-      if (spellData && spellData->isValid(block.revision()) && !spellData->isEmpty()) {
-        VSyntaxHighlighter::highlightMisspell(spellData);
-      }
-    }
+  if (needSpellCheck) {
+    highlightSpellCheck(p_text);
   }
 }
 
@@ -252,7 +274,6 @@ void PegMarkdownHighlighter::highlightBlockOne(const QVector<peg::HLUnit> &p_uni
 // highlightBlock() will be called before this function.
 void PegMarkdownHighlighter::handleContentsChange(int p_position, int p_charsRemoved,
                                                   int p_charsAdded) {
-  Q_UNUSED(p_position);
 
   int interval = m_contentChangeTime.restart();
 
@@ -262,6 +283,15 @@ void PegMarkdownHighlighter::handleContentsChange(int p_position, int p_charsRem
 
   ++m_timeStamp;
 
+  ContentsChange change;
+  change.m_position = p_position;
+  change.m_charsRemoved = p_charsRemoved;
+  change.m_charsAdded = p_charsAdded;
+  m_editJournal->append(m_timeStamp, change);
+  if (!m_parseResult.isNull()) {
+    EditJournal::merge(m_parseResultChange, change);
+  }
+
   m_parseTimer->stop();
 
   if (m_timeStamp > 2) {
@@ -276,11 +306,20 @@ void PegMarkdownHighlighter::handleContentsChange(int p_position, int p_charsRem
 }
 
 void PegMarkdownHighlighter::startParse() {
+  if (startIncrementalParse()) {
+    return;
+  }
+
+  startFullParse();
+}
+
+void PegMarkdownHighlighter::startFullParse() {
   QSharedPointer<peg::PegParseConfig> config(new peg::PegParseConfig());
   config->m_timeStamp = m_timeStamp;
-  config->m_data = document()->toPlainText().toUtf8();
+  config->m_data = document()->toPlainText();
   config->m_numOfBlocks = document()->blockCount();
   config->m_extensions = m_parserExts;
+  config->m_resultBuilder = buildHighlighterResult;
 
   m_parser->parseAsync(config);
 }
@@ -319,7 +358,7 @@ void PegMarkdownHighlighter::startFastParse(int p_position, int p_charsRemoved,
 
   QSharedPointer<peg::PegParseConfig> config(new peg::PegParseConfig());
   config->m_timeStamp = m_timeStamp;
-  config->m_data = text.toUtf8();
+  config->m_data = text;
   config->m_numOfBlocks = document()->blockCount();
   config->m_offset = offset;
   config->m_extensions = m_parserExts;
@@ -336,11 +375,26 @@ void PegMarkdownHighlighter::processFastParseResult(
   // Add additional single format blocks.
   appendSingleFormatBlocks(m_fastResult->m_blocksHighlights);
 
-  if (!m_fastResult->matched(m_timeStamp) || m_result->matched(m_timeStamp)) {
+  if (!m_fastResult->matched(m_timeStamp)) {
     return;
   }
 
   auto doc = document();
+  if (m_result->matched(m_timeStamp)) {
+    // Only a rebased result leaves blocks to the fast parse.
+    if (EditJournal::isEmpty(m_parseResultChange)) {
+      return;
+    }
+
+    auto &blocksHighlights = m_result->m_blocksHighlights;
+    const int lastBlock =
+        qMin(m_fastParseBlocks.second, static_cast<int>(blocksHighlights.size()) - 1);
+    for (int i = m_fastParseBlocks.first; i <= lastBlock; ++i) {
+      blocksHighlights[i] = m_fastResult->m_blocksHighlights.value(i);
+      PegHighlightBlockData::get(doc->findBlockByNumber(i))->clearHighlight();
+    }
+  }
+
   for (int i = m_fastParseBlocks.first; i <= m_fastParseBlocks.second; ++i) {
     QTextBlock block = doc->findBlockByNumber(i);
     rehighlightBlock(block);
@@ -349,11 +403,14 @@ void PegMarkdownHighlighter::processFastParseResult(
 
 void PegMarkdownHighlighter::updateHighlight() {
   m_parseTimer->stop();
-  if (m_result->matched(m_timeStamp)) {
+  // A rebased result is matched but not parsed from the latest contents.
+  if (m_result->matched(m_timeStamp) && EditJournal::isEmpty(m_parseResultChange)) {
     // No need to parse again. Already the latest.
     updateCodeBlocks(m_result);
     rehighlightBlocksLater();
-    completeHighlight(m_result);
+    if (!m_progressiveTimer->isActive()) {
+      completeHighlight(m_result);
+    }
   } else {
     startParse();
   }
@@ -361,39 +418,144 @@ void PegMarkdownHighlighter::updateHighlight() {
 
 void PegMarkdownHighlighter::handleParseResult(
     const QSharedPointer<peg::PegParseResult> &p_result) {
-  if (!m_result.isNull() && p_result->m_timeStamp != m_timeStamp) {
-    // Directly skip non-matched results to avoid highlight noise.
+  // Changes since a stale result, which will be rebased onto the current document instead of
+  // being discarded so that highlight still converges during sustained typing.
+  ContentsChange staleChange;
+  const bool stale = p_result->m_timeStamp != m_timeStamp;
+  if (stale) {
+    if (p_result->m_incrementalFailed || !p_result->hasBlockPositions() ||
+        (!m_parseResult.isNull() && p_result->m_timeStamp <= m_parseResult->m_timeStamp) ||
+        !m_editJournal->changeSince(p_result->m_timeStamp, m_timeStamp, staleChange)) {
+      return;
+    }
+  }
+
+  if (p_result->m_incrementalFailed) {
+    startFullParse();
+    return;
+  }
+
+  // The parse result is kept as the base of incremental parse, while the highlighter result
+  // built on the worker is taken over by m_result.
+  QSharedPointer<PegHighlighterResult> result;
+  result.swap(p_result->m_highlighterResult);
+  if (!result) {
+    if (!p_result->hasBlockPositions()) {
+      p_result->setText(document()->toPlainText());
+    }
+    result.reset(new PegHighlighterResult(p_result));
+  }
+
+  m_parseResult = p_result;
+  m_parseResultChange = staleChange;
+  m_editJournal->trim(p_result->m_timeStamp);
+
+  if (stale && !rebaseResult(result, p_result, staleChange)) {
+    // Still a closer base for incremental parse.
     return;
   }
 
   clearFastParseResult();
 
-  m_result.reset(new PegHighlighterResult(this, p_result, m_timeStamp, m_lastContentsChange));
+  if (stale) {
+    // Fill the dirty blocks of the rebased result with a fast parse, which is what the user
+    // sees while typing.
+    m_lastContentsChange = staleChange;
+    m_fastParseTimer->start(0);
+  }
+
+  m_progressiveTimer->stop();
+  const auto priorityBlocks = progressiveBlockRange(p_result);
+  const bool progressive = priorityBlocks.first > -1;
+  result->m_priorityBlocks = priorityBlocks;
+  m_result = result;
 
   m_result->m_codeBlockTimeStamp = nextCodeBlockTimeStamp();
 
+  // Blocks out of the priority blocks will be handled by continueProgressiveHighlight().
+  const int firstBlock = progressive ? priorityBlocks.first : 0;
+  const int lastBlock = progressive ? priorityBlocks.second : INT_MAX;
+
   m_singleFormatBlocks.clear();
-  appendSingleFormatBlocks(m_result->m_blocksHighlights);
+  appendSingleFormatBlocks(m_result->m_blocksHighlights, firstBlock, lastBlock);
 
   bool matched = m_result->matched(m_timeStamp);
   if (matched) {
-    clearAllBlocksUserDataAndState(m_result);
+    clearBlocksUserDataAndState(m_result, firstBlock, lastBlock);
 
-    updateAllBlocksUserDataAndState(m_result);
+    updateBlocksUserDataAndState(m_result, firstBlock, lastBlock);
 
     updateCodeBlocks(m_result);
   }
 
   if (m_result->m_timeStamp == 2) {
-    m_notifyHighlightComplete = true;
+    m_notifyHighlightComplete = !progressive;
     rehighlightBlocks();
   } else {
     rehighlightBlocksLater();
   }
 
-  if (matched) {
+  // A progressive result is completed by continueProgressiveHighlight() after the last batch.
+  if (matched && !progressive) {
     completeHighlight(m_result);
   }
+
+  if (progressive) {
+    m_nextProgressiveBlock = 0;
+    m_progressiveTimer->start();
+  }
+}
+
+void PegMarkdownHighlighter::continueProgressiveHighlight() {
+  QSharedPointer<PegHighlighterResult> result(m_result);
+  if (!result->isProgressive() || !result->matched(m_timeStamp)) {
+    // Cancelled by a newer time stamp.
+    return;
+  }
+
+  const auto &priorityBlocks = result->m_priorityBlocks;
+  QElapsedTimer timer;
+  timer.start();
+  do {
+    const int first = m_nextProgressiveBlock;
+    if (first >= result->m_numOfBlocks) {
+      // Blocks highlighted before their highlights are ready need another pass.
+      rehighlightBlocksLater();
+      completeHighlight(result);
+      return;
+    }
+
+    if (first == priorityBlocks.first) {
+      m_nextProgressiveBlock = priorityBlocks.second + 1;
+      continue;
+    }
+
+    int last = qMin(first + PROGRESSIVE_CHUNK_SIZE, result->m_numOfBlocks) - 1;
+    if (first < priorityBlocks.first) {
+      last = qMin(last, priorityBlocks.first - 1);
+    }
+
+    appendSingleFormatBlocks(result->m_blocksHighlights, first, last);
+    clearBlocksUserDataAndState(result, first, last);
+    updateBlocksUserDataAndState(result, first, last);
+    m_nextProgressiveBlock = last + 1;
+  } while (timer.elapsed() < PROGRESSIVE_TIME_SLICE);
+
+  m_progressiveTimer->start();
+}
+
+QPair<int, int> PegMarkdownHighlighter::progressiveBlockRange(
+    const QSharedPointer<peg::PegParseResult> &p_result) const {
+  if (!m_config->m_progressiveHighlightEnabled || p_result->m_numOfBlocks <= LARGE_BLOCK_NUMBER ||
+      p_result->m_numOfBlocks != document()->blockCount() || !p_result->hasBlockPositions()) {
+    return qMakePair(-1, -1);
+  }
+
+  const auto range = sensitiveBlockRange();
+  if (range.first > range.second) {
+    return qMakePair(-1, -1);
+  }
+  return range;
 }
 
 void PegMarkdownHighlighter::clearFastParseResult() {
@@ -403,9 +565,10 @@ void PegMarkdownHighlighter::clearFastParseResult() {
 }
 
 void PegMarkdownHighlighter::appendSingleFormatBlocks(
-    const QVector<QVector<peg::HLUnit>> &p_highlights) {
+    const QVector<QVector<peg::HLUnit>> &p_highlights, int p_first, int p_last) {
   auto doc = document();
-  for (int i = 0; i < p_highlights.size(); ++i) {
+  const int last = qMin(p_last, p_highlights.size() - 1);
+  for (int i = p_first; i <= last; ++i) {
     const auto &units = p_highlights[i];
     if (units.size() == 1) {
       const auto &unit = units[0];
@@ -419,10 +582,10 @@ void PegMarkdownHighlighter::appendSingleFormatBlocks(
   }
 }
 
-void PegMarkdownHighlighter::clearAllBlocksUserDataAndState(
-    const QSharedPointer<PegHighlighterResult> &p_result) {
-  QTextBlock block = document()->firstBlock();
-  while (block.isValid()) {
+void PegMarkdownHighlighter::clearBlocksUserDataAndState(
+    const QSharedPointer<PegHighlighterResult> &p_result, int p_first, int p_last) {
+  QTextBlock block = document()->findBlockByNumber(p_first);
+  for (int i = p_first; block.isValid() && i <= p_last; ++i) {
     clearBlockUserData(p_result, block);
 
     block.setUserState(peg::HighlightBlockState::Normal);
@@ -449,28 +612,58 @@ void PegMarkdownHighlighter::clearBlockUserData(
   }
 }
 
-void PegMarkdownHighlighter::updateAllBlocksUserDataAndState(
-    const QSharedPointer<PegHighlighterResult> &p_result) {
+void PegMarkdownHighlighter::updateBlocksUserDataAndState(
+    const QSharedPointer<PegHighlighterResult> &p_result, int p_first, int p_last) {
   auto doc = document();
+  const auto firstBlock = doc->findBlockByNumber(p_first);
+  if (!firstBlock.isValid()) {
+    return;
+  }
+  auto lastBlock = doc->findBlockByNumber(p_last);
+  if (!lastBlock.isValid()) {
+    lastBlock = doc->lastBlock();
+    p_last = lastBlock.blockNumber();
+  }
 
   // Code blocks.
   const QHash<int, peg::HighlightBlockState> &cbStates = p_result->m_codeBlocksState;
-  for (auto it = cbStates.begin(); it != cbStates.end(); ++it) {
-    QTextBlock block = doc->findBlockByNumber(it.key());
-    if (!block.isValid()) {
-      continue;
+  if (p_last - p_first + 1 < cbStates.size()) {
+    auto block = firstBlock;
+    for (int i = p_first; block.isValid() && i <= p_last; ++i) {
+      auto it = cbStates.find(i);
+      if (it != cbStates.end()) {
+        block.setUserState(it.value());
+      }
+      block = block.next();
+    }
+  } else {
+    for (auto it = cbStates.begin(); it != cbStates.end(); ++it) {
+      if (it.key() < p_first || it.key() > p_last) {
+        continue;
+      }
+
+      QTextBlock block = doc->findBlockByNumber(it.key());
+      if (!block.isValid()) {
+        continue;
+      }
+      block.setUserState(it.value());
     }
-    block.setUserState(it.value());
   }
 
   // Table blocks.
+  const int startPos = firstBlock.position();
+  const int endPos = lastBlock.position() + lastBlock.length();
   for (const auto &tbb : p_result->m_tableBlocks) {
-    auto block = doc->findBlock(tbb.m_startPos);
+    if (tbb.m_endPos <= startPos || tbb.m_startPos >= endPos) {
+      continue;
+    }
+
+    auto block = doc->findBlock(qMax(tbb.m_startPos, startPos));
     if (!block.isValid()) {
       continue;
     }
 
-    while (block.isValid() && block.position() < tbb.m_endPos) {
+    while (block.isValid() && block.position() < qMin(tbb.m_endPos, endPos)) {
       PegHighlightBlockData::get(block)->setWrapLineEnabled(false);
       block = block.next();
     }
@@ -489,7 +682,8 @@ void PegMarkdownHighlighter::updateCodeBlocks(
     } else {
       p_result->m_codeBlockHighlightReceived = true;
     }
-    m_codeBlockHighlighter->highlight(p_result->m_timeStamp, p_result->m_codeBlocks);
+    m_codeBlockHighlighter->highlight(p_result->m_timeStamp, p_result->m_codeBlocks,
+                                      sensitiveBlockRange());
   } else {
     p_result->m_codeBlockHighlightReceived = true;
   }
@@ -674,20 +868,26 @@ void PegMarkdownHighlighter::completeHighlight(QSharedPointer<PegHighlighterResu
 
 bool PegMarkdownHighlighter::isMathEnabled() const { return m_parserExts & pmh_EXT_MATH; }
 
-void PegMarkdownHighlighter::rehighlightSensitiveBlocks() {
-  QTextBlock cb = m_interface->textCursor().block();
-
+QPair<int, int> PegMarkdownHighlighter::sensitiveBlockRange() const {
   auto range = m_interface->visibleBlockRange();
 
-  bool cursorVisible = cb.blockNumber() >= range.first && cb.blockNumber() <= range.second;
-
   // Include extra blocks.
   const int nrUpExtra = 5;
   const int nrDownExtra = 20;
   int first = qMax(0, range.first - nrUpExtra);
   int last = qMin(document()->blockCount() - 1, range.second + nrDownExtra);
+  return qMakePair(first, last);
+}
+
+void PegMarkdownHighlighter::rehighlightSensitiveBlocks() {
+  QTextBlock cb = m_interface->textCursor().block();
+
+  auto range = m_interface->visibleBlockRange();
+
+  bool cursorVisible = cb.blockNumber() >= range.first && cb.blockNumber() <= range.second;
 
-  if (rehighlightBlockRange(first, last)) {
+  const auto sensitiveRange = sensitiveBlockRange();
+  if (rehighlightBlockRange(sensitiveRange.first, sensitiveRange.second)) {
     if (cursorVisible) {
       m_interface->ensureCursorVisible();
     }
@@ -812,6 +1012,282 @@ void PegMarkdownHighlighter::getFastParseBlockRange(int p_position, int p_charsR
   }
 }
 
+// Whether @p_text may start or end a construct spanning across blank lines.
+static bool isMultiBlockMarker(const QString &p_text) {
+  const auto text = p_text.trimmed();
+  return text.startsWith(QStringLiteral("```")) || text.startsWith(QStringLiteral("~~~")) ||
+         text.startsWith(QStringLiteral("$$")) || text.endsWith(QStringLiteral("$$")) ||
+         text.startsWith(QStringLiteral("\\begin")) || text.startsWith(QStringLiteral("\\end")) ||
+         text.startsWith(QLatin1Char('<')) || text.contains(QStringLiteral("-->"));
+}
+
+// Whether a top-level markdown block starts at @p_block.
+static bool isTopLevelBlockStart(const QTextBlock &p_block) {
+  auto preBlock = p_block.previous();
+  if (!preBlock.isValid()) {
+    return true;
+  }
+
+  return TextEditUtils::isEmptyBlock(preBlock) && !TextEditUtils::isEmptyBlock(p_block) &&
+         TextEditUtils::fetchIndentation(p_block) == 0;
+}
+
+// Whether a top-level markdown block ends at @p_block.
+static bool isTopLevelBlockEnd(const QTextBlock &p_block) {
+  auto nextBlock = p_block.next();
+  if (!nextBlock.isValid()) {
+    return true;
+  }
+
+  if (!TextEditUtils::isEmptyBlock(nextBlock) || TextEditUtils::isEmptyBlock(p_block)) {
+    return false;
+  }
+
+  while (nextBlock.isValid() && TextEditUtils::isEmptyBlock(nextBlock)) {
+    nextBlock = nextBlock.next();
+  }
+
+  return !nextBlock.isValid() || TextEditUtils::fetchIndentation(nextBlock) == 0;
+}
+
+bool PegMarkdownHighlighter::startIncrementalParse() {
+  if (m_parseResult.isNull() || m_parseResult->isEmpty() ||
+      EditJournal::isEmpty(m_parseResultChange)) {
+    return false;
+  }
+
+  // Full parse is cheap enough for small documents.
+  auto doc = document();
+  if (doc->blockCount() <= LARGE_BLOCK_NUMBER) {
+    return false;
+  }
+
+  const auto &change = m_parseResultChange;
+  const int delta = change.m_charsAdded - change.m_charsRemoved;
+
+  QTextBlock firstBlock = doc->findBlock(change.m_position);
+  QTextBlock lastBlock = doc->findBlock(change.m_position + change.m_charsAdded);
+  if (!lastBlock.isValid()) {
+    lastBlock = doc->lastBlock();
+  }
+
+  if (!firstBlock.isValid()) {
+    return false;
+  }
+
+  // Changes of the markers of multi-block constructs may affect the rest of the document.
+  for (auto block = firstBlock; block.isValid(); block = block.next()) {
+    if (isMultiBlockMarker(block.text())) {
+      return false;
+    }
+
+    if (block == lastBlock) {
+      break;
+    }
+  }
+
+  {
+    // Check the removed or modified markers.
+    const int lineStart = firstBlock.position();
+    const int lineEnd = lastBlock.position() + lastBlock.length() - delta;
+    auto touched = [lineStart, lineEnd](int p_pos) {
+      return p_pos >= lineStart && p_pos <= lineEnd;
+    };
+    const pmh_element_type types[] = {pmh_FENCEDCODEBLOCK, pmh_DISPLAYFORMULA, pmh_FRONTMATTER,
+                                      pmh_HTMLBLOCK, pmh_COMMENT};
+    for (auto type : types) {
+      for (const auto &elem : m_parseResult->m_elements[type]) {
+        if (touched(elem.m_startPos) || touched(elem.m_endPos - 1)) {
+          return false;
+        }
+      }
+    }
+  }
+
+  if (!expandIncrementalParseBlockRange(firstBlock, lastBlock)) {
+    return false;
+  }
+
+  if (lastBlock.blockNumber() - firstBlock.blockNumber() + 1 > doc->blockCount() / 2) {
+    return false;
+  }
+
+  const int start = firstBlock.position();
+  const int baseEnd = lastBlock.position() + lastBlock.length() - delta;
+
+  QString text;
+  for (auto block = firstBlock; block.isValid(); block = block.next()) {
+    if (block == firstBlock) {
+      text = block.text();
+    } else {
+      text += QStringLiteral("\n") + block.text();
+    }
+
+    if (block == lastBlock) {
+      break;
+    }
+  }
+
+  QSharedPointer<peg::PegParseConfig> config(new peg::PegParseConfig());
+  config->m_timeStamp = m_timeStamp;
+  config->m_numOfBlocks = doc->blockCount();
+  config->m_offset = start;
+  config->m_extensions = m_parserExts;
+  if (start > 0) {
+    // Front matter is only allowed at the beginning of the document.
+    config->m_extensions &= ~pmh_EXT_FRONTMATTER;
+  }
+  config->m_baseResult = m_parseResult;
+  config->m_baseEnd = baseEnd;
+  config->m_regionLength = text.size();
+  config->m_delta = delta;
+
+  // Append reference definitions so that reference links within the region could be resolved.
+  const auto refs = fetchReferenceDefinitions(start, baseEnd, delta);
+  if (!refs.isEmpty()) {
+    text += QStringLiteral("\n\n") + refs;
+  }
+  config->m_data = text;
+  config->m_resultBuilder = buildHighlighterResult;
+
+  m_parser->parseAsync(config);
+  return true;
+}
+
+bool PegMarkdownHighlighter::expandIncrementalParseBlockRange(QTextBlock &p_firstBlock,
+                                                              QTextBlock &p_lastBlock) const {
+  auto doc = document();
+  const int delta = m_parseResultChange.m_charsAdded - m_parseResultChange.m_charsRemoved;
+
+  // Only block-level elements could span across blank lines.
+  const pmh_element_type types[] = {pmh_FENCEDCODEBLOCK, pmh_VERBATIM,  pmh_BLOCKQUOTE,
+                                    pmh_HTMLBLOCK,       pmh_COMMENT,   pmh_FRONTMATTER,
+                                    pmh_DISPLAYFORMULA,  pmh_TABLE,     pmh_NOTE,
+                                    pmh_REFERENCE};
+
+  bool expanded = true;
+  while (expanded) {
+    expanded = false;
+
+    while (!isTopLevelBlockStart(p_firstBlock)) {
+      p_firstBlock = p_firstBlock.previous();
+    }
+
+    while (!isTopLevelBlockEnd(p_lastBlock)) {
+      p_lastBlock = p_lastBlock.next();
+    }
+
+    // Positions in the document of m_parseResult.
+    const int start = p_firstBlock.position();
+    const int baseEnd = p_lastBlock.position() + p_lastBlock.length() - delta;
+    int nextContentPos = INT_MAX;
+    {
+      auto block = p_lastBlock.next();
+      while (block.isValid() && TextEditUtils::isEmptyBlock(block)) {
+        block = block.next();
+      }
+      if (block.isValid()) {
+        nextContentPos = block.position() - delta;
+      }
+    }
+
+    for (auto type : types) {
+      for (const auto &elem : m_parseResult->m_elements[type]) {
+        if (elem.m_startPos < start && elem.m_endPos > start) {
+          if (type == pmh_REFERENCE) {
+            return false;
+          }
+
+          auto block = doc->findBlock(elem.m_startPos);
+          if (block.isValid() && block.blockNumber() < p_firstBlock.blockNumber()) {
+            p_firstBlock = block;
+            expanded = true;
+          }
+        }
+
+        if (elem.m_startPos < baseEnd && elem.m_endPos > nextContentPos) {
+          if (type == pmh_REFERENCE) {
+            return false;
+          }
+
+          auto block = doc->findBlock(elem.m_endPos - 1 + delta);
+          if (!block.isValid()) {
+            block = doc->lastBlock();
+          }
+          if (block.blockNumber() > p_lastBlock.blockNumber()) {
+            p_lastBlock = block;
+            expanded = true;
+          }
+        }
+
+        // Reference definitions within the region may affect the whole document.
+        if (type == pmh_REFERENCE && elem.m_startPos >= start && elem.m_startPos < baseEnd) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+bool PegMarkdownHighlighter::rebaseResult(const QSharedPointer<PegHighlighterResult> &p_result,
+                                          const QSharedPointer<peg::PegParseResult> &p_parseResult,
+                                          const ContentsChange &p_change) {
+  auto doc = document();
+  QPair<int, int> dirtyBlocks;
+  if (!p_result->rebase(p_parseResult, p_change, m_timeStamp, doc->blockCount(), dirtyBlocks)) {
+    return false;
+  }
+
+  for (int i = dirtyBlocks.first; i <= dirtyBlocks.second; ++i) {
+    if (isMultiBlockMarker(doc->findBlockByNumber(i).text())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+QString PegMarkdownHighlighter::fetchReferenceDefinitions(int p_start, int p_baseEnd,
+                                                          int p_delta) const {
+  auto doc = document();
+  OrderedIntSet blocks;
+  for (const auto &elem : m_parseResult->m_elements[pmh_REFERENCE]) {
+    int pos = elem.m_startPos;
+    int end = elem.m_endPos;
+    if (end <= p_start) {
+      // Unchanged.
+    } else if (pos >= p_baseEnd) {
+      pos += p_delta;
+      end += p_delta;
+    } else {
+      continue;
+    }
+
+    auto block = doc->findBlock(pos);
+    while (block.isValid() && block.position() < end) {
+      blocks.insert(block.blockNumber(), QMapDummyValue());
+      block = block.next();
+    }
+  }
+
+  QString text;
+  for (auto it = blocks.constBegin(); it != blocks.constEnd(); ++it) {
+    auto block = doc->findBlockByNumber(it.key());
+    if (TextEditUtils::isEmptyBlock(block)) {
+      continue;
+    }
+
+    if (!text.isEmpty()) {
+      text += QStringLiteral("\n");
+    }
+    text += block.text();
+  }
+
+  return text;
+}
+
 const QVector<peg::ElementRegion> &PegMarkdownHighlighter::getHeaderRegions() const {
   return m_result->m_headerRegions;
 }
@@ -1,143 +1,402 @@
 #include "pegparser.h"
 
+#include <algorithm>
+
 using namespace vte;
 using namespace vte::peg;
 
-void PegParseResult::parse(QAtomicInt &p_stop, bool p_fast) {
-  if (p_fast) {
-    return;
+namespace {
+// Merge adjacent sorted runs of @p_data, delimited by @p_bounds, pairwise until one is left.
+// Equal ones keep the order of their runs as std::stable_sort() does.
+template <typename T, typename Less>
+void mergeSortedRuns(QVector<T> &p_data, QVector<int> p_bounds, Less p_less) {
+  while (p_bounds.size() > 2) {
+    QVector<int> bounds;
+    bounds.reserve(p_bounds.size() / 2 + 1);
+    bounds.append(0);
+    int i = 0;
+    for (; i + 2 < p_bounds.size(); i += 2) {
+      std::inplace_merge(p_data.begin() + p_bounds[i], p_data.begin() + p_bounds[i + 1],
+                         p_data.begin() + p_bounds[i + 2], p_less);
+      bounds.append(p_bounds[i + 2]);
+    }
+
+    if (i + 1 < p_bounds.size()) {
+      // The last run is left alone.
+      bounds.append(p_bounds.last());
+    }
+    p_bounds.swap(bounds);
   }
+}
 
-  parseImageRegions(p_stop);
+// Merge the elements of all types into one vector sorted by start position.
+// Elements of the same start position are in the order of their types.
+QVector<HighlightElement> mergeElements(const QVector<ElementRegion> *p_elements) {
+  int cnt = 0;
+  for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+    cnt += p_elements[i].size();
+  }
 
-  parseHeaderRegions(p_stop);
+  QVector<HighlightElement> elements;
+  elements.reserve(cnt);
+  QVector<int> bounds;
+  bounds.append(0);
+  for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+    if (p_elements[i].isEmpty()) {
+      continue;
+    }
 
-  parseFencedCodeBlockRegions(p_stop);
+    for (const auto &reg : p_elements[i]) {
+      HighlightElement ele;
+      ele.m_startPos = reg.m_startPos;
+      ele.m_endPos = reg.m_endPos;
+      ele.m_styleIndex = i;
+      elements.append(ele);
+    }
+    bounds.append(elements.size());
+  }
 
-  parseInlineEquationRegions(p_stop);
+  mergeSortedRuns(elements, bounds, [](const HighlightElement &p_a, const HighlightElement &p_b) {
+    return p_a.m_startPos < p_b.m_startPos;
+  });
+  return elements;
+}
 
-  parseDisplayFormulaRegions(p_stop);
+QVector<ElementRegion> mergeHeaderRegions(const QVector<ElementRegion> *p_elements) {
+  const pmh_element_type hx[6] = {pmh_H1, pmh_H2, pmh_H3, pmh_H4, pmh_H5, pmh_H6};
+  QVector<ElementRegion> regions;
+  QVector<int> bounds;
+  bounds.append(0);
+  for (auto type : hx) {
+    regions += p_elements[type];
+    bounds.append(regions.size());
+  }
 
-  parseHRuleRegions(p_stop);
+  mergeSortedRuns(regions, bounds, std::less<ElementRegion>());
+  return regions;
+}
 
-  parseTableRegions(p_stop);
+// Keep the first one of regions of the same start position.
+QVector<ElementRegion> uniqueRegions(const QVector<ElementRegion> &p_regions) {
+  QVector<ElementRegion> regions;
+  regions.reserve(p_regions.size());
+  for (const auto &reg : p_regions) {
+    if (regions.isEmpty() || regions.last().m_startPos != reg.m_startPos) {
+      regions.append(reg);
+    }
+  }
+  return regions;
+}
 
-  parseTableHeaderRegions(p_stop);
+// Splice regions sorted by start position: those of @p_base starting before @p_start, then
+// @p_region, and then those of @p_base starting from @p_baseEnd shifted by @p_delta.
+// Region boundaries are found by binary search and the rest are copied in bulk.
+template <typename T>
+QVector<T> spliceSortedRegions(const QVector<T> &p_base, const QVector<T> &p_region,
+                               int p_start, int p_baseEnd, int p_delta) {
+  const auto startLess = [](const T &p_reg, int p_pos) { return p_reg.m_startPos < p_pos; };
+  const auto first = std::lower_bound(p_base.constBegin(), p_base.constEnd(), p_start, startLess);
+  const auto last = std::lower_bound(first, p_base.constEnd(), p_baseEnd, startLess);
+  if (p_region.isEmpty() && first == last && (p_delta == 0 || last == p_base.constEnd())) {
+    // Implicit sharing.
+    return p_base;
+  }
 
-  parseTableBorderRegions(p_stop);
+  const int numOfPrefix = static_cast<int>(first - p_base.constBegin());
+  const int numOfSuffix = static_cast<int>(p_base.constEnd() - last);
+  QVector<T> regions(numOfPrefix + p_region.size() + numOfSuffix);
+  auto out = std::copy(p_base.constBegin(), first, regions.begin());
+  out = std::copy(p_region.constBegin(), p_region.constEnd(), out);
+  std::transform(last, p_base.constEnd(), out, [p_delta](T p_reg) {
+    p_reg.m_startPos += p_delta;
+    p_reg.m_endPos += p_delta;
+    return p_reg;
+  });
+  return regions;
 }
+} // namespace
 
-void PegParseResult::parseImageRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_IMAGE, m_imageRegions, false);
-}
+void PegParseResult::setElements(pmh_element **p_pmhElements, QAtomicInt &p_stop) {
+  m_hasElements = p_pmhElements != NULL;
+  for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+    m_elements[i].clear();
+  }
 
-void PegParseResult::parseHeaderRegions(QAtomicInt &p_stop) {
-  // From Qt5.7, the capacity is preserved.
-  m_headerRegions.clear();
-  if (isEmpty()) {
+  if (!p_pmhElements) {
     return;
   }
 
-  pmh_element_type hx[6] = {pmh_H1, pmh_H2, pmh_H3, pmh_H4, pmh_H5, pmh_H6};
-  for (int i = 0; i < 6; ++i) {
-    pmh_element *elem = m_pmhElements[hx[i]];
-    while (elem != NULL) {
-      if (elem->end <= elem->pos) {
-        elem = elem->next;
-        continue;
-      }
+  for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+    if (p_stop.loadAcquire() == 1) {
+      return;
+    }
 
-      if (p_stop.loadAcquire() == 1) {
-        return;
+    auto &elements = m_elements[i];
+    for (auto elem = p_pmhElements[i]; elem; elem = elem->next) {
+      if (elem->end > elem->pos) {
+        elements.append(ElementRegion(m_offset + elem->pos, m_offset + elem->end));
       }
-
-      m_headerRegions.push_back(ElementRegion(m_offset + elem->pos, m_offset + elem->end));
-      elem = elem->next;
     }
+
+    // The parser prepends elements.
+    std::sort(elements.begin(), elements.end());
   }
+}
+
+void PegParseResult::parse(QAtomicInt &p_stop, bool p_fast) {
+  if (p_fast) {
+    return;
+  }
+
+  // Elements of each type are sorted already so they are merged instead of sorted again.
+  m_sortedElements = mergeElements(m_elements);
 
   if (p_stop.loadAcquire() == 1) {
     return;
   }
 
-  std::sort(m_headerRegions.begin(), m_headerRegions.end());
+  m_headerRegions = mergeHeaderRegions(m_elements);
+
+  m_codeBlockRegions = uniqueRegions(m_elements[pmh_FENCEDCODEBLOCK]);
+
+  shareRegions();
 }
 
-void PegParseResult::parseFencedCodeBlockRegions(QAtomicInt &p_stop) {
-  m_codeBlockRegions.clear();
-  if (isEmpty()) {
+void PegParseResult::shareRegions() {
+  m_imageRegions = m_elements[pmh_IMAGE];
+  m_inlineEquationRegions = m_elements[pmh_INLINEEQUATION];
+  m_displayFormulaRegions = m_elements[pmh_DISPLAYFORMULA];
+  m_hruleRegions = m_elements[pmh_HRULE];
+  m_tableRegions = m_elements[pmh_TABLE];
+  m_tableHeaderRegions = m_elements[pmh_TABLEHEADER];
+  m_tableBorderRegions = m_elements[pmh_TABLEBORDER];
+}
+
+void PegParseResult::parseBlockPositions(const QSharedPointer<PegParseConfig> &p_config) {
+  m_blockPositions.clear();
+  m_text.clear();
+  if (p_config->m_fast) {
     return;
   }
 
-  pmh_element *elem = m_pmhElements[pmh_FENCEDCODEBLOCK];
-  while (elem != NULL) {
-    if (elem->end <= elem->pos) {
-      elem = elem->next;
-      continue;
-    }
-
-    if (p_stop.loadAcquire() == 1) {
+  const auto &data = p_config->m_data;
+  if (p_config->isIncremental()) {
+    const auto &base = p_config->m_baseResult;
+    const auto &basePositions = base->m_blockPositions;
+    if (basePositions.isEmpty()) {
       return;
     }
 
-    if (!m_codeBlockRegions.contains(m_offset + elem->pos)) {
-      m_codeBlockRegions.insert(m_offset + elem->pos,
-                                ElementRegion(m_offset + elem->pos, m_offset + elem->end));
+    // Region blocks replace base blocks within [m_offset, m_baseEnd).
+    const int start = p_config->m_offset;
+    QVector<int> regionPositions;
+    regionPositions.append(start);
+    for (int i = 0; i < p_config->m_regionLength; ++i) {
+      if (data[i] == QLatin1Char('\n')) {
+        regionPositions.append(start + i + 1);
+      }
     }
 
-    elem = elem->next;
+    // The last one is the end of the document, which is always after the region.
+    const auto first = std::lower_bound(basePositions.constBegin(), basePositions.constEnd() - 1,
+                                        start);
+    const auto last = std::lower_bound(first, basePositions.constEnd(), p_config->m_baseEnd);
+    m_blockPositions.resize(static_cast<int>(first - basePositions.constBegin()) +
+                            regionPositions.size() +
+                            static_cast<int>(basePositions.constEnd() - last));
+    auto out = std::copy(basePositions.constBegin(), first, m_blockPositions.begin());
+    out = std::copy(regionPositions.constBegin(), regionPositions.constEnd(), out);
+    const int delta = p_config->m_delta;
+    std::transform(last, basePositions.constEnd(), out,
+                   [delta](int p_pos) { return p_pos + delta; });
+
+    // The region excludes the separator of its last block, which is kept from the base text
+    // unless it is the implicit one at the end.
+    const int baseEnd = qMin(p_config->m_baseEnd - 1, base->m_text.size());
+    m_text.reserve(base->m_text.size() + p_config->m_delta);
+    m_text.append(base->m_text.constData(), qMin(start, base->m_text.size()));
+    m_text.append(data.constData(), p_config->m_regionLength);
+    m_text.append(base->m_text.constData() + baseEnd, base->m_text.size() - baseEnd);
+  } else if (p_config->m_offset == 0) {
+    setText(data);
+    return;
   }
-}
 
-void PegParseResult::parseInlineEquationRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_INLINEEQUATION, m_inlineEquationRegions, false);
+  if (m_blockPositions.size() != m_numOfBlocks + 1 ||
+      m_blockPositions.last() != m_text.size() + 1) {
+    // Not matched with the document.
+    m_blockPositions.clear();
+    m_text.clear();
+  }
 }
 
-void PegParseResult::parseDisplayFormulaRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_DISPLAYFORMULA, m_displayFormulaRegions, true);
-}
+void PegParseResult::setText(const QString &p_text) {
+  m_text = p_text;
+  m_blockPositions.clear();
+  m_blockPositions.reserve(m_numOfBlocks + 1);
+  m_blockPositions.append(0);
+  for (int i = 0; i < m_text.size(); ++i) {
+    if (m_text[i] == QLatin1Char('\n')) {
+      m_blockPositions.append(i + 1);
+    }
+  }
+
+  // End of the last block including the implicit paragraph separator.
+  m_blockPositions.append(m_text.size() + 1);
 
-void PegParseResult::parseHRuleRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_HRULE, m_hruleRegions, false);
+  if (m_blockPositions.size() != m_numOfBlocks + 1) {
+    // Not matched with the document.
+    m_blockPositions.clear();
+    m_text.clear();
+  }
 }
 
-void PegParseResult::parseTableRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_TABLE, m_tableRegions, true);
+QString PegParseResult::blockText(int p_blockNumber) const {
+  Q_ASSERT(p_blockNumber >= 0 && p_blockNumber < m_blockPositions.size() - 1);
+  const int pos = m_blockPositions[p_blockNumber];
+  return m_text.mid(pos, m_blockPositions[p_blockNumber + 1] - pos - 1);
 }
 
-void PegParseResult::parseTableHeaderRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_TABLEHEADER, m_tableHeaderRegions, true);
+int PegParseResult::findBlockIndex(int p_pos, int p_hint) const {
+  // The last one is the end of the document.
+  const int nrBlocks = m_blockPositions.size() - 1;
+  if (p_hint >= 0 && p_hint < nrBlocks && m_blockPositions[p_hint] <= p_pos) {
+    // Positions are usually ascending in a sweep. Fall back to a binary search if it is far.
+    const int maxSteps = 16;
+    for (int i = 0; i < maxSteps; ++i) {
+      if (p_hint + 1 >= nrBlocks || m_blockPositions[p_hint + 1] > p_pos) {
+        return p_hint;
+      }
+      ++p_hint;
+    }
+  } else {
+    p_hint = 0;
+  }
+
+  auto it = std::upper_bound(m_blockPositions.begin() + p_hint,
+                             m_blockPositions.begin() + nrBlocks, p_pos);
+  return qMax(0, static_cast<int>(it - m_blockPositions.begin()) - 1);
 }
 
-void PegParseResult::parseTableBorderRegions(QAtomicInt &p_stop) {
-  parseRegions(p_stop, pmh_TABLEBORDER, m_tableBorderRegions, true);
+void PegParseResult::parseBlocksHighlights(QVector<QVector<HLUnit>> &p_blocksHighlights) const {
+  Q_ASSERT(hasBlockPositions());
+  p_blocksHighlights.resize(m_numOfBlocks);
+
+  int hint = -1;
+  for (const auto &ele : m_sortedElements) {
+    hint = parseBlocksHighlightOne(p_blocksHighlights, ele.m_startPos, ele.m_endPos,
+                                   ele.m_styleIndex, hint);
+  }
+
+  for (auto &units : p_blocksHighlights) {
+    if (units.size() > 1) {
+      std::sort(units.begin(), units.end(), HLUnitLess());
+    }
+  }
 }
 
-void PegParseResult::parseRegions(QAtomicInt &p_stop, pmh_element_type p_type,
-                                  QVector<ElementRegion> &p_result, bool p_sort) {
-  p_result.clear();
-  if (isEmpty()) {
-    return;
+int PegParseResult::parseBlocksHighlightOne(QVector<QVector<HLUnit>> &p_blocksHighlights,
+                                            int p_pos, int p_end, int p_styleIndex,
+                                            int p_hint) const {
+  // When the the highlight element is at the end of document, @p_end will
+  // equals to the characterCount.
+  const int nrChar = m_blockPositions.last();
+  if (p_end >= nrChar && nrChar > 0) {
+    p_end = nrChar - 1;
   }
 
-  pmh_element *elem = m_pmhElements[p_type];
-  while (elem != NULL) {
-    if (elem->end <= elem->pos) {
-      elem = elem->next;
-      continue;
+  const int startBlockNum = findBlockIndex(p_pos, p_hint);
+  int endBlockNum = findBlockIndex(p_end - 1, startBlockNum);
+  if (endBlockNum >= p_blocksHighlights.size()) {
+    endBlockNum = p_blocksHighlights.size() - 1;
+  }
+
+  for (int blockNum = startBlockNum; blockNum <= endBlockNum; ++blockNum) {
+    const int blockStartPos = m_blockPositions[blockNum];
+    const int blockLength = m_blockPositions[blockNum + 1] - blockStartPos;
+    HLUnit unit;
+    if (blockNum == startBlockNum) {
+      unit.start = p_pos - blockStartPos;
+      unit.length =
+          (startBlockNum == endBlockNum) ? (p_end - p_pos) : (blockLength - unit.start);
+    } else if (blockNum == endBlockNum) {
+      unit.start = 0;
+      unit.length = p_end - blockStartPos;
+    } else {
+      unit.start = 0;
+      unit.length = blockLength;
     }
 
-    if (p_stop.loadAcquire() == 1) {
-      return;
+    unit.styleIndex = p_styleIndex;
+
+    Q_ASSERT(unit.length > 0);
+
+    if (unit.length > 0) {
+      p_blocksHighlights[blockNum].append(unit);
     }
+  }
 
-    p_result.push_back(ElementRegion(m_offset + elem->pos, m_offset + elem->end));
-    elem = elem->next;
+  return startBlockNum;
+}
+
+bool PegParseResult::spliceElements(const QSharedPointer<PegParseConfig> &p_config,
+                                    pmh_element **p_regionElements) {
+  Q_ASSERT(isEmpty());
+  const auto &base = p_config->m_baseResult;
+  Q_ASSERT(base->m_offset == 0);
+  if (base->isEmpty()) {
+    return false;
   }
 
-  if (p_sort && p_stop.loadAcquire() != 1) {
-    std::sort(p_result.begin(), p_result.end());
+  const int start = p_config->m_offset;
+  const int baseEnd = p_config->m_baseEnd;
+  // The parser appends two new lines to the input.
+  const unsigned long regionEnd = p_config->m_regionLength + 2;
+  const int delta = p_config->m_delta;
+
+  // Region elements in the coordinates of the document.
+  QVector<ElementRegion> regionElements[pmh_NUM_LANG_TYPES];
+  if (p_regionElements) {
+    for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+      auto &elements = regionElements[i];
+      for (auto elem = p_regionElements[i]; elem; elem = elem->next) {
+        if (elem->pos >= regionEnd) {
+          // Extra reference definitions.
+          continue;
+        }
+
+        if (elem->end > regionEnd || i == pmh_REFERENCE) {
+          return false;
+        }
+
+        if (elem->end > elem->pos) {
+          elements.append(ElementRegion(start + elem->pos, start + elem->end));
+        }
+      }
+
+      std::sort(elements.begin(), elements.end());
+    }
+  }
+
+  // The region consists of whole top-level blocks and the caller expands it to cover any
+  // block element crossing it, so no element of the base starts before the region and ends
+  // within or after it.
+  for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+    m_elements[i] =
+        spliceSortedRegions(base->m_elements[i], regionElements[i], start, baseEnd, delta);
   }
+  m_hasElements = true;
+  m_offset = 0;
+
+  m_sortedElements = spliceSortedRegions(base->m_sortedElements, mergeElements(regionElements),
+                                         start, baseEnd, delta);
+  m_headerRegions = spliceSortedRegions(base->m_headerRegions, mergeHeaderRegions(regionElements),
+                                        start, baseEnd, delta);
+  m_codeBlockRegions =
+      spliceSortedRegions(base->m_codeBlockRegions,
+                          uniqueRegions(regionElements[pmh_FENCEDCODEBLOCK]), start, baseEnd, delta);
+  shareRegions();
+  return true;
 }
 
 PegParserWorker::PegParserWorker(QObject *p_parent) : QThread(p_parent) {}
@@ -168,6 +427,17 @@ void PegParserWorker::run() {
     return;
   }
 
+  // Second stage to build the highlighter result.
+  const auto &builder = m_parseConfig->m_resultBuilder;
+  if (builder && !m_parseConfig->m_fast && !m_parseResult->m_incrementalFailed) {
+    m_parseResult->m_highlighterResult = builder(m_parseResult);
+
+    if (isAskedToStop()) {
+      m_state = WorkerState::Cancelled;
+      return;
+    }
+  }
+
   m_state = WorkerState::Finished;
 }
 
@@ -175,11 +445,18 @@ QSharedPointer<PegParseResult>
 PegParserWorker::parseMarkdown(const QSharedPointer<PegParseConfig> &p_config, QAtomicInt &p_stop) {
   QSharedPointer<PegParseResult> result(new PegParseResult(p_config));
 
+  if (p_config->isIncremental()) {
+    parseMarkdownIncrementally(result, p_config, p_stop);
+    return result;
+  }
+
   if (p_config->m_data.isEmpty()) {
     return result;
   }
 
-  result->m_pmhElements = PegParser::parseMarkdownToElements(p_config);
+  pmh_arena *arena = pmh_arena_new();
+  result->setElements(PegParser::parseMarkdownToElements(p_config, arena), p_stop);
+  pmh_arena_free(arena);
 
   if (p_stop.loadAcquire() == 1) {
     return result;
@@ -187,15 +464,45 @@ PegParserWorker::parseMarkdown(const QSharedPointer<PegParseConfig> &p_config, Q
 
   result->parse(p_stop, p_config->m_fast);
 
+  result->parseBlockPositions(p_config);
+
   return result;
 }
 
-#define NUM_OF_THREADS 2
+void PegParserWorker::parseMarkdownIncrementally(QSharedPointer<PegParseResult> &p_result,
+                                                 const QSharedPointer<PegParseConfig> &p_config,
+                                                 QAtomicInt &p_stop) {
+  // Region elements are copied out on splicing.
+  pmh_arena *regionArena = pmh_arena_new();
+
+  // May be NULL if the region is empty.
+  pmh_element **regionElements = PegParser::parseMarkdownToElements(p_config, regionArena);
 
-PegParser::PegParser(QObject *p_parent) : QObject(p_parent) { init(); }
+  if (p_stop.loadAcquire() == 1) {
+    pmh_arena_free(regionArena);
+    return;
+  }
+
+  bool ret = p_result->spliceElements(p_config, regionElements);
+  pmh_arena_free(regionArena);
+
+  if (!ret) {
+    p_result->m_incrementalFailed = true;
+    return;
+  }
+
+  // Sorted elements and regions are spliced along with the elements.
+  p_result->parseBlockPositions(p_config);
+}
 
-void PegParser::init() {
-  for (int i = 0; i < NUM_OF_THREADS; ++i) {
+PegParser::PegParser(int p_numOfWorkers, QObject *p_parent) : QObject(p_parent) {
+  init(p_numOfWorkers);
+}
+
+void PegParser::init(int p_numOfWorkers) {
+  // The parser is reentrant so workers could parse concurrently.
+  const int num = qMax(1, p_numOfWorkers);
+  for (int i = 0; i < num; ++i) {
     PegParserWorker *th = new PegParserWorker(this);
     connect(th, &PegParserWorker::finished, this, [this, th]() { handleWorkerFinished(th); });
 
@@ -225,18 +532,8 @@ void PegParser::parseAsync(const QSharedPointer<PegParseConfig> &p_config) {
 }
 
 QSharedPointer<PegParseResult> PegParser::parse(const QSharedPointer<PegParseConfig> &p_config) {
-  QSharedPointer<PegParseResult> result(new PegParseResult(p_config));
-
-  if (p_config->m_data.isEmpty()) {
-    return result;
-  }
-
-  result->m_pmhElements = PegParser::parseMarkdownToElements(p_config);
-
   QAtomicInt stop(0);
-  result->parse(stop, p_config->m_fast);
-
-  return result;
+  return PegParserWorker::parseMarkdown(p_config, stop);
 }
 
 void PegParser::handleWorkerFinished(PegParserWorker *p_worker) {
@@ -271,13 +568,11 @@ void PegParser::pickWorker() {
   }
 
   if (allBusy) {
-    // Need to stop the worker with non-minimal timestamp.
+    // Need to stop the worker with non-minimal timestamp, that is, the latest one.
     int idx = 0;
-    TimeStamp minTS = m_workers[idx]->workTimeStamp();
-
-    if (m_workers.size() > 1) {
-      if (m_workers[1]->workTimeStamp() > minTS) {
-        idx = 1;
+    for (int i = 1; i < m_workers.size(); ++i) {
+      if (m_workers[i]->workTimeStamp() > m_workers[idx]->workTimeStamp()) {
+        idx = i;
       }
     }
 
@@ -297,8 +592,10 @@ void PegParser::scheduleWork(PegParserWorker *p_worker,
 QVector<ElementRegion>
 PegParser::parseImageRegions(const QSharedPointer<PegParseConfig> &p_config) {
   QVector<ElementRegion> regs;
-  pmh_element **res = PegParser::parseMarkdownToElements(p_config);
+  pmh_arena *arena = pmh_arena_new();
+  pmh_element **res = PegParser::parseMarkdownToElements(p_config, arena);
   if (!res) {
+    pmh_arena_free(arena);
     return regs;
   }
 
@@ -314,151 +611,25 @@ PegParser::parseImageRegions(const QSharedPointer<PegParseConfig> &p_config) {
     elem = elem->next;
   }
 
-  pmh_free_elements(res);
+  pmh_arena_free(arena);
 
   return regs;
 }
 
-#define MAX_CODE_POINT 65535
-
-#define X_CHAR 86U
-
-#define HAS_UTF8_BOM(x)                                                                            \
-  (((*x & 0xFF) == 0xEF) && ((*(x + 1) & 0xFF) == 0xBB) && ((*(x + 2) & 0xFF) == 0xBF))
-
-// Calculate the UTF8 code point.
-// Return the number of chars consumed.
-static inline int utf8CodePoint(const char *p_ch, int &p_codePoint) {
-  unsigned char uch = *p_ch;
-
-  if ((uch & 0x80) == 0) {
-    p_codePoint = uch;
-    return 1;
-  } else if ((uch & 0xE0) == 0xC0) {
-    // 110yyyxx 10xxxxxx -> 00000yyy xxxxxxxx
-    unsigned char uch2 = *(p_ch + 1);
-    p_codePoint = ((uch & 0x1CL) << 6) + ((uch & 0x3L) << 6) + (uch2 & 0x3FL);
-    return 2;
-  } else if ((uch & 0xF0) == 0xE0) {
-    // 1110yyyy 10yyyyxx 10xxxxxx -> yyyyyyyy xxxxxxxx
-    unsigned char uch2 = *(p_ch + 1);
-    unsigned char uch3 = *(p_ch + 2);
-    p_codePoint =
-        ((uch & 0xF) << 12) + ((uch2 & 0x3CL) << 6) + ((uch2 & 0x3L) << 6) + (uch3 & 0x3FL);
-    return 3;
-  } else if ((uch & 0xF8) == 0xF0) {
-    // 11110zzz 10zzyyyy 10yyyyxx 10xxxxxx -> 000zzzzz yyyyyyyy xxxxxxxx
-    unsigned char uch2 = *(p_ch + 1);
-    unsigned char uch3 = *(p_ch + 2);
-    unsigned char uch4 = *(p_ch + 3);
-    p_codePoint = ((uch & 0x7L) << 18) + ((uch2 & 0x30L) << 12) + ((uch2 & 0xFL) << 12) +
-                  ((uch3 & 0x3CL) << 6) + ((uch3 & 0x3L) << 6) + (uch4 & 0x3FL);
-    return 4;
-  } else {
-    return -1;
-  }
-}
-
-static inline void copyChars(char *p_dest, const char *p_src, int p_num) {
-  for (int i = 0; i < p_num; ++i) {
-    *(p_dest + i) = *(p_src + i);
-  }
-}
-
-// @p_data: UTF-8 data array.
-// If @p_data contain unicode characters with code value above 65535, it will
-// break it into two characters with code value below 65536. Return null if
-// there is no fix. Otherwise, return a fixed copy of the data.
-static QSharedPointer<char> tryFixUnicodeData(const char *p_data) {
-  bool needFix = false;
-  int sz = 0;
-
-  const char *ch = p_data;
-  bool hasBOM = false;
-  if (HAS_UTF8_BOM(ch)) {
-    hasBOM = true;
-    ch += 3;
-    sz += 3;
-  }
-
-  // Calculate the size of fixed data.
-  while (*ch != '\0') {
-    int cp;
-    int nr = utf8CodePoint(ch, cp);
-    if (nr == -1) {
-      return NULL;
-    }
-
-    if (cp > MAX_CODE_POINT) {
-      needFix = true;
-      ch += nr;
-      // Use two one-byte chars to replace.
-      sz += 2;
-    } else {
-      ch += nr;
-      sz += nr;
-    }
-  }
-
-  if (!needFix) {
-    return NULL;
-  }
-
-  // Replace those chars with two one-byte chars.
-  QSharedPointer<char> res(new char[sz + 1]);
-  char *newChar = res.data();
-  int idx = 0;
-  ch = p_data;
-  if (hasBOM) {
-    copyChars(newChar + idx, ch, 3);
-    ch += 3;
-    idx += 3;
-  }
-
-  while (*ch != '\0') {
-    int cp;
-    int nr = utf8CodePoint(ch, cp);
-    Q_ASSERT(nr > 0);
-    if (cp > MAX_CODE_POINT) {
-      *(newChar + idx) = X_CHAR;
-      *(newChar + idx + 1) = X_CHAR;
-      ch += nr;
-      idx += 2;
-    } else {
-      copyChars(newChar + idx, ch, nr);
-      ch += nr;
-      idx += nr;
-    }
-  }
-
-  Q_ASSERT(idx == sz);
-  *(newChar + sz) = '\0';
-
-  return res;
-}
-
-pmh_element **PegParser::parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config) {
+pmh_element **PegParser::parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config,
+                                                 pmh_arena *p_arena) {
   if (p_config->m_data.isEmpty()) {
     return NULL;
   }
 
   pmh_element **pmhResult = NULL;
 
-  // p_config->m_data is encoding in UTF-8.
-  // QString stores a string of 16-bit QChars. Unicode characters with code
-  // values above 65535 are stored using surrogate pairs, i.e., two consecutive
-  // QChars. Hence, a QString using two QChars to save one code value if it's
-  // above 65535, with size() returning 2. pmh_markdown_to_elements() will treat
-  // it at the size of 1 (expected). To make it work, we split unicode
-  // characters whose code value is above 65535 into two unicode characters
-  // whose code value is below 65535.
-  char *data = p_config->m_data.data();
-  QSharedPointer<char> fixedData = tryFixUnicodeData(data);
-  if (fixedData) {
-    data = fixedData.data();
-  }
-
-  pmh_markdown_to_elements(data, p_config->m_extensions, &pmhResult);
+  // Parse the UTF-16 data in place without any conversion or copy. Unicode
+  // characters above 65535 are stored as surrogate pairs in QString and are
+  // counted as two characters by the parser, matching QString positions.
+  const auto data = reinterpret_cast<const unsigned short *>(p_config->m_data.constData());
+  pmh_utf16_markdown_to_elements_in_arena(data, p_config->m_data.size(), p_config->m_extensions,
+                                          p_arena, &pmhResult);
   return pmhResult;
 }
 
@@ -3,6 +3,8 @@
 
 #include <QObject>
 
+#include <functional>
+
 #include <QAtomicInt>
 #include <QSharedPointer>
 #include <QThread>
@@ -17,11 +19,19 @@ extern "C" {
 }
 
 namespace vte {
+class PegHighlighterResult;
+
 namespace peg {
+struct PegParseResult;
+
 struct PegParseConfig {
+  bool isIncremental() const { return !m_baseResult.isNull(); }
+
   TimeStamp m_timeStamp = 0;
 
-  QByteArray m_data;
+  // Text to parse. The parser reads its UTF-16 buffer in place, so the
+  // positions of the results are in QChar units.
+  QString m_data;
 
   int m_numOfBlocks = 0;
 
@@ -33,68 +43,145 @@ struct PegParseConfig {
   // Fast parse.
   bool m_fast = false;
 
+  // Incremental parse.
+  // m_data contains the region to re-parse starting at m_offset, which replaces
+  // [m_offset, m_baseEnd) of m_baseResult. The parse result will be spliced into
+  // m_baseResult and share the same coordinates as the whole document.
+  QSharedPointer<PegParseResult> m_baseResult;
+
+  // End of the replaced region in m_baseResult.
+  int m_baseEnd = 0;
+
+  // Length of the region in m_data, which may be followed by extra reference
+  // definitions.
+  int m_regionLength = 0;
+
+  // Length difference between current document and the document of m_baseResult.
+  int m_delta = 0;
+
+  // Second stage run on the worker after a successful parse to build the highlighter result,
+  // so that the GUI thread only needs to apply it. It should work from the parse result only
+  // and never access the document. Not run for a fast parse.
+  std::function<QSharedPointer<PegHighlighterResult>(const QSharedPointer<PegParseResult> &)>
+      m_resultBuilder;
+
   QString toString() const {
-    return QStringLiteral("PegParseConfig ts %1 data %2 blocks %3")
+    return QStringLiteral("PegParseConfig ts %1 data %2 blocks %3 incremental %4")
         .arg(m_timeStamp)
         .arg(m_data.size())
-        .arg(m_numOfBlocks);
+        .arg(m_numOfBlocks)
+        .arg(isIncremental());
   }
 };
 
+// Element of a parse result in the coordinates of the document.
+struct HighlightElement {
+  int m_startPos = 0;
+
+  int m_endPos = 0;
+
+  int m_styleIndex = 0;
+};
+
 struct PegParseResult {
   PegParseResult(const QSharedPointer<PegParseConfig> &p_config)
       : m_timeStamp(p_config->m_timeStamp), m_numOfBlocks(p_config->m_numOfBlocks),
-        m_offset(p_config->m_offset), m_pmhElements(NULL) {}
-
-  ~PegParseResult() { clearPmhElements(); }
-
-  void clearPmhElements() {
-    if (m_pmhElements) {
-      pmh_free_elements(m_pmhElements);
-      m_pmhElements = NULL;
-    }
-  }
+        m_offset(p_config->m_offset) {}
 
   bool operator<(const PegParseResult &p_other) const { return m_timeStamp < p_other.m_timeStamp; }
 
   QString toString() const { return QStringLiteral("PegParseResult ts %1").arg(m_timeStamp); }
 
-  bool isEmpty() const { return !m_pmhElements; }
+  bool isEmpty() const { return !m_hasElements; }
+
+  // Copy the elements of @p_pmhElements into m_elements. @p_pmhElements could be freed then.
+  void setElements(pmh_element **p_pmhElements, QAtomicInt &p_stop);
 
-  // Parse m_pmhElements.
+  // Parse m_elements into the sorted elements and regions.
   void parse(QAtomicInt &p_stop, bool p_fast);
 
+  // Calculate m_blockPositions and m_text of the document parsed by @p_config.
+  void parseBlockPositions(const QSharedPointer<PegParseConfig> &p_config);
+
+  // Set m_text to @p_text, the whole document parsed, and calculate m_blockPositions from it.
+  void setText(const QString &p_text);
+
+  bool hasBlockPositions() const { return !m_blockPositions.isEmpty(); }
+
+  // Text of block @p_blockNumber from m_text.
+  QString blockText(int p_blockNumber) const;
+
+  // Return the index of the block containing @p_pos via m_blockPositions.
+  // @p_hint: index of a block at or before @p_pos to start searching from, or -1.
+  int findBlockIndex(int p_pos, int p_hint = -1) const;
+
+  // Map elements to highlights of blocks via m_blockPositions in a single sweep of
+  // m_sortedElements. Highlights of each block are sorted.
+  void parseBlocksHighlights(QVector<QVector<HLUnit>> &p_blocksHighlights) const;
+
+  // Map element [@p_pos, @p_end) to highlights of blocks via m_blockPositions.
+  // @p_hint: index of a block at or before @p_pos to start searching from, or -1.
+  // Return the index of the block containing @p_pos.
+  int parseBlocksHighlightOne(QVector<QVector<HLUnit>> &p_blocksHighlights, int p_pos, int p_end,
+                              int p_styleIndex, int p_hint) const;
+
+  // Build m_elements and the sorted elements and regions from the base result of @p_config
+  // with the re-parsed region @p_regionElements spliced in. Those before the region are kept
+  // and those after the region are shifted, without being parsed or sorted again.
+  // Return false if the region could not be spliced, such as the region
+  // elements leaking out of the region or reference definitions changed.
+  bool spliceElements(const QSharedPointer<PegParseConfig> &p_config,
+                      pmh_element **p_regionElements);
+
   TimeStamp m_timeStamp = 0;
 
   int m_numOfBlocks = 0;
 
   int m_offset = 0;
 
-  pmh_element **m_pmhElements = nullptr;
+  // Non-empty elements of each type sorted by position, in the coordinates of the document.
+  QVector<ElementRegion> m_elements[pmh_NUM_LANG_TYPES];
+
+  // Whether the parser returns any elements.
+  bool m_hasElements = false;
+
+  // Whether an incremental parse failed and a full parse is needed.
+  bool m_incrementalFailed = false;
+
+  // Start positions of all the blocks followed by the characterCount() of the document.
+  // Empty if not available, such as for a fast parse.
+  QVector<int> m_blockPositions;
+
+  // Snapshot of the whole document parsed, which is available along with m_blockPositions.
+  // Blocks are separated by '\n' as QTextDocument::toPlainText().
+  QString m_text;
+
+  // Built by PegParseConfig::m_resultBuilder on the worker.
+  QSharedPointer<PegHighlighterResult> m_highlighterResult;
+
+  // All the elements of m_elements sorted by start position.
+  QVector<HighlightElement> m_sortedElements;
 
+  // Regions below are sorted by start position.
   // All image link regions.
   QVector<ElementRegion> m_imageRegions;
 
   // All header regions.
-  // Sorted by start position.
   QVector<ElementRegion> m_headerRegions;
 
-  // Fenced code block regions.
-  // Ordered by start position in ascending order.
-  QMap<int, ElementRegion> m_codeBlockRegions;
+  // Fenced code block regions of distinct start positions.
+  QVector<ElementRegion> m_codeBlockRegions;
 
   // All $ $ inline equation regions.
   QVector<ElementRegion> m_inlineEquationRegions;
 
   // All $$ $$ display formula regions.
-  // Sorted by start position.
   QVector<ElementRegion> m_displayFormulaRegions;
 
   // HRule regions.
   QVector<ElementRegion> m_hruleRegions;
 
   // All table regions.
-  // Sorted by start position.
   QVector<ElementRegion> m_tableRegions;
 
   // All table header regions.
@@ -104,26 +191,8 @@ struct PegParseResult {
   QVector<ElementRegion> m_tableBorderRegions;
 
 private:
-  void parseImageRegions(QAtomicInt &p_stop);
-
-  void parseHeaderRegions(QAtomicInt &p_stop);
-
-  void parseFencedCodeBlockRegions(QAtomicInt &p_stop);
-
-  void parseInlineEquationRegions(QAtomicInt &p_stop);
-
-  void parseDisplayFormulaRegions(QAtomicInt &p_stop);
-
-  void parseHRuleRegions(QAtomicInt &p_stop);
-
-  void parseTableRegions(QAtomicInt &p_stop);
-
-  void parseTableHeaderRegions(QAtomicInt &p_stop);
-
-  void parseTableBorderRegions(QAtomicInt &p_stop);
-
-  void parseRegions(QAtomicInt &p_stop, pmh_element_type p_type, QVector<ElementRegion> &p_result,
-                    bool p_sort = false);
+  // Regions of a single type share the data of m_elements.
+  void shareRegions();
 };
 
 class PegParserWorker : public QThread {
@@ -151,6 +220,9 @@ public:
 
   const QSharedPointer<PegParseResult> &parseResult() const { return m_parseResult; }
 
+  static QSharedPointer<PegParseResult> parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
+                                                      QAtomicInt &p_stop);
+
 public slots:
   void stop();
 
@@ -158,8 +230,10 @@ protected:
   void run() Q_DECL_OVERRIDE;
 
 private:
-  QSharedPointer<PegParseResult> parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
-                                               QAtomicInt &p_stop);
+  // Re-parse the region and splice it into the base result.
+  static void parseMarkdownIncrementally(QSharedPointer<PegParseResult> &p_result,
+                                         const QSharedPointer<PegParseConfig> &p_config,
+                                         QAtomicInt &p_stop);
 
   bool isAskedToStop() const { return m_stop.loadAcquire() == 1; }
 
@@ -175,18 +249,22 @@ private:
 class PegParser : public QObject {
   Q_OBJECT
 public:
-  explicit PegParser(QObject *p_parent = nullptr);
+  // @p_numOfWorkers: number of worker threads to parse asynchronously, at least 1.
+  explicit PegParser(int p_numOfWorkers = 2, QObject *p_parent = nullptr);
 
   ~PegParser();
 
-  QSharedPointer<PegParseResult> parse(const QSharedPointer<PegParseConfig> &p_config);
+  // Parse synchronously, either fully or incrementally.
+  static QSharedPointer<PegParseResult> parse(const QSharedPointer<PegParseConfig> &p_config);
 
   void parseAsync(const QSharedPointer<PegParseConfig> &p_config);
 
   static QVector<ElementRegion> parseImageRegions(const QSharedPointer<PegParseConfig> &p_config);
 
-  // MUST pmh_free_elements() the result.
-  static pmh_element **parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config);
+  // The result is allocated from @p_arena and is valid until @p_arena is freed.
+  // MUST NOT pmh_free_elements() the result.
+  static pmh_element **parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config,
+                                               pmh_arena *p_arena);
 
   static int getNumberOfStyles();
 
@@ -197,7 +275,7 @@ private slots:
   void handleWorkerFinished(PegParserWorker *p_worker);
 
 private:
-  void init();
+  void init(int p_numOfWorkers);
 
   void clear();
 
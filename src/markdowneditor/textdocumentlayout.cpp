@@ -9,6 +9,8 @@
 #include <QTextDocument>
 #include <QTextFrame>
 #include <QTextLayout>
+#include <QTimer>
+#include <QtMath>
 
 #include <vtextedit/previewdata.h>
 #include <vtextedit/textblockdata.h>
@@ -24,11 +26,18 @@ const int TextDocumentLayout::c_maxInlineImageHeight = 400;
 
 const int TextDocumentLayout::c_imagePadding = 2;
 
+const int TextDocumentLayout::c_lazyLayoutExtraBlocks = 100;
+
 static bool realEqual(qreal p_a, qreal p_b) { return qAbs(p_a - p_b) < 1e-8; }
 
 TextDocumentLayout::TextDocumentLayout(QTextDocument *p_doc, DocumentResourceMgr *p_resourceMgr)
     : QAbstractTextDocumentLayout(p_doc), m_margin(p_doc->documentMargin()),
-      m_resourceMgr(p_resourceMgr) {}
+      m_resourceMgr(p_resourceMgr) {
+  m_documentSizeTimer = new QTimer(this);
+  m_documentSizeTimer->setSingleShot(true);
+  m_documentSizeTimer->setInterval(0);
+  connect(m_documentSizeTimer, &QTimer::timeout, this, &TextDocumentLayout::updateDocumentSize);
+}
 
 static void fillBackground(QPainter *p_painter, const QRectF &p_rect, QBrush p_brush,
                            QRectF p_gradientRect = QRectF()) {
@@ -56,126 +65,54 @@ void TextDocumentLayout::blockRangeFromRect(const QRectF &p_rect, int &p_first,
     return;
   }
 
-  p_first = -1;
-  p_last = document()->blockCount() - 1;
-  int y = p_rect.y();
-  QTextBlock block = document()->firstBlock();
-  while (block.isValid()) {
-    auto info = BlockLayoutData::get(block);
-    Q_ASSERT(info->hasOffset());
-
-    if (info->top() == y || (info->top() < y && info->bottom() >= y)) {
-      p_first = block.blockNumber();
-      break;
-    }
-
-    block = block.next();
-  }
-
-  if (p_first == -1) {
-    p_last = -1;
-    return;
-  }
-
-  y += p_rect.height();
-  while (block.isValid()) {
-    auto info = BlockLayoutData::get(block);
-    Q_ASSERT(info->hasOffset());
-
-    if (info->bottom() > y) {
-      p_last = block.blockNumber();
-      break;
-    }
-
-    block = block.next();
-  }
-}
-
-void TextDocumentLayout::blockRangeFromRectBS(const QRectF &p_rect, int &p_first,
-                                              int &p_last) const {
-  if (p_rect.isNull()) {
-    p_first = 0;
-    p_last = document()->blockCount() - 1;
-    return;
-  }
-
   p_first = findBlockByPosition(p_rect.topLeft());
   if (p_first == -1) {
     p_last = -1;
     return;
   }
 
-  int y = p_rect.bottom();
-  QTextBlock block = document()->findBlockByNumber(p_first);
-  auto info = BlockLayoutData::get(block);
-  if (realEqual(info->top(), p_rect.top()) && p_first > 0) {
+  // Prefer the block above if at the border.
+  if (p_first > 0 && realEqual(blockOffset(p_first), p_rect.top())) {
     --p_first;
   }
 
-  p_last = document()->blockCount() - 1;
-  while (block.isValid()) {
-    auto tinfo = BlockLayoutData::get(block);
-    if (!tinfo->hasOffset()) {
-      qWarning() << "block without offset" << block.blockNumber() << tinfo->m_offset
-                 << tinfo->m_rect << tinfo->m_rect.isNull();
-    }
-
-    Q_ASSERT(tinfo->hasOffset());
-
-    if (tinfo->bottom() > y) {
-      p_last = block.blockNumber();
-      break;
-    }
-
-    block = block.next();
-  }
+  p_last = m_blockHeights.findIndex(p_rect.bottom());
 }
 
 int TextDocumentLayout::findBlockByPosition(const QPointF &p_point) const {
-  QTextDocument *doc = document();
-  int first = 0, last = doc->blockCount() - 1;
-  int y = p_point.y();
-  while (first <= last) {
-    int mid = (first + last) / 2;
-    QTextBlock blk = doc->findBlockByNumber(mid);
-    auto info = BlockLayoutData::get(blk);
-    if (!info) {
-      return -1;
-    }
-
-    Q_ASSERT(info->hasOffset());
-    if (info->top() <= y && info->bottom() > y) {
-      // Found it.
-      return mid;
-    } else if (info->top() > y) {
-      last = mid - 1;
-    } else {
-      first = mid + 1;
-    }
+  if (m_blockHeights.size() != document()->blockCount()) {
+    return -1;
   }
 
-  QTextBlock blk = doc->lastBlock();
-  auto info = BlockLayoutData::get(blk);
-  if (y >= info->bottom()) {
-    return blk.blockNumber();
-  }
+  return m_blockHeights.findIndex(p_point.y());
+}
 
-  return 0;
+qreal TextDocumentLayout::blockOffset(int p_blockNumber) const {
+  return m_blockHeights.offset(p_blockNumber);
 }
 
 void TextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_context) {
   // Find out the blocks.
   int first, last;
-  blockRangeFromRectBS(p_context.clip, first, last);
+  blockRangeFromRect(p_context.clip, first, last);
   if (first == -1) {
     return;
   }
 
+  if (m_lazyLayoutEnabled) {
+    if (layoutBlocksIfNull(first, last)) {
+      // Estimated heights are replaced so more blocks may come in.
+      blockRangeFromRect(p_context.clip, first, last);
+      layoutBlocksIfNull(first, last);
+      updateDocumentSizeLater();
+    }
+  }
+
   p_painter->setRenderHints(QPainter::SmoothPixmapTransform | QPainter::Antialiasing);
 
   QTextDocument *doc = document();
   QTextBlock block = doc->findBlockByNumber(first);
-  QPointF offset(m_margin, BlockLayoutData::get(block)->top());
+  QPointF offset(m_margin, blockOffset(first));
   QTextBlock lastBlock = doc->findBlockByNumber(last);
 
   QPen oldPen = p_painter->pen();
@@ -183,7 +120,7 @@ void TextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_context
 
   while (block.isValid()) {
     auto info = BlockLayoutData::get(block);
-    Q_ASSERT(info->hasOffset());
+    Q_ASSERT(!info->isNull());
 
     const QRectF &rect = info->m_rect;
     QTextLayout *layout = block.layout();
@@ -294,9 +231,13 @@ int TextDocumentLayout::hitTest(const QPointF &p_point, Qt::HitTestAccuracy p_ac
 
   QTextBlock block = document()->findBlockByNumber(bn);
   Q_ASSERT(block.isValid());
+  if (layoutBlockIfNull(block)) {
+    updateDocumentSizeLater();
+  }
+
   QTextLayout *layout = block.layout();
   int off = 0;
-  QPointF pos = p_point - QPointF(m_margin, BlockLayoutData::get(block)->top());
+  QPointF pos = p_point - QPointF(m_margin, blockOffset(bn));
   for (int i = 0; i < layout->lineCount(); ++i) {
     QTextLine line = layout->lineAt(i);
     const QRectF lr = line.naturalTextRect();
@@ -329,15 +270,12 @@ QRectF TextDocumentLayout::blockBoundingRect(const QTextBlock &p_block) const {
   }
 
   auto info = BlockLayoutData::get(p_block);
-  if (!info->hasOffset()) {
-    if (info->isNull()) {
-      const_cast<TextDocumentLayout *>(this)->layoutBlockAndUpdateOffset(p_block);
-    } else {
-      const_cast<TextDocumentLayout *>(this)->updateOffset(p_block);
-    }
+  if (layoutBlockIfNull(p_block)) {
+    updateDocumentSizeLater();
   }
 
-  QRectF geo = info->m_rect.adjusted(0, info->m_offset, 0, info->m_offset);
+  const qreal offset = blockOffset(p_block.blockNumber());
+  QRectF geo = info->m_rect.adjusted(0, offset, 0, offset);
   return geo;
 }
 
@@ -361,6 +299,12 @@ void TextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_c
     changeEndBlock = doc->findBlock(p_from + charsChanged);
   }
 
+  if (!updateBlockGeometryCount(changeStartBlock.blockNumber(), newBlockCount)) {
+    // Layout all the blocks.
+    changeStartBlock = doc->firstBlock();
+    changeEndBlock = QTextBlock();
+  }
+
   /*
   qDebug() << "documentChanged" << p_from << p_charsRemoved << p_charsAdded
            << m_blockCount << newBlockCount
@@ -373,14 +317,13 @@ void TextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_c
     QTextBlock block = changeStartBlock;
     if (block.isValid() && block.length()) {
       needRelayout = false;
-      QRectF oldBr = blockBoundingRect(block);
+      const qreal oldHeight = m_blockHeights.height(block.blockNumber());
       clearBlockLayout(block);
-      layoutBlockAndUpdateOffset(block);
-      QRectF newBr = blockBoundingRect(block);
+      layoutBlock(block);
       // Only one block is affected.
-      if (newBr.height() == oldBr.height()) {
+      if (m_blockHeights.height(block.blockNumber()) == oldHeight) {
         // Update document size.
-        updateDocumentSizeWithOneBlockChanged(block);
+        updateDocumentSizeWithOneBlockChanged();
 
         emit updateBlock(block);
         return;
@@ -389,18 +332,7 @@ void TextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_c
   }
 
   if (needRelayout) {
-    QTextBlock block = changeStartBlock;
-    do {
-      clearBlockLayout(block);
-      layoutBlock(block);
-      if (block == changeEndBlock) {
-        break;
-      }
-
-      block = block.next();
-    } while (block.isValid());
-
-    updateOffset(changeStartBlock);
+    layoutBlocks(changeStartBlock, changeEndBlock);
   }
 
   m_blockCount = newBlockCount;
@@ -408,16 +340,42 @@ void TextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_c
   updateDocumentSize();
 
   // TODO: Update the view of all the blocks after changeStartBlock.
-  qreal offset = BlockLayoutData::get(changeStartBlock)->m_offset;
+  qreal offset = blockOffset(changeStartBlock.blockNumber());
   emit update(QRectF(0., offset, 1000000000., 1000000000.));
 }
 
+bool TextDocumentLayout::updateBlockGeometryCount(int p_blockNumber, int p_newBlockCount) {
+  if (m_blockHeights.size() == m_blockCount && m_blockWidths.size() == m_blockCount) {
+    // Blocks inserted or removed must be right after the first changed block.
+    const int delta = p_newBlockCount - m_blockCount;
+    if (delta > 0) {
+      m_blockHeights.insert(p_blockNumber + 1, delta);
+      m_blockWidths.insert(p_blockNumber + 1, delta);
+    } else if (delta < 0) {
+      m_blockHeights.remove(p_blockNumber + 1, -delta);
+      m_blockWidths.remove(p_blockNumber + 1, -delta);
+    }
+
+    if (m_blockHeights.size() == p_newBlockCount && m_blockWidths.size() == p_newBlockCount) {
+      return true;
+    }
+  }
+
+  m_blockHeights.reset(p_newBlockCount);
+  m_blockWidths.reset(p_newBlockCount);
+  return false;
+}
+
 // MUST layout out the block after clearBlockLayout().
-// TODO: Do we need to clear all the offset after @p_block?
 void TextDocumentLayout::clearBlockLayout(QTextBlock &p_block) {
   p_block.clearLayout();
   auto info = BlockLayoutData::get(p_block);
   info->reset();
+
+  const int blockNum = p_block.blockNumber();
+  if (blockNum < m_blockWidths.size()) {
+    m_blockWidths.setWidth(blockNum, 0);
+  }
 }
 
 // From Qt's qguiapplication_p.h.
@@ -437,7 +395,7 @@ static Qt::Alignment visualAlignment(Qt::LayoutDirection p_direction, Qt::Alignm
   return p_alignment;
 }
 
-void TextDocumentLayout::layoutBlock(const QTextBlock &p_block) {
+void TextDocumentLayout::layoutBlock(const QTextBlock &p_block) const {
   QTextDocument *doc = document();
   Q_ASSERT(m_margin == doc->documentMargin());
 
@@ -466,17 +424,20 @@ void TextDocumentLayout::layoutBlock(const QTextBlock &p_block) {
     extraMargin += fm.horizontalAdvance(QChar(0x21B5));
   }
 
-  qreal availableWidth = doc->pageSize().width();
-  if (availableWidth <= 0 || !shouldBlockWrapLine(p_block)) {
-    availableWidth = qreal(INT_MAX);
-  }
-
-  availableWidth -= (2 * m_margin + extraMargin + m_cursorMargin + m_cursorWidth);
+  const qreal availWidth = blockAvailableWidth(p_block, extraMargin);
 
   QVector<Marker> markers;
   QVector<ImagePaintData> images;
 
-  layoutLines(p_block, tl, markers, images, availableWidth, 0);
+  layoutLines(p_block, tl, markers, images, availWidth, 0);
+
+  if (m_lazyLayoutEnabled) {
+    // Learn how the estimation differs from the real one for wrapped blocks.
+    const int estimatedLines = estimateLineCount(p_block, availWidth);
+    if (estimatedLines > 1 || tl->lineCount() > 1) {
+      m_wrapRatio = m_wrapRatio * 0.9 + 0.1 * tl->lineCount() / estimatedLines;
+    }
+  }
 
   // Set this block's line count to its layout's line count.
   // That is one block may occupy multiple visual lines.
@@ -486,76 +447,9 @@ void TextDocumentLayout::layoutBlock(const QTextBlock &p_block) {
   finishBlockLayout(p_block, markers, images);
 }
 
-void TextDocumentLayout::updateOffsetBefore(const QTextBlock &p_block) {
-  auto info = BlockLayoutData::get(p_block);
-  Q_ASSERT(!info->isNull());
-
-  const int blockNum = p_block.blockNumber();
-  if (blockNum == 0) {
-    info->m_offset = 0;
-  } else {
-    QTextBlock blk = p_block.previous();
-    while (blk.isValid()) {
-      auto pinfo = BlockLayoutData::get(blk);
-      if (!pinfo->hasOffset()) {
-        int num = blk.blockNumber();
-        if (pinfo->isNull()) {
-          layoutBlock(blk);
-        }
-
-        if (num == 0) {
-          pinfo->m_offset = 0;
-        } else {
-          blk = blk.previous();
-          continue;
-        }
-      }
-
-      // Now we reach a block with offset.
-      qreal offset = pinfo->bottom();
-      blk = blk.next();
-      while (blk.isValid() && blk.blockNumber() <= blockNum) {
-        auto ninfo = BlockLayoutData::get(blk);
-        Q_ASSERT(!ninfo->isNull());
-        ninfo->m_offset = offset;
-        offset = ninfo->bottom();
-        blk = blk.next();
-      }
-
-      break;
-    }
-
-    Q_ASSERT(info->hasOffset());
-  }
-}
-
-// NOTICE: It will skip non-layouted or offset-non-changed blocks.
-// So if you relayout separated blocks, you need to updateOffsetAfter() for each
-// of them.
-void TextDocumentLayout::updateOffsetAfter(const QTextBlock &p_block) {
-  auto info = BlockLayoutData::get(p_block);
-  Q_ASSERT(info->hasOffset());
-  qreal offset = info->bottom();
-  QTextBlock blk = p_block.next();
-  while (blk.isValid()) {
-    auto ninfo = BlockLayoutData::get(blk);
-    if (ninfo->isNull()) {
-      break;
-    }
-
-    if (realEqual(ninfo->m_offset, offset)) {
-      break;
-    }
-
-    ninfo->m_offset = offset;
-    offset = ninfo->bottom();
-    blk = blk.next();
-  }
-}
-
 qreal TextDocumentLayout::layoutLines(const QTextBlock &p_block, QTextLayout *p_tl,
                                       QVector<Marker> &p_markers, QVector<ImagePaintData> &p_images,
-                                      qreal p_availableWidth, qreal p_height) {
+                                      qreal p_availableWidth, qreal p_height) const {
   Q_ASSERT(p_block.isValid());
 
   // Handle block inline image.
@@ -612,7 +506,7 @@ qreal TextDocumentLayout::layoutLines(const QTextBlock &p_block, QTextLayout *p_
 void TextDocumentLayout::layoutInlineImage(const PreviewImageData *p_data, qreal p_heightInBlock,
                                            qreal p_imageSpaceHeight, qreal p_xStart, qreal p_xEnd,
                                            QVector<Marker> &p_markers,
-                                           QVector<ImagePaintData> &p_images) {
+                                           QVector<ImagePaintData> &p_images) const {
   Marker mk;
   qreal mky = p_imageSpaceHeight + p_heightInBlock + c_imagePadding * 2 + c_markerThickness;
   mk.m_start = QPointF(p_xStart, mky);
@@ -638,7 +532,7 @@ void TextDocumentLayout::layoutInlineImage(const PreviewImageData *p_data, qreal
 
 void TextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
                                            const QVector<Marker> &p_markers,
-                                           const QVector<ImagePaintData> &p_images) {
+                                           const QVector<ImagePaintData> &p_images) const {
   Q_ASSERT(p_block.isValid());
   ImagePaintData ipd;
   auto info = BlockLayoutData::get(p_block);
@@ -669,36 +563,24 @@ void TextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
 
     info->m_markers.append(mk);
   }
-}
 
-void TextDocumentLayout::updateDocumentSize() {
-  QTextBlock block = document()->lastBlock();
-  auto info = BlockLayoutData::get(block);
-  if (!info->hasOffset()) {
-    if (info->isNull()) {
-      layoutBlock(block);
-    }
-
-    updateOffsetBefore(block);
+  const int blockNum = p_block.blockNumber();
+  if (blockNum < m_blockHeights.size()) {
+    m_blockHeights.setHeight(blockNum, info->m_rect.height());
+  }
+  if (blockNum < m_blockWidths.size()) {
+    m_blockWidths.setWidth(blockNum, info->m_rect.width());
   }
+}
 
+void TextDocumentLayout::updateDocumentSize() {
   int oldHeight = m_height;
   int oldWidth = m_width;
 
-  m_height = info->bottom();
+  m_height = m_blockHeights.totalHeight();
 
-  m_width = 0;
-  QTextBlock blk = document()->firstBlock();
-  while (blk.isValid()) {
-    auto ninfo = BlockLayoutData::get(blk);
-    Q_ASSERT(ninfo->hasOffset());
-    if (m_width < ninfo->m_rect.width()) {
-      m_width = ninfo->m_rect.width();
-      m_maximumWidthBlockNumber = blk.blockNumber();
-    }
-
-    blk = blk.next();
-  }
+  m_width = m_blockWidths.maximumWidth();
+  m_maximumWidthBlockNumber = m_blockWidths.maximumWidthIndex();
 
   if (oldHeight != m_height || oldWidth != m_width) {
     emit documentSizeChanged(documentSize());
@@ -706,7 +588,7 @@ void TextDocumentLayout::updateDocumentSize() {
 }
 
 QRectF TextDocumentLayout::blockRectFromTextLayout(const QTextBlock &p_block,
-                                                   ImagePaintData *p_image) {
+                                                   ImagePaintData *p_image) const {
   if (p_image) {
     *p_image = ImagePaintData();
   }
@@ -763,16 +645,13 @@ QRectF TextDocumentLayout::blockRectFromTextLayout(const QTextBlock &p_block,
   return br;
 }
 
-void TextDocumentLayout::updateDocumentSizeWithOneBlockChanged(const QTextBlock &p_block) {
-  auto info = BlockLayoutData::get(p_block);
-  qreal width = info->m_rect.width();
-  if (width > m_width) {
+void TextDocumentLayout::updateDocumentSizeWithOneBlockChanged() {
+  // Width of the changed block has been updated in m_blockWidths.
+  const qreal width = m_blockWidths.maximumWidth();
+  m_maximumWidthBlockNumber = m_blockWidths.maximumWidthIndex();
+  if (!realEqual(width, m_width)) {
     m_width = width;
-    m_maximumWidthBlockNumber = p_block.blockNumber();
     emit documentSizeChanged(documentSize());
-  } else if (width < m_width && p_block.blockNumber() == m_maximumWidthBlockNumber) {
-    // Shrink the longest block.
-    updateDocumentSize();
   }
 }
 
@@ -851,15 +730,7 @@ void TextDocumentLayout::relayout() {
   // Update the margin.
   m_margin = doc->documentMargin();
 
-  QTextBlock block = doc->firstBlock();
-  while (block.isValid()) {
-    clearBlockLayout(block);
-    layoutBlock(block);
-
-    block = block.next();
-  }
-
-  updateOffset(doc->firstBlock());
+  layoutBlocks(doc->firstBlock(), QTextBlock());
 
   updateDocumentSize();
 
@@ -889,24 +760,15 @@ void TextDocumentLayout::relayout(const OrderedIntSet &p_blocks) {
     return;
   }
 
-  // Need to update offset for each of these discontinuous blocks, because
-  // the offset of the non-touched blocks may be the same but there are still
-  // touched blocks after them.
-  for (auto &blk : blocks) {
-    updateOffset(blk);
-  }
-
   updateDocumentSize();
 
-  qreal offset = BlockLayoutData::get(blocks.first())->m_offset;
+  qreal offset = blockOffset(blocks.first().blockNumber());
   emit update(QRectF(0., offset, 1000000000., 1000000000.));
 }
 
-qreal TextDocumentLayout::fetchInlineImagesForOneLine(const QVector<PreviewData *> &p_data,
-                                                      const QTextLine *p_line, qreal p_margin,
-                                                      int &p_index,
-                                                      QVector<const PreviewImageData *> &p_images,
-                                                      QVector<QPair<qreal, qreal>> &p_imageRange) {
+qreal TextDocumentLayout::fetchInlineImagesForOneLine(
+    const QVector<PreviewData *> &p_data, const QTextLine *p_line, qreal p_margin, int &p_index,
+    QVector<const PreviewImageData *> &p_images, QVector<QPair<qreal, qreal>> &p_imageRange) const {
   qreal maxHeight = 0;
   int start = p_line->textStart();
   int end = p_line->textLength() + start;
@@ -1013,7 +875,7 @@ void TextDocumentLayout::updateBlockByNumber(int p_blockNumber) {
   }
 }
 
-void TextDocumentLayout::scaleSize(QSize &p_size, int p_width, int p_height) {
+void TextDocumentLayout::scaleSize(QSize &p_size, int p_width, int p_height) const {
   if (p_size.width() > p_width || p_size.height() > p_height) {
     p_size.scale(p_width, p_height, Qt::KeepAspectRatio);
   }
@@ -1023,16 +885,6 @@ void TextDocumentLayout::setCursorWidth(int p_width) { m_cursorWidth = p_width;
 
 int TextDocumentLayout::cursorWidth() const { return m_cursorWidth; }
 
-void TextDocumentLayout::layoutBlockAndUpdateOffset(const QTextBlock &p_block) {
-  layoutBlock(p_block);
-  updateOffset(p_block);
-}
-
-void TextDocumentLayout::updateOffset(const QTextBlock &p_block) {
-  updateOffsetBefore(p_block);
-  updateOffsetAfter(p_block);
-}
-
 void TextDocumentLayout::setPreviewMarkerForeground(const QColor &p_color) {
   m_previewMarkerForeground = p_color;
 }
@@ -1055,6 +907,157 @@ void TextDocumentLayout::setPreviewEnabled(bool p_enabled) {
   relayout();
 }
 
+void TextDocumentLayout::setLazyLayoutEnabled(bool p_enabled) {
+  if (m_lazyLayoutEnabled == p_enabled) {
+    return;
+  }
+
+  m_lazyLayoutEnabled = p_enabled;
+  if (!m_lazyLayoutEnabled) {
+    // Layout all the estimated blocks.
+    if (layoutBlocksIfNull(0, m_blockHeights.size() - 1)) {
+      updateDocumentSize();
+      emit update(QRectF(0., 0., 1000000000., 1000000000.));
+    }
+  }
+}
+
+void TextDocumentLayout::setViewportRect(const QRectF &p_rect) { m_viewportRect = p_rect; }
+
+void TextDocumentLayout::layoutBlocks(QTextBlock p_first, const QTextBlock &p_last) {
+  if (!p_first.isValid()) {
+    return;
+  }
+
+  QPair<int, int> eagerBlocks(0, INT_MAX);
+  if (m_lazyLayoutEnabled) {
+    updateFontMetrics();
+    eagerBlocks = eagerBlockRange();
+  }
+
+  int blockNum = p_first.blockNumber();
+  QTextBlock block = p_first;
+  do {
+    clearBlockLayout(block);
+    if (blockNum >= eagerBlocks.first && blockNum <= eagerBlocks.second) {
+      layoutBlock(block);
+    } else {
+      estimateBlockLayout(block);
+    }
+
+    if (block == p_last) {
+      break;
+    }
+
+    block = block.next();
+    ++blockNum;
+  } while (block.isValid());
+}
+
+QPair<int, int> TextDocumentLayout::eagerBlockRange() const {
+  if (m_viewportRect.isValid() && !m_blockHeights.isEmpty()) {
+    const int first = m_blockHeights.findIndex(m_viewportRect.top());
+    const int last = m_blockHeights.findIndex(m_viewportRect.bottom());
+    return qMakePair(qMax(first - c_lazyLayoutExtraBlocks, 0), last + c_lazyLayoutExtraBlocks);
+  }
+
+  // Not painted yet, which is most likely at the top.
+  return qMakePair(0, c_lazyLayoutExtraBlocks * 2);
+}
+
+void TextDocumentLayout::estimateBlockLayout(const QTextBlock &p_block) {
+  auto info = BlockLayoutData::get(p_block);
+  Q_ASSERT(info->isNull());
+
+  const qreal availWidth = blockAvailableWidth(p_block, 0);
+  const int estimatedLines = estimateLineCount(p_block, availWidth);
+  int lines = estimatedLines;
+  if (lines > 1) {
+    lines = qMax(1, qRound(lines * m_wrapRatio));
+  }
+
+  qreal height = lines * (m_lineHeight + m_leadingSpaceOfLine);
+  if (!p_block.next().isValid()) {
+    height += m_margin;
+  }
+
+  const qreal textWidth = (p_block.length() - 1) * m_averageCharWidth;
+  const qreal width = qMin(textWidth, availWidth) + m_margin * 2 + m_cursorWidth;
+
+  const_cast<QTextBlock &>(p_block).setLineCount(p_block.isVisible() ? lines : 0);
+
+  const int blockNum = p_block.blockNumber();
+  if (blockNum < m_blockHeights.size()) {
+    m_blockHeights.setHeight(blockNum, height);
+  }
+  if (blockNum < m_blockWidths.size()) {
+    m_blockWidths.setWidth(blockNum, width);
+  }
+}
+
+bool TextDocumentLayout::layoutBlockIfNull(const QTextBlock &p_block) const {
+  if (!BlockLayoutData::get(p_block)->isNull()) {
+    return false;
+  }
+
+  const int blockNum = p_block.blockNumber();
+  if (blockNum >= m_blockHeights.size()) {
+    layoutBlock(p_block);
+    return false;
+  }
+
+  const qreal oldHeight = m_blockHeights.height(blockNum);
+  layoutBlock(p_block);
+  return !realEqual(oldHeight, m_blockHeights.height(blockNum));
+}
+
+bool TextDocumentLayout::layoutBlocksIfNull(int p_first, int p_last) {
+  bool changed = false;
+  QTextBlock block = document()->findBlockByNumber(p_first);
+  for (int blockNum = p_first; blockNum <= p_last && block.isValid(); ++blockNum) {
+    if (layoutBlockIfNull(block)) {
+      changed = true;
+    }
+
+    block = block.next();
+  }
+
+  return changed;
+}
+
+int TextDocumentLayout::estimateLineCount(const QTextBlock &p_block,
+                                          qreal p_availableWidth) const {
+  const qreal textWidth = (p_block.length() - 1) * m_averageCharWidth;
+  if (p_availableWidth <= 0 || textWidth <= p_availableWidth) {
+    return 1;
+  }
+
+  return qCeil(textWidth / p_availableWidth);
+}
+
+qreal TextDocumentLayout::blockAvailableWidth(const QTextBlock &p_block,
+                                              int p_extraMargin) const {
+  qreal width = document()->pageSize().width();
+  if (width <= 0 || !shouldBlockWrapLine(p_block)) {
+    width = qreal(INT_MAX);
+  }
+
+  width -= (2 * m_margin + p_extraMargin + m_cursorMargin + m_cursorWidth);
+  return width;
+}
+
+void TextDocumentLayout::updateFontMetrics() {
+  QFontMetricsF fm(document()->defaultFont());
+  m_averageCharWidth = fm.averageCharWidth();
+  m_lineHeight = fm.height();
+}
+
+void TextDocumentLayout::updateDocumentSizeLater() const {
+  if (!m_documentSizeTimer->isActive()) {
+    m_documentSizeTimer->start();
+  }
+}
+
 qreal TextDocumentLayout::getLeadingSpaceOfLine() const { return m_leadingSpaceOfLine; }
 
 void TextDocumentLayout::setLeadingSpaceOfLine(qreal p_leading) {
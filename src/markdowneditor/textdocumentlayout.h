@@ -8,8 +8,12 @@
 
 #include <vtextedit/orderedintset.h>
 
+#include "blockheightindex.h"
+#include "blockwidthindex.h"
 #include "textdocumentlayoutdata.h"
 
+class QTimer;
+
 namespace vte {
 class DocumentResourceMgr;
 struct PreviewImageData;
@@ -47,6 +51,14 @@ public:
 
   void setPreviewEnabled(bool p_enabled);
 
+  // Whether layout blocks far from the viewport lazily. Those blocks get an estimated
+  // height until they are painted or queried.
+  void setLazyLayoutEnabled(bool p_enabled);
+
+  // Set the viewport of the editor in document coordinates. Blocks around it are layouted
+  // eagerly with lazy layout.
+  void setViewportRect(const QRectF &p_rect);
+
   // Relayout all the blocks.
   void relayout();
 
@@ -63,33 +75,57 @@ protected:
 
 private:
   // Layout one block.
-  // Only update the rect of the block. Offset is not updated yet.
-  void layoutBlock(const QTextBlock &p_block);
+  void layoutBlock(const QTextBlock &p_block) const;
+
+  // Estimate the height and width of @p_block without layouting it.
+  void estimateBlockLayout(const QTextBlock &p_block);
+
+  // Layout @p_block if it has no layout, such as an estimated block.
+  // Return true if its height changes.
+  bool layoutBlockIfNull(const QTextBlock &p_block) const;
+
+  // Layout blocks within [@p_first, @p_last] if they have no layout.
+  // Return true if the height of any block changes.
+  bool layoutBlocksIfNull(int p_first, int p_last);
+
+  // Blocks to layout in lazy layout, which are those around the viewport.
+  QPair<int, int> eagerBlockRange() const;
+
+  // Layout blocks from @p_first to @p_last, or to the end if @p_last is invalid.
+  // Blocks out of eagerBlockRange() are estimated in lazy layout.
+  void layoutBlocks(QTextBlock p_first, const QTextBlock &p_last);
+
+  // Estimated line count of @p_block without considering m_wrapRatio.
+  int estimateLineCount(const QTextBlock &p_block, qreal p_availableWidth) const;
+
+  // Available width for the text of @p_block.
+  qreal blockAvailableWidth(const QTextBlock &p_block, int p_extraMargin) const;
 
-  // Update the offset of @p_block.
-  // @p_block has a valid layout.
-  // After the call, all block before @p_block will have the correct layout and
-  // offset.
-  void updateOffsetBefore(const QTextBlock &p_block);
+  void updateFontMetrics();
 
-  // Update the offset of blocks after @p_block if they are layouted.
-  void updateOffsetAfter(const QTextBlock &p_block);
+  // Update document size later when block heights are changed by lazy layout.
+  void updateDocumentSizeLater() const;
 
-  void updateOffset(const QTextBlock &p_block);
+  // Y offset of block @p_blockNumber.
+  qreal blockOffset(int p_blockNumber) const;
 
-  void layoutBlockAndUpdateOffset(const QTextBlock &p_block);
+  // Sync m_blockHeights and m_blockWidths with the block count of document when blocks
+  // after @p_blockNumber are inserted or removed.
+  // Return false if they are reset and all blocks need to be layouted.
+  bool updateBlockGeometryCount(int p_blockNumber, int p_newBlockCount);
 
   // Returns the total height of this block after layouting lines and inline
   // images.
   qreal layoutLines(const QTextBlock &p_block, QTextLayout *p_tl, QVector<Marker> &p_markers,
-                    QVector<ImagePaintData> &p_images, qreal p_availableWidth, qreal p_height);
+                    QVector<ImagePaintData> &p_images, qreal p_availableWidth,
+                    qreal p_height) const;
 
   // Layout inline image in a line.
   // @p_data: if NULL, means just layout a marker.
   // Returns the image height.
   void layoutInlineImage(const PreviewImageData *p_data, qreal p_heightInBlock,
                          qreal p_imageSpaceHeight, qreal p_xStart, qreal p_xEnd,
-                         QVector<Marker> &p_markers, QVector<ImagePaintData> &p_images);
+                         QVector<Marker> &p_markers, QVector<ImagePaintData> &p_images) const;
 
   // Get inline images belonging to @p_line from @p_data.
   // @p_index: image [0, p_index) has been drawn.
@@ -99,38 +135,34 @@ private:
   qreal fetchInlineImagesForOneLine(const QVector<PreviewData *> &p_data, const QTextLine *p_line,
                                     qreal p_margin, int &p_index,
                                     QVector<const PreviewImageData *> &p_images,
-                                    QVector<QPair<qreal, qreal>> &p_imageRange);
+                                    QVector<QPair<qreal, qreal>> &p_imageRange) const;
 
   // Clear the layout of @p_block.
-  // Also clear all the offset behind this block.
   void clearBlockLayout(QTextBlock &p_block);
 
-  // Update rect of a block.
+  // Update rect of a block as well as its height and width in index.
   void finishBlockLayout(const QTextBlock &p_block, const QVector<Marker> &p_markers,
-                         const QVector<ImagePaintData> &p_images);
+                         const QVector<ImagePaintData> &p_images) const;
 
   void updateDocumentSize();
 
   QVector<QTextLayout::FormatRange>
   formatRangeFromSelection(const QTextBlock &p_block, const QVector<Selection> &p_selections) const;
 
-  // Get the block range [first, last] by rect @p_rect.
+  // Get the block range [first, last] by rect @p_rect via m_blockHeights.
   // @p_rect: a clip region in document coordinates. If null, returns all the
   // blocks. Return [-1, -1] if no valid block range found.
   void blockRangeFromRect(const QRectF &p_rect, int &p_first, int &p_last) const;
 
-  // Binary search to get the block range [first, last] by @p_rect.
-  void blockRangeFromRectBS(const QRectF &p_rect, int &p_first, int &p_last) const;
-
   // Return a rect from the layout.
   // If @p_imageRect is not NULL and there is block image for this block, it
   // will be set to the rect of that image. Return a null rect if @p_block has
   // not been layouted.
-  QRectF blockRectFromTextLayout(const QTextBlock &p_block, ImagePaintData *p_image = NULL);
+  QRectF blockRectFromTextLayout(const QTextBlock &p_block, ImagePaintData *p_image = NULL) const;
 
   // Update document size when only @p_block is changed and the height
   // remains the same.
-  void updateDocumentSizeWithOneBlockChanged(const QTextBlock &p_block);
+  void updateDocumentSizeWithOneBlockChanged();
 
   void adjustImagePaddingAndSize(const PreviewImageData *p_data, int p_maximumWidth, int &p_padding,
                                  QSize &p_size) const;
@@ -141,7 +173,7 @@ private:
 
   void drawPreviewMarker(QPainter *p_painter, const QTextBlock &p_block, const QPointF &p_offset);
 
-  void scaleSize(QSize &p_size, int p_width, int p_height);
+  void scaleSize(QSize &p_size, int p_width, int p_height) const;
 
   // Get text length in pixel.
   // @p_pos: position within the layout.
@@ -167,6 +199,13 @@ private:
   // Block count of the document.
   int m_blockCount = 0;
 
+  // Heights of all the blocks, from which the offset of each block is calculated.
+  // Mutable since const queries may layout estimated blocks in lazy layout.
+  mutable BlockHeightIndex m_blockHeights;
+
+  // Widths of all the blocks, from which the width of document is calculated.
+  mutable BlockWidthIndex m_blockWidths;
+
   // Width of the cursor.
   int m_cursorWidth = 1;
 
@@ -183,12 +222,31 @@ private:
 
   QColor m_previewMarkerForeground = {"#9575CD"};
 
+  bool m_lazyLayoutEnabled = false;
+
+  // Viewport of the editor in document coordinates.
+  QRectF m_viewportRect;
+
+  // Ratio of the real line count to the estimated one of wrapped blocks.
+  mutable qreal m_wrapRatio = 1.0;
+
+  // Average character width and line height of the default font to estimate layout.
+  qreal m_averageCharWidth = 0;
+
+  qreal m_lineHeight = 0;
+
+  // Update document size once after blocks are layouted by const queries.
+  QTimer *m_documentSizeTimer = nullptr;
+
   static const int c_markerThickness;
 
   static const int c_maxInlineImageHeight;
 
   // Padding of image preview for top and bottom.
   static const int c_imagePadding;
+
+  // Number of blocks to layout around the viewport in lazy layout.
+  static const int c_lazyLayoutExtraBlocks;
 };
 
 } // namespace vte
@@ -35,7 +35,6 @@ struct ImagePaintData {
 // Data about a block layout.
 struct BlockLayoutData {
   void reset() {
-    m_offset = -1;
     m_rect = QRectF();
     m_markers.clear();
     m_images.clear();
@@ -43,18 +42,6 @@ struct BlockLayoutData {
 
   bool isNull() const { return m_rect.isNull(); }
 
-  bool hasOffset() const { return m_offset > -1 && !m_rect.isNull(); }
-
-  qreal top() const {
-    Q_ASSERT(hasOffset());
-    return m_offset;
-  }
-
-  qreal bottom() const {
-    Q_ASSERT(hasOffset());
-    return m_offset + m_rect.height();
-  }
-
   static QSharedPointer<BlockLayoutData> get(const QTextBlock &p_block) {
     auto blockData = TextBlockData::get(p_block);
     auto data = blockData->getBlockLayoutData();
@@ -65,10 +52,6 @@ struct BlockLayoutData {
     return data;
   }
 
-  // Y offset of this block.
-  // -1 for invalid.
-  qreal m_offset = -1;
-
   // The bounding rect of this block, including the margins.
   // Null for invalid.
   QRectF m_rect;
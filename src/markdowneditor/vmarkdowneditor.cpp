@@ -19,9 +19,14 @@
 #include "webcodeblockhighlighter.h"
 
 #include <QDebug>
+#include <QDir>
+#include <QScrollBar>
+#include <QStandardPaths>
 
 using namespace vte;
 
+bool VMarkdownEditor::s_codeBlockHighlightCacheFileSet = false;
+
 VMarkdownEditor::VMarkdownEditor(const QSharedPointer<MarkdownEditorConfig> &p_config,
                                  const QSharedPointer<TextEditorParameters> &p_paras,
                                  QWidget *p_parent)
@@ -57,6 +62,15 @@ void VMarkdownEditor::setSyntax(const QString &p_syntax) {
 QString VMarkdownEditor::getSyntax() const { return QStringLiteral("richmarkdown"); }
 
 void VMarkdownEditor::setupSyntaxHighlighter() {
+  if (!s_codeBlockHighlightCacheFileSet) {
+    QString filePath;
+    const auto cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheDir.isEmpty()) {
+      filePath = QDir(cacheDir).filePath(QStringLiteral("vtextedit/codeblockhighlight.cache"));
+    }
+    setCodeBlockHighlightCacheFile(filePath);
+  }
+
   m_highlighterInterface.reset(new EditorPegMarkdownHighlighter(this));
   CodeBlockHighlighter *codeBlockHighlighter = nullptr;
   if (m_config->m_webCodeBlockHighlighterEnabled) {
@@ -68,7 +82,8 @@ void VMarkdownEditor::setupSyntaxHighlighter() {
     codeBlockHighlighter = m_webCodeBlockHighlighter;
   } else {
     codeBlockHighlighter =
-        new KSyntaxCodeBlockHighlighter(m_config->m_textEditorConfig->m_syntaxTheme, this);
+        new KSyntaxCodeBlockHighlighter(m_config->m_textEditorConfig->m_syntaxTheme,
+                                        m_config->m_codeBlockHighlightWorkerCount, this);
   }
   auto highlighterConfig = QSharedPointer<peg::HighlighterConfig>::create();
   highlighterConfig->m_mathExtEnabled = true;
@@ -92,6 +107,21 @@ void VMarkdownEditor::setupDocumentLayout() {
 
   connect(m_textEdit, &VTextEdit::cursorWidthChanged, this,
           [this]() { documentLayout()->setCursorWidth(m_textEdit->cursorWidth()); });
+
+  // The clip of a paint may be only part of the viewport, such as the cursor line.
+  connect(m_textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this,
+          &VMarkdownEditor::updateDocumentLayoutViewport);
+  connect(m_textEdit->horizontalScrollBar(), &QScrollBar::valueChanged, this,
+          &VMarkdownEditor::updateDocumentLayoutViewport);
+  connect(m_textEdit, &VTextEdit::resized, this, &VMarkdownEditor::updateDocumentLayoutViewport);
+  updateDocumentLayoutViewport();
+}
+
+void VMarkdownEditor::updateDocumentLayoutViewport() {
+  const auto viewport = m_textEdit->viewport();
+  documentLayout()->setViewportRect(QRectF(m_textEdit->horizontalScrollBar()->value(),
+                                           m_textEdit->verticalScrollBar()->value(),
+                                           viewport->width(), viewport->height()));
 }
 
 TextDocumentLayout *VMarkdownEditor::documentLayout() const {
@@ -137,6 +167,8 @@ void VMarkdownEditor::updateFromConfig() {
   documentLayout()->setConstrainPreviewWidthEnabled(
       m_config->m_constrainInplacePreviewWidthEnabled);
 
+  documentLayout()->setLazyLayoutEnabled(m_config->m_lazyLayoutEnabled);
+
   updateInplacePreviewSources();
 
   updateSpaceWidth();
@@ -428,3 +460,8 @@ void VMarkdownEditor::setExternalCodeBlockHighlihgtStyles(
     const ExternalCodeBlockHighlightStyles &p_styles) {
   WebCodeBlockHighlighter::setExternalCodeBlockHighlihgtStyles(p_styles);
 }
+
+void VMarkdownEditor::setCodeBlockHighlightCacheFile(const QString &p_filePath) {
+  s_codeBlockHighlightCacheFileSet = true;
+  CodeBlockHighlighter::setCacheFile(p_filePath);
+}
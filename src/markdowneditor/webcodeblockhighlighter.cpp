@@ -1,5 +1,9 @@
 #include "webcodeblockhighlighter.h"
 
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
 #include <QXmlStreamReader>
 
@@ -9,9 +13,16 @@ using namespace vte;
 
 WebCodeBlockHighlighter::ExternalCodeBlockHighlightStyles WebCodeBlockHighlighter::s_styles;
 
+QString WebCodeBlockHighlighter::s_stylesId;
+
 WebCodeBlockHighlighter::WebCodeBlockHighlighter(QObject *p_parent)
     : CodeBlockHighlighter(p_parent) {}
 
+QString WebCodeBlockHighlighter::cacheScope() const {
+  // Results depend on the external styles.
+  return QStringLiteral("web:") + s_stylesId;
+}
+
 void WebCodeBlockHighlighter::highlightInternal(int p_idx) {
   const auto &block = m_codeBlocks[p_idx];
   if (block.m_lang.isEmpty()) {
@@ -209,4 +220,15 @@ QTextCharFormat WebCodeBlockHighlighter::styleOfClasses(const QStringList &p_cla
 void WebCodeBlockHighlighter::setExternalCodeBlockHighlihgtStyles(
     const ExternalCodeBlockHighlightStyles &p_styles) {
   s_styles = p_styles;
+
+  // Digest of the styles in a stable order.
+  QByteArray data;
+  QDataStream stream(&data, QIODevice::WriteOnly);
+  auto classes = s_styles.keys();
+  std::sort(classes.begin(), classes.end());
+  for (const auto &cla : classes) {
+    stream << cla << s_styles.value(cla);
+  }
+  s_stylesId =
+      QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex());
 }
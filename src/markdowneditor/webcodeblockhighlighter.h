@@ -22,6 +22,8 @@ signals:
   void externalCodeBlockHighlightRequested(int p_idx, TimeStamp p_timeStamp, const QString &p_text);
 
 protected:
+  QString cacheScope() const Q_DECL_OVERRIDE;
+
   // @p_idx Index in m_codeBlocks.
   void highlightInternal(int p_idx) Q_DECL_OVERRIDE;
 
@@ -37,6 +39,9 @@ private:
                                int &p_offset);
 
   static ExternalCodeBlockHighlightStyles s_styles;
+
+  // Digest of s_styles.
+  static QString s_stylesId;
 };
 } // namespace vte
 
@@ -50,9 +50,24 @@ bool SpellChecker::isMisspelled(const QString &p_word) const {
   return m_speller->isMisspelled(p_word);
 }
 
-void SpellChecker::ignoreWord(const QString &p_word) { m_speller->addToSession(p_word); }
+void SpellChecker::ignoreWord(const QString &p_word) {
+  m_speller->addToSession(p_word);
 
-void SpellChecker::addToDictionary(const QString &p_word) { m_speller->addToPersonal(p_word); }
+  QMutexLocker locker(&m_acceptedWordsMutex);
+  m_acceptedWords.append(p_word);
+}
+
+void SpellChecker::addToDictionary(const QString &p_word) {
+  m_speller->addToPersonal(p_word);
+
+  QMutexLocker locker(&m_acceptedWordsMutex);
+  m_acceptedWords.append(p_word);
+}
+
+QStringList SpellChecker::acceptedWords(int p_from) const {
+  QMutexLocker locker(&m_acceptedWordsMutex);
+  return m_acceptedWords.mid(p_from);
+}
 
 QStringList SpellChecker::suggest(const QString &p_word, bool p_autoDetectEnabled) {
   if (p_autoDetectEnabled) {
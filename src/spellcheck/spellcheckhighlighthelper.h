@@ -1,17 +1,28 @@
 #ifndef SPELLCHECKHIGHLIGHTHELPER_H
 #define SPELLCHECKHIGHLIGHTHELPER_H
 
+#include <QSharedPointer>
 #include <QTextBlock>
 
+#include "spellcheckworker.h"
+
 namespace vte {
+struct BlockSpellCheckData;
+
 class SpellCheckHighlightHelper {
 public:
   SpellCheckHighlightHelper() = delete;
 
-  // Fill the BlockSpellCheckData of @p_block.
-  // Return true if spell check succeeded.
-  static bool checkBlock(const QTextBlock &p_block, const QString &p_text,
-                         bool p_autoDetectEnabled);
+  // Return the BlockSpellCheckData of @p_block if it is up to date.
+  // Otherwise, add @p_block to @p_worker to check and return null.
+  static QSharedPointer<BlockSpellCheckData> checkBlock(SpellCheckWorker *p_worker,
+                                                        const QTextBlock &p_block,
+                                                        const QString &p_text,
+                                                        bool p_autoDetectEnabled);
+
+  // Fill the BlockSpellCheckData of the block of @p_doc from @p_result.
+  // Return the block if succeeded or an invalid block if the block has changed since.
+  static QTextBlock applyResult(QTextDocument *p_doc, const SpellCheckWorker::Result &p_result);
 };
 } // namespace vte
 
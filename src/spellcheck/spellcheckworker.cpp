@@ -0,0 +1,261 @@
+#include "spellcheckworker.h"
+
+#include <QHash>
+
+#include <languagefilter_p.h>
+#include <speller.h>
+
+#include <vtextedit/spellchecker.h>
+
+using namespace vte;
+
+namespace {
+// Speller owned by the worker thread, never shared with the GUI thread.
+class WorkerSpeller {
+public:
+  WorkerSpeller() : m_languageFilter(new Sonnet::SentenceTokenizer()) {
+    m_speller.setAttribute(Sonnet::Speller::AutoDetectLanguage, false);
+  }
+
+  // Return the misspelled words of @p_text.
+  // If @p_autoDetectEnabled, the language is switched per sentence.
+  QVector<BlockSegment> checkText(const QString &p_text, bool p_autoDetectEnabled,
+                                  const QString &p_defaultLanguage) {
+    QVector<BlockSegment> misspellings;
+    if (!p_defaultLanguage.isEmpty()) {
+      setLanguage(p_defaultLanguage);
+    }
+
+    if (!m_speller.isValid()) {
+      return misspellings;
+    }
+
+    syncAcceptedWords();
+
+    m_languageFilter.setBuffer(p_text);
+    while (m_languageFilter.hasNext()) {
+      if (!m_languageFilter.isSpellcheckable()) {
+        continue;
+      }
+
+      const auto sentence = m_languageFilter.next();
+      if (p_autoDetectEnabled) {
+        const auto lang = m_languageFilter.language();
+        if (lang.isEmpty()) {
+          continue;
+        }
+
+        setLanguage(lang);
+        syncAcceptedWords();
+      }
+
+      m_wordTokenizer.setBuffer(sentence.toString());
+      const int offset = sentence.position();
+      while (m_wordTokenizer.hasNext()) {
+        const auto token = m_wordTokenizer.next();
+
+        if (!m_wordTokenizer.isSpellcheckable()) {
+          continue;
+        }
+
+        auto word = token.toString();
+        // Remove the ending _.
+        if (word.endsWith(QLatin1Char('_'))) {
+          word.chop(1);
+        }
+
+        if (m_speller.isMisspelled(word)) {
+          // Found one.
+          misspellings.push_back(BlockSegment(token.position() + offset, token.length()));
+        }
+      }
+    }
+
+    return misspellings;
+  }
+
+private:
+  void setLanguage(const QString &p_lang) {
+    if (p_lang == m_speller.language()) {
+      return;
+    }
+
+    m_speller.setLanguage(p_lang);
+    // The session words are dropped with the dictionary.
+    m_acceptedWordCount = 0;
+  }
+
+  // Catch up with the words ignored or added to dictionary via the GUI speller.
+  void syncAcceptedWords() {
+    const auto words = SpellChecker::getInst().acceptedWords(m_acceptedWordCount);
+    for (const auto &word : words) {
+      m_speller.addToSession(word);
+    }
+    m_acceptedWordCount += words.size();
+  }
+
+  Sonnet::Speller m_speller;
+
+  Sonnet::LanguageFilter m_languageFilter;
+
+  Sonnet::WordTokenizer m_wordTokenizer;
+
+  int m_acceptedWordCount = 0;
+};
+} // namespace
+
+SpellCheckWorker::SpellCheckWorker(QObject *p_parent) : QThread(p_parent) {}
+
+SpellCheckWorker::~SpellCheckWorker() {
+  stop();
+  wait();
+}
+
+void SpellCheckWorker::addJob(int p_blockNumber, int p_revision, const QString &p_text,
+                              bool p_autoDetectEnabled) {
+  {
+    QMutexLocker locker(&m_mutex);
+    auto &job = m_jobs[p_blockNumber];
+    job.m_revision = p_revision;
+    job.m_text = p_text;
+    job.m_autoDetectEnabled = p_autoDetectEnabled;
+  }
+
+  m_jobAdded.wakeOne();
+
+  if (!isRunning()) {
+    start(QThread::LowPriority);
+  }
+}
+
+void SpellCheckWorker::setLanguage(const QString &p_lang) {
+  QMutexLocker locker(&m_mutex);
+  m_language = p_lang;
+}
+
+void SpellCheckWorker::setPriorityBlockRange(int p_first, int p_last) {
+  QMutexLocker locker(&m_mutex);
+  m_priorityBlocks.first = p_first;
+  m_priorityBlocks.second = p_last;
+}
+
+void SpellCheckWorker::shiftBlocks(int p_blockNumber, int p_delta) {
+  if (p_delta == 0) {
+    return;
+  }
+
+  QMutexLocker locker(&m_mutex);
+  QMap<int, Job> jobs;
+  for (auto it = m_jobs.constBegin(); it != m_jobs.constEnd(); ++it) {
+    const int num = shiftBlockNumber(it.key(), p_blockNumber, p_delta);
+    if (num != -1) {
+      jobs.insert(num, it.value());
+    }
+  }
+  m_jobs.swap(jobs);
+
+  for (int i = m_results.size() - 1; i >= 0; --i) {
+    auto &result = m_results[i];
+    result.m_blockNumber = shiftBlockNumber(result.m_blockNumber, p_blockNumber, p_delta);
+    if (result.m_blockNumber == -1) {
+      m_results.remove(i);
+    }
+  }
+
+  if (m_checkingBlockNumber != -1) {
+    m_checkingBlockNumber = shiftBlockNumber(m_checkingBlockNumber, p_blockNumber, p_delta);
+  }
+}
+
+int SpellCheckWorker::shiftBlockNumber(int p_blockNumber, int p_firstBlock, int p_delta) {
+  if (p_blockNumber <= p_firstBlock) {
+    return p_blockNumber;
+  }
+
+  if (p_delta < 0 && p_blockNumber <= p_firstBlock - p_delta) {
+    return -1;
+  }
+
+  return p_blockNumber + p_delta;
+}
+
+void SpellCheckWorker::clear() {
+  QMutexLocker locker(&m_mutex);
+  m_jobs.clear();
+  m_results.clear();
+  ++m_generation;
+}
+
+QVector<SpellCheckWorker::Result> SpellCheckWorker::takeResults() {
+  QMutexLocker locker(&m_mutex);
+  QVector<Result> results;
+  results.swap(m_results);
+  return results;
+}
+
+uint SpellCheckWorker::textHash(const QString &p_text) { return static_cast<uint>(qHash(p_text)); }
+
+void SpellCheckWorker::stop() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopped = true;
+  }
+
+  m_jobAdded.wakeAll();
+}
+
+void SpellCheckWorker::run() {
+  WorkerSpeller speller;
+
+  while (true) {
+    Result result;
+    Job job;
+    int generation = 0;
+    QString language;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_jobs.isEmpty() && !m_stopped) {
+        m_jobAdded.wait(&m_mutex);
+      }
+
+      if (m_stopped) {
+        return;
+      }
+
+      auto it = m_jobs.lowerBound(m_priorityBlocks.first);
+      if (it == m_jobs.end() || it.key() > m_priorityBlocks.second) {
+        it = m_jobs.begin();
+      }
+
+      m_checkingBlockNumber = it.key();
+      job = it.value();
+      m_jobs.erase(it);
+      generation = m_generation;
+      language = m_language;
+    }
+
+    result.m_revision = job.m_revision;
+    result.m_textHash = textHash(job.m_text);
+    result.m_misspellings = speller.checkText(job.m_text, job.m_autoDetectEnabled, language);
+
+    bool needNotify = false;
+    {
+      QMutexLocker locker(&m_mutex);
+      if (generation != m_generation || m_checkingBlockNumber == -1) {
+        continue;
+      }
+
+      result.m_blockNumber = m_checkingBlockNumber;
+      m_checkingBlockNumber = -1;
+
+      // The receiver takes all the results at once.
+      needNotify = m_results.isEmpty();
+      m_results.append(result);
+    }
+
+    if (needNotify) {
+      emit resultsReady();
+    }
+  }
+}
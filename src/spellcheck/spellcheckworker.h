@@ -0,0 +1,103 @@
+#ifndef SPELLCHECKWORKER_H
+#define SPELLCHECKWORKER_H
+
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <vtextedit/blocksegment.h>
+
+namespace vte {
+// Spell check blocks on a worker thread.
+// Jobs are keyed by block number and those within the priority block range are checked
+// first. Call shiftBlocks() on blocks inserted or removed to keep the numbers of the pending
+// jobs and results. Call takeResults() to fetch the results once resultsReady() is emitted.
+// The worker checks with its own speller, which is never touched by the GUI thread.
+class SpellCheckWorker : public QThread {
+  Q_OBJECT
+public:
+  struct Result {
+    int m_blockNumber = -1;
+
+    // Revision of the block when the job is added.
+    int m_revision = -1;
+
+    // Hash of the checked text to tell whether the block number still refers to the same block.
+    uint m_textHash = 0;
+
+    QVector<BlockSegment> m_misspellings;
+  };
+
+  explicit SpellCheckWorker(QObject *p_parent = nullptr);
+
+  ~SpellCheckWorker();
+
+  // Add a block to check. A pending job of the same block number will be replaced.
+  void addJob(int p_blockNumber, int p_revision, const QString &p_text, bool p_autoDetectEnabled);
+
+  // Queue the default language to the worker, which switches its speller before next job.
+  void setLanguage(const QString &p_lang);
+
+  // Blocks within [@p_first, @p_last] will be checked first.
+  void setPriorityBlockRange(int p_first, int p_last);
+
+  // @p_delta blocks are inserted after block @p_blockNumber if positive, or removed if negative.
+  // Shift the block numbers after it and drop those removed.
+  void shiftBlocks(int p_blockNumber, int p_delta);
+
+  // Drop all the pending jobs as well as the results of the job being checked.
+  void clear();
+
+  QVector<Result> takeResults();
+
+  static uint textHash(const QString &p_text);
+
+signals:
+  // Emitted in the worker thread when results become available.
+  void resultsReady();
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  struct Job {
+    int m_revision = -1;
+
+    QString m_text;
+
+    bool m_autoDetectEnabled = false;
+  };
+
+  void stop();
+
+  // Return the number of @p_blockNumber after shiftBlocks(), or -1 if it is removed.
+  static int shiftBlockNumber(int p_blockNumber, int p_firstBlock, int p_delta);
+
+  QMutex m_mutex;
+
+  QWaitCondition m_jobAdded;
+
+  // Pending jobs keyed by block number.
+  QMap<int, Job> m_jobs;
+
+  QPair<int, int> m_priorityBlocks = {-1, -1};
+
+  // Default language queued by setLanguage(). Empty to use the default one of Sonnet.
+  QString m_language;
+
+  QVector<Result> m_results;
+
+  // Number of the block being checked, or -1 if it is removed since.
+  int m_checkingBlockNumber = -1;
+
+  // Increased by clear() to drop the result of the job being checked.
+  int m_generation = 0;
+
+  bool m_stopped = false;
+};
+} // namespace vte
+
+#endif // SPELLCHECKWORKER_H
@@ -14,6 +14,7 @@
 #include <vtextedit/vtexteditor.h>
 
 #include "textfolding.h"
+#include "visearchhelper.h"
 #include <textedit/autoindenthelper.h>
 
 #define EDITOR_NIY                                                                                 \
@@ -209,8 +210,37 @@ KateViI::Range EditorInputMode::selectionRange() const {
 QVector<KateViI::Range> EditorInputMode::searchText(const KateViI::Range &p_range,
                                                     const QString &p_pattern,
                                                     const KateViI::SearchOptions p_options) const {
-  EDITOR_NIY;
-  return QVector<KateViI::Range>();
+  return ViSearchHelper::searchText(document(), p_range, searchRegExp(p_pattern, p_options),
+                                    p_options & KateViI::Backwards);
+}
+
+const QRegularExpression &EditorInputMode::searchRegExp(const QString &p_pattern,
+                                                        KateViI::SearchOptions p_options) const {
+  // Direction does not matter.
+  p_options &= ~KateViI::SearchOptions(KateViI::Backwards);
+  if (m_searchRegExp.pattern().isEmpty() || p_pattern != m_searchPattern ||
+      p_options != m_searchOptions) {
+    m_searchPattern = p_pattern;
+    m_searchOptions = p_options;
+
+    bool caseSensitive = !(p_options & KateViI::CaseInsensitive);
+    QString pattern;
+    if (p_options & KateViI::Regex) {
+      pattern = ViSearchHelper::vimRegExpToQt(p_pattern, caseSensitive);
+    } else {
+      pattern = QRegularExpression::escape(p_pattern);
+      if (p_options & KateViI::WholeWords) {
+        pattern = QStringLiteral("\\b%1\\b").arg(pattern);
+      }
+    }
+
+    m_searchRegExp.setPattern(pattern);
+    m_searchRegExp.setPatternOptions(caseSensitive ? QRegularExpression::NoPatternOption
+                                                   : QRegularExpression::CaseInsensitiveOption);
+    m_searchRegExp.optimize();
+  }
+
+  return m_searchRegExp;
 }
 
 KateViI::Cursor EditorInputMode::documentEnd() const {
@@ -2,6 +2,7 @@
 #define EDITORINPUTMODE_H
 
 #include <QObject>
+#include <QRegularExpression>
 #include <inputmode/inputmodeeditorinterface.h>
 
 class QTextDocument;
@@ -204,6 +205,11 @@ private:
   // How many blocks in one page scroll step.
   int blockCountOfOnePageStep() const;
 
+  // Get the compiled regular expression of @p_pattern, which is cached since KateVi searches
+  // the same pattern repeatedly.
+  const QRegularExpression &searchRegExp(const QString &p_pattern,
+                                         KateViI::SearchOptions p_options) const;
+
   VTextEditor *m_editor = nullptr;
 
   VTextEdit *m_textEdit = nullptr;
@@ -224,6 +230,13 @@ private:
   // Work around of the Qt bug.
   // See editStart() and editEnd().
   int m_verticalScrollBarValue = 0;
+
+  // Pattern and options of m_searchRegExp.
+  mutable QString m_searchPattern;
+
+  mutable KateViI::SearchOptions m_searchOptions;
+
+  mutable QRegularExpression m_searchRegExp;
 };
 } // namespace vte
 
@@ -0,0 +1,137 @@
+#include "findworker.h"
+
+using namespace vte;
+
+const int FindWorker::c_chunkSize = 256 * 1024;
+
+FindWorker::FindWorker(QObject *p_parent) : QThread(p_parent) {}
+
+FindWorker::~FindWorker() {
+  stop();
+  wait();
+}
+
+int FindWorker::find(const TextFinder &p_finder, const QString &p_text, int p_start, int p_end) {
+  int id = 0;
+  {
+    QMutexLocker locker(&m_mutex);
+    m_job.m_finder = p_finder;
+    m_job.m_text = p_text;
+    m_job.m_start = p_start;
+    m_job.m_end = p_end;
+    m_hasJob = true;
+
+    id = ++m_jobId;
+    m_result = Result();
+    m_result.m_id = id;
+    m_resultPending = false;
+  }
+
+  m_jobAdded.wakeOne();
+
+  if (!isRunning()) {
+    start(QThread::LowPriority);
+  }
+
+  return id;
+}
+
+void FindWorker::cancel() {
+  QMutexLocker locker(&m_mutex);
+  m_hasJob = false;
+  m_job = Job();
+
+  ++m_jobId;
+  m_result = Result();
+  m_resultPending = false;
+}
+
+FindWorker::Result FindWorker::takeResult() {
+  QMutexLocker locker(&m_mutex);
+  Result result = m_result;
+  m_result.m_matches.clear();
+  m_resultPending = false;
+  return result;
+}
+
+void FindWorker::stop() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopped = true;
+  }
+
+  m_jobAdded.wakeAll();
+}
+
+bool FindWorker::appendResult(int p_id, const QVector<TextFinder::Match> &p_matches,
+                              bool p_finished) {
+  bool needNotify = false;
+  {
+    QMutexLocker locker(&m_mutex);
+    if (p_id != m_jobId || m_stopped) {
+      return false;
+    }
+
+    if (p_matches.isEmpty() && !p_finished) {
+      return true;
+    }
+
+    m_result.m_matches += p_matches;
+    m_result.m_finished = p_finished;
+
+    // The receiver takes all the matches at once.
+    needNotify = !m_resultPending;
+    m_resultPending = true;
+  }
+
+  if (needNotify) {
+    emit resultReady();
+  }
+
+  return true;
+}
+
+void FindWorker::run() {
+  while (true) {
+    Job job;
+    int id = 0;
+
+    {
+      QMutexLocker locker(&m_mutex);
+      while (!m_hasJob && !m_stopped) {
+        m_jobAdded.wait(&m_mutex);
+      }
+
+      if (m_stopped) {
+        return;
+      }
+
+      job = m_job;
+      m_job = Job();
+      m_hasJob = false;
+      id = m_jobId;
+    }
+
+    const auto &text = job.m_text;
+    const int end = (job.m_end < 0 || job.m_end > text.size()) ? text.size() : job.m_end;
+    int pos = qMax(job.m_start, 0);
+    while (true) {
+      // Split chunks at block boundaries since a match never crosses blocks.
+      int chunkEnd = end;
+      if (end - pos > c_chunkSize) {
+        const int idx = text.indexOf(QLatin1Char('\n'), pos + c_chunkSize);
+        if (idx != -1 && idx < end) {
+          chunkEnd = idx + 1;
+        }
+      }
+
+      const bool finished = chunkEnd == end;
+      const auto matches = job.m_finder.findAll(text, pos, chunkEnd);
+      if (!appendResult(id, matches, finished) || finished) {
+        break;
+      }
+
+      pos = chunkEnd;
+    }
+  }
+}
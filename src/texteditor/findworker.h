@@ -0,0 +1,90 @@
+#ifndef FINDWORKER_H
+#define FINDWORKER_H
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "textfinder.h"
+
+namespace vte {
+// Find all matches of a text snapshot on a worker thread.
+// The text is scanned chunk by chunk and matches are handed out as soon as each chunk is done.
+// Call takeResult() to fetch them once resultReady() is emitted.
+class FindWorker : public QThread {
+  Q_OBJECT
+public:
+  struct Result {
+    // Id of the job.
+    int m_id = -1;
+
+    // Matches found since last takeResult(), in ascending order.
+    QVector<TextFinder::Match> m_matches;
+
+    // Whether the job is finished.
+    bool m_finished = false;
+  };
+
+  explicit FindWorker(QObject *p_parent = nullptr);
+
+  ~FindWorker();
+
+  // Find all matches of @p_finder within [@p_start, @p_end) of @p_text.
+  // The job being run will be abandoned.
+  // Return the id of the new job.
+  int find(const TextFinder &p_finder, const QString &p_text, int p_start, int p_end);
+
+  // Abandon current job.
+  void cancel();
+
+  Result takeResult();
+
+signals:
+  // Emitted in the worker thread when there is result to take.
+  void resultReady();
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  struct Job {
+    TextFinder m_finder;
+
+    QString m_text;
+
+    int m_start = 0;
+
+    int m_end = -1;
+  };
+
+  void stop();
+
+  // Return false if @p_id is no longer the current job.
+  bool appendResult(int p_id, const QVector<TextFinder::Match> &p_matches, bool p_finished);
+
+  QMutex m_mutex;
+
+  QWaitCondition m_jobAdded;
+
+  Job m_job;
+
+  bool m_hasJob = false;
+
+  // Id of the latest job.
+  int m_jobId = 0;
+
+  Result m_result;
+
+  // Whether m_result has anything not taken yet.
+  bool m_resultPending = false;
+
+  bool m_stopped = false;
+
+  // Length of text to scan before handing out the matches.
+  static const int c_chunkSize;
+};
+} // namespace vte
+
+#endif // FINDWORKER_H
@@ -8,6 +8,8 @@ using namespace vte;
 
 KSyntaxHighlighting::Repository *KSyntaxHighlighterWrapper::s_repository = nullptr;
 
+QStringList KSyntaxHighlighterWrapper::s_customDefinitionPaths;
+
 QList<KSyntaxHighlighting::Definition>
 KSyntaxHighlighterWrapper::definitionsForFileName(const QString &p_fileName) {
   // TODO: We should be able to override the mappings by config.
@@ -44,11 +46,17 @@ KSyntaxHighlighterWrapper::KSyntaxHighlighterWrapper(ApplyFormatFunc p_applyForm
 
 void KSyntaxHighlighterWrapper::Initialize(const QStringList &p_customDefinitionPaths) {
   if (!s_repository) {
-    s_repository = new KSyntaxHighlighting::Repository();
-    for (const auto &defPath : p_customDefinitionPaths) {
-      s_repository->addCustomSearchPath(defPath);
-    }
+    s_customDefinitionPaths = p_customDefinitionPaths;
+    s_repository = createRepository();
+  }
+}
+
+KSyntaxHighlighting::Repository *KSyntaxHighlighterWrapper::createRepository() {
+  auto repo = new KSyntaxHighlighting::Repository();
+  for (const auto &defPath : s_customDefinitionPaths) {
+    repo->addCustomSearchPath(defPath);
   }
+  return repo;
 }
 
 KSyntaxHighlighting::Repository *KSyntaxHighlighterWrapper::repository() {
@@ -32,6 +32,10 @@ public:
 
   static KSyntaxHighlighting::Repository *repository();
 
+  // Create a repository of the same definitions as repository(), owned by the caller.
+  // Definitions load their data lazily, so a repository should not be shared across threads.
+  static KSyntaxHighlighting::Repository *createRepository();
+
   static KSyntaxHighlighting::Definition definitionForSyntax(const QString &p_syntax);
 
   static KSyntaxHighlighting::Definition definitionForFileName(const QString &p_fileName);
@@ -53,6 +57,8 @@ private:
   ApplyFoldingFunc m_applyFoldingFunc;
 
   static KSyntaxHighlighting::Repository *s_repository;
+
+  static QStringList s_customDefinitionPaths;
 };
 } // namespace vte
 
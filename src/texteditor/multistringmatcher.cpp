@@ -0,0 +1,71 @@
+#include "multistringmatcher.h"
+
+#include <algorithm>
+
+using namespace vte;
+
+typedef QPair<ushort, int> Edge;
+
+static bool edgeLessThan(const Edge &p_edge, ushort p_ch) { return p_edge.first < p_ch; }
+
+MultiStringMatcher::MultiStringMatcher(const QStringList &p_patterns, Qt::CaseSensitivity p_cs)
+    : m_cs(p_cs) {
+  m_nodes.append(Node());
+
+  // Build the trie.
+  for (int i = 0; i < p_patterns.size(); ++i) {
+    const auto &pattern = p_patterns[i];
+    Q_ASSERT(!pattern.isEmpty());
+    int node = 0;
+    for (const auto &c : pattern) {
+      const ushort ch = normalize(c);
+      int next = child(node, ch);
+      if (next == -1) {
+        next = m_nodes.size();
+        auto &children = m_nodes[node].m_children;
+        auto it = std::lower_bound(children.begin(), children.end(), ch, edgeLessThan);
+        children.insert(it, Edge(ch, next));
+        m_nodes.append(Node());
+      }
+
+      node = next;
+    }
+
+    m_nodes[node].m_patterns.append(i);
+    m_patternLengths.append(pattern.size());
+    m_maximumPatternLength = qMax(m_maximumPatternLength, pattern.size());
+  }
+
+  // Build fail links in BFS order.
+  QVector<int> queue;
+  for (const auto &edge : m_nodes[0].m_children) {
+    queue.append(edge.second);
+  }
+
+  for (int i = 0; i < queue.size(); ++i) {
+    const int node = queue[i];
+    for (const auto &edge : m_nodes[node].m_children) {
+      int fail = m_nodes[node].m_fail;
+      int target = child(fail, edge.first);
+      while (target == -1 && fail != 0) {
+        fail = m_nodes[fail].m_fail;
+        target = child(fail, edge.first);
+      }
+
+      auto &next = m_nodes[edge.second];
+      next.m_fail = target == -1 ? 0 : target;
+      const auto &failNode = m_nodes[next.m_fail];
+      next.m_outputLink = failNode.m_patterns.isEmpty() ? failNode.m_outputLink : next.m_fail;
+      queue.append(edge.second);
+    }
+  }
+}
+
+int MultiStringMatcher::child(int p_node, ushort p_ch) const {
+  const auto &children = m_nodes[p_node].m_children;
+  auto it = std::lower_bound(children.constBegin(), children.constEnd(), p_ch, edgeLessThan);
+  if (it != children.constEnd() && it->first == p_ch) {
+    return it->second;
+  }
+  return -1;
+}
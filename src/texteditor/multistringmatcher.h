@@ -0,0 +1,96 @@
+#ifndef MULTISTRINGMATCHER_H
+#define MULTISTRINGMATCHER_H
+
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+namespace vte {
+// Find occurrences of multiple strings in one pass via the Aho-Corasick automaton.
+// The cost is O(text + occurrences) regardless of the number of patterns.
+class MultiStringMatcher {
+public:
+  MultiStringMatcher() = default;
+
+  // Empty patterns are not allowed.
+  MultiStringMatcher(const QStringList &p_patterns, Qt::CaseSensitivity p_cs);
+
+  int size() const { return m_patternLengths.size(); }
+
+  int patternLength(int p_idx) const { return m_patternLengths[p_idx]; }
+
+  int maximumPatternLength() const { return m_maximumPatternLength; }
+
+  // Call @p_func(patternIndex, start) for each occurrence within [@p_start, @p_end) of @p_text,
+  // including overlapping ones, in the order of the end of occurrences.
+  template <typename T>
+  void forEachMatch(const QChar *p_text, int p_start, int p_end, T p_func) const;
+
+private:
+  struct Node {
+    // Children sorted by the char.
+    QVector<QPair<ushort, int>> m_children;
+
+    // Longest proper suffix in the trie.
+    int m_fail = 0;
+
+    // Patterns ending at this node.
+    QVector<int> m_patterns;
+
+    // Nearest node with patterns in the fail chain, or -1.
+    int m_outputLink = -1;
+  };
+
+  int child(int p_node, ushort p_ch) const;
+
+  ushort normalize(QChar p_ch) const {
+    return m_cs == Qt::CaseSensitive ? p_ch.unicode() : p_ch.toCaseFolded().unicode();
+  }
+
+  Qt::CaseSensitivity m_cs = Qt::CaseSensitive;
+
+  // The first node is the root.
+  QVector<Node> m_nodes;
+
+  QVector<int> m_patternLengths;
+
+  int m_maximumPatternLength = 0;
+};
+
+template <typename T>
+void MultiStringMatcher::forEachMatch(const QChar *p_text, int p_start, int p_end,
+                                      T p_func) const {
+  if (m_nodes.isEmpty()) {
+    return;
+  }
+
+  int state = 0;
+  for (int i = p_start; i < p_end; ++i) {
+    const ushort ch = normalize(p_text[i]);
+    while (true) {
+      const int next = child(state, ch);
+      if (next != -1) {
+        state = next;
+        break;
+      }
+
+      if (state == 0) {
+        break;
+      }
+
+      state = m_nodes[state].m_fail;
+    }
+
+    int node = m_nodes[state].m_patterns.isEmpty() ? m_nodes[state].m_outputLink : state;
+    while (node != -1) {
+      for (int pattern : m_nodes[node].m_patterns) {
+        p_func(pattern, i + 1 - m_patternLengths[pattern]);
+      }
+
+      node = m_nodes[node].m_outputLink;
+    }
+  }
+}
+} // namespace vte
+
+#endif // MULTISTRINGMATCHER_H
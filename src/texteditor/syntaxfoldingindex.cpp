@@ -0,0 +1,135 @@
+#include "syntaxfoldingindex.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include <vtextedit/textblockdata.h>
+
+using namespace vte;
+
+SyntaxFoldingIndex::SyntaxFoldingIndex(QTextDocument *p_doc) : m_document(p_doc) {}
+
+void SyntaxFoldingIndex::invalidate(int p_blockNumber) {
+  // Truncate lazily since blocks are usually rehighlighted one by one.
+  m_dirtyBlockNumber = qMin(m_dirtyBlockNumber, qMax(p_blockNumber, 0));
+}
+
+int SyntaxFoldingIndex::scannedBlockCount() const { return m_startFoldings.size(); }
+
+void SyntaxFoldingIndex::truncate() {
+  const int blockNumber = m_dirtyBlockNumber;
+  m_dirtyBlockNumber = INT_MAX;
+  if (blockNumber >= scannedBlockCount()) {
+    return;
+  }
+
+  m_openFoldings.resize(m_firstOpenFoldings[blockNumber]);
+  m_firstOpenFoldings.resize(blockNumber);
+  m_startFoldings.resize(blockNumber);
+
+  // Restore the stacks before @blockNumber. Open foldings closed after it are pending again.
+  m_pendingFoldings.clear();
+  for (int i = 0; i < m_openFoldings.size(); ++i) {
+    auto &folding = m_openFoldings[i];
+    if (folding.m_closeBlockNumber >= blockNumber) {
+      folding.m_closeBlockNumber = -1;
+    }
+
+    if (folding.m_closeBlockNumber == -1) {
+      m_pendingFoldings[folding.m_type].push_back(i);
+    }
+  }
+}
+
+int SyntaxFoldingIndex::findFoldingEnd(int p_blockNumber) {
+  if (p_blockNumber < 0 || p_blockNumber >= m_document->blockCount()) {
+    return -1;
+  }
+
+  truncate();
+  scan(p_blockNumber);
+  if (p_blockNumber >= scannedBlockCount()) {
+    return -1;
+  }
+
+  const int idx = m_startFoldings[p_blockNumber];
+  if (idx == -1) {
+    return -1;
+  }
+
+  const int closeBlockNumber = m_openFoldings[idx].m_closeBlockNumber;
+  return closeBlockNumber == -1 ? m_document->blockCount() : closeBlockNumber;
+}
+
+void SyntaxFoldingIndex::scan(int p_blockNumber) {
+  auto isResolved = [this, p_blockNumber]() {
+    if (p_blockNumber >= scannedBlockCount()) {
+      return false;
+    }
+
+    const int idx = m_startFoldings[p_blockNumber];
+    return idx == -1 || m_openFoldings[idx].m_closeBlockNumber != -1;
+  };
+
+  if (isResolved()) {
+    return;
+  }
+
+  auto block = m_document->findBlockByNumber(scannedBlockCount());
+  while (block.isValid()) {
+    scanBlock(block);
+    if (isResolved()) {
+      break;
+    }
+    block = block.next();
+  }
+}
+
+void SyntaxFoldingIndex::scanBlock(const QTextBlock &p_block) {
+  const int blockNumber = scannedBlockCount();
+  Q_ASSERT(p_block.blockNumber() == blockNumber);
+
+  const int first = m_openFoldings.size();
+  m_firstOpenFoldings.push_back(first);
+
+  auto data = TextBlockData::get(p_block);
+  for (const auto &folding : data->getFoldings()) {
+    if (folding.isOpen()) {
+      OpenFolding openFolding;
+      openFolding.m_blockNumber = blockNumber;
+      openFolding.m_offset = folding.m_offset;
+      openFolding.m_type = folding.m_value;
+      m_pendingFoldings[folding.m_value].push_back(m_openFoldings.size());
+      m_openFoldings.push_back(openFolding);
+    } else {
+      // A close folding matches the last pending open folding of the same id.
+      auto it = m_pendingFoldings.find(-folding.m_value);
+      if (it != m_pendingFoldings.end() && !it.value().isEmpty()) {
+        m_openFoldings[it.value().takeLast()].m_closeBlockNumber = blockNumber;
+      }
+    }
+  }
+
+  // The folding starting on this block is of the id of the first pending open folding. It is
+  // closed by the first unmatched close folding of that id after this block, which matches the
+  // last pending open folding of that id within this block.
+  int startType = 0;
+  int startOffset = -1;
+  for (int i = first; i < m_openFoldings.size(); ++i) {
+    const auto &folding = m_openFoldings[i];
+    if (folding.m_closeBlockNumber == -1 && (startOffset == -1 || folding.m_offset < startOffset)) {
+      startType = folding.m_type;
+      startOffset = folding.m_offset;
+    }
+  }
+
+  int startIdx = -1;
+  for (int i = m_openFoldings.size() - 1; i >= first && startType != 0; --i) {
+    const auto &folding = m_openFoldings[i];
+    if (folding.m_closeBlockNumber == -1 && folding.m_type == startType) {
+      startIdx = i;
+      break;
+    }
+  }
+  m_startFoldings.push_back(startIdx);
+}
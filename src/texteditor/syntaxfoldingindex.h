@@ -0,0 +1,71 @@
+#ifndef SYNTAXFOLDINGINDEX_H
+#define SYNTAXFOLDINGINDEX_H
+
+#include <climits>
+
+#include <QHash>
+#include <QVector>
+
+class QTextBlock;
+class QTextDocument;
+
+namespace vte {
+// Index of the block closing the syntax folding starting on each block, paired by a stack-based
+// pass over the syntax foldings of TextBlockData.
+// Blocks are scanned lazily on lookup and rescanned from the first rehighlighted block.
+class SyntaxFoldingIndex {
+public:
+  explicit SyntaxFoldingIndex(QTextDocument *p_doc);
+
+  // Syntax foldings of block @p_blockNumber changed, which may also change the block numbers
+  // after it.
+  void invalidate(int p_blockNumber);
+
+  // Return the number of the block closing the first pending open folding of @p_blockNumber.
+  // Return -1 if there is no pending open folding.
+  // Return the block count if it is not closed.
+  int findFoldingEnd(int p_blockNumber);
+
+private:
+  struct OpenFolding {
+    int m_blockNumber = -1;
+
+    int m_offset = 0;
+
+    // Folding id.
+    int m_type = 0;
+
+    // Block of the matched close folding, -1 if pending.
+    int m_closeBlockNumber = -1;
+  };
+
+  // Drop results from m_dirtyBlockNumber.
+  void truncate();
+
+  // Scan blocks until the folding starting on @p_blockNumber is closed or the end.
+  void scan(int p_blockNumber);
+
+  void scanBlock(const QTextBlock &p_block);
+
+  int scannedBlockCount() const;
+
+  QTextDocument *m_document = nullptr;
+
+  // Open foldings of scanned blocks in document order.
+  QVector<OpenFolding> m_openFoldings;
+
+  // Index in m_openFoldings of the first open folding of each scanned block.
+  QVector<int> m_firstOpenFoldings;
+
+  // Index in m_openFoldings of the folding starting on each scanned block, or -1.
+  QVector<int> m_startFoldings;
+
+  // Open foldings pending after the scanned blocks per folding id, which act as the stacks.
+  QHash<int, QVector<int>> m_pendingFoldings;
+
+  // Blocks from this one need to be rescanned.
+  int m_dirtyBlockNumber = INT_MAX;
+};
+} // namespace vte
+
+#endif // SYNTAXFOLDINGINDEX_H
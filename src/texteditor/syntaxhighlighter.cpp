@@ -11,9 +11,6 @@
 #include "ksyntaxhighlighterwrapper.h"
 #include <vtextedit/textblockdata.h>
 
-#include "blockspellcheckdata.h"
-#include <spellcheck/spellcheckhighlighthelper.h>
-
 #include <utils/utils.h>
 
 using namespace vte;
@@ -27,7 +24,7 @@ static KSyntaxHighlighting::Repository *repository() {
 
 SyntaxHighlighter::SyntaxHighlighter(QTextDocument *p_doc, const QString &p_theme,
                                      const QString &p_syntax)
-    : VSyntaxHighlighter(p_doc) {
+    : VSyntaxHighlighter(p_doc), m_foldingIndex(p_doc) {
   auto def = KSyntaxHighlighterWrapper::definitionForSyntax(p_syntax);
   if (def.isValid()) {
     qDebug() << "use definition" << def.name() << "to highlight for syntax" << p_syntax;
@@ -56,6 +53,7 @@ void SyntaxHighlighter::highlightBlock(const QString &p_text) {
   }
 
   auto block = currentBlock();
+  m_foldingIndex.invalidate(block.blockNumber());
 
   auto data = TextBlockData::get(block);
   // Clean up.
@@ -74,16 +72,7 @@ void SyntaxHighlighter::highlightBlock(const QString &p_text) {
   }
 
   // Do spell check.
-  if (!p_text.isEmpty() && m_spellCheckEnabled) {
-    bool ret = SpellCheckHighlightHelper::checkBlock(block, p_text, m_autoDetectLanguageEnabled);
-    if (ret) {
-      // Further check and highlight.
-      auto spellData = data->getBlockSpellCheckData();
-      if (spellData && spellData->isValid(block.revision()) && !spellData->isEmpty()) {
-        VSyntaxHighlighter::highlightMisspell(spellData);
-      }
-    }
-  }
+  highlightSpellCheck(p_text);
 
   // Store the state.
   const auto nextBlock = block.next();
@@ -147,3 +136,7 @@ bool SyntaxHighlighter::isValidSyntax(const QString &p_syntax) {
 }
 
 bool SyntaxHighlighter::isSyntaxFoldingEnabled() const { return true; }
+
+int SyntaxHighlighter::findSyntaxFoldingEnd(int p_blockNumber) {
+  return m_foldingIndex.findFoldingEnd(p_blockNumber);
+}
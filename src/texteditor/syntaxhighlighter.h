@@ -9,6 +9,7 @@
 #include <QSharedPointer>
 
 #include "formatcache.h"
+#include "syntaxfoldingindex.h"
 
 namespace vte {
 struct BlockSpellCheckData;
@@ -23,6 +24,8 @@ public:
 
   bool isSyntaxFoldingEnabled() const Q_DECL_OVERRIDE;
 
+  int findSyntaxFoldingEnd(int p_blockNumber) Q_DECL_OVERRIDE;
+
   static bool isValidSyntax(const QString &p_syntax);
 
 protected:
@@ -39,6 +42,9 @@ private:
   QHash<int, int> m_pendingFoldingStart;
 
   FormatCache m_formatCache;
+
+  // Pairs of syntax folding regions.
+  SyntaxFoldingIndex m_foldingIndex;
 };
 } // namespace vte
 
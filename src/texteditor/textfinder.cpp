@@ -0,0 +1,390 @@
+#include "textfinder.h"
+
+#include <algorithm>
+#include <deque>
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+using namespace vte;
+
+TextFinder::TextFinder(const QStringList &p_texts, FindFlags p_flags) : m_flags(p_flags) {
+  const auto cs = (p_flags & FindFlag::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  QStringList literals;
+  for (const auto &text : p_texts) {
+    if (text.isEmpty()) {
+      continue;
+    }
+
+    if (p_flags & FindFlag::RegularExpression) {
+      QRegularExpression regExp(text, cs == Qt::CaseSensitive
+                                          ? QRegularExpression::NoPatternOption
+                                          : QRegularExpression::CaseInsensitiveOption);
+      if (!regExp.isValid()) {
+        continue;
+      }
+
+      // Compile it once for all the blocks.
+      regExp.optimize();
+      m_regExps.append(regExp);
+    } else {
+      if (text.contains(QLatin1Char('\n'))) {
+        // Could not match within one block.
+        continue;
+      }
+
+      literals.append(text);
+    }
+  }
+
+  if (literals.size() == 1) {
+    m_matchers.append(QStringMatcher(literals.first(), cs));
+  } else if (literals.size() > 1) {
+    m_multiMatcher = MultiStringMatcher(literals, cs);
+  }
+}
+
+bool TextFinder::isValid() const {
+  return !m_matchers.isEmpty() || m_multiMatcher.size() > 0 || !m_regExps.isEmpty();
+}
+
+QVector<TextFinder::Match> TextFinder::findAll(const QString &p_text, int p_start,
+                                               int p_end) const {
+  QVector<Match> matches;
+  if (p_end < 0 || p_end > p_text.size()) {
+    p_end = p_text.size();
+  }
+  p_start = qMax(p_start, 0);
+  if (p_start > p_end) {
+    return matches;
+  }
+
+  for (const auto &matcher : m_matchers) {
+    findAll(matcher, p_text, p_start, p_end, matches);
+  }
+
+  if (m_multiMatcher.size() > 0) {
+    findAll(m_multiMatcher, p_text, p_start, p_end, matches);
+  }
+
+  for (const auto &regExp : m_regExps) {
+    findAll(regExp, p_text, p_start, p_end, matches);
+  }
+
+  if (m_regExps.size() > 1) {
+    std::sort(matches.begin(), matches.end());
+  }
+
+  return matches;
+}
+
+bool TextFinder::updateMatches(QVector<Match> &p_matches, const QTextDocument *p_doc,
+                               int p_position, int p_charsRemoved, int p_charsAdded,
+                               int *p_trackedIndex) const {
+  // A match never crosses blocks, so re-find the blocks covering the change. Since the texts
+  // before and after the change are kept, these blocks are also aligned with blocks before
+  // the change. Lookaround of regular expression is limited within blocks, too.
+  const int delta = p_charsAdded - p_charsRemoved;
+  const int textLength = p_doc->characterCount() - 1;
+  const auto firstBlock = p_doc->findBlock(p_position);
+  const auto lastBlock = p_doc->findBlock(qMin(p_position + p_charsAdded, textLength));
+  if (!firstBlock.isValid() || !lastBlock.isValid()) {
+    return false;
+  }
+
+  const int rangeStart = firstBlock.position();
+  const int rangeEnd = qMin(lastBlock.position() + lastBlock.length(), textLength);
+
+  // Matches within [rangeStart, rangeEnd - delta) before the change are replaced.
+  const int first = std::lower_bound(p_matches.constBegin(), p_matches.constEnd(),
+                                     Match(rangeStart, rangeStart)) -
+                    p_matches.constBegin();
+  int last = p_matches.size();
+  if (rangeEnd < textLength) {
+    const int oldRangeEnd = rangeEnd - delta;
+    last = std::lower_bound(p_matches.constBegin() + first, p_matches.constEnd(),
+                            Match(oldRangeEnd, oldRangeEnd)) -
+           p_matches.constBegin();
+  }
+
+  // Same as QTextDocument::toPlainText().
+  auto rangeText = blocksText(firstBlock, lastBlock);
+  rangeText.replace(QChar::Nbsp, QLatin1Char(' '));
+
+  auto newMatches = findAll(rangeText);
+  for (auto &match : newMatches) {
+    match.m_start += rangeStart;
+    match.m_end += rangeStart;
+  }
+
+  for (int i = last; i < p_matches.size(); ++i) {
+    p_matches[i].m_start += delta;
+    p_matches[i].m_end += delta;
+  }
+
+  p_matches.remove(first, last - first);
+  p_matches.insert(first, newMatches.size(), Match());
+  std::copy(newMatches.constBegin(), newMatches.constEnd(), p_matches.begin() + first);
+
+  if (p_trackedIndex) {
+    if (*p_trackedIndex >= last) {
+      *p_trackedIndex += newMatches.size() - (last - first);
+    } else if (*p_trackedIndex >= first) {
+      *p_trackedIndex = -1;
+    }
+  }
+
+  return true;
+}
+
+// Literal text followed by a back reference.
+struct ReplacePiece {
+  QString m_text;
+
+  // -1 for no back reference.
+  int m_capture = -1;
+};
+
+// Split @p_replaceText by back references the same as QString::replace(), that is \1 to \99
+// limited by @p_captureCount.
+static QVector<ReplacePiece> parseReplaceText(const QString &p_replaceText, int p_captureCount) {
+  QVector<ReplacePiece> pieces(1);
+  const int len = p_replaceText.size();
+  for (int i = 0; i < len; ++i) {
+    const auto ch = p_replaceText.at(i);
+    if (ch == QLatin1Char('\\') && i + 1 < len) {
+      int no = p_replaceText.at(i + 1).digitValue();
+      if (no > 0 && no <= p_captureCount) {
+        ++i;
+        if (i + 1 < len) {
+          const int secondDigit = p_replaceText.at(i + 1).digitValue();
+          if (secondDigit != -1 && no * 10 + secondDigit <= p_captureCount) {
+            no = no * 10 + secondDigit;
+            ++i;
+          }
+        }
+
+        pieces.last().m_capture = no;
+        pieces.append(ReplacePiece());
+        continue;
+      }
+    }
+
+    pieces.last().m_text.append(ch);
+  }
+
+  return pieces;
+}
+
+QString TextFinder::replace(const QString &p_text, const QVector<Match> &p_matches,
+                            const QString &p_replaceText, int p_start, int p_end) const {
+  // Resolve back references once instead of for each match.
+  const QRegularExpression *regExp = nullptr;
+  QVector<ReplacePiece> pieces;
+  if (m_regExps.size() == 1) {
+    pieces = parseReplaceText(p_replaceText, m_regExps.first().captureCount());
+    if (pieces.size() > 1) {
+      regExp = &m_regExps.first();
+    }
+  }
+
+  // Matches are found with nbsp as space.
+  QString subject;
+  if (regExp) {
+    subject = p_text;
+    subject.replace(QChar::Nbsp, QLatin1Char(' '));
+  }
+
+  QString result;
+  result.reserve(p_end - p_start);
+  int pos = p_start;
+  for (const auto &match : p_matches) {
+    if (match.m_start < pos || match.m_end > p_end) {
+      continue;
+    }
+
+    result.append(p_text.constData() + pos, match.m_start - pos);
+    pos = match.m_end;
+
+    if (!regExp) {
+      result.append(p_replaceText);
+      continue;
+    }
+
+    // Match again within the block to get the captures. It gets the same match since there is
+    // no match between the search offset and the match start when it was found.
+    const int blockStart =
+        match.m_start > 0 ? subject.lastIndexOf(QLatin1Char('\n'), match.m_start - 1) + 1 : 0;
+    int blockEnd = subject.indexOf(QLatin1Char('\n'), match.m_start);
+    if (blockEnd == -1) {
+      blockEnd = subject.size();
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 2))
+    const auto blockText = QStringView(subject).mid(blockStart, blockEnd - blockStart);
+#else
+    const auto blockText = subject.mid(blockStart, blockEnd - blockStart);
+#endif
+    const auto regMatch = regExp->match(blockText, match.m_start - blockStart);
+    const bool matched = regMatch.hasMatch() &&
+                         regMatch.capturedStart() + blockStart == match.m_start &&
+                         regMatch.capturedEnd() + blockStart == match.m_end;
+    for (const auto &piece : pieces) {
+      result.append(piece.m_text);
+      if (matched && piece.m_capture > 0) {
+        const int capturedStart = regMatch.capturedStart(piece.m_capture);
+        if (capturedStart != -1) {
+          result.append(p_text.constData() + blockStart + capturedStart,
+                        regMatch.capturedLength(piece.m_capture));
+        }
+      }
+    }
+  }
+
+  result.append(p_text.constData() + pos, p_end - pos);
+  return result;
+}
+
+QString TextFinder::blocksText(const QTextBlock &p_first, const QTextBlock &p_last) {
+  QString text;
+  for (auto block = p_first; block.isValid(); block = block.next()) {
+    if (block != p_first) {
+      text += QLatin1Char('\n');
+    }
+    text += block.text();
+    if (block == p_last) {
+      break;
+    }
+  }
+  return text;
+}
+
+void TextFinder::findAll(const QStringMatcher &p_matcher, const QString &p_text, int p_start,
+                         int p_end, QVector<Match> &p_matches) const {
+  const int len = p_matcher.pattern().size();
+  int pos = p_start;
+  while (true) {
+    // Limit the length so that matches beyond @p_end will not be scanned.
+    const int idx = p_matcher.indexIn(p_text.constData(), p_end, pos);
+    if (idx == -1) {
+      break;
+    }
+
+    if (!checkWholeWord(p_text, idx, idx + len)) {
+      pos = idx + 1;
+      continue;
+    }
+
+    p_matches.append(Match(idx, idx + len));
+    pos = idx + len;
+  }
+}
+
+void TextFinder::findAll(const MultiStringMatcher &p_matcher, const QString &p_text, int p_start,
+                         int p_end, QVector<Match> &p_matches) const {
+  // Each pattern does not overlap itself, the same as finding the patterns one by one.
+  QVector<int> nextStarts(p_matcher.size(), p_start);
+
+  // Occurrences come in the order of their end. Hold them until no later occurrence could
+  // start before them, so that the matches come out in order without sorting.
+  const int maxLen = p_matcher.maximumPatternLength();
+  std::deque<Match> pendingMatches;
+
+  p_matcher.forEachMatch(
+      p_text.constData(), p_start, p_end, [&](int p_pattern, int p_matchStart) {
+        const int matchEnd = p_matchStart + p_matcher.patternLength(p_pattern);
+        if (p_matchStart < nextStarts[p_pattern] ||
+            !checkWholeWord(p_text, p_matchStart, matchEnd)) {
+          return;
+        }
+
+        nextStarts[p_pattern] = matchEnd;
+
+        // Later occurrences will start at (matchEnd - maxLen) at least.
+        while (!pendingMatches.empty() && pendingMatches.front().m_start <= matchEnd - maxLen) {
+          p_matches.append(pendingMatches.front());
+          pendingMatches.pop_front();
+        }
+
+        const Match match(p_matchStart, matchEnd);
+        auto it = pendingMatches.end();
+        while (it != pendingMatches.begin() && match < *(it - 1)) {
+          --it;
+        }
+        pendingMatches.insert(it, match);
+      });
+
+  for (const auto &match : pendingMatches) {
+    p_matches.append(match);
+  }
+}
+
+void TextFinder::findAll(const QRegularExpression &p_regExp, const QString &p_text, int p_start,
+                         int p_end, QVector<Match> &p_matches) const {
+  // Zero-length match at the end of the text is allowed, such as `$`.
+  const bool toEnd = p_end == p_text.size();
+  auto isBeforeEnd = [p_end, toEnd](int p_pos) {
+    return p_pos < p_end || (toEnd && p_pos == p_end);
+  };
+
+  // Match block by block so that ^, $ and lookaround work the same as QTextDocument::find().
+  int blockStart = p_start > 0 ? p_text.lastIndexOf(QLatin1Char('\n'), p_start - 1) + 1 : 0;
+  while (isBeforeEnd(blockStart)) {
+    int blockEnd = p_text.indexOf(QLatin1Char('\n'), blockStart);
+    if (blockEnd == -1) {
+      blockEnd = p_text.size();
+    }
+
+    const int blockLen = blockEnd - blockStart;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 2))
+    const auto blockText = QStringView(p_text).mid(blockStart, blockLen);
+#else
+    const auto blockText = p_text.mid(blockStart, blockLen);
+#endif
+
+    int offset = qMax(p_start - blockStart, 0);
+    while (offset <= blockLen) {
+      const auto match = p_regExp.match(blockText, offset);
+      if (!match.hasMatch()) {
+        break;
+      }
+
+      const int start = blockStart + match.capturedStart();
+      const int end = blockStart + match.capturedEnd();
+      if (end > p_end || !isBeforeEnd(start)) {
+        return;
+      }
+
+      if (!checkWholeWord(p_text, start, end)) {
+        offset = match.capturedStart() + 1;
+        continue;
+      }
+
+      p_matches.append(Match(start, end));
+
+      offset = match.capturedEnd();
+      if (start == end) {
+        // Zero-length match, such as ^ and $.
+        ++offset;
+      }
+    }
+
+    blockStart = blockEnd + 1;
+  }
+}
+
+bool TextFinder::checkWholeWord(const QString &p_text, int p_start, int p_end) const {
+  if (!(m_flags & FindFlag::WholeWordOnly)) {
+    return true;
+  }
+
+  // Same as QTextDocument::find().
+  if (p_start > 0 && p_text.at(p_start - 1).isLetterOrNumber()) {
+    return false;
+  }
+
+  if (p_end < p_text.size() && p_text.at(p_end).isLetterOrNumber()) {
+    return false;
+  }
+
+  return true;
+}
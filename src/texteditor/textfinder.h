@@ -0,0 +1,99 @@
+#ifndef TEXTFINDER_H
+#define TEXTFINDER_H
+
+#include <QRegularExpression>
+#include <QStringList>
+#include <QStringMatcher>
+#include <QVector>
+
+#include <vtextedit/global.h>
+
+#include "multistringmatcher.h"
+
+class QTextBlock;
+class QTextDocument;
+
+namespace vte {
+// Find texts within a plain text snapshot of a document, such as QTextDocument::toPlainText().
+// Blocks are separated by '\n' and a match never crosses blocks, which is consistent with
+// QTextDocument::find().
+// Matches are plain offsets so it could be used in a non-GUI thread.
+class TextFinder {
+public:
+  struct Match {
+    Match() = default;
+
+    Match(int p_start, int p_end) : m_start(p_start), m_end(p_end) {}
+
+    bool operator==(const Match &p_other) const {
+      return m_start == p_other.m_start && m_end == p_other.m_end;
+    }
+
+    bool operator<(const Match &p_other) const {
+      return m_start < p_other.m_start || (m_start == p_other.m_start && m_end < p_other.m_end);
+    }
+
+    // [m_start, m_end).
+    int m_start = 0;
+    int m_end = 0;
+  };
+
+  TextFinder() = default;
+
+  // Empty texts are ignored.
+  TextFinder(const QStringList &p_texts, FindFlags p_flags);
+
+  // Whether there is any pattern to find.
+  bool isValid() const;
+
+  // Find all matches starting within [@p_start, @p_end) and ending before @p_end.
+  // @p_end, -1 indicates the end of @p_text.
+  // Return matches in ascending order.
+  QVector<Match> findAll(const QString &p_text, int p_start = 0, int p_end = -1) const;
+
+  // Update @p_matches of the whole @p_doc after a contents change of @p_doc.
+  // Only the blocks covering the change are re-found and the rest matches are shifted.
+  // @p_trackedIndex: an index of @p_matches to update, which will be -1 if that match is
+  // re-found.
+  // Return false if failed and @p_matches should be re-found as a whole.
+  bool updateMatches(QVector<Match> &p_matches, const QTextDocument *p_doc, int p_position,
+                     int p_charsRemoved, int p_charsAdded, int *p_trackedIndex = nullptr) const;
+
+  // Build the text of [@p_start, @p_end) of @p_text with @p_matches replaced by @p_replaceText
+  // in one pass. @p_matches should be found in @p_text and be in ascending order. Matches
+  // overlapping previous ones or out of the range are skipped.
+  // For one regular expression, back references like \1 in @p_replaceText are resolved, which
+  // requires @p_text to contain the whole blocks of @p_matches.
+  QString replace(const QString &p_text, const QVector<Match> &p_matches,
+                  const QString &p_replaceText, int p_start, int p_end) const;
+
+  // Texts of blocks [@p_first, @p_last] joined by '\n', the same as QTextDocument::toPlainText()
+  // except that nbsp is kept.
+  static QString blocksText(const QTextBlock &p_first, const QTextBlock &p_last);
+
+private:
+  void findAll(const QStringMatcher &p_matcher, const QString &p_text, int p_start, int p_end,
+               QVector<Match> &p_matches) const;
+
+  void findAll(const MultiStringMatcher &p_matcher, const QString &p_text, int p_start, int p_end,
+               QVector<Match> &p_matches) const;
+
+  void findAll(const QRegularExpression &p_regExp, const QString &p_text, int p_start, int p_end,
+               QVector<Match> &p_matches) const;
+
+  // Whether [@p_start, @p_end) of @p_text is a whole word if needed.
+  bool checkWholeWord(const QString &p_text, int p_start, int p_end) const;
+
+  FindFlags m_flags = FindFlag::None;
+
+  // Used when there is only one literal pattern.
+  QVector<QStringMatcher> m_matchers;
+
+  // Used when there are multiple literal patterns.
+  MultiStringMatcher m_multiMatcher;
+
+  QVector<QRegularExpression> m_regExps;
+};
+} // namespace vte
+
+#endif // TEXTFINDER_H
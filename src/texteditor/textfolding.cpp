@@ -212,6 +212,10 @@ bool TextFolding::compareRangeByStartBeforeBlock(const FoldingRange *p_range, in
   return p_range->first() < p_blockNumber;
 }
 
+bool TextFolding::compareRangeByEndBeforeBlock(const FoldingRange *p_range, int p_blockNumber) {
+  return p_range->last() < p_blockNumber;
+}
+
 bool TextFolding::compareRangeByStartAfterBlock(int p_blockNumber, const FoldingRange *p_range) {
   return p_blockNumber < p_range->first();
 }
@@ -255,6 +259,7 @@ void TextFolding::updateFoldedRangesForNewRange(TextFolding::FoldingRange *p_new
   }
 
   m_foldedFoldingRanges = foldedFoldingRanges;
+  updateHiddenLines();
 
   setRangeFolded(p_newRange->m_range, true);
 }
@@ -287,6 +292,18 @@ void TextFolding::updateFoldedRangesForRemovedRange(TextFolding::FoldingRange *p
   }
 
   m_foldedFoldingRanges = foldedFoldingRanges;
+  updateHiddenLines();
+}
+
+void TextFolding::updateHiddenLines() {
+  const int cnt = m_foldedFoldingRanges.size();
+  m_hiddenLinesBefore.resize(cnt + 1);
+  m_hiddenLinesBefore[0] = 0;
+  for (int i = 0; i < cnt; ++i) {
+    const auto range = m_foldedFoldingRanges[i];
+    const int hiddenLines = range->isValid() ? range->last() - range->first() : 0;
+    m_hiddenLinesBefore[i + 1] = m_hiddenLinesBefore[i] + hiddenLines;
+  }
 }
 
 QVector<QPair<qint64, TextFolding::FoldingRangeFlags>>
@@ -535,6 +552,10 @@ void TextFolding::checkAndUpdateFoldings() {
   }
 
   bool needUpdate = checkAndUpdateFoldings(m_foldingRanges);
+
+  // Edits may change the lines of folded ranges.
+  updateHiddenLines();
+
   if (needUpdate) {
     markDocumentContentsDirty();
     emit foldingRangesChanged();
@@ -661,23 +682,20 @@ int TextFolding::lineToVisibleLine(int p_line) const {
     return 0;
   }
 
-  // visible line - line.
-  int delta = 0;
-  for (const auto &range : m_foldedFoldingRanges) {
-    Q_ASSERT(range->isValid());
-    if (p_line <= range->first()) {
-      return p_line + delta;
-    } else if (p_line <= range->last()) {
-      // Locate within the folded range.
-      delta += (range->first() - p_line);
-      return p_line + delta;
-    } else {
-      delta += (range->first() - range->last());
-    }
+  // Find the first folded range ending at or after @p_line.
+  // Folded ranges are sorted and non-overlapping, so their ends are ascending.
+  const int idx = std::lower_bound(m_foldedFoldingRanges.begin(), m_foldedFoldingRanges.end(),
+                                   p_line, compareRangeByEndBeforeBlock) -
+                  m_foldedFoldingRanges.begin();
+  if (idx == m_foldedFoldingRanges.size()) {
+    // @p_line goes through all the folded folding ranges.
+    return qMin(p_line, m_document->blockCount() - 1) - m_hiddenLinesBefore[idx];
   }
 
-  // @p_line goes through all the folded folding ranges.
-  return qMin(p_line, m_document->blockCount() - 1) + delta;
+  const auto range = m_foldedFoldingRanges[idx];
+  Q_ASSERT(range->isValid());
+  // Lines within the folded range locate at its first line.
+  return qMin(p_line, range->first()) - m_hiddenLinesBefore[idx];
 }
 
 int TextFolding::visibleLineToLine(int p_line) const {
@@ -688,21 +706,23 @@ int TextFolding::visibleLineToLine(int p_line) const {
     return 0;
   }
 
-  // line - visual line.
-  int delta = 0;
-  for (const auto &range : m_foldedFoldingRanges) {
-    Q_ASSERT(range->isValid());
-    // Visual line for this range.
-    int visualLine = range->first() - delta;
-    if (visualLine >= p_line) {
-      return p_line + delta;
+  // Find the first folded range whose visual line is not before @p_line.
+  // Visual lines of folded ranges are ascending.
+  int low = 0;
+  int high = m_foldedFoldingRanges.size();
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    Q_ASSERT(m_foldedFoldingRanges[mid]->isValid());
+    const int visualLine = m_foldedFoldingRanges[mid]->first() - m_hiddenLinesBefore[mid];
+    if (visualLine < p_line) {
+      low = mid + 1;
     } else {
-      delta += (range->last() - range->first());
+      high = mid;
     }
   }
 
-  // @p_line goes through all the folded folding ranges.
-  return qMin(p_line + delta, m_document->blockCount() - 1);
+  // @p_line may go through all the folded folding ranges.
+  return qMin(p_line + m_hiddenLinesBefore[low], m_document->blockCount() - 1);
 }
 
 void TextFolding::setEnabled(bool p_enable) {
@@ -122,6 +122,9 @@ private:
 
   void updateFoldedRangesForRemovedRange(TextFolding::FoldingRange *p_oldRange);
 
+  // Update m_hiddenLinesBefore from m_foldedFoldingRanges.
+  void updateHiddenLines();
+
   void foldingRangesStartingOnBlock(const TextFolding::FoldingRange::Vector &p_ranges,
                                     int p_blockNumber,
                                     QVector<QPair<qint64, FoldingRangeFlags>> &p_results) const;
@@ -159,6 +162,8 @@ private:
 
   static bool compareRangeByStartBeforeBlock(const FoldingRange *p_range, int p_blockNumber);
 
+  static bool compareRangeByEndBeforeBlock(const FoldingRange *p_range, int p_blockNumber);
+
   static bool compareRangeByStartAfterBlock(int p_blockNumber, const FoldingRange *p_range);
 
   QTextDocument *m_document = nullptr;
@@ -183,6 +188,11 @@ private:
   // this.
   FoldingRange::Vector m_foldedFoldingRanges;
 
+  // Prefix sums of the hidden lines of m_foldedFoldingRanges.
+  // [i] is the number of lines hidden by the folded ranges before the i-th one, and the last one
+  // is the total.
+  QVector<int> m_hiddenLinesBefore = {0};
+
   qint64 m_nextId = 0;
 
   QHash<qint64, FoldingRange *> m_idToFoldingRange;
@@ -7,11 +7,13 @@ using namespace vte;
 QJsonObject ViConfig::toJson() const {
   QJsonObject obj;
   obj[QStringLiteral("control_c_to_copy")] = m_controlCToCopy;
+  obj[QStringLiteral("store_file")] = m_storeFile;
   return obj;
 }
 
 void ViConfig::fromJson(const QJsonObject &p_jobj) {
   m_controlCToCopy = p_jobj[QStringLiteral("control_c_to_copy")].toBool();
+  m_storeFile = p_jobj[QStringLiteral("store_file")].toString();
 }
 
 QSharedPointer<KateViI::KateViConfig> ViConfig::toKateViConfig() const {
@@ -24,5 +26,7 @@ QSharedPointer<KateViI::KateViConfig> ViConfig::toKateViConfig() const {
     kateConfig->skipKey(Qt::Key_X, Qt::ControlModifier);
   }
 
+  kateConfig->setStoreFile(m_storeFile);
+
   return kateConfig;
 }
@@ -0,0 +1,104 @@
+#include "visearchhelper.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+using namespace vte;
+
+QVector<KateViI::Range> ViSearchHelper::searchText(const QTextDocument *p_doc,
+                                                   const KateViI::Range &p_range,
+                                                   const QRegularExpression &p_regExp,
+                                                   bool p_backward) {
+  QVector<KateViI::Range> result(1, KateViI::Range::invalid());
+  if (!p_regExp.isValid() || !p_range.isValid()) {
+    return result;
+  }
+
+  const auto startBlock = p_doc->findBlockByNumber(p_range.start().line());
+  if (!startBlock.isValid()) {
+    return result;
+  }
+  auto endBlock = p_doc->findBlockByNumber(p_range.end().line());
+  int endColumn = p_range.end().column();
+  if (!endBlock.isValid()) {
+    endBlock = p_doc->lastBlock();
+    endColumn = endBlock.length() - 1;
+  }
+
+  // Match block by block within [p_range.start(), p_range.end()].
+  // Only the last match of one block is needed for backward search, so it could stop at the
+  // first block having a match from the end, instead of searching from the start repeatedly.
+  auto block = p_backward ? endBlock : startBlock;
+  while (block.isValid()) {
+    const auto text = block.text();
+    const int startColumn =
+        block == startBlock ? qMin(p_range.start().column(), text.size()) : 0;
+    const int maxEnd = block == endBlock ? qMin(endColumn, text.size()) : text.size();
+
+    QRegularExpressionMatch lastMatch;
+    int offset = startColumn;
+    while (offset <= maxEnd) {
+      auto match = p_regExp.match(text, offset);
+      if (!match.hasMatch() || match.capturedEnd() > maxEnd) {
+        break;
+      }
+
+      lastMatch = match;
+      if (!p_backward) {
+        break;
+      }
+
+      // Advance at least one char for zero-length match.
+      offset = qMax(match.capturedEnd(), match.capturedStart() + 1);
+    }
+
+    if (lastMatch.hasMatch()) {
+      const int line = block.blockNumber();
+      result.clear();
+      for (int i = 0; i <= lastMatch.lastCapturedIndex(); ++i) {
+        if (lastMatch.capturedStart(i) == -1) {
+          result.append(KateViI::Range::invalid());
+        } else {
+          result.append(KateViI::Range(line, lastMatch.capturedStart(i), line,
+                                       lastMatch.capturedEnd(i)));
+        }
+      }
+      break;
+    }
+
+    if (block == (p_backward ? startBlock : endBlock)) {
+      break;
+    }
+    block = p_backward ? block.previous() : block.next();
+  }
+
+  return result;
+}
+
+QString ViSearchHelper::vimRegExpToQt(const QString &p_pattern, bool &p_caseSensitive) {
+  QString pattern;
+  pattern.reserve(p_pattern.size());
+  const int len = p_pattern.size();
+  for (int i = 0; i < len; ++i) {
+    const auto ch = p_pattern.at(i);
+    if (ch != QLatin1Char('\\') || i + 1 == len) {
+      pattern.append(ch);
+      continue;
+    }
+
+    const auto next = p_pattern.at(++i);
+    if (next == QLatin1Char('<') || next == QLatin1Char('>')) {
+      // Word boundaries.
+      pattern.append(QStringLiteral("\\b"));
+    } else if (next == QLatin1Char('c')) {
+      p_caseSensitive = false;
+    } else if (next == QLatin1Char('C')) {
+      p_caseSensitive = true;
+    } else {
+      pattern.append(ch);
+      pattern.append(next);
+    }
+  }
+
+  return pattern;
+}
@@ -0,0 +1,31 @@
+#ifndef VISEARCHHELPER_H
+#define VISEARCHHELPER_H
+
+#include <QRegularExpression>
+#include <QVector>
+
+#include <katevi/interface/range.h>
+
+class QTextDocument;
+
+namespace vte {
+// Search helpers of EditorInputMode for KateVi.
+class ViSearchHelper {
+public:
+  ViSearchHelper() = delete;
+
+  // Search @p_regExp in @p_doc within [@p_range.start(), @p_range.end()].
+  // Like KTextEditor, return the range of the match followed by ranges of the captures, or one
+  // invalid range if not found. Backward search returns the last match within the range.
+  static QVector<KateViI::Range> searchText(const QTextDocument *p_doc,
+                                            const KateViI::Range &p_range,
+                                            const QRegularExpression &p_regExp, bool p_backward);
+
+  // Translate vim specific syntax in @p_pattern: \< and \> for word boundaries, \c and \C
+  // for case sensitivity which will override @p_caseSensitive.
+  // KateVi passes other syntax the same as QRegularExpression.
+  static QString vimRegExpToQt(const QString &p_pattern, bool &p_caseSensitive);
+};
+} // namespace vte
+
+#endif // VISEARCHHELPER_H
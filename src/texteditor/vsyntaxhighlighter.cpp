@@ -3,11 +3,32 @@
 #include <QTextDocument>
 
 #include "blockspellcheckdata.h"
+#include <spellcheck/spellcheckhighlighthelper.h>
+#include <spellcheck/spellcheckworker.h>
 #include <vtextedit/textblockdata.h>
 
 using namespace vte;
 
-VSyntaxHighlighter::VSyntaxHighlighter(QTextDocument *p_doc) : QSyntaxHighlighter(p_doc) {}
+VSyntaxHighlighter::VSyntaxHighlighter(QTextDocument *p_doc)
+    : QSyntaxHighlighter(static_cast<QObject *>(p_doc)), m_blockCount(p_doc->blockCount()) {
+  // Shift the pending spell check jobs before QSyntaxHighlighter rehighlights the changed blocks
+  // and adds jobs of the new block numbers.
+  connect(p_doc, &QTextDocument::contentsChange, this, &VSyntaxHighlighter::handleContentsChange);
+  setDocument(p_doc);
+}
+
+void VSyntaxHighlighter::handleContentsChange(int p_position, int p_charsRemoved,
+                                              int p_charsAdded) {
+  Q_UNUSED(p_charsRemoved);
+  Q_UNUSED(p_charsAdded);
+  const int blockCount = document()->blockCount();
+  const int delta = blockCount - m_blockCount;
+  m_blockCount = blockCount;
+  if (delta != 0 && m_spellCheckWorker) {
+    // Blocks before the one at @p_position are untouched.
+    m_spellCheckWorker->shiftBlocks(document()->findBlock(p_position).blockNumber(), delta);
+  }
+}
 
 void VSyntaxHighlighter::highlightMisspell(const QSharedPointer<BlockSpellCheckData> &p_data) {
   for (const auto &seg : p_data->m_misspellings) {
@@ -19,6 +40,55 @@ void VSyntaxHighlighter::highlightMisspell(const QSharedPointer<BlockSpellCheckD
   }
 }
 
+void VSyntaxHighlighter::highlightSpellCheck(const QString &p_text) {
+  if (p_text.isEmpty() || !m_spellCheckEnabled) {
+    return;
+  }
+
+  auto spellData = SpellCheckHighlightHelper::checkBlock(spellCheckWorker(), currentBlock(), p_text,
+                                                         m_autoDetectLanguageEnabled);
+  if (spellData && !spellData->isEmpty()) {
+    highlightMisspell(spellData);
+  }
+}
+
+SpellCheckWorker *VSyntaxHighlighter::spellCheckWorker() {
+  if (!m_spellCheckWorker) {
+    m_spellCheckWorker = new SpellCheckWorker(this);
+    m_spellCheckWorker->setLanguage(m_spellCheckLanguage);
+    m_spellCheckWorker->setPriorityBlockRange(m_spellCheckPriorityBlocks.first,
+                                              m_spellCheckPriorityBlocks.second);
+    connect(m_spellCheckWorker, &SpellCheckWorker::resultsReady, this,
+            &VSyntaxHighlighter::handleSpellCheckResults, Qt::QueuedConnection);
+  }
+
+  return m_spellCheckWorker;
+}
+
+void VSyntaxHighlighter::handleSpellCheckResults() {
+  const auto results = m_spellCheckWorker->takeResults();
+  if (!m_spellCheckEnabled) {
+    return;
+  }
+
+  auto doc = document();
+  for (const auto &result : results) {
+    // Only blocks with misspellings need to be rehighlighted.
+    auto block = SpellCheckHighlightHelper::applyResult(doc, result);
+    if (block.isValid() && !result.m_misspellings.isEmpty()) {
+      rehighlightBlock(block);
+    }
+  }
+}
+
+void VSyntaxHighlighter::setSpellCheckPriorityBlockRange(int p_first, int p_last) {
+  m_spellCheckPriorityBlocks.first = p_first;
+  m_spellCheckPriorityBlocks.second = p_last;
+  if (m_spellCheckWorker) {
+    m_spellCheckWorker->setPriorityBlockRange(p_first, p_last);
+  }
+}
+
 void VSyntaxHighlighter::setSpellCheckEnabled(bool p_enabled) {
   if (m_spellCheckEnabled == p_enabled) {
     return;
@@ -35,7 +105,24 @@ void VSyntaxHighlighter::setAutoDetectLanguageEnabled(bool p_enabled) {
   refreshSpellCheck();
 }
 
+void VSyntaxHighlighter::setSpellCheckLanguage(const QString &p_lang) {
+  if (m_spellCheckLanguage == p_lang) {
+    return;
+  }
+  m_spellCheckLanguage = p_lang;
+  if (m_spellCheckWorker) {
+    m_spellCheckWorker->setLanguage(p_lang);
+    if (m_spellCheckEnabled) {
+      refreshSpellCheck();
+    }
+  }
+}
+
 void VSyntaxHighlighter::refreshSpellCheck() {
+  if (m_spellCheckWorker) {
+    m_spellCheckWorker->clear();
+  }
+
   // Clear all the spell check cache data.
   auto block = document()->firstBlock();
   while (block.isValid()) {
@@ -62,3 +149,8 @@ void VSyntaxHighlighter::refreshBlockSpellCheck(const QTextBlock &p_block) {
 }
 
 bool VSyntaxHighlighter::isSyntaxFoldingEnabled() const { return false; }
+
+int VSyntaxHighlighter::findSyntaxFoldingEnd(int p_blockNumber) {
+  Q_UNUSED(p_blockNumber);
+  return -1;
+}
@@ -15,11 +15,13 @@
 #include "editorextraselection.h"
 #include "editorindicatorsborder.h"
 #include "editorinputmode.h"
+#include "findworker.h"
 #include "indicatorsborder.h"
 #include "ksyntaxhighlighterwrapper.h"
 #include "plaintexthighlighter.h"
 #include "statusindicator.h"
 #include "syntaxhighlighter.h"
+#include "textfinder.h"
 #include "textfolding.h"
 
 #include <vtextedit/spellchecker.h>
@@ -27,7 +29,6 @@
 #include <vtextedit/textutils.h>
 
 #include <QHBoxLayout>
-#include <QHash>
 #include <QMenu>
 #include <QPair>
 #include <QRegularExpression>
@@ -41,6 +42,58 @@ int VTextEditor::s_instanceCount = 0;
 
 Completer *VTextEditor::s_completer = nullptr;
 
+// Documents longer than this will be searched in background.
+static const int c_asyncFindMinLength = 1024 * 1024;
+
+struct VTextEditor::FindResultCache {
+  void clear();
+
+  bool matched(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end) const;
+
+  // Reset to an empty result of given find.
+  void update(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end);
+
+  // Find range [m_start, m_end).
+  int m_start = -1;
+  int m_end = -1;
+
+  QStringList m_texts;
+
+  FindFlags m_flags = FindFlag::None;
+
+  // Matches in ascending order.
+  QVector<TextFinder::Match> m_result;
+
+  // False if matches are still being appended by the find worker.
+  bool m_finished = true;
+
+  // Id of the job of the find worker.
+  int m_jobId = -1;
+
+  // Used to update m_result incrementally on contents change.
+  TextFinder m_finder;
+
+  // Whether matches are highlighted.
+  bool m_highlighting = false;
+
+  // Index of the match being highlighted as current match.
+  // It will be -1 if current match is broken by editing.
+  int m_currentIndex = -1;
+
+  // A find waiting for more matches to locate its current match.
+  struct PendingFind {
+    bool m_valid = false;
+
+    int m_position = 0;
+
+    bool m_skipCurrent = false;
+
+    bool m_forward = true;
+  };
+
+  PendingFind m_pendingFind;
+};
+
 void VTextEditor::FindResultCache::clear() {
   m_start = -1;
   m_end = -1;
@@ -48,6 +101,12 @@ void VTextEditor::FindResultCache::clear() {
   m_texts.clear();
   m_flags = FindFlag::None;
   m_result.clear();
+  m_finished = true;
+  m_jobId = -1;
+  m_finder = TextFinder();
+  m_highlighting = false;
+  m_currentIndex = -1;
+  m_pendingFind = PendingFind();
 }
 
 bool VTextEditor::FindResultCache::matched(const QStringList &p_texts, FindFlags p_flags,
@@ -57,18 +116,102 @@ bool VTextEditor::FindResultCache::matched(const QStringList &p_texts, FindFlags
 }
 
 void VTextEditor::FindResultCache::update(const QStringList &p_texts, FindFlags p_flags,
-                                          int p_start, int p_end,
-                                          const QList<QTextCursor> &p_result) {
+                                          int p_start, int p_end) {
+  clear();
   m_texts = p_texts;
   m_flags = p_flags;
   m_start = p_start;
   m_end = p_end;
-  m_result = p_result;
+}
+
+// @p_matches is in ascending order.
+// If @p_forward is true, find the smallest match whose start is greater than @p_pos or the
+// first match if wrapped. Otherwise, find the largest match whose start is smaller than @p_pos
+// or the last match if wrapped.
+static int selectMatch(const QVector<TextFinder::Match> &p_matches, int p_pos, bool p_skipCurrent,
+                       bool p_forward, bool &p_isWrapped) {
+  Q_ASSERT(!p_matches.isEmpty());
+
+  p_isWrapped = false;
+  int first = 0, last = p_matches.size() - 1;
+  int lastMatch = -1;
+  while (first <= last) {
+    int mid = (first + last) / 2;
+    const int start = p_matches.at(mid).m_start;
+    if (p_forward) {
+      if (start < p_pos) {
+        first = mid + 1;
+      } else if (start == p_pos) {
+        if (!p_skipCurrent) {
+          // Found it.
+          lastMatch = mid;
+        } else if (mid < p_matches.size() - 1) {
+          // Next one is the right one.
+          lastMatch = mid + 1;
+        } else {
+          lastMatch = 0;
+          p_isWrapped = true;
+        }
+        break;
+      } else {
+        // It is a match.
+        if (lastMatch == -1 || mid < lastMatch) {
+          lastMatch = mid;
+        }
+
+        last = mid - 1;
+      }
+    } else {
+      if (start > p_pos) {
+        last = mid - 1;
+      } else if (start == p_pos) {
+        if (!p_skipCurrent) {
+          // Found it.
+          lastMatch = mid;
+        } else if (mid > 0) {
+          // Previous one is the right one.
+          lastMatch = mid - 1;
+        } else {
+          lastMatch = p_matches.size() - 1;
+          p_isWrapped = true;
+        }
+        break;
+      } else {
+        // It is a match.
+        if (lastMatch == -1 || mid > lastMatch) {
+          lastMatch = mid;
+        }
+
+        first = mid + 1;
+      }
+    }
+  }
+
+  if (lastMatch == -1) {
+    p_isWrapped = true;
+    lastMatch = p_forward ? 0 : (p_matches.size() - 1);
+  }
+
+  return lastMatch;
+}
+
+// Whether the match to select around @p_pos is known from partial matches @p_matches which
+// will be appended later.
+static bool isMatchSelectable(const QVector<TextFinder::Match> &p_matches, int p_pos) {
+  return !p_matches.isEmpty() && p_matches.last().m_start > p_pos;
+}
+
+static QTextCursor matchCursor(QTextDocument *p_doc, const TextFinder::Match &p_match) {
+  QTextCursor cursor(p_doc);
+  cursor.setPosition(p_match.m_start);
+  cursor.setPosition(p_match.m_end, QTextCursor::KeepAnchor);
+  return cursor;
 }
 
 VTextEditor::VTextEditor(const QSharedPointer<TextEditorConfig> &p_config,
                          const QSharedPointer<TextEditorParameters> &p_paras, QWidget *p_parent)
-    : QWidget(p_parent), m_config(p_config), m_parameters(p_paras) {
+    : QWidget(p_parent), m_config(p_config), m_parameters(p_paras),
+      m_findResultCache(new FindResultCache()) {
   if (!m_config) {
     m_config = QSharedPointer<TextEditorConfig>::create();
   }
@@ -85,7 +228,7 @@ VTextEditor::VTextEditor(const QSharedPointer<TextEditorConfig> &p_config,
 
   setupCompleter();
 
-  connect(m_textEdit, &VTextEdit::contentsChanged, this, &VTextEditor::clearFindResultCache);
+  connect(document(), &QTextDocument::contentsChange, this, &VTextEditor::updateFindResultCache);
 
   // Status widget.
   connect(m_textEdit, &QTextEdit::cursorPositionChanged, this,
@@ -171,7 +314,12 @@ void VTextEditor::setupTextEdit() {
     m_topLineChangedTimer->setInterval(300);
     connect(m_topLineChangedTimer, &QTimer::timeout, this, &VTextEditor::topLineChanged);
     connect(sb, &QScrollBar::valueChanged, m_topLineChangedTimer, QOverload<>::of(&QTimer::start));
+    connect(sb, &QScrollBar::valueChanged, this, &VTextEditor::updateSpellCheckPriorityBlocks);
+    connect(sb, &QScrollBar::valueChanged, this, &VTextEditor::updateSearchHighlight);
   }
+
+  connect(m_textEdit, &VTextEdit::resized, this, &VTextEditor::updateSpellCheckPriorityBlocks);
+  connect(m_textEdit, &VTextEdit::resized, this, &VTextEditor::updateSearchHighlight);
 }
 
 void VTextEditor::setText(const QString &p_text) {
@@ -522,77 +670,24 @@ VTextEditor::fetchSyntaxFoldingRangeStartingOnBlock(int p_blockNumber) {
     return nullptr;
   }
 
-  // Search the type of the first folding region which remains pending.
-  int openRegionType = 0;
-  int openRegionOffset = -1;
-  {
-    // <folding id, <offset, count>>.
-    QHash<int, QPair<int, int>> openFoldingMap;
-    for (const auto &folding : data->getFoldings()) {
-      if (folding.isOpen()) {
-        // A folding open, like `{`.
-        auto it = openFoldingMap.find(folding.m_value);
-        if (it != openFoldingMap.end()) {
-          ++(it.value().second);
-        } else {
-          openFoldingMap.insert(folding.m_value, qMakePair(folding.m_offset, 1));
-        }
-      } else {
-        // A folding close, like `}`.
-        auto it = openFoldingMap.find(-folding.m_value);
-        if (it != openFoldingMap.end()) {
-          if (it.value().second > 1) {
-            --(it.value().second);
-          } else {
-            openFoldingMap.erase(it);
-          }
-        }
-      }
-    }
-
-    // Get the first pending open folding with offset.
-    for (auto it = openFoldingMap.begin(); it != openFoldingMap.end(); ++it) {
-      if (openRegionOffset == -1 || it->first < openRegionOffset) {
-        openRegionType = it.key();
-        openRegionOffset = it->first;
-      }
-    }
+  const int endBlockNumber = m_highlighter->findSyntaxFoldingEnd(p_blockNumber);
+  if (endBlockNumber < 0) {
+    return nullptr;
   }
 
-  if (openRegionType == 0) {
-    return nullptr;
+  if (endBlockNumber >= document()->blockCount()) {
+    // Since there is no matched close folding, the open folding range spans
+    // to the end of the document.
+    return QSharedPointer<TextBlockRange>::create(block, document()->end());
   }
 
-  // Search the following lines for the matched close folding.
-  {
-    int numOfOpenRegions = 1;
-    for (auto nextBlock = block.next(); nextBlock.isValid(); nextBlock = nextBlock.next()) {
-      auto nextData = TextBlockData::get(nextBlock);
-      for (const auto &folding : nextData->getFoldings()) {
-        if (folding.m_value == -openRegionType) {
-          // Found one match.
-          --numOfOpenRegions;
-          if (numOfOpenRegions == 0) {
-            // Don't return a valid folding range without contents (only two
-            // lines).
-            if (nextBlock.blockNumber() - p_blockNumber == 1) {
-              return nullptr;
-            }
-
-            // Got the range.
-            return QSharedPointer<TextBlockRange>::create(block, nextBlock);
-          }
-        } else if (folding.m_value == openRegionType) {
-          // Another open folding in the same type.
-          ++numOfOpenRegions;
-        }
-      }
-    }
+  // Don't return a valid folding range without contents (only two lines).
+  if (endBlockNumber - p_blockNumber == 1) {
+    return nullptr;
   }
 
-  // Since we could not find a matched close folding, the open folding range
-  // spans to the end of the document.
-  return QSharedPointer<TextBlockRange>::create(block, document()->end());
+  return QSharedPointer<TextBlockRange>::create(block,
+                                                document()->findBlockByNumber(endBlockNumber));
 }
 
 TextFolding *VTextEditor::getTextFolding() const { return m_folding; }
@@ -901,7 +996,7 @@ VTextEditor::FindResult VTextEditor::findText(const QStringList &p_texts, FindFl
     cursor.setPosition(pos);
     skipCurrent = false;
   }
-  auto result = findTextHelper(p_texts, p_flags, p_start, p_end, skipCurrent, cursor);
+  auto result = findTextHelper(p_texts, p_flags, p_start, p_end, skipCurrent, cursor, false);
   if (!cursor.isNull()) {
     cursor.setPosition(cursor.selectionStart());
     m_textEdit->setTextCursor(cursor);
@@ -911,7 +1006,7 @@ VTextEditor::FindResult VTextEditor::findText(const QStringList &p_texts, FindFl
 
 VTextEditor::FindResult VTextEditor::findTextHelper(const QStringList &p_texts, FindFlags p_flags,
                                                     int p_start, int p_end, bool p_skipCurrent,
-                                                    QTextCursor &p_cursor) {
+                                                    QTextCursor &p_cursor, bool p_sync) {
   clearIncrementalSearchHighlight();
 
   FindResult result;
@@ -922,20 +1017,32 @@ VTextEditor::FindResult VTextEditor::findTextHelper(const QStringList &p_texts,
     return result;
   }
 
-  const auto &allResults = findAllText(p_texts, p_flags, p_start, p_end);
-  if (!allResults.isEmpty()) {
+  findAllText(p_texts, p_flags, p_start, p_end, p_sync);
+
+  auto &cache = *m_findResultCache;
+  const int pos = p_cursor.position();
+  const bool forward = !(p_flags & FindFlag::FindBackward);
+  if (!cache.m_finished && !isMatchSelectable(cache.m_result, pos)) {
+    // Locate current match once more matches are found.
+    clearSearchHighlight();
+    auto &pendingFind = cache.m_pendingFind;
+    pendingFind.m_valid = true;
+    pendingFind.m_position = pos;
+    pendingFind.m_skipCurrent = p_skipCurrent;
+    pendingFind.m_forward = forward;
+
+    p_cursor = QTextCursor();
+    return currentFindResult();
+  }
+
+  if (!cache.m_result.isEmpty()) {
     // Locate to the right match and update current cursor.
     bool wrapped = false;
-    int idx = selectCursor(allResults, p_cursor.position(), p_skipCurrent,
-                           !(p_flags & FindFlag::FindBackward), wrapped);
+    int idx = selectMatch(cache.m_result, pos, p_skipCurrent, forward, wrapped);
     Q_ASSERT(idx != -1);
-    p_cursor = allResults[idx];
-
-    // Highlight.
-    highlightSearch(allResults, idx);
+    p_cursor = setCurrentMatch(idx);
 
-    result.m_totalMatches = allResults.size();
-    result.m_currentMatchIndex = idx;
+    result = currentFindResult();
     result.m_wrapped = wrapped;
   } else {
     clearSearchHighlight();
@@ -945,11 +1052,49 @@ VTextEditor::FindResult VTextEditor::findTextHelper(const QStringList &p_texts,
   return result;
 }
 
+VTextEditor::FindResult VTextEditor::currentFindResult() const {
+  const auto &cache = *m_findResultCache;
+  FindResult result;
+  result.m_totalMatches = cache.m_result.size();
+  result.m_currentMatchIndex = cache.m_currentIndex;
+  result.m_searching = !cache.m_finished;
+  return result;
+}
+
+void VTextEditor::updateFindResultCache(int p_position, int p_charsRemoved, int p_charsAdded) {
+  if (p_charsRemoved == 0 && p_charsAdded == 0) {
+    return;
+  }
+
+  auto &cache = *m_findResultCache;
+  if (cache.m_texts.isEmpty()) {
+    return;
+  }
+
+  if (!cache.m_finished || cache.m_start != 0 || cache.m_end != -1) {
+    // Only result of the whole document is updated incrementally.
+    clearFindResultCache();
+    return;
+  }
+
+  if (!cache.m_finder.updateMatches(cache.m_result, document(), p_position, p_charsRemoved,
+                                    p_charsAdded, &cache.m_currentIndex)) {
+    clearFindResultCache();
+    return;
+  }
+
+  if (cache.m_highlighting) {
+    // Layout is not updated yet.
+    QTimer::singleShot(0, this, &VTextEditor::updateSearchHighlight);
+    emit findResultUpdated(currentFindResult());
+  }
+}
+
 VTextEditor::FindResult VTextEditor::replaceText(const QString &p_text, FindFlags p_flags,
                                                  const QString &p_replaceText, int p_start,
                                                  int p_end) {
   auto cursor = m_textEdit->textCursor();
-  auto result = findTextHelper(QStringList(p_text), p_flags, p_start, p_end, false, cursor);
+  auto result = findTextHelper(QStringList(p_text), p_flags, p_start, p_end, false, cursor, true);
   if (result.m_totalMatches > 0) {
     Q_ASSERT(!cursor.isNull());
     result.m_totalMatches = 1;
@@ -977,28 +1122,40 @@ VTextEditor::FindResult VTextEditor::replaceAll(const QString &p_text, FindFlags
     return result;
   }
 
-  const auto &allResults = findAllText(QStringList(p_text), p_flags, p_start, p_end);
-  if (!allResults.isEmpty()) {
-    result.m_totalMatches = allResults.size();
+  findAllText(QStringList(p_text), p_flags, p_start, p_end, true);
+
+  auto matches = m_findResultCache->m_result;
+  const auto finder = m_findResultCache->m_finder;
+
+  // No need to update the cache on the replacement.
+  clearFindResultCache();
+
+  if (!matches.isEmpty()) {
+    result.m_totalMatches = matches.size();
+
+    // Build the replaced text of the span covering all matches and replace it as one edit,
+    // instead of inserting text match by match which churns the document and emits
+    // contentsChange for each match.
+    const int start = matches.first().m_start;
+    const int end = matches.last().m_end;
+
+    // Whole blocks are needed to resolve back references.
+    auto doc = document();
+    const auto firstBlock = doc->findBlock(start);
+    const int textStart = firstBlock.position();
+    const auto text = TextFinder::blocksText(firstBlock, doc->findBlock(end));
+    for (auto &match : matches) {
+      match.m_start -= textStart;
+      match.m_end -= textStart;
+    }
+    const auto newText =
+        finder.replace(text, matches, p_replaceText, start - textStart, end - textStart);
 
-    // Replace all matches one by one.
     auto cursor = m_textEdit->textCursor();
     cursor.beginEditBlock();
-    bool hasBackRef =
-        (p_flags & FindFlag::RegularExpression) ? hasBackReference(p_replaceText) : false;
-    QRegularExpression regExp(hasBackRef ? p_text : QString());
-    for (const auto &result : allResults) {
-      cursor.setPosition(result.selectionStart());
-      cursor.setPosition(result.selectionEnd(), QTextCursor::KeepAnchor);
-
-      if (hasBackRef) {
-        auto newText = resolveBackReferenceInReplaceText(
-            p_replaceText, TextEditUtils::getSelectedText(cursor), regExp);
-        cursor.insertText(newText);
-      } else {
-        cursor.insertText(p_replaceText);
-      }
-    }
+    cursor.setPosition(start);
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+    cursor.insertText(newText);
     cursor.endEditBlock();
     m_textEdit->setTextCursor(cursor);
   }
@@ -1011,128 +1168,148 @@ void VTextEditor::clearIncrementalSearchHighlight() {
   m_extraSelectionMgr->setSelections(m_incrementalSearchExtraSelection, QList<QTextCursor>());
 }
 
-void VTextEditor::clearFindResultCache() { m_findResultCache.clear(); }
+void VTextEditor::clearFindResultCache() {
+  m_findResultCache->clear();
+
+  if (m_findWorker) {
+    m_findWorker->cancel();
+  }
+}
 
 void VTextEditor::clearSearchHighlight() {
+  m_findResultCache->m_highlighting = false;
+  m_findResultCache->m_currentIndex = -1;
+  m_findResultCache->m_pendingFind = FindResultCache::PendingFind();
+
   m_extraSelectionMgr->setSelections(m_searchExtraSelection, QList<QTextCursor>());
   m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, QList<QTextCursor>());
 }
 
-const QList<QTextCursor> &VTextEditor::findAllText(const QStringList &p_texts, FindFlags p_flags,
-                                                   int p_start, int p_end) {
-  if (p_texts.isEmpty() || (p_texts.size() == 1 && p_texts[0].isEmpty())) {
-    m_findResultCache.clear();
-    return m_findResultCache.m_result;
+void VTextEditor::findAllText(const QStringList &p_texts, FindFlags p_flags, int p_start,
+                              int p_end, bool p_sync) {
+  auto &cache = *m_findResultCache;
+  if (cache.matched(p_texts, p_flags, p_start, p_end) && (cache.m_finished || !p_sync)) {
+    return;
   }
 
-  if (m_findResultCache.matched(p_texts, p_flags, p_start, p_end)) {
-    return m_findResultCache.m_result;
+  if (m_findWorker) {
+    m_findWorker->cancel();
   }
 
-  int cnt = 0;
-  QList<QTextCursor> results;
-  for (const auto &text : p_texts) {
-    if (text.isEmpty()) {
-      continue;
-    }
+  cache.update(p_texts, p_flags, p_start, p_end);
 
-    ++cnt;
-    results.append(m_textEdit->findAllText(text, p_flags, p_start, p_end));
+  TextFinder finder(p_texts, p_flags);
+  if (!finder.isValid()) {
+    return;
   }
+  cache.m_finder = finder;
 
-  if (cnt > 1) {
-    // Sort it.
-    std::sort(results.begin(), results.end());
+  // Positions of the plain text are the same as the document.
+  const auto text = m_textEdit->toPlainText();
+  if (p_sync || text.size() < c_asyncFindMinLength) {
+    cache.m_result = finder.findAll(text, p_start, p_end);
+  } else {
+    cache.m_finished = false;
+    cache.m_jobId = findWorker()->find(finder, text, p_start, p_end);
   }
-
-  m_findResultCache.update(p_texts, p_flags, p_start, p_end, results);
-
-  return m_findResultCache.m_result;
 }
 
-int VTextEditor::selectCursor(const QList<QTextCursor> &p_cursors, int p_pos, bool p_skipCurrent,
-                              bool p_forward, bool &p_isWrapped) {
-  Q_ASSERT(!p_cursors.isEmpty());
-
-  p_isWrapped = false;
-  int first = 0, last = p_cursors.size() - 1;
-  int lastMatch = -1;
-  while (first <= last) {
-    int mid = (first + last) / 2;
-    const QTextCursor &cur = p_cursors.at(mid);
-    if (p_forward) {
-      if (cur.selectionStart() < p_pos) {
-        first = mid + 1;
-      } else if (cur.selectionStart() == p_pos) {
-        if (!p_skipCurrent) {
-          // Found it.
-          lastMatch = mid;
-        } else if (mid < p_cursors.size() - 1) {
-          // Next one is the right one.
-          lastMatch = mid + 1;
-        } else {
-          lastMatch = 0;
-          p_isWrapped = true;
-        }
-        break;
-      } else {
-        // It is a match.
-        if (lastMatch == -1 || mid < lastMatch) {
-          lastMatch = mid;
-        }
+FindWorker *VTextEditor::findWorker() {
+  if (!m_findWorker) {
+    m_findWorker = new FindWorker(this);
+    connect(m_findWorker, &FindWorker::resultReady, this, &VTextEditor::handleFindWorkerResult,
+            Qt::QueuedConnection);
+  }
 
-        last = mid - 1;
-      }
-    } else {
-      if (cur.selectionStart() > p_pos) {
-        last = mid - 1;
-      } else if (cur.selectionStart() == p_pos) {
-        if (!p_skipCurrent) {
-          // Found it.
-          lastMatch = mid;
-        } else if (mid > 0) {
-          // Previous one is the right one.
-          lastMatch = mid - 1;
-        } else {
-          lastMatch = p_cursors.size() - 1;
-          p_isWrapped = true;
-        }
-        break;
-      } else {
-        // It is a match.
-        if (lastMatch == -1 || mid > lastMatch) {
-          lastMatch = mid;
-        }
+  return m_findWorker;
+}
 
-        first = mid + 1;
-      }
-    }
+void VTextEditor::handleFindWorkerResult() {
+  const auto result = m_findWorker->takeResult();
+  auto &cache = *m_findResultCache;
+  if (cache.m_finished || result.m_id != cache.m_jobId) {
+    return;
   }
 
-  if (lastMatch == -1) {
-    p_isWrapped = true;
-    lastMatch = p_forward ? 0 : (p_cursors.size() - 1);
+  // Matches come in order.
+  cache.m_result += result.m_matches;
+  cache.m_finished = result.m_finished;
+
+  bool wrapped = false;
+  auto &pendingFind = cache.m_pendingFind;
+  if (cache.m_highlighting) {
+    // Index of current match is not changed by appending.
+    highlightSearch();
+  } else if (pendingFind.m_valid &&
+             (cache.m_finished || isMatchSelectable(cache.m_result, pendingFind.m_position))) {
+    pendingFind.m_valid = false;
+    if (!cache.m_result.isEmpty()) {
+      int idx = selectMatch(cache.m_result, pendingFind.m_position, pendingFind.m_skipCurrent,
+                            pendingFind.m_forward, wrapped);
+      auto cursor = setCurrentMatch(idx);
+      cursor.setPosition(cursor.selectionStart());
+      m_textEdit->setTextCursor(cursor);
+    }
   }
 
-  return lastMatch;
+  auto findResult = currentFindResult();
+  findResult.m_wrapped = wrapped;
+  emit findResultUpdated(findResult);
 }
 
-void VTextEditor::highlightSearch(const QList<QTextCursor> &p_results, int p_currentIdx) {
-  Q_ASSERT(!p_results.isEmpty() && p_currentIdx >= 0);
-  m_extraSelectionMgr->setSelections(m_searchExtraSelection, p_results);
+QTextCursor VTextEditor::setCurrentMatch(int p_idx) {
+  auto &cache = *m_findResultCache;
+  Q_ASSERT(p_idx >= 0 && p_idx < cache.m_result.size());
+  cache.m_highlighting = true;
+  cache.m_currentIndex = p_idx;
+  cache.m_pendingFind = FindResultCache::PendingFind();
 
-  QList<QTextCursor> searchUnderCursor;
-  searchUnderCursor << p_results[p_currentIdx];
-  m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, searchUnderCursor);
+  highlightSearch();
 
-  const int selStart = p_results[p_currentIdx].selectionStart();
-  if (selStart == p_results[p_currentIdx].selectionEnd()) {
+  auto cursor = matchCursor(document(), cache.m_result[p_idx]);
+  if (cursor.selectionStart() == cursor.selectionEnd()) {
     // Zero-length match.
-    const auto rect = m_textEdit->cursorRect(p_results[p_currentIdx]);
+    const auto rect = m_textEdit->cursorRect(cursor);
     QToolTip::hideText();
     QToolTip::showText(m_textEdit->mapToGlobal(rect.topLeft()), tr("Zero-length match"),
                        m_textEdit);
   }
+
+  return cursor;
+}
+
+void VTextEditor::highlightSearch() {
+  const auto &cache = *m_findResultCache;
+  Q_ASSERT(cache.m_currentIndex < cache.m_result.size());
+  auto doc = document();
+
+  // There may be tons of matches, so create cursors for those within visible blocks only.
+  // A match never crosses blocks.
+  QList<QTextCursor> visibleResults;
+  const auto firstBlock = TextEditUtils::firstVisibleBlock(m_textEdit);
+  const auto lastBlock = TextEditUtils::lastVisibleBlock(m_textEdit);
+  if (firstBlock.isValid() && lastBlock.isValid()) {
+    const int visibleStart = firstBlock.position();
+    const int visibleEnd = lastBlock.position() + lastBlock.length();
+    auto it = std::lower_bound(cache.m_result.constBegin(), cache.m_result.constEnd(),
+                               TextFinder::Match(visibleStart, visibleStart));
+    for (; it != cache.m_result.constEnd() && it->m_start < visibleEnd; ++it) {
+      visibleResults.append(matchCursor(doc, *it));
+    }
+  }
+  m_extraSelectionMgr->setSelections(m_searchExtraSelection, visibleResults);
+
+  QList<QTextCursor> searchUnderCursor;
+  if (cache.m_currentIndex > -1) {
+    searchUnderCursor << matchCursor(doc, cache.m_result[cache.m_currentIndex]);
+  }
+  m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, searchUnderCursor);
+}
+
+void VTextEditor::updateSearchHighlight() {
+  if (m_findResultCache->m_highlighting) {
+    highlightSearch();
+  }
 }
 
 bool VTextEditor::hasBackReference(const QString &p_regExpText) {
@@ -1165,11 +1342,23 @@ void VTextEditor::updateSpellCheck() {
     SpellChecker::getInst().setCurrentLanguage(m_parameters->m_defaultSpellCheckLanguage);
   }
   if (m_highlighter) {
+    updateSpellCheckPriorityBlocks();
+    m_highlighter->setSpellCheckLanguage(m_parameters->m_defaultSpellCheckLanguage);
     m_highlighter->setSpellCheckEnabled(m_parameters->m_spellCheckEnabled);
     m_highlighter->setAutoDetectLanguageEnabled(m_parameters->m_autoDetectLanguageEnabled);
   }
 }
 
+void VTextEditor::updateSpellCheckPriorityBlocks() {
+  if (!m_highlighter || !m_parameters->m_spellCheckEnabled) {
+    return;
+  }
+
+  m_highlighter->setSpellCheckPriorityBlockRange(
+      TextEditUtils::firstVisibleBlock(m_textEdit).blockNumber(),
+      TextEditUtils::lastVisibleBlock(m_textEdit).blockNumber());
+}
+
 bool VTextEditor::appendSpellCheckMenu(QContextMenuEvent *p_event, QMenu *p_menu) {
   if (!m_highlighter || !m_parameters->m_spellCheckEnabled) {
     return false;
@@ -989,7 +989,7 @@ QVector<MarkdownLink> MarkdownUtils::fetchImagesFromMarkdownText(const QString &
 
 QVector<peg::ElementRegion> MarkdownUtils::fetchImageRegionsViaParser(const QString &p_content) {
   auto parserConfig = QSharedPointer<peg::PegParseConfig>::create();
-  parserConfig->m_data = p_content.toUtf8();
+  parserConfig->m_data = p_content;
   return peg::PegParser::parseImageRegions(parserConfig);
 }
 
@@ -0,0 +1,239 @@
+#include "test_commandmatcher.h"
+
+#include <command.h>
+#include <commandmatcher.h>
+#include <modes/normalvimode.h>
+#include <motion.h>
+
+using namespace tests;
+
+using namespace KateVi;
+
+// Pairs of pattern and whether it is a regular expression.
+static QVector<QPair<QString, bool>> getPatterns()
+{
+    QVector<QPair<QString, bool>> patterns;
+    const QStringList literals = {
+        "a", "A", "i", "I", "o", "O", "d", "dd", "D", "c", "cc", "C", "y", "yy", "Y", "p", "P",
+        "x", "X", "u", "J", "gJ", "gu", "guu", "gU", "gUU", "g~", "g~~", "<", "<<", ">", ">>",
+        "=", "==", ".", "~", "ZZ", "zz", "zt", "zb", "zo", "zc", "zR", "zM", "h", "j", "k", "l",
+        "w", "W", "b", "B", "e", "E", "ge", "gE", "0", "^", "$", "gg", "G", "%", "H", "M", "L",
+        "{", "}", "n", "N", "*", "#", "iw", "aw", "iW", "aW", "is", "as", "ip", "ap", "i\"",
+        "a\"", "i'", "a'"
+    };
+    for (const auto &literal : literals) {
+        patterns.append(qMakePair(literal, false));
+    }
+
+    const QStringList regexes = {
+        "r.", "m.", "q.", "@.", "f.", "F.", "t.", "T.", "`[a-zA-Z^><\\.\\[\\]]", "'[a-zA-Z^><]",
+        "i[()b]", "a[()b]", "i[{}B]", "a[{}B]", "i[\\[\\]]", "a[\\[\\]]"
+    };
+    for (const auto &regex : regexes) {
+        patterns.append(qMakePair(regex, true));
+    }
+
+    return patterns;
+}
+
+// Encoded patterns of the real commands and then motions of NormalViMode.
+static QVector<QPair<QString, bool>> getNormalViModePatterns()
+{
+    // Only to encode the patterns.
+    QVector<Command *> commands;
+    QVector<Motion *> motions;
+#define ADDCMD(STR, FUNC, FLGS) \
+    commands.push_back(new Command(nullptr, QStringLiteral(STR), &NormalViMode::FUNC, FLGS));
+#define ADDMOTION(STR, FUNC, FLGS) \
+    motions.push_back(new Motion(nullptr, QStringLiteral(STR), &NormalViMode::FUNC, FLGS));
+#include <modes/normalvimodecommands.h>
+#undef ADDCMD
+#undef ADDMOTION
+
+    QVector<QPair<QString, bool>> patterns;
+    for (const auto cmd : commands) {
+        patterns.append(qMakePair(cmd->pattern(), cmd->isRegexPattern()));
+    }
+    for (const auto motion : motions) {
+        patterns.append(qMakePair(motion->pattern(), motion->isRegexPattern()));
+    }
+
+    qDeleteAll(commands);
+    qDeleteAll(motions);
+    return patterns;
+}
+
+static CommandMatcher getMatcher(const QVector<QPair<QString, bool>> &patterns)
+{
+    CommandMatcher matcher;
+    for (const auto &pattern : patterns) {
+        matcher.addPattern(pattern.first, pattern.second);
+    }
+    return matcher;
+}
+
+// Get the indexes of the patterns which @keys from @from matches one by one.
+static QVector<int> matchOneByOne(const QVector<QPair<QString, bool>> &patterns,
+                                  const QString &keys,
+                                  int from)
+{
+    QVector<int> indexes;
+    for (int i = 0; i < patterns.size(); ++i) {
+        const auto &pattern = patterns[i];
+        const bool matched =
+            pattern.second ? CommandMatcher::regexMatches(CommandMatcher::compileRegex(pattern.first), keys, from)
+                           : CommandMatcher::literalMatches(pattern.first, keys, from);
+        if (matched) {
+            indexes.append(i);
+        }
+    }
+    return indexes;
+}
+
+void TestCommandMatcher::testMatch_data()
+{
+    QTest::addColumn<QString>("keys");
+    QTest::addColumn<int>("from");
+    QTest::addColumn<QStringList>("expectedPatterns");
+
+    QTest::newRow("literal") << QStringLiteral("d") << 0 << QStringList{"d", "dd"};
+    QTest::newRow("literal exact") << QStringLiteral("dd") << 0 << QStringList{"dd"};
+    QTest::newRow("nested") << QStringLiteral("gu") << 0 << QStringList{"gu", "guu"};
+    QTest::newRow("regex prefix") << QStringLiteral("r") << 0 << QStringList{"r."};
+    QTest::newRow("regex") << QStringLiteral("rx") << 0 << QStringList{"r."};
+    QTest::newRow("regex too long") << QStringLiteral("rxy") << 0 << QStringList();
+    QTest::newRow("regex class") << QStringLiteral("`.") << 0 << QStringList{"`[a-zA-Z^><\\.\\[\\]]"};
+    QTest::newRow("regex class mismatch") << QStringLiteral("'.") << 0 << QStringList();
+    QTest::newRow("literal and regex") << QStringLiteral("i") << 0
+                                       << QStringList{"i", "iw", "iW", "is", "ip", "i\"", "i'",
+                                                      "i[()b]", "i[{}B]", "i[\\[\\]]"};
+    QTest::newRow("literal and regex 2") << QStringLiteral("iw") << 0 << QStringList{"iw"};
+    QTest::newRow("regex only") << QStringLiteral("i(") << 0 << QStringList{"i[()b]"};
+    QTest::newRow("none") << QStringLiteral("v") << 0 << QStringList();
+    QTest::newRow("from") << QStringLiteral("dgu") << 1 << QStringList{"gu", "guu"};
+    QTest::newRow("from regex") << QStringLiteral("dfx") << 1 << QStringList{"f."};
+}
+
+void TestCommandMatcher::testMatch()
+{
+    QFETCH(QString, keys);
+    QFETCH(int, from);
+    QFETCH(QStringList, expectedPatterns);
+
+    const auto patterns = getPatterns();
+    const auto matcher = getMatcher(patterns);
+    QVector<int> indexes;
+    matcher.match(keys, from, indexes);
+
+    // Should be the same as matching each pattern one by one in order.
+    QCOMPARE(indexes, matchOneByOne(patterns, keys, from));
+
+    QStringList matchedPatterns;
+    for (const int idx : indexes) {
+        matchedPatterns << patterns[idx].first;
+    }
+    matchedPatterns.sort();
+    expectedPatterns.sort();
+    QCOMPARE(matchedPatterns, expectedPatterns);
+
+    // Capacity is kept.
+    matcher.match(QStringLiteral("v"), 0, indexes);
+    QVERIFY(indexes.isEmpty());
+}
+
+void TestCommandMatcher::testRegexLiteralPrefix()
+{
+    // Quantifiers which may drop the previous character and alternations.
+    const QVector<QPair<QString, bool>> patterns = {
+        {"ab*c", true}, {"ab?c", true}, {"ab{0,2}c", true}, {"abc+", true},
+        {"x|yz", true}, {"a\\|b", true}, {"[|]z", true}, {"(ab|cd)e", true},
+        {"abd", false}, {"ac", false}
+    };
+    const auto matcher = getMatcher(patterns);
+
+    const QStringList keysList = {
+        "a", "ab", "ac", "abc", "abbc", "abbbc", "abcc", "x", "y", "yz", "a|", "a|b",
+        "|", "|z", "c", "cde", "abe", "abd", "z"
+    };
+    QVector<int> indexes;
+    for (const auto &keys : keysList) {
+        matcher.match(keys, 0, indexes);
+        QCOMPARE(indexes, matchOneByOne(patterns, keys, 0));
+    }
+
+    matcher.match(QStringLiteral("ac"), 0, indexes);
+    QCOMPARE(indexes, (QVector<int>{0, 1, 2, 9}));
+
+    matcher.match(QStringLiteral("yz"), 0, indexes);
+    QCOMPARE(indexes, (QVector<int>{4}));
+}
+
+void TestCommandMatcher::testMatchesExact()
+{
+    CommandMatcher matcher;
+    matcher.addPattern(QStringLiteral("d"), false);
+    matcher.addPattern(QStringLiteral("dd"), false);
+    matcher.addPattern(QStringLiteral("r."), true);
+
+    QVERIFY(matcher.matchesExact(0, QStringLiteral("d"), 0));
+    QVERIFY(!matcher.matchesExact(0, QStringLiteral("dd"), 0));
+    QVERIFY(matcher.matchesExact(0, QStringLiteral("dd"), 1));
+    QVERIFY(matcher.matchesExact(1, QStringLiteral("dd"), 0));
+    QVERIFY(!matcher.matchesExact(2, QStringLiteral("r"), 0));
+    QVERIFY(matcher.matchesExact(2, QStringLiteral("r\n"), 0));
+    QVERIFY(matcher.matchesExact(2, QStringLiteral("drx"), 1));
+    QVERIFY(!matcher.matchesExact(2, QStringLiteral("rxy"), 0));
+}
+
+void TestCommandMatcher::benchmarkDispatch_data()
+{
+    QTest::addColumn<bool>("viaMatcher");
+
+    QTest::newRow("per pattern") << false;
+    QTest::newRow("matcher") << true;
+}
+
+void TestCommandMatcher::benchmarkDispatch()
+{
+    QFETCH(bool, viaMatcher);
+
+    const auto patterns = getNormalViModePatterns();
+    const auto matcher = getMatcher(patterns);
+
+    QString macro;
+    for (int i = 0; i < 2000; ++i) {
+        macro += QStringLiteral("jjwwdwciwxrxggGdd}{fxtyi(yy`aguu");
+    }
+
+    int executed = 0;
+    QBENCHMARK {
+        executed = 0;
+        QString keys;
+        QVector<int> indexes;
+        for (const auto key : macro) {
+            keys.append(key);
+            if (viaMatcher) {
+                matcher.match(keys, 0, indexes);
+            } else {
+                indexes.resize(0);
+                for (int i = 0; i < patterns.size(); ++i) {
+                    const auto &pattern = patterns[i];
+                    if (pattern.second ? CommandMatcher::regexMatches(CommandMatcher::compileRegex(pattern.first), keys, 0)
+                                       : CommandMatcher::literalMatches(pattern.first, keys, 0)) {
+                        indexes.append(i);
+                    }
+                }
+            }
+
+            if (indexes.isEmpty()) {
+                keys.clear();
+            } else if (indexes.size() == 1 && matcher.matchesExact(indexes.first(), keys, 0)) {
+                ++executed;
+                keys.clear();
+            }
+        }
+    }
+    QVERIFY(executed > 0);
+}
+
+QTEST_MAIN(tests::TestCommandMatcher)
@@ -0,0 +1,29 @@
+#ifndef TESTS_TEST_COMMANDMATCHER_H
+#define TESTS_TEST_COMMANDMATCHER_H
+
+#include <QtTest>
+
+namespace tests
+{
+    class TestCommandMatcher : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check matched patterns of pending keys, including regular expression patterns.
+        void testMatch_data();
+        void testMatch();
+
+        // Keys could skip the literal-looking part of a regular expression pattern.
+        void testRegexLiteralPrefix();
+
+        void testMatchesExact();
+
+        // Dispatch a long replayed macro of normal mode keys to the commands and motions of
+        // NormalViMode via the matcher, or via matching each pattern one by one with the regular
+        // expression compiled on each call.
+        void benchmarkDispatch_data();
+        void benchmarkDispatch();
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,178 @@
+#include "test_globalstate.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <history.h>
+#include <katevi/completion.h>
+#include <katevi/globalstate.h>
+#include <macros.h>
+#include <registers.h>
+
+using namespace tests;
+
+using namespace KateVi;
+
+static KeyEvent makeKeyEvent(int key, QChar ch)
+{
+    KeyEvent event;
+    event.type = QEvent::KeyPress;
+    event.key = key;
+    event.text = ch;
+    event.toChar = ch;
+    return event;
+}
+
+void TestGlobalState::testStoreRoundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto storeFile = dir.filePath(QStringLiteral("vi/store"));
+
+    {
+        GlobalState state;
+        state.setStoreFile(storeFile);
+
+        // The closing q is dropped.
+        const QList<KeyEvent> keys = {makeKeyEvent(Qt::Key_D, QLatin1Char('d')),
+                                      makeKeyEvent(Qt::Key_W, QLatin1Char('w')),
+                                      makeKeyEvent(Qt::Key_Q, QLatin1Char('q'))};
+        const CompletionList completions = {
+            Completion(QStringLiteral("foo"), false, Completion::PlainText),
+            Completion(QStringLiteral("bar()"), true, Completion::FunctionWithoutArgs)};
+        state.macros()->store(QLatin1Char('a'), keys, completions);
+
+        state.registers()->set(QLatin1Char('b'), QStringLiteral("line\n"), LineWise);
+        state.registers()->set(QLatin1Char('1'), QStringLiteral("deleted"), CharWise);
+
+        state.searchHistory()->append(QStringLiteral("foo"));
+        state.searchHistory()->append(QStringLiteral("bar"));
+        state.commandHistory()->append(QStringLiteral("w"));
+        state.replaceHistory()->append(QStringLiteral("baz"));
+
+        // Written on destruction.
+    }
+
+    QVERIFY(QFile::exists(storeFile));
+
+    GlobalState state;
+    state.setStoreFile(storeFile);
+
+    QCOMPARE(state.macros()->get(QLatin1Char('a')), QStringLiteral("dw"));
+    const auto completions = state.macros()->getCompletions(QLatin1Char('a'));
+    QCOMPARE(completions.size(), 2);
+    QCOMPARE(completions[0].completedText(), QStringLiteral("foo"));
+    QCOMPARE(completions[0].completionType(), Completion::PlainText);
+    QCOMPARE(completions[1].completedText(), QStringLiteral("bar()"));
+    QCOMPARE(completions[1].removeTail(), true);
+    QCOMPARE(completions[1].completionType(), Completion::FunctionWithoutArgs);
+
+    QCOMPARE(state.registers()->getContent(QLatin1Char('b')), QStringLiteral("line\n"));
+    QCOMPARE(state.registers()->getFlag(QLatin1Char('b')), LineWise);
+    QCOMPARE(state.registers()->getContent(QLatin1Char('1')), QStringLiteral("deleted"));
+
+    QCOMPARE(state.searchHistory()->items(), (QStringList{"foo", "bar"}));
+    QCOMPARE(state.commandHistory()->items(), QStringList{"w"});
+    QCOMPARE(state.replaceHistory()->items(), QStringList{"baz"});
+}
+
+void TestGlobalState::testStoreInvalidFile_data()
+{
+    QTest::addColumn<quint32>("magic");
+    QTest::addColumn<quint32>("version");
+    QTest::addColumn<bool>("withData");
+
+    // KVST.
+    const quint32 magic = 0x4b565354;
+
+    QTest::newRow("bad magic") << quint32(0x12345678) << quint32(1) << true;
+    QTest::newRow("newer version") << magic << quint32(2) << true;
+    QTest::newRow("truncated") << magic << quint32(1) << false;
+}
+
+void TestGlobalState::testStoreInvalidFile()
+{
+    QFETCH(quint32, magic);
+    QFETCH(quint32, version);
+    QFETCH(bool, withData);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto storeFile = dir.filePath(QStringLiteral("store"));
+
+    {
+        QFile file(storeFile);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_12);
+        stream << magic << version;
+        if (withData) {
+            // Looks like valid macros.
+            stream << QStringList{"a"} << QStringList{"dw"} << QStringList{"0"};
+        } else {
+            // Cut in the middle of the macros.
+            stream << quint32(3);
+        }
+    }
+
+    QByteArray content;
+    {
+        QFile file(storeFile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        content = file.readAll();
+    }
+
+    {
+        GlobalState state;
+        state.setStoreFile(storeFile);
+
+        QVERIFY(state.macros()->get(QLatin1Char('a')).isEmpty());
+        QVERIFY(state.registers()->getContent(QLatin1Char('a')).isEmpty());
+        QVERIFY(state.searchHistory()->items().isEmpty());
+        QVERIFY(state.commandHistory()->items().isEmpty());
+        QVERIFY(state.replaceHistory()->items().isEmpty());
+
+        // Still usable.
+        state.searchHistory()->append(QStringLiteral("foo"));
+        QCOMPARE(state.searchHistory()->items(), QStringList{"foo"});
+    }
+
+    // Not overwritten by the changes above.
+    QFile file(storeFile);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), content);
+}
+
+void TestGlobalState::testStoreNotWrittenIfUnchanged()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto storeFile = dir.filePath(QStringLiteral("store"));
+
+    {
+        GlobalState state;
+        state.setStoreFile(storeFile);
+        state.searchHistory()->append(QStringLiteral("foo"));
+    }
+
+    // Back date the file to tell whether it is written again.
+    const auto oldTime = QDateTime::currentDateTime().addDays(-1);
+    {
+        QFile file(storeFile);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(oldTime, QFileDevice::FileModificationTime));
+    }
+
+    {
+        GlobalState state;
+        state.setStoreFile(storeFile);
+        QCOMPARE(state.searchHistory()->items(), QStringList{"foo"});
+    }
+
+    QCOMPARE(QFileInfo(storeFile).lastModified().toSecsSinceEpoch(), oldTime.toSecsSinceEpoch());
+}
+
+QTEST_MAIN(tests::TestGlobalState)
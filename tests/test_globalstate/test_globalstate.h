@@ -0,0 +1,25 @@
+#ifndef TESTS_TEST_GLOBALSTATE_H
+#define TESTS_TEST_GLOBALSTATE_H
+
+#include <QtTest>
+
+namespace tests
+{
+    class TestGlobalState : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check macros, registers and histories written to the store file and read back.
+        void testStoreRoundTrip();
+
+        // Check that a store file of unknown magic or version, or a truncated one, is ignored
+        // and survives a GlobalState lifetime untouched.
+        void testStoreInvalidFile_data();
+        void testStoreInvalidFile();
+
+        // Check that the store file is not rewritten if nothing changed.
+        void testStoreNotWrittenIfUnchanged();
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,178 @@
+#include "test_mappings.h"
+
+#include <QRandomGenerator>
+#include <QSet>
+
+#include <keyparser.h>
+#include <mappings.h>
+
+using namespace tests;
+
+using namespace KateVi;
+
+static const Mappings::MappingMode c_mode = Mappings::NormalModeMapping;
+
+// Return "full", "partial", "both" or "none".
+static QString matchMapping(const Mappings &mappings, const QString &keys)
+{
+    bool isFullMapping = false;
+    bool isPartialMapping = false;
+    mappings.match(c_mode, KeyParser::self()->encodeKeySequence(keys), isFullMapping, isPartialMapping);
+    if (isFullMapping) {
+        return isPartialMapping ? QStringLiteral("both") : QStringLiteral("full");
+    }
+    return isPartialMapping ? QStringLiteral("partial") : QStringLiteral("none");
+}
+
+void TestMappings::testAddRemove()
+{
+    Mappings mappings;
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("none"));
+
+    mappings.add(c_mode, "ab", "x", Mappings::Recursive);
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("full"));
+    QCOMPARE(matchMapping(mappings, "abc"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "b"), QStringLiteral("none"));
+    QCOMPARE(mappings.get(c_mode, "ab"), QStringLiteral("x"));
+
+    // Special keys.
+    mappings.add(c_mode, "<c-a>x", "y", Mappings::NonRecursive);
+    QCOMPARE(matchMapping(mappings, "<c-a>"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "<c-a>x"), QStringLiteral("full"));
+    QVERIFY(!mappings.isRecursive(c_mode, KeyParser::self()->encodeKeySequence("<c-a>x")));
+
+    // Replacing one keeps it once.
+    mappings.add(c_mode, "ab", "z", Mappings::Recursive);
+    mappings.remove(c_mode, "ab");
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("none"));
+    QVERIFY(mappings.get(c_mode, "ab").isEmpty());
+
+    // Removing a missing one changes nothing.
+    mappings.remove(c_mode, "ab");
+    mappings.remove(c_mode, "<c-a>");
+    QCOMPARE(matchMapping(mappings, "<c-a>x"), QStringLiteral("full"));
+
+    mappings.add(c_mode, "ab", "x", Mappings::Recursive);
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("full"));
+
+    mappings.clear(c_mode);
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "<c-a>"), QStringLiteral("none"));
+    QVERIFY(mappings.getAll(c_mode).isEmpty());
+}
+
+void TestMappings::testPrefix()
+{
+    Mappings mappings;
+    mappings.add(c_mode, "a", "1", Mappings::Recursive);
+    mappings.add(c_mode, "abc", "3", Mappings::Recursive);
+    mappings.add(c_mode, "ab", "2", Mappings::Recursive);
+    mappings.add(c_mode, "b", "4", Mappings::Recursive);
+
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("both"));
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("both"));
+    QCOMPARE(matchMapping(mappings, "abc"), QStringLiteral("full"));
+    QCOMPARE(matchMapping(mappings, "abd"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "b"), QStringLiteral("full"));
+    QCOMPARE(matchMapping(mappings, "c"), QStringLiteral("none"));
+
+    // Other modes are not affected.
+    bool isFullMapping = true;
+    bool isPartialMapping = true;
+    mappings.match(Mappings::InsertModeMapping, "a", isFullMapping, isPartialMapping);
+    QVERIFY(!isFullMapping);
+    QVERIFY(!isPartialMapping);
+}
+
+void TestMappings::testRemoveSharedPrefix()
+{
+    Mappings mappings;
+    mappings.add(c_mode, "ab", "1", Mappings::Recursive);
+    mappings.add(c_mode, "ac", "2", Mappings::Recursive);
+    mappings.add(c_mode, "abcd", "3", Mappings::Recursive);
+
+    mappings.remove(c_mode, "ab");
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "abc"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "abcd"), QStringLiteral("full"));
+    QCOMPARE(matchMapping(mappings, "ac"), QStringLiteral("full"));
+
+    mappings.remove(c_mode, "abcd");
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "abc"), QStringLiteral("none"));
+    QCOMPARE(matchMapping(mappings, "ac"), QStringLiteral("full"));
+
+    mappings.remove(c_mode, "ac");
+    QCOMPARE(matchMapping(mappings, "a"), QStringLiteral("none"));
+
+    // Nodes kept after removal are reused.
+    mappings.add(c_mode, "abc", "4", Mappings::Recursive);
+    QCOMPARE(matchMapping(mappings, "ab"), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, "abc"), QStringLiteral("full"));
+    QCOMPARE(matchMapping(mappings, "abcd"), QStringLiteral("none"));
+}
+
+void TestMappings::testLeader()
+{
+    Mappings mappings;
+    mappings.setLeader(QLatin1Char(','));
+    mappings.add(c_mode, "<leader>w", ":w<cr>", Mappings::Recursive);
+
+    QCOMPARE(matchMapping(mappings, ","), QStringLiteral("partial"));
+    QCOMPARE(matchMapping(mappings, ",w"), QStringLiteral("full"));
+
+    // The replaced one is temporary.
+    QVERIFY(mappings.get(c_mode, ",w").isEmpty());
+    QVERIFY(!mappings.get(c_mode, ",w", false, true).isEmpty());
+
+    mappings.remove(c_mode, ",w");
+    QCOMPARE(matchMapping(mappings, ",w"), QStringLiteral("none"));
+}
+
+void TestMappings::testRandomEdits()
+{
+    const QString alphabet = QStringLiteral("abc");
+    QRandomGenerator rand(7);
+    const auto randomKeys = [&rand, &alphabet]() {
+        QString keys;
+        const int len = rand.bounded(1, 5);
+        for (int i = 0; i < len; ++i) {
+            keys += alphabet.at(rand.bounded(alphabet.size()));
+        }
+        return keys;
+    };
+
+    Mappings mappings;
+    QSet<QString> added;
+    for (int i = 0; i < 500; ++i) {
+        const auto keys = randomKeys();
+        if (rand.bounded(3) == 0) {
+            mappings.remove(c_mode, keys);
+            added.remove(keys);
+        } else {
+            mappings.add(c_mode, keys, "x", Mappings::Recursive);
+            added.insert(keys);
+        }
+
+        const auto probe = randomKeys();
+        bool isFullMapping = false;
+        bool isPartialMapping = false;
+        mappings.match(c_mode, probe, isFullMapping, isPartialMapping);
+
+        bool expectedPartialMapping = false;
+        for (const auto &from : added) {
+            if (from.size() > probe.size() && from.startsWith(probe)) {
+                expectedPartialMapping = true;
+                break;
+            }
+        }
+        QCOMPARE(isFullMapping, added.contains(probe));
+        QCOMPARE(isPartialMapping, expectedPartialMapping);
+    }
+}
+
+QTEST_MAIN(tests::TestMappings)
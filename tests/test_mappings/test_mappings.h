@@ -0,0 +1,29 @@
+#ifndef TESTS_TEST_MAPPINGS_H
+#define TESTS_TEST_MAPPINGS_H
+
+#include <QtTest>
+
+namespace tests
+{
+    class TestMappings : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check full and partial matches after adding and removing mappings.
+        void testAddRemove();
+
+        // Check mappings which are prefixes of others.
+        void testPrefix();
+
+        // Removing a mapping should keep others sharing its prefix.
+        void testRemoveSharedPrefix();
+
+        // Mappings with <leader> are matched with the leader replaced.
+        void testLeader();
+
+        // Compare with checking all the mappings one by one after random adds and removes.
+        void testRandomEdits();
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,499 @@
+#include "test_pegparser.h"
+
+#include <QRandomGenerator>
+#include <QScrollBar>
+#include <QSignalSpy>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThread>
+
+#include <editjournal.h>
+#include <vtextedit/pegmarkdownhighlighter.h>
+#include <vtextedit/texteditorconfig.h>
+
+using namespace tests;
+
+using namespace vte;
+
+static const int c_numOfThreads = 8;
+
+static const int c_numOfParsesPerThread = 10;
+
+namespace
+{
+    // A view of the first lines of the document without any widget.
+    class HighlighterInterface : public PegMarkdownHighlighterInterface
+    {
+    public:
+        explicit HighlighterInterface(QTextDocument *p_doc)
+            : m_doc(p_doc)
+        {
+        }
+
+        QTextCursor textCursor() const Q_DECL_OVERRIDE
+        {
+            return QTextCursor(m_doc);
+        }
+
+        QPair<int, int> visibleBlockRange() const Q_DECL_OVERRIDE
+        {
+            return qMakePair(0, 50);
+        }
+
+        void ensureCursorVisible() Q_DECL_OVERRIDE
+        {
+        }
+
+        QScrollBar *verticalScrollBar() const Q_DECL_OVERRIDE
+        {
+            return &m_scrollBar;
+        }
+
+    private:
+        QTextDocument *m_doc = nullptr;
+
+        mutable QScrollBar m_scrollBar;
+    };
+}
+
+QSharedPointer<peg::PegParseConfig> TestPegParser::createConfig(TimeStamp p_timeStamp, int p_numOfSections)
+{
+    // Nested display formulas exercise the parser state kept during parsing.
+    const QString section = QStringLiteral("# Header\n\n"
+                                           "Some *emphasis*, **strong**, `code` and $x^2$ with [link][ref].\n\n"
+                                           "$$\n\\begin{aligned}\n$$\na = b\n$$\n\\end{aligned}\n$$\n\n"
+                                           "- item\n- ~~strike~~ and ==mark==\n\n"
+                                           "```cpp\nint main() {}\n```\n\n"
+                                           "| a | b |\n| - | - |\n| 1 | 2 |\n\n"
+                                           "> quote with unicode 中文 and ![image](a.png)\n\n"
+                                           "* * *\n\n"
+                                           "[ref]: http://example.com\n\n");
+    QString text;
+    for (int i = 0; i < p_numOfSections; ++i) {
+        text += section;
+    }
+
+    auto config = QSharedPointer<peg::PegParseConfig>::create();
+    config->m_timeStamp = p_timeStamp;
+    config->m_data = text;
+    config->m_numOfBlocks = text.count(QLatin1Char('\n')) + 1;
+    config->m_extensions = pmh_EXT_NOTES | pmh_EXT_STRIKE | pmh_EXT_MARK | pmh_EXT_TABLE
+                           | pmh_EXT_MATH | pmh_EXT_MATH_RAW;
+    return config;
+}
+
+QString TestPegParser::dumpElements(const QSharedPointer<peg::PegParseResult> &p_result)
+{
+    QString dump;
+    for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+        for (const auto &elem : p_result->m_elements[i]) {
+            dump += QStringLiteral("%1:%2-%3\n").arg(i).arg(elem.m_startPos).arg(elem.m_endPos);
+        }
+    }
+    return dump;
+}
+
+void TestPegParser::testConcurrentParse()
+{
+    auto config = createConfig(1);
+    const auto expected = dumpElements(peg::PegParser::parse(config));
+    QVERIFY(!expected.isEmpty());
+
+    QVector<QStringList> dumps(c_numOfThreads);
+    QVector<QThread *> threads;
+    for (int i = 0; i < c_numOfThreads; ++i) {
+        auto &dump = dumps[i];
+        threads.append(QThread::create([config, &dump]() {
+            for (int j = 0; j < c_numOfParsesPerThread; ++j) {
+                dump << dumpElements(peg::PegParser::parse(config));
+            }
+        }));
+    }
+
+    for (auto th : threads) {
+        th->start();
+    }
+
+    for (auto th : threads) {
+        th->wait();
+        delete th;
+    }
+
+    for (const auto &dump : dumps) {
+        QCOMPARE(dump.size(), c_numOfParsesPerThread);
+        for (const auto &one : dump) {
+            QCOMPARE(one, expected);
+        }
+    }
+}
+
+void TestPegParser::testAsyncParseWithWorkers()
+{
+    peg::PegParser parser(c_numOfThreads);
+    QSharedPointer<peg::PegParseResult> result;
+    connect(&parser, &peg::PegParser::parseResultReady,
+            this, [&result](const QSharedPointer<peg::PegParseResult> &p_result) {
+                if (result.isNull() || result->m_timeStamp < p_result->m_timeStamp) {
+                    result = p_result;
+                }
+            });
+
+    const TimeStamp lastTimeStamp = c_numOfThreads * 2;
+    for (TimeStamp ts = 1; ts <= lastTimeStamp; ++ts) {
+        parser.parseAsync(createConfig(ts));
+    }
+
+    const auto expected = dumpElements(peg::PegParser::parse(createConfig(lastTimeStamp)));
+
+    QTRY_VERIFY_WITH_TIMEOUT(!result.isNull() && result->m_timeStamp == lastTimeStamp, 10000);
+    QCOMPARE(dumpElements(result), expected);
+}
+
+void TestPegParser::parseBlocksHighlightsViaDocument(QVector<QVector<peg::HLUnit>> &p_blocksHighlights,
+                                                     const QTextDocument *p_doc,
+                                                     const QSharedPointer<peg::PegParseResult> &p_result)
+{
+    p_blocksHighlights.resize(p_result->m_numOfBlocks);
+    const int nrChar = p_doc->characterCount();
+    for (int i = 0; i < pmh_NUM_LANG_TYPES; ++i) {
+        for (const auto &elem : p_result->m_elements[i]) {
+            const int pos = elem.m_startPos;
+            const int end = qMin(elem.m_endPos, nrChar - 1);
+            auto block = p_doc->findBlock(pos);
+            const int startBlockNum = block.blockNumber();
+            const int endBlockNum = p_doc->findBlock(end - 1).blockNumber();
+            while (block.isValid() && block.blockNumber() <= endBlockNum) {
+                const int blockNum = block.blockNumber();
+                peg::HLUnit unit;
+                if (blockNum == startBlockNum) {
+                    unit.start = pos - block.position();
+                    unit.length = (startBlockNum == endBlockNum) ? (end - pos) : (block.length() - unit.start);
+                } else if (blockNum == endBlockNum) {
+                    unit.start = 0;
+                    unit.length = end - block.position();
+                } else {
+                    unit.start = 0;
+                    unit.length = block.length();
+                }
+                unit.styleIndex = i;
+                p_blocksHighlights[blockNum].append(unit);
+                block = block.next();
+            }
+        }
+    }
+
+    for (auto &units : p_blocksHighlights) {
+        std::sort(units.begin(), units.end(), peg::HLUnitLess());
+    }
+}
+
+void TestPegParser::testBlocksHighlights()
+{
+    auto config = createConfig(1, 20);
+    auto result = peg::PegParser::parse(config);
+    QVERIFY(result->hasBlockPositions());
+
+    QTextDocument doc(config->m_data);
+    QCOMPARE(result->m_blockPositions.size(), doc.blockCount() + 1);
+    for (auto block = doc.begin(); block.isValid(); block = block.next()) {
+        QCOMPARE(result->m_blockPositions[block.blockNumber()], block.position());
+    }
+    QCOMPARE(result->m_blockPositions.last(), doc.characterCount());
+
+    QVector<QVector<peg::HLUnit>> expected;
+    parseBlocksHighlightsViaDocument(expected, &doc, result);
+
+    QVector<QVector<peg::HLUnit>> highlights;
+    result->parseBlocksHighlights(highlights);
+    QCOMPARE(highlights.size(), expected.size());
+    for (int i = 0; i < highlights.size(); ++i) {
+        // Order of units with the same range is not specified.
+        QStringList units, expectedUnits;
+        for (const auto &unit : highlights[i]) {
+            units << QStringLiteral("%1:%2-%3").arg(unit.styleIndex).arg(unit.start).arg(unit.length);
+        }
+        for (const auto &unit : expected[i]) {
+            expectedUnits << QStringLiteral("%1:%2-%3").arg(unit.styleIndex).arg(unit.start).arg(unit.length);
+        }
+        units.sort();
+        expectedUnits.sort();
+        QCOMPARE(units, expectedUnits);
+    }
+}
+
+void TestPegParser::testBlockTexts()
+{
+    auto config = createConfig(1, 20);
+    auto result = peg::PegParser::parse(config);
+    QVERIFY(result->hasBlockPositions());
+    QCOMPARE(result->m_text, config->m_data);
+
+    QTextDocument doc(config->m_data);
+    for (auto block = doc.begin(); block.isValid(); block = block.next()) {
+        QCOMPARE(result->blockText(block.blockNumber()), block.text());
+        QCOMPARE(result->findBlockIndex(block.position()), block.blockNumber());
+        QCOMPARE(result->findBlockIndex(block.position() + block.length() - 1), block.blockNumber());
+    }
+
+    // Not matched with the document.
+    result->m_numOfBlocks += 1;
+    result->setText(config->m_data);
+    QVERIFY(!result->hasBlockPositions());
+    QVERIFY(result->m_text.isEmpty());
+}
+
+void TestPegParser::testEditJournal()
+{
+    QRandomGenerator rand(22);
+    QStringList texts;
+    texts << QStringLiteral("# Header\n\nSome text.\n");
+
+    EditJournal journal;
+    const int numOfEdits = 200;
+    for (int ts = 1; ts <= numOfEdits; ++ts) {
+        QString text = texts.last();
+        ContentsChange change;
+        change.m_position = rand.bounded(text.size() + 1);
+        change.m_charsRemoved = rand.bounded(qMin(5, text.size() - change.m_position) + 1);
+        const QString added = QString(rand.bounded(6), QChar('a' + ts % 26));
+        change.m_charsAdded = added.size();
+        text.replace(change.m_position, change.m_charsRemoved, added);
+        texts << text;
+        journal.append(ts, change);
+    }
+
+    for (int from = 0; from <= numOfEdits; from += 7) {
+        ContentsChange change;
+        QVERIFY(journal.changeSince(from, numOfEdits, change));
+        const auto &oldText = texts[from];
+        const auto &newText = texts[numOfEdits];
+        QCOMPARE(newText.size() - oldText.size(), change.m_charsAdded - change.m_charsRemoved);
+        QCOMPARE(newText.left(change.m_position), oldText.left(change.m_position));
+        QCOMPARE(newText.mid(change.m_position + change.m_charsAdded),
+                 oldText.mid(change.m_position + change.m_charsRemoved));
+    }
+
+    ContentsChange change;
+    QVERIFY(journal.changeSince(numOfEdits, numOfEdits, change));
+    QVERIFY(EditJournal::isEmpty(change));
+
+    // Changes dropped from the journal could not be merged.
+    journal.trim(100);
+    QVERIFY(!journal.changeSince(50, numOfEdits, change));
+    QVERIFY(journal.changeSince(100, numOfEdits, change));
+    QVERIFY(!journal.changeSince(100, numOfEdits + 1, change));
+}
+
+QSharedPointer<peg::PegParseConfig> TestPegParser::createIncrementalConfig(
+    const QSharedPointer<peg::PegParseResult> &p_baseResult, const QString &p_baseText, QString &p_text)
+{
+    // Replace the paragraph line of a section in the middle, as the highlighter re-parses the
+    // top-level blocks touched by an edit.
+    const auto header = QStringLiteral("Some *emphasis*");
+    const int numOfSections = p_baseText.count(header);
+    int start = -1;
+    for (int i = 0; i < numOfSections / 2; ++i) {
+        start = p_baseText.indexOf(header, start + 1);
+    }
+    if (start <= 0) {
+        return nullptr;
+    }
+
+    const int lineEnd = p_baseText.indexOf(QLatin1Char('\n'), start);
+    const QString region = QStringLiteral("New ![image](b.png), $y$, **strong** and [link][ref].");
+    p_text = p_baseText;
+    p_text.replace(start, lineEnd - start, region);
+
+    auto config = createConfig(p_baseResult->m_timeStamp + 1, 0);
+    config->m_numOfBlocks = p_baseResult->m_numOfBlocks;
+    config->m_offset = start;
+    config->m_baseResult = p_baseResult;
+    config->m_baseEnd = lineEnd + 1;
+    config->m_regionLength = region.size();
+    config->m_delta = p_text.size() - p_baseText.size();
+    // Reference definitions to resolve the links in the region.
+    config->m_data = region + QStringLiteral("\n\n[ref]: http://example.com");
+    return config;
+}
+
+void TestPegParser::testIncrementalParse()
+{
+    const int numOfSections = 20;
+    auto baseConfig = createConfig(1, numOfSections);
+    auto baseResult = peg::PegParser::parse(baseConfig);
+    QVERIFY(baseResult->hasBlockPositions());
+
+    QString text;
+    auto config = createIncrementalConfig(baseResult, baseConfig->m_data, text);
+    QVERIFY(config);
+
+    peg::PegParser parser(1);
+    QSharedPointer<peg::PegParseResult> result;
+    connect(&parser, &peg::PegParser::parseResultReady,
+            this, [&result](const QSharedPointer<peg::PegParseResult> &p_result) {
+                result = p_result;
+            });
+    parser.parseAsync(config);
+    QTRY_VERIFY_WITH_TIMEOUT(!result.isNull(), 10000);
+    QVERIFY(!result->m_incrementalFailed);
+
+    auto fullConfig = createConfig(2, numOfSections);
+    fullConfig->m_data = text;
+    auto fullResult = peg::PegParser::parse(fullConfig);
+
+    // Elements of each type are in the same order.
+    QCOMPARE(dumpElements(result), dumpElements(fullResult));
+
+    QCOMPARE(result->m_imageRegions, fullResult->m_imageRegions);
+    QCOMPARE(result->m_headerRegions, fullResult->m_headerRegions);
+    QCOMPARE(result->m_inlineEquationRegions, fullResult->m_inlineEquationRegions);
+    QCOMPARE(result->m_displayFormulaRegions, fullResult->m_displayFormulaRegions);
+    QCOMPARE(result->m_hruleRegions, fullResult->m_hruleRegions);
+    QCOMPARE(result->m_tableRegions, fullResult->m_tableRegions);
+    QCOMPARE(result->m_tableHeaderRegions, fullResult->m_tableHeaderRegions);
+    QCOMPARE(result->m_tableBorderRegions, fullResult->m_tableBorderRegions);
+    QCOMPARE(result->m_codeBlockRegions, fullResult->m_codeBlockRegions);
+
+    QCOMPARE(result->m_sortedElements.size(), fullResult->m_sortedElements.size());
+    for (int i = 0; i < result->m_sortedElements.size(); ++i) {
+        const auto &ele = result->m_sortedElements[i];
+        const auto &fullEle = fullResult->m_sortedElements[i];
+        QCOMPARE(ele.m_startPos, fullEle.m_startPos);
+        QCOMPARE(ele.m_endPos, fullEle.m_endPos);
+        QCOMPARE(ele.m_styleIndex, fullEle.m_styleIndex);
+    }
+
+    QVERIFY(result->hasBlockPositions());
+    QCOMPARE(result->m_text, text);
+    QCOMPARE(result->m_blockPositions, fullResult->m_blockPositions);
+
+    // Parsed synchronously.
+    auto syncResult = peg::PegParser::parse(config);
+    QVERIFY(!syncResult->m_incrementalFailed);
+    QCOMPARE(dumpElements(syncResult), dumpElements(fullResult));
+}
+
+void TestPegParser::benchmarkIncrementalParse_data()
+{
+    QTest::addColumn<int>("numOfSections");
+
+    // Each section has about 25 lines.
+    const int lines[] = {10000, 50000, 200000};
+    for (int num : lines) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 lines").arg(num))) << num / 25;
+    }
+}
+
+void TestPegParser::benchmarkIncrementalParse()
+{
+    QFETCH(int, numOfSections);
+
+    auto baseConfig = createConfig(1, numOfSections);
+    auto baseResult = peg::PegParser::parse(baseConfig);
+    QVERIFY(baseResult->hasBlockPositions());
+
+    QString text;
+    auto config = createIncrementalConfig(baseResult, baseConfig->m_data, text);
+    QVERIFY(config);
+
+    // Only one paragraph is parsed. The elements, regions and block positions are spliced via
+    // binary search and bulk copies instead of being rebuilt and sorted from the whole document.
+    QSharedPointer<peg::PegParseResult> result;
+    QBENCHMARK {
+        result = peg::PegParser::parse(config);
+    }
+    QVERIFY(!result->m_incrementalFailed);
+    QVERIFY(result->hasBlockPositions());
+    QCOMPARE(result->m_text, text);
+}
+
+void TestPegParser::benchmarkHandleParseResult_data()
+{
+    QTest::addColumn<int>("numOfSections");
+    QTest::addColumn<bool>("progressive");
+
+    // Each section has about 25 lines.
+    const int lines[] = {10000, 50000, 200000};
+    for (int num : lines) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 lines").arg(num))) << num / 25 << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 lines progressive").arg(num))) << num / 25 << true;
+    }
+}
+
+void TestPegParser::benchmarkHandleParseResult()
+{
+    QFETCH(int, numOfSections);
+    QFETCH(bool, progressive);
+
+    const int timeout = 60000;
+
+    QTextDocument doc;
+    HighlighterInterface interface(&doc);
+
+    auto config = QSharedPointer<peg::HighlighterConfig>::create();
+    config->m_mathExtEnabled = true;
+    config->m_codeBlockHighlightEnabled = false;
+    config->m_progressiveHighlightEnabled = progressive;
+
+    PegMarkdownHighlighter highlighter(&interface, &doc, TextEditorConfig::defaultTheme(), nullptr, config);
+    // By name to use the meta object of the highlighter instance.
+    QSignalSpy spy(&highlighter, SIGNAL(highlightCompleted()));
+
+    doc.setPlainText(createConfig(1, numOfSections)->m_data);
+    highlighter.updateHighlight();
+    QVERIFY(spy.wait(timeout));
+
+    // Type at the end of a paragraph in the middle of the document and wait until the new result
+    // is applied.
+    auto block = doc.findBlockByNumber(doc.blockCount() / 2);
+    while (!block.text().startsWith(QStringLiteral("Some "))) {
+        block = block.next();
+    }
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::EndOfBlock);
+    QBENCHMARK {
+        spy.clear();
+        cursor.insertText(QStringLiteral("a"));
+        highlighter.updateHighlight();
+        QVERIFY(spy.wait(timeout));
+    }
+    QCOMPARE(highlighter.getHeaderRegions().size(), numOfSections);
+}
+
+void TestPegParser::benchmarkBlocksHighlights_data()
+{
+    QTest::addColumn<int>("numOfSections");
+    QTest::addColumn<bool>("viaDocument");
+
+    // Each section has about 25 lines.
+    const int lines[] = {10000, 50000, 200000};
+    for (int num : lines) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 lines sweep").arg(num))) << num / 25 << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 lines findBlock").arg(num))) << num / 25 << true;
+    }
+}
+
+void TestPegParser::benchmarkBlocksHighlights()
+{
+    QFETCH(int, numOfSections);
+    QFETCH(bool, viaDocument);
+
+    auto config = createConfig(1, numOfSections);
+    auto result = peg::PegParser::parse(config);
+    QVERIFY(result->hasBlockPositions());
+
+    QTextDocument doc(config->m_data);
+    QVector<QVector<peg::HLUnit>> highlights;
+    QBENCHMARK {
+        highlights.clear();
+        if (viaDocument) {
+            parseBlocksHighlightsViaDocument(highlights, &doc, result);
+        } else {
+            result->parseBlocksHighlights(highlights);
+        }
+    }
+    QCOMPARE(highlights.size(), doc.blockCount());
+}
+
+QTEST_MAIN(tests::TestPegParser)
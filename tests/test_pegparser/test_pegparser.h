@@ -0,0 +1,69 @@
+#ifndef TESTS_TEST_PEGPARSER_H
+#define TESTS_TEST_PEGPARSER_H
+
+#include <QtTest>
+
+#include <pegparser.h>
+
+namespace tests
+{
+    class TestPegParser : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Run several parses concurrently and check they get the same result.
+        void testConcurrentParse();
+
+        // Keep more workers than the default busy and check the latest result arrives.
+        void testAsyncParseWithWorkers();
+
+        // Check mapping elements to blocks via block positions against QTextDocument.
+        void testBlocksHighlights();
+
+        // Check the text snapshot of a parse result against QTextDocument.
+        void testBlockTexts();
+
+        // Check changes merged from the edit journal against the texts of each time stamp.
+        void testEditJournal();
+
+        // Check that splicing a re-parsed region gets the same result as a full parse of the
+        // edited text.
+        void testIncrementalParse();
+
+        // Map elements to blocks of documents of different number of lines.
+        void benchmarkBlocksHighlights_data();
+        void benchmarkBlocksHighlights();
+
+        // Re-parse one paragraph of documents of different number of lines, whose cost should
+        // not grow with the document.
+        void benchmarkIncrementalParse_data();
+        void benchmarkIncrementalParse();
+
+        // Parse and apply the result to a QTextDocument via PegMarkdownHighlighter after one
+        // keystroke for documents of different number of lines, with progressive highlight on
+        // and off.
+        void benchmarkHandleParseResult_data();
+        void benchmarkHandleParseResult();
+
+    private:
+        static QSharedPointer<vte::peg::PegParseConfig> createConfig(vte::TimeStamp p_timeStamp,
+                                                                    int p_numOfSections = 200);
+
+        // Replace the paragraph of the middle section of @p_baseText, parsed as @p_baseResult.
+        // @p_text will be the edited text.
+        static QSharedPointer<vte::peg::PegParseConfig> createIncrementalConfig(
+            const QSharedPointer<vte::peg::PegParseResult> &p_baseResult,
+            const QString &p_baseText,
+            QString &p_text);
+
+        // Dump all the elements of @p_result for comparison.
+        static QString dumpElements(const QSharedPointer<vte::peg::PegParseResult> &p_result);
+
+        // Map elements to blocks via QTextDocument::findBlock() as a reference.
+        static void parseBlocksHighlightsViaDocument(QVector<QVector<vte::peg::HLUnit>> &p_blocksHighlights,
+                                                     const QTextDocument *p_doc,
+                                                     const QSharedPointer<vte::peg::PegParseResult> &p_result);
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,219 @@
+#include "test_syntaxfoldingindex.h"
+
+#include <functional>
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <vtextedit/textblockdata.h>
+
+#include <syntaxfoldingindex.h>
+
+using namespace tests;
+
+using namespace vte;
+
+int TestSyntaxFoldingIndex::findFoldingEndViaScan(QTextDocument *p_doc, int p_blockNumber)
+{
+    auto block = p_doc->findBlockByNumber(p_blockNumber);
+    auto data = TextBlockData::get(block);
+
+    // Search the type of the first folding region which remains pending.
+    int openRegionType = 0;
+    int openRegionOffset = -1;
+    {
+        // <folding id, <offset, count>>.
+        QHash<int, QPair<int, int>> openFoldingMap;
+        for (const auto &folding : data->getFoldings()) {
+            if (folding.isOpen()) {
+                auto it = openFoldingMap.find(folding.m_value);
+                if (it != openFoldingMap.end()) {
+                    ++(it.value().second);
+                } else {
+                    openFoldingMap.insert(folding.m_value, qMakePair(folding.m_offset, 1));
+                }
+            } else {
+                auto it = openFoldingMap.find(-folding.m_value);
+                if (it != openFoldingMap.end()) {
+                    if (it.value().second > 1) {
+                        --(it.value().second);
+                    } else {
+                        openFoldingMap.erase(it);
+                    }
+                }
+            }
+        }
+
+        for (auto it = openFoldingMap.begin(); it != openFoldingMap.end(); ++it) {
+            if (openRegionOffset == -1 || it->first < openRegionOffset) {
+                openRegionType = it.key();
+                openRegionOffset = it->first;
+            }
+        }
+    }
+
+    if (openRegionType == 0) {
+        return -1;
+    }
+
+    // Search the following lines for the matched close folding.
+    int numOfOpenRegions = 1;
+    for (auto nextBlock = block.next(); nextBlock.isValid(); nextBlock = nextBlock.next()) {
+        auto nextData = TextBlockData::get(nextBlock);
+        for (const auto &folding : nextData->getFoldings()) {
+            if (folding.m_value == -openRegionType) {
+                --numOfOpenRegions;
+                if (numOfOpenRegions == 0) {
+                    return nextBlock.blockNumber();
+                }
+            } else if (folding.m_value == openRegionType) {
+                ++numOfOpenRegions;
+            }
+        }
+    }
+
+    return p_doc->blockCount();
+}
+
+// Set random foldings of up to 3 ids to @p_block.
+static void setRandomFoldings(const QTextBlock &p_block)
+{
+    auto rand = QRandomGenerator::global();
+    auto data = TextBlockData::get(p_block);
+    data->clearFoldings();
+    const int cnt = rand->bounded(4);
+    int offset = 0;
+    for (int i = 0; i < cnt; ++i) {
+        offset += rand->bounded(1, 4);
+        const int id = rand->bounded(1, 4);
+        data->addFolding(offset, rand->bounded(2) ? id : -id);
+    }
+}
+
+// Set foldings to @p_doc per line of @p_foldings, where each character is an open folding
+// like `{` `(` `[` or a close one.
+static void setFoldings(QTextDocument *p_doc, const QStringList &p_foldings)
+{
+    const QString opens("{([");
+    const QString closes("})]");
+    auto block = p_doc->firstBlock();
+    for (const auto &line : p_foldings) {
+        auto data = TextBlockData::get(block);
+        data->clearFoldings();
+        for (int i = 0; i < line.size(); ++i) {
+            const int openIdx = opens.indexOf(line[i]);
+            if (openIdx != -1) {
+                data->addFolding(i, openIdx + 1);
+            } else {
+                const int closeIdx = closes.indexOf(line[i]);
+                if (closeIdx != -1) {
+                    data->addFolding(i, -(closeIdx + 1));
+                }
+            }
+        }
+        block = block.next();
+    }
+}
+
+static void verifyIndex(SyntaxFoldingIndex &p_index,
+                        QTextDocument *p_doc,
+                        const std::function<int(QTextDocument *, int)> &p_scan)
+{
+    for (int i = p_doc->blockCount() - 1; i >= 0; --i) {
+        QCOMPARE(p_index.findFoldingEnd(i), p_scan(p_doc, i));
+    }
+    QCOMPARE(p_index.findFoldingEnd(-1), -1);
+    QCOMPARE(p_index.findFoldingEnd(p_doc->blockCount()), -1);
+}
+
+void TestSyntaxFoldingIndex::testFindFoldingEnd_data()
+{
+    QTest::addColumn<QStringList>("foldings");
+    QTest::addColumn<QVector<int>>("ends");
+
+    QTest::newRow("empty") << QStringList{"", "", ""} << QVector<int>{-1, -1, -1};
+    QTest::newRow("simple") << QStringList{"{", "", "}"} << QVector<int>{2, -1, -1};
+    QTest::newRow("nested") << QStringList{"{", "{", "}", "}"} << QVector<int>{3, 2, -1, -1};
+    QTest::newRow("balanced in block") << QStringList{"{}", "{", "}"} << QVector<int>{-1, 2, -1};
+    QTest::newRow("unclosed") << QStringList{"{", "", "("} << QVector<int>{3, -1, 3};
+    QTest::newRow("first by offset") << QStringList{"({", "}", ")"} << QVector<int>{2, -1, -1};
+    QTest::newRow("two in block") << QStringList{"{{", "}", "}"} << QVector<int>{1, -1, -1};
+    QTest::newRow("interleaved") << QStringList{"{", "(", "}", ")"} << QVector<int>{2, 3, -1, -1};
+    QTest::newRow("close first") << QStringList{"}{", "{", "}}"} << QVector<int>{2, 2, -1};
+}
+
+void TestSyntaxFoldingIndex::testFindFoldingEnd()
+{
+    QFETCH(QStringList, foldings);
+    QFETCH(QVector<int>, ends);
+
+    QTextDocument doc;
+    doc.setPlainText(QString("\n").repeated(foldings.size() - 1));
+    QCOMPARE(doc.blockCount(), (int)foldings.size());
+    setFoldings(&doc, foldings);
+
+    SyntaxFoldingIndex index(&doc);
+    for (int i = 0; i < ends.size(); ++i) {
+        QCOMPARE(index.findFoldingEnd(i), ends[i]);
+    }
+
+    verifyIndex(index, &doc, findFoldingEndViaScan);
+}
+
+void TestSyntaxFoldingIndex::testInvalidate()
+{
+    auto rand = QRandomGenerator::global();
+
+    QTextDocument doc;
+    doc.setPlainText(QString("\n").repeated(199));
+    for (auto block = doc.firstBlock(); block.isValid(); block = block.next()) {
+        setRandomFoldings(block);
+    }
+
+    SyntaxFoldingIndex index(&doc);
+    verifyIndex(index, &doc, findFoldingEndViaScan);
+
+    for (int round = 0; round < 200; ++round) {
+        const int blockNumber = rand->bounded(doc.blockCount());
+        auto block = doc.findBlockByNumber(blockNumber);
+        switch (rand->bounded(3)) {
+        case 0:
+            setRandomFoldings(block);
+            break;
+
+        case 1:
+        {
+            QTextCursor cursor(block);
+            cursor.insertBlock();
+            setRandomFoldings(doc.findBlockByNumber(blockNumber));
+            setRandomFoldings(doc.findBlockByNumber(blockNumber + 1));
+            break;
+        }
+
+        default:
+            if (block.next().isValid()) {
+                QTextCursor cursor(block);
+                cursor.setPosition(block.next().position(), QTextCursor::KeepAnchor);
+                cursor.removeSelectedText();
+                setRandomFoldings(doc.findBlockByNumber(blockNumber));
+            }
+            break;
+        }
+
+        // Highlighter rehighlights from the changed block.
+        index.invalidate(blockNumber);
+
+        // Query one block only sometimes to leave the rest scanned lazily.
+        if (rand->bounded(2)) {
+            const int num = rand->bounded(doc.blockCount());
+            QCOMPARE(index.findFoldingEnd(num), findFoldingEndViaScan(&doc, num));
+        } else {
+            verifyIndex(index, &doc, findFoldingEndViaScan);
+        }
+    }
+}
+
+QTEST_MAIN(tests::TestSyntaxFoldingIndex)
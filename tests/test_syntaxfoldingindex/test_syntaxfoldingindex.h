@@ -0,0 +1,28 @@
+#ifndef TESTS_TEST_SYNTAXFOLDINGINDEX_H
+#define TESTS_TEST_SYNTAXFOLDINGINDEX_H
+
+#include <QtTest>
+
+class QTextDocument;
+
+namespace tests
+{
+    class TestSyntaxFoldingIndex : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check the end of the folding starting on each block against a linear scan.
+        void testFindFoldingEnd_data();
+        void testFindFoldingEnd();
+
+        // Check that the index stays consistent with a linear scan on random edits of blocks
+        // and their foldings.
+        void testInvalidate();
+
+    private:
+        // The linear scan replaced by SyntaxFoldingIndex as a reference.
+        static int findFoldingEndViaScan(QTextDocument *p_doc, int p_blockNumber);
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,253 @@
+#include "test_textdocumentlayout.h"
+
+#include <QFontMetricsF>
+#include <QRandomGenerator>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <blockheightindex.h>
+#include <blockwidthindex.h>
+#include <documentresourcemgr.h>
+#include <textdocumentlayout.h>
+
+using namespace tests;
+
+using namespace vte;
+
+static void verifyIndex(const BlockHeightIndex &p_index, const QVector<qreal> &p_heights)
+{
+    QCOMPARE(p_index.size(), p_heights.size());
+
+    qreal offset = 0;
+    for (int i = 0; i < p_heights.size(); ++i) {
+        QCOMPARE(p_index.height(i), p_heights[i]);
+        QCOMPARE(p_index.offset(i), offset);
+        if (p_heights[i] > 0) {
+            QCOMPARE(p_index.findIndex(offset), i);
+            QCOMPARE(p_index.findIndex(offset + p_heights[i] / 2), i);
+        }
+        offset += p_heights[i];
+    }
+    QCOMPARE(p_index.totalHeight(), offset);
+
+    if (p_heights.isEmpty()) {
+        QCOMPARE(p_index.findIndex(0), -1);
+    } else {
+        QCOMPARE(p_index.findIndex(-10), 0);
+        QCOMPARE(p_index.findIndex(offset + 10), p_heights.size() - 1);
+    }
+}
+
+void TestTextDocumentLayout::testBlockHeightIndex()
+{
+    BlockHeightIndex index;
+    verifyIndex(index, QVector<qreal>());
+
+    QVector<qreal> heights(1000);
+    index.reset(heights.size());
+    for (int i = 0; i < heights.size(); ++i) {
+        heights[i] = (i % 7) * 10;
+        index.setHeight(i, heights[i]);
+    }
+    verifyIndex(index, heights);
+
+    // Zero-height blocks are skipped on lookup.
+    heights[1] = 0;
+    index.setHeight(1, 0);
+    QCOMPARE(index.findIndex(heights[0]), 2);
+
+    heights[500] = 123.5;
+    index.setHeight(500, heights[500]);
+    verifyIndex(index, heights);
+}
+
+void TestTextDocumentLayout::testBlockHeightIndexInsertRemove()
+{
+    BlockHeightIndex index;
+    QVector<qreal> heights;
+
+    index.insert(0, 3);
+    heights.insert(0, 3, 0);
+    for (int i = 0; i < heights.size(); ++i) {
+        heights[i] = 20;
+        index.setHeight(i, 20);
+    }
+    verifyIndex(index, heights);
+
+    index.insert(1, 5);
+    heights.insert(1, 5, 0);
+    index.setHeight(2, 30);
+    heights[2] = 30;
+    verifyIndex(index, heights);
+
+    index.remove(2, 4);
+    heights.remove(2, 4);
+    verifyIndex(index, heights);
+
+    // Out of range removal is clipped.
+    index.remove(3, 100);
+    heights.remove(3, heights.size() - 3);
+    verifyIndex(index, heights);
+
+    // Batches of random edits, which are queried only after the whole batch.
+    QRandomGenerator rand(7);
+    for (int round = 0; round < 200; ++round) {
+        const int numOfEdits = rand.bounded(1, 8);
+        for (int i = 0; i < numOfEdits; ++i) {
+            const int pos = rand.bounded(heights.size() + 1);
+            const int count = rand.bounded(1, 10);
+            switch (rand.bounded(3)) {
+            case 0:
+                index.insert(pos, count);
+                heights.insert(pos, count, 0);
+                break;
+
+            case 1:
+                if (pos < heights.size()) {
+                    index.remove(pos, count);
+                    heights.remove(pos, qMin(count, heights.size() - pos));
+                }
+                break;
+
+            default:
+                if (pos < heights.size()) {
+                    heights[pos] = rand.bounded(1, 50);
+                    index.setHeight(pos, heights[pos]);
+                }
+                break;
+            }
+        }
+        verifyIndex(index, heights);
+    }
+}
+
+void TestTextDocumentLayout::testBlockWidthIndex()
+{
+    BlockWidthIndex index;
+    QCOMPARE(index.maximumWidthIndex(), -1);
+    QCOMPARE(index.maximumWidth(), qreal(0));
+
+    index.reset(100);
+    QCOMPARE(index.maximumWidthIndex(), 0);
+
+    for (int i = 0; i < index.size(); ++i) {
+        index.setWidth(i, i % 10);
+    }
+    // The first widest block.
+    QCOMPARE(index.maximumWidthIndex(), 9);
+    QCOMPARE(index.maximumWidth(), qreal(9));
+
+    index.setWidth(50, 100);
+    QCOMPARE(index.maximumWidthIndex(), 50);
+
+    // Shrink the widest block.
+    index.setWidth(50, 0);
+    QCOMPARE(index.maximumWidthIndex(), 9);
+
+    index.setWidth(70, 20);
+    index.insert(10, 5);
+    QCOMPARE(index.size(), 105);
+    QCOMPARE(index.maximumWidthIndex(), 75);
+    QCOMPARE(index.width(10), qreal(0));
+
+    index.remove(70, 10);
+    QCOMPARE(index.size(), 95);
+    QCOMPARE(index.maximumWidthIndex(), 9);
+}
+
+void TestTextDocumentLayout::testLazyLayout()
+{
+    QTextDocument doc;
+    QStringList lines;
+    for (int i = 0; i < 1000; ++i) {
+        lines << QStringLiteral("line %1").arg(i);
+    }
+    doc.setPlainText(lines.join(QLatin1Char('\n')));
+
+    // A block much higher than the estimation from the default font.
+    const int blockNum = 800;
+    QTextCursor cursor(doc.findBlockByNumber(blockNum));
+    cursor.select(QTextCursor::BlockUnderCursor);
+    QTextCharFormat fmt;
+    fmt.setFontPointSize(doc.defaultFont().pointSizeF() * 4);
+    cursor.mergeCharFormat(fmt);
+
+    DocumentResourceMgr resourceMgr;
+    auto layout = new TextDocumentLayout(&doc, &resourceMgr);
+    layout->setLazyLayoutEnabled(true);
+    doc.setDocumentLayout(layout);
+
+    const qreal estimatedHeight = QFontMetricsF(doc.defaultFont()).height();
+    const auto prevBlock = doc.findBlockByNumber(blockNum - 1);
+    const auto block = doc.findBlockByNumber(blockNum);
+    const auto nextBlock = doc.findBlockByNumber(blockNum + 1);
+
+    // Blocks at the top are layouted while those far away are estimated.
+    QVERIFY(!BlockLayoutData::get(doc.firstBlock())->isNull());
+    QVERIFY(BlockLayoutData::get(block)->isNull());
+
+    // Querying the neighbours layouts only themselves.
+    const QRectF prevRect = layout->blockBoundingRect(prevBlock);
+    const QRectF nextRect = layout->blockBoundingRect(nextBlock);
+    QVERIFY(BlockLayoutData::get(block)->isNull());
+    QCOMPARE(nextRect.top() - prevRect.bottom(), estimatedHeight);
+    const qreal estimatedDocHeight = layout->documentSize().height();
+    QCOMPARE(layout->findBlockByPosition(QPointF(0, prevRect.bottom() + estimatedHeight / 2)), blockNum);
+
+    // Now the real height takes place of the estimated one.
+    const QRectF rect = layout->blockBoundingRect(block);
+    QVERIFY(!BlockLayoutData::get(block)->isNull());
+    QVERIFY(rect.height() > estimatedHeight * 2);
+    QCOMPARE(rect.top(), prevRect.bottom());
+    QCOMPARE(layout->blockBoundingRect(nextBlock).top(), rect.bottom());
+    QCOMPARE(layout->findBlockByPosition(QPointF(0, rect.bottom() - 1)), blockNum);
+
+    // Document size is updated later.
+    QTRY_COMPARE(layout->documentSize().height(), estimatedDocHeight + rect.height() - estimatedHeight);
+}
+
+void TestTextDocumentLayout::benchmarkKeystroke_data()
+{
+    QTest::addColumn<int>("numOfBlocks");
+    QTest::addColumn<bool>("lazyLayout");
+
+    const int counts[] = {1000, 10000, 100000};
+    for (int num : counts) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 blocks").arg(num))) << num << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 blocks lazy").arg(num))) << num << true;
+    }
+}
+
+void TestTextDocumentLayout::benchmarkKeystroke()
+{
+    QFETCH(int, numOfBlocks);
+    QFETCH(bool, lazyLayout);
+
+    QTextDocument doc;
+    QStringList lines;
+    for (int i = 0; i < numOfBlocks; ++i) {
+        lines << QString(10 + i % 80, QLatin1Char('a'));
+    }
+    doc.setPlainText(lines.join(QLatin1Char('\n')));
+
+    DocumentResourceMgr resourceMgr;
+    auto layout = new TextDocumentLayout(&doc, &resourceMgr);
+    layout->setLazyLayoutEnabled(lazyLayout);
+    doc.setDocumentLayout(layout);
+
+    // Typing in the middle of the document, which relayouts the block and updates the document
+    // size, and the cursor rect is queried by the editor.
+    const auto block = doc.findBlockByNumber(numOfBlocks / 2);
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::EndOfBlock);
+    qreal size = 0;
+    QBENCHMARK {
+        cursor.insertText(QStringLiteral("a"));
+        const auto rect = layout->blockBoundingRect(block);
+        size += rect.bottom() + layout->documentSize().width() + layout->documentSize().height();
+    }
+    QVERIFY(size > 0);
+}
+
+QTEST_MAIN(tests::TestTextDocumentLayout)
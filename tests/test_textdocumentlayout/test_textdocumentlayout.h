@@ -0,0 +1,32 @@
+#ifndef TESTS_TEST_TEXTDOCUMENTLAYOUT_H
+#define TESTS_TEST_TEXTDOCUMENTLAYOUT_H
+
+#include <QtTest>
+
+namespace tests
+{
+    class TestTextDocumentLayout : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check offsets and lookups of BlockHeightIndex against a linear scan.
+        void testBlockHeightIndex();
+
+        // Check inserting and removing blocks of BlockHeightIndex against a QVector.
+        void testBlockHeightIndexInsertRemove();
+
+        // Check the widest block of BlockWidthIndex along with updates.
+        void testBlockWidthIndex();
+
+        // Check that blocks far from the viewport get estimated heights with lazy layout, which
+        // are replaced by the real ones once the blocks are layouted.
+        void testLazyLayout();
+
+        // Typing into a QTextDocument laid out by TextDocumentLayout in documents of different
+        // number of blocks, with lazy layout on and off.
+        void benchmarkKeystroke_data();
+        void benchmarkKeystroke();
+    };
+} // ns tests
+
+#endif
@@ -0,0 +1,346 @@
+#include "test_textfinder.h"
+
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <utils/utils.h>
+
+using namespace tests;
+
+using namespace vte;
+
+static QString getText()
+{
+    return utils::getCppText()
+           + QStringLiteral("\nnon%1breaking space\n\n    trailing  \nFolding FOLDING folding\n").arg(QChar(QChar::Nbsp));
+}
+
+template <typename T>
+static void findAllInDocument(QVector<TextFinder::Match> &p_matches,
+                              QTextDocument *p_doc,
+                              const T &p_text,
+                              QTextDocument::FindFlags p_flags,
+                              int p_start,
+                              int p_end)
+{
+    int start = p_start;
+    int end = p_end == -1 ? p_doc->characterCount() + 1 : p_end;
+    while (start < end) {
+        QTextCursor cursor = p_doc->find(p_text, start, p_flags);
+        if (cursor.isNull()) {
+            break;
+        }
+
+        start = cursor.selectionEnd();
+        if (start <= end) {
+            p_matches.append(TextFinder::Match(cursor.selectionStart(), cursor.selectionEnd()));
+        }
+
+        if (cursor.selectionStart() == cursor.selectionEnd()) {
+            ++start;
+        }
+    }
+}
+
+QVector<TextFinder::Match> TestTextFinder::findAllViaDocument(QTextDocument *p_doc,
+                                                              const QStringList &p_texts,
+                                                              FindFlags p_flags,
+                                                              int p_start,
+                                                              int p_end)
+{
+    QTextDocument::FindFlags flags;
+    if (p_flags & FindFlag::CaseSensitive) {
+        flags |= QTextDocument::FindCaseSensitively;
+    }
+    if (p_flags & FindFlag::WholeWordOnly) {
+        flags |= QTextDocument::FindWholeWords;
+    }
+
+    // Qt 6 ignores FindCaseSensitively for regular expression.
+    const auto regExpOptions = (p_flags & FindFlag::CaseSensitive) ? QRegularExpression::NoPatternOption
+                                                                   : QRegularExpression::CaseInsensitiveOption;
+
+    QVector<TextFinder::Match> matches;
+    for (const auto &text : p_texts) {
+        if (p_flags & FindFlag::RegularExpression) {
+            findAllInDocument(matches, p_doc, QRegularExpression(text, regExpOptions), flags, p_start, p_end);
+        } else {
+            findAllInDocument(matches, p_doc, text, flags, p_start, p_end);
+        }
+    }
+
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+void TestTextFinder::testMultiStringMatcher()
+{
+    const QStringList patterns = {"he", "she", "his", "hers"};
+    MultiStringMatcher matcher(patterns, Qt::CaseInsensitive);
+    QCOMPARE(matcher.size(), patterns.size());
+    QCOMPARE(matcher.maximumPatternLength(), 4);
+
+    const QString text("uSHErs his");
+    QStringList occurrences;
+    matcher.forEachMatch(text.constData(), 0, text.size(), [&](int p_pattern, int p_start) {
+        occurrences << QStringLiteral("%1@%2").arg(patterns[p_pattern]).arg(p_start);
+    });
+
+    // In the order of the end of occurrences.
+    const QStringList expected = {"she@1", "he@2", "hers@2", "his@7"};
+    QCOMPARE(occurrences, expected);
+
+    // Limit the range.
+    occurrences.clear();
+    matcher.forEachMatch(text.constData(), 2, 5, [&](int p_pattern, int p_start) {
+        occurrences << QStringLiteral("%1@%2").arg(patterns[p_pattern]).arg(p_start);
+    });
+    QCOMPARE(occurrences, QStringList{"he@2"});
+}
+
+void TestTextFinder::testFindAll_data()
+{
+    QTest::addColumn<QStringList>("texts");
+    QTest::addColumn<int>("flags");
+    QTest::addColumn<int>("start");
+    QTest::addColumn<int>("end");
+
+    QTest::newRow("literal") << QStringList{"folding"} << int(FindFlag::None) << 0 << -1;
+    QTest::newRow("literal case sensitive") << QStringList{"Folding"} << int(FindFlag::CaseSensitive) << 0 << -1;
+    QTest::newRow("literal whole word") << QStringList{"range"} << int(FindFlag::WholeWordOnly) << 0 << -1;
+    QTest::newRow("literal partial word") << QStringList{"rang"} << int(FindFlag::WholeWordOnly) << 0 << -1;
+    QTest::newRow("literal nbsp") << QStringList{"non breaking"} << int(FindFlag::None) << 0 << -1;
+    QTest::newRow("literal range") << QStringList{"folding"} << int(FindFlag::None) << 100 << 300;
+    QTest::newRow("literal multiple") << QStringList{"folding", "range", "ing"} << int(FindFlag::None) << 0 << -1;
+    QTest::newRow("literal multiple prefixes") << QStringList{"fold", "folding", "old", "include"} << int(FindFlag::CaseSensitive) << 0 << -1;
+    QTest::newRow("literal multiple whole word") << QStringList{"folding", "range", "ing", "FOLDING"} << int(FindFlag::WholeWordOnly) << 0 << -1;
+    QTest::newRow("literal multiple duplicated") << QStringList{"range", "Range"} << int(FindFlag::None) << 0 << -1;
+    QTest::newRow("literal multiple range") << QStringList{"folding", "range", "#"} << int(FindFlag::None) << 50 << 320;
+    QTest::newRow("regex") << QStringList{"f\\w+g"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex case sensitive") << QStringList{"F\\w+G"} << int(FindFlag::RegularExpression | FindFlag::CaseSensitive) << 0 << -1;
+    QTest::newRow("regex whole word") << QStringList{"\\w+ing"} << int(FindFlag::RegularExpression | FindFlag::WholeWordOnly) << 0 << -1;
+    QTest::newRow("regex start of block") << QStringList{"^//"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex end of block") << QStringList{"\\s+$"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex zero-length") << QStringList{"^"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex empty block") << QStringList{"^$"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex lookbehind") << QStringList{"(?<=// )\\w+"} << int(FindFlag::RegularExpression) << 0 << -1;
+    QTest::newRow("regex range") << QStringList{"\\w+"} << int(FindFlag::RegularExpression) << 120 << 260;
+    QTest::newRow("regex multiple") << QStringList{"f\\w+g", "^#\\w+"} << int(FindFlag::RegularExpression) << 0 << -1;
+}
+
+void TestTextFinder::testFindAll()
+{
+    QFETCH(QStringList, texts);
+    QFETCH(int, flags);
+    QFETCH(int, start);
+    QFETCH(int, end);
+
+    QTextDocument doc(getText());
+    const auto findFlags = static_cast<FindFlags>(flags);
+    const auto expected = findAllViaDocument(&doc, texts, findFlags, start, end);
+
+    TextFinder finder(texts, findFlags);
+    QVERIFY(finder.isValid());
+    QCOMPARE(finder.findAll(doc.toPlainText(), start, end), expected);
+}
+
+void TestTextFinder::testFindAllInChunks()
+{
+    const auto text = getText();
+    const QVector<TextFinder> finders = {
+        TextFinder({"folding", "range"}, FindFlag::None),
+        TextFinder({"^$", "\\w+$", "(?<=// )\\w+"}, FindFlag::RegularExpression)
+    };
+
+    for (const auto &finder : finders) {
+        const auto expected = finder.findAll(text);
+        QVERIFY(!expected.isEmpty());
+
+        // Split chunks at block boundaries.
+        for (int chunkSize = 1; chunkSize < 200; chunkSize += 37) {
+            QVector<TextFinder::Match> matches;
+            int pos = 0;
+            while (true) {
+                const int idx = text.indexOf(QLatin1Char('\n'), pos + chunkSize);
+                if (idx == -1) {
+                    matches += finder.findAll(text, pos, -1);
+                    break;
+                }
+
+                matches += finder.findAll(text, pos, idx + 1);
+                pos = idx + 1;
+            }
+
+            QCOMPARE(matches, expected);
+        }
+    }
+}
+
+void TestTextFinder::testUpdateMatches()
+{
+    const QVector<TextFinder> finders = {
+        TextFinder({"folding", "range", "ing"}, FindFlag::WholeWordOnly),
+        TextFinder({"^$", "\\w+$", "(?<=// )\\w+", "^#"}, FindFlag::RegularExpression)
+    };
+    const QStringList insertions = {"folding", "range\n", "\n", "// ", "#", "ing\n\nx", " "};
+
+    for (const auto &finder : finders) {
+        QTextDocument doc(getText());
+        auto matches = finder.findAll(doc.toPlainText());
+        QVERIFY(!matches.isEmpty());
+
+        // Track a match after the edit at the start.
+        int trackedIndex = matches.size() / 2;
+        const auto trackedMatch = matches[trackedIndex];
+
+        bool updated = false;
+        auto conn = connect(&doc, &QTextDocument::contentsChange,
+                            [&](int p_position, int p_charsRemoved, int p_charsAdded) {
+                                updated = finder.updateMatches(matches, &doc, p_position, p_charsRemoved, p_charsAdded, &trackedIndex);
+                            });
+
+        QTextCursor cursor(&doc);
+        cursor.insertText(QStringLiteral("x\n"));
+        QVERIFY(updated);
+        QCOMPARE(matches, finder.findAll(doc.toPlainText()));
+        QVERIFY(trackedIndex > -1);
+        QCOMPARE(matches[trackedIndex], TextFinder::Match(trackedMatch.m_start + 2, trackedMatch.m_end + 2));
+
+        QRandomGenerator generator(10);
+        for (int i = 0; i < 500; ++i) {
+            const int length = doc.characterCount() - 1;
+            const int pos = generator.bounded(length + 1);
+            cursor.setPosition(pos);
+            updated = false;
+            if (pos == length || generator.bounded(2) == 0) {
+                cursor.insertText(insertions[generator.bounded(insertions.size())]);
+            } else {
+                cursor.setPosition(qMin(pos + 1 + generator.bounded(20), length), QTextCursor::KeepAnchor);
+                cursor.removeSelectedText();
+            }
+
+            QVERIFY(updated);
+            QCOMPARE(matches, finder.findAll(doc.toPlainText()));
+        }
+
+        disconnect(conn);
+    }
+}
+
+void TestTextFinder::testReplace_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("flags");
+    QTest::addColumn<QString>("replaceText");
+    QTest::addColumn<QString>("result");
+
+    QTest::newRow("literal") << QStringLiteral("foo bar foo\nFoo") << QStringLiteral("foo")
+                             << static_cast<int>(FindFlag::None) << QStringLiteral("baz")
+                             << QStringLiteral("baz bar baz\nbaz");
+    QTest::newRow("literal with backslash") << QStringLiteral("(a)") << QStringLiteral("a")
+                                            << static_cast<int>(FindFlag::None) << QStringLiteral("\\1")
+                                            << QStringLiteral("(\\1)");
+    QTest::newRow("back references") << QStringLiteral("a@b, cc@dd\nx@y") << QStringLiteral("(\\w+)@(\\w+)")
+                                     << static_cast<int>(FindFlag::RegularExpression) << QStringLiteral("\\2 at \\1")
+                                     << QStringLiteral("b at a, dd at cc\ny at x");
+    QTest::newRow("lookbehind") << QStringLiteral("ab cb\nb") << QStringLiteral("(?<=a)(b)")
+                                << static_cast<int>(FindFlag::RegularExpression) << QStringLiteral("<\\1>")
+                                << QStringLiteral("a<b> cb\nb");
+    QTest::newRow("two digits") << QStringLiteral("abcdefghijk") << QStringLiteral("(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)")
+                                << static_cast<int>(FindFlag::RegularExpression) << QStringLiteral("\\11\\10\\1\\12\\0")
+                                << QStringLiteral("kjaa2\\0");
+    QTest::newRow("unmatched group") << QStringLiteral("ab b") << QStringLiteral("(a)?b")
+                                     << static_cast<int>(FindFlag::RegularExpression) << QStringLiteral("[\\1]")
+                                     << QStringLiteral("[a] []");
+    QTest::newRow("nbsp") << QStringLiteral("a%1b x").arg(QChar(QChar::Nbsp)) << QStringLiteral("(a\\sb) (x)")
+                          << static_cast<int>(FindFlag::RegularExpression) << QStringLiteral("\\2 \\1")
+                          << QStringLiteral("x a%1b").arg(QChar(QChar::Nbsp));
+}
+
+void TestTextFinder::testReplace()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, pattern);
+    QFETCH(int, flags);
+    QFETCH(QString, replaceText);
+    QFETCH(QString, result);
+
+    TextFinder finder(QStringList(pattern), static_cast<FindFlags>(flags));
+    auto subject = text;
+    subject.replace(QChar::Nbsp, QLatin1Char(' '));
+    const auto matches = finder.findAll(subject);
+    QVERIFY(!matches.isEmpty());
+    QCOMPARE(finder.replace(text, matches, replaceText, 0, text.size()), result);
+
+    // Replace part of the text.
+    const int start = matches.first().m_start;
+    const int end = matches.last().m_end;
+    QCOMPARE(finder.replace(text, matches, replaceText, start, end),
+             result.mid(start, result.size() - text.size() + end - start));
+}
+
+void TestTextFinder::benchmarkReplaceAll_data()
+{
+    QTest::addColumn<bool>("onePass");
+
+    QTest::newRow("per cursor") << false;
+    QTest::newRow("one pass") << true;
+}
+
+void TestTextFinder::benchmarkReplaceAll()
+{
+    QFETCH(bool, onePass);
+
+    QString text;
+    for (int i = 0; i < 10000; ++i) {
+        text += QStringLiteral("foo = bar(foo, %1);\n").arg(i);
+    }
+
+    const auto pattern = QStringLiteral("(foo|bar)");
+    const auto replaceText = QStringLiteral("<\\1>");
+    TextFinder finder(QStringList(pattern), FindFlag::RegularExpression);
+    const auto matches = finder.findAll(text);
+    QCOMPARE(matches.size(), 30000);
+
+    QTextDocument doc;
+    int contentsChanges = 0;
+    connect(&doc, &QTextDocument::contentsChange, [&contentsChanges]() {
+        ++contentsChanges;
+    });
+
+    QBENCHMARK {
+        doc.setPlainText(text);
+        contentsChanges = 0;
+
+        QTextCursor cursor(&doc);
+        cursor.beginEditBlock();
+        if (onePass) {
+            cursor.setPosition(matches.first().m_start);
+            cursor.setPosition(matches.last().m_end, QTextCursor::KeepAnchor);
+            cursor.insertText(finder.replace(text, matches, replaceText, matches.first().m_start, matches.last().m_end));
+        } else {
+            const QRegularExpression regExp(pattern);
+            int delta = 0;
+            for (const auto &match : matches) {
+                const int end = match.m_end + delta;
+                cursor.setPosition(match.m_start + delta);
+                cursor.setPosition(end, QTextCursor::KeepAnchor);
+                cursor.insertText(cursor.selectedText().replace(regExp, replaceText));
+                delta += cursor.position() - end;
+            }
+        }
+        cursor.endEditBlock();
+    }
+
+    auto result = text;
+    result.replace(QRegularExpression(pattern), replaceText);
+    QCOMPARE(doc.toPlainText(), result);
+    if (onePass) {
+        QCOMPARE(contentsChanges, 1);
+    }
+}
+
+QTEST_MAIN(tests::TestTextFinder)
@@ -0,0 +1,47 @@
+#ifndef TESTS_TEST_TEXTFINDER_H
+#define TESTS_TEST_TEXTFINDER_H
+
+#include <QtTest>
+
+#include <textfinder.h>
+
+class QTextDocument;
+
+namespace tests
+{
+    class TestTextFinder : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check occurrences of multiple strings, including overlapping ones.
+        void testMultiStringMatcher();
+
+        // Check matches against QTextDocument::find().
+        void testFindAll_data();
+        void testFindAll();
+
+        // Check that finding chunk by chunk gets the same matches as a whole.
+        void testFindAllInChunks();
+
+        // Check that matches updated incrementally on random edits are the same as re-found.
+        void testUpdateMatches();
+
+        // Check replacing matches in one pass, including back references.
+        void testReplace_data();
+        void testReplace();
+
+        // Replace all matches in a document one by one via cursors, or as one edit.
+        void benchmarkReplaceAll_data();
+        void benchmarkReplaceAll();
+
+    private:
+        // Find all matches via QTextDocument::find() as a reference.
+        static QVector<vte::TextFinder::Match> findAllViaDocument(QTextDocument *p_doc,
+                                                                  const QStringList &p_texts,
+                                                                  vte::FindFlags p_flags,
+                                                                  int p_start,
+                                                                  int p_end);
+    };
+} // ns tests
+
+#endif
@@ -1,6 +1,7 @@
 #include "test_textfolding.h"
 
 #include <QDebug>
+#include <QTextCursor>
 #include <QTextDocument>
 
 #include <utils/utils.h>
@@ -267,4 +268,91 @@ void TestTextFolding::textFoldRange()
     }
 }
 
+// Check the line mappings against the visibility of blocks.
+static void checkLineMapping(const QTextDocument *p_doc, const TextFolding *p_folding)
+{
+    int visibleLine = -1;
+    auto block = p_doc->firstBlock();
+    while (block.isValid()) {
+        const int line = block.blockNumber();
+        if (block.isVisible()) {
+            ++visibleLine;
+            QCOMPARE(p_folding->visibleLineToLine(visibleLine), line);
+        }
+
+        // Hidden lines locate at the first line of the folded range.
+        QCOMPARE(p_folding->lineToVisibleLine(line), visibleLine);
+
+        block = block.next();
+    }
+
+    // Out of range.
+    QCOMPARE(p_folding->lineToVisibleLine(p_doc->blockCount() + 10), visibleLine);
+    QCOMPARE(p_folding->visibleLineToLine(visibleLine + 10), p_doc->blockCount() - 1);
+}
+
+void TestTextFolding::testLineMapping()
+{
+    checkLineMapping(m_doc, m_textFolding);
+
+    insertNewFoldingRange(2, 5, TextFolding::Folded);
+    checkLineMapping(m_doc, m_textFolding);
+
+    auto id = insertNewFoldingRange(10, 30, TextFolding::Persistent);
+    insertNewFoldingRange(12, 14, TextFolding::Folded);
+    insertNewFoldingRange(20, 25, TextFolding::Folded);
+    insertNewFoldingRange(26, 28, TextFolding::Folded);
+    checkLineMapping(m_doc, m_textFolding);
+
+    // Fold the parent range.
+    m_textFolding->toggleRange(id);
+    QCOMPARE(m_textFolding->debugDump(),
+             QStringLiteral("tree [2 f 5] [10 pf [12 f 14] [20 f 25] [26 f 28] 30] "
+                            "- folded [2 f 5] [10 pf 30]"));
+    checkLineMapping(m_doc, m_textFolding);
+
+    // Unfold the parent range.
+    m_textFolding->toggleRange(id);
+    checkLineMapping(m_doc, m_textFolding);
+
+    // Edits shifting folded ranges.
+    QTextCursor cursor(m_doc->findBlockByNumber(8));
+    cursor.insertText(QStringLiteral("\n\n"));
+    checkLineMapping(m_doc, m_textFolding);
+
+    cursor.deletePreviousChar();
+    cursor.deletePreviousChar();
+    checkLineMapping(m_doc, m_textFolding);
+}
+
+void TestTextFolding::benchmarkLineMapping()
+{
+    // 10k folded ranges of two lines separated by one visible line.
+    const int numOfRanges = 10000;
+    QStringList lines;
+    for (int i = 0; i < numOfRanges * 3; ++i) {
+        lines << QString::number(i);
+    }
+
+    QTextDocument doc(lines.join(QLatin1Char('\n')));
+    TextFolding folding(&doc);
+    for (int i = 0; i < numOfRanges; ++i) {
+        TextBlockRange range(doc.findBlockByNumber(i * 3), doc.findBlockByNumber(i * 3 + 1));
+        folding.newFoldingRange(range, TextFolding::Folded);
+    }
+    QCOMPARE(folding.m_foldedFoldingRanges.size(), numOfRanges);
+    QCOMPARE(folding.lineToVisibleLine(numOfRanges * 3 - 1), numOfRanges * 2 - 1);
+    QCOMPARE(folding.visibleLineToLine(numOfRanges * 2 - 1), numOfRanges * 3 - 1);
+
+    // Simulate j/k motions through the whole document.
+    const int blockCount = doc.blockCount();
+    qint64 sum = 0;
+    QBENCHMARK {
+        for (int line = 0; line < blockCount; line += 7) {
+            sum += folding.visibleLineToLine(folding.lineToVisibleLine(line) + 1);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
 QTEST_MAIN(tests::TestTextFolding)
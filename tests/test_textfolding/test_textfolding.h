@@ -20,6 +20,10 @@ namespace tests
 
         void textFoldRange();
 
+        void testLineMapping();
+
+        void benchmarkLineMapping();
+
         void cleanupTestCase();
 
         // Will be executed before any test function.
@@ -1,9 +1,34 @@
 #include "test_utils.h"
 
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
 #include <vtextedit/lrucache.h>
 
+#include <codeblockhighlightcache.h>
+
+#include "legacylrucache.h"
+
 using namespace tests;
 
+using vte::CodeBlockHighlightCache;
+
+// Similar to the highlight styles of code blocks.
+typedef QVector<QVector<int>> CacheValue;
+
+template <typename _Cache>
+static void runLruCache(_Cache &p_cache, const QStringList &p_keys, const QVector<int> &p_ops,
+                        const CacheValue &p_value)
+{
+    for (int idx : p_ops) {
+        const auto &key = p_keys[idx];
+        if (p_cache.get(key).isEmpty()) {
+            p_cache.set(key, p_value);
+        }
+    }
+}
+
 void TestUtils::testLruCache()
 {
     vte::LruCache<int, QString> cache(5, QString());
@@ -48,4 +73,268 @@ void TestUtils::testLruCache()
     QCOMPARE(cache.get(6), "h");
 }
 
+void TestUtils::testLruCacheEviction()
+{
+    vte::LruCache<int, QString> cache(3, QString());
+    QVector<int> evicted;
+    cache.setEvictionHandler([&evicted, &cache](const int &p_key, const QString &p_val) {
+        QVERIFY(cache.contains(p_key));
+        QCOMPARE(p_val, QString::number(p_key));
+        evicted.push_back(p_key);
+    });
+
+    for (int i = 0; i < 3; ++i) {
+        cache.set(i, QString::number(i));
+    }
+    QVERIFY(evicted.isEmpty());
+
+    // 1 is the least recently used one after accessing 0.
+    QCOMPARE(cache.get(0), QStringLiteral("0"));
+    cache.set(3, QStringLiteral("3"));
+    QCOMPARE(evicted, QVector<int>({1}));
+    QVERIFY(!cache.contains(1));
+
+    // Replacing does not evict.
+    cache.set(2, QStringLiteral("2"));
+    QCOMPARE((int)evicted.size(), 1);
+
+    QVector<int> keys;
+    cache.forEach([&keys](const int &p_key, const QString &p_val) {
+        Q_UNUSED(p_val);
+        keys.push_back(p_key);
+    });
+    QCOMPARE(keys, QVector<int>({0, 3, 2}));
+}
+
+void TestUtils::testLruCacheMemoryBudget()
+{
+    vte::LruCache<int, QString> cache(5, QString());
+    QVector<int> evicted;
+    cache.setEvictionHandler([&evicted](const int &p_key, const QString &p_val) {
+        Q_UNUSED(p_val);
+        evicted.push_back(p_key);
+    });
+    cache.setMemoryBudget(10, [](const int &p_key, const QString &p_val) {
+        Q_UNUSED(p_key);
+        return static_cast<qint64>(p_val.size());
+    });
+
+    cache.set(1, QString(4, QLatin1Char('a')));
+    cache.set(2, QString(4, QLatin1Char('b')));
+    QCOMPARE(cache.totalCost(), qint64(8));
+    QVERIFY(evicted.isEmpty());
+
+    cache.set(3, QString(4, QLatin1Char('c')));
+    QCOMPARE(evicted, QVector<int>({1}));
+    QCOMPARE(cache.totalCost(), qint64(8));
+
+    // Replacing updates the cost.
+    cache.set(2, QString(1, QLatin1Char('b')));
+    QCOMPARE(cache.totalCost(), qint64(5));
+
+    // The count does not matter.
+    for (int i = 10; i < 15; ++i) {
+        cache.set(i, QString());
+    }
+    QCOMPARE((int)cache.size(), 7);
+    QCOMPARE((int)evicted.size(), 1);
+
+    // The most recently used one is kept even if it exceeds the budget.
+    cache.set(20, QString(20, QLatin1Char('d')));
+    QCOMPARE((int)cache.size(), 1);
+    QCOMPARE((int)cache.get(20).size(), 20);
+    QCOMPARE(cache.totalCost(), qint64(20));
+
+    cache.clear();
+    QCOMPARE((int)cache.size(), 0);
+    QCOMPARE(cache.totalCost(), qint64(0));
+}
+
+static CodeBlockHighlightCache::HighlightStyles makeHighlights(int p_seed)
+{
+    CodeBlockHighlightCache::HighlightStyles highlights(p_seed % 5 + 1);
+    for (int i = 0; i < highlights.size(); ++i) {
+        vte::peg::HLUnitStyle unit;
+        unit.start = i;
+        unit.length = p_seed + 1;
+        unit.format.setForeground(QColor(p_seed * 10 % 256, i * 20 % 256, 0));
+        unit.format.setFontWeight(i % 2 ? QFont::Bold : QFont::Normal);
+        highlights[i].append(unit);
+    }
+    return highlights;
+}
+
+static CodeBlockHighlightCache::Key makeKey(int p_idx, const QString &p_scope)
+{
+    CodeBlockHighlightCache::Key key;
+    key.m_textHash = 1000 + p_idx;
+    key.m_lang = QStringLiteral("cpp");
+    key.m_scope = p_scope;
+    return key;
+}
+
+static qint64 fileSize(const QString &p_filePath)
+{
+    return QFileInfo(p_filePath).size();
+}
+
+void TestUtils::testCodeBlockHighlightCacheSpill()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("cache.dat"));
+    const QString scope = QStringLiteral("spill");
+
+    auto &cache = CodeBlockHighlightCache::getInst();
+    cache.setSpillFile(filePath);
+    // Keep only the most recently used entry in memory.
+    cache.setMemoryBudget(1);
+
+    const int numOfKeys = 5;
+    for (int i = 0; i < numOfKeys; ++i) {
+        cache.set(makeKey(i, scope), makeHighlights(i));
+    }
+
+    CodeBlockHighlightCache::HighlightStyles highlights;
+    for (int i = 0; i < numOfKeys; ++i) {
+        QVERIFY(cache.get(makeKey(i, scope), highlights));
+        QCOMPARE(highlights, makeHighlights(i));
+    }
+    QVERIFY(!cache.get(makeKey(numOfKeys, scope), highlights));
+
+    // Records of an earlier session are indexed on open.
+    cache.setSpillFile(QString());
+    cache.setSpillFile(filePath);
+    for (int i = numOfKeys - 1; i >= 0; --i) {
+        QVERIFY(cache.get(makeKey(i, scope), highlights));
+        QCOMPARE(highlights, makeHighlights(i));
+    }
+
+    // The same key is spilled only once.
+    cache.flush();
+    const qint64 size = fileSize(filePath);
+    for (int i = 0; i < numOfKeys; ++i) {
+        cache.set(makeKey(i, scope), makeHighlights(i));
+    }
+    cache.flush();
+    QCOMPARE(fileSize(filePath), size);
+
+    cache.setSpillFile(QString());
+    cache.setMemoryBudget(16 * 1024 * 1024);
+}
+
+void TestUtils::testCodeBlockHighlightCacheCorruptFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("cache.dat"));
+    const QString scope = QStringLiteral("corrupt");
+
+    auto &cache = CodeBlockHighlightCache::getInst();
+    cache.setSpillFile(filePath);
+    cache.setMemoryBudget(1);
+
+    for (int i = 0; i < 3; ++i) {
+        cache.set(makeKey(i, scope), makeHighlights(i));
+    }
+    cache.flush();
+    const qint64 validSize = fileSize(filePath);
+
+    // The last record.
+    cache.set(makeKey(3, scope), makeHighlights(3));
+    cache.flush();
+    const qint64 fullSize = fileSize(filePath);
+    QVERIFY(fullSize > validSize);
+    cache.setSpillFile(QString());
+
+    {
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.resize(fullSize - 5));
+    }
+
+    // The broken record is dropped on open.
+    cache.setSpillFile(filePath);
+    QCOMPARE(fileSize(filePath), validSize);
+
+    CodeBlockHighlightCache::HighlightStyles highlights;
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(cache.get(makeKey(i, scope), highlights));
+        QCOMPARE(highlights, makeHighlights(i));
+    }
+
+    // Records are appended after the valid ones.
+    cache.set(makeKey(4, scope), makeHighlights(4));
+    cache.set(makeKey(3, scope), makeHighlights(3));
+    cache.setSpillFile(QString());
+    cache.setSpillFile(filePath);
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(cache.get(makeKey(i, scope), highlights));
+        QCOMPARE(highlights, makeHighlights(i));
+    }
+    cache.setSpillFile(QString());
+
+    // A file of bad magic or version starts over.
+    const QByteArray validHeader("\x56\x43\x42\x48\0\0\0\x01", 8);
+    const QByteArray badVersion("\x56\x43\x42\x48\0\0\0\x09", 8);
+    for (const auto &header : {QByteArray("garbage data"), badVersion}) {
+        {
+            QFile file(filePath);
+            QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            file.write(header);
+        }
+
+        cache.setSpillFile(filePath);
+        QVERIFY(!cache.get(makeKey(0, scope), highlights));
+        cache.setSpillFile(QString());
+
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.read(validHeader.size()), validHeader);
+    }
+
+    cache.setMemoryBudget(16 * 1024 * 1024);
+}
+
+void TestUtils::benchmarkLruCache_data()
+{
+    QTest::addColumn<bool>("legacy");
+
+    QTest::newRow("legacy") << true;
+    QTest::newRow("intrusive") << false;
+}
+
+void TestUtils::benchmarkLruCache()
+{
+    QFETCH(bool, legacy);
+
+    // Keys like the text of code blocks, with more keys than the capacity.
+    const int capacity = 100;
+    QStringList keys;
+    for (int i = 0; i < capacity * 3 / 2; ++i) {
+        keys << QString(1024, QLatin1Char('a' + i % 26)) + QString::number(i);
+    }
+
+    // Hot keys are more likely to be touched.
+    QRandomGenerator rand(25);
+    QVector<int> ops;
+    for (int i = 0; i < 100000; ++i) {
+        const int idx = rand.bounded(keys.size());
+        ops << (rand.bounded(4) == 0 ? idx : idx % capacity);
+    }
+
+    const CacheValue value(20, QVector<int>(10, 1));
+    if (legacy) {
+        QBENCHMARK {
+            LegacyLruCache<QString, CacheValue> cache(capacity, CacheValue());
+            runLruCache(cache, keys, ops, value);
+        }
+    } else {
+        QBENCHMARK {
+            vte::LruCache<QString, CacheValue> cache(capacity, CacheValue());
+            runLruCache(cache, keys, ops, value);
+        }
+    }
+}
+
 QTEST_MAIN(tests::TestUtils)
@@ -12,6 +12,22 @@ namespace tests
         // LruCache Tests.
         void testLruCache();
 
+        // Check the entries evicted and iterated.
+        void testLruCacheEviction();
+
+        // Check eviction by the total cost of entries.
+        void testLruCacheMemoryBudget();
+
+        // Check entries spilled to the file and loaded back, also across sessions.
+        void testCodeBlockHighlightCacheSpill();
+
+        // Check that a broken tail or header of the spill file is dropped.
+        void testCodeBlockHighlightCacheCorruptFile();
+
+        // Compare with the QLinkedList based LegacyLruCache.
+        void benchmarkLruCache_data();
+        void benchmarkLruCache();
+
     };
 } // ns tests
 
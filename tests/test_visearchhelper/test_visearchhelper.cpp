@@ -0,0 +1,128 @@
+#include "test_visearchhelper.h"
+
+#include <QTextDocument>
+
+#include <visearchhelper.h>
+
+using namespace tests;
+
+using namespace vte;
+
+// "line:column-line:column" of each range, or "invalid".
+static QStringList rangesToStrings(const QVector<KateViI::Range> &ranges)
+{
+    QStringList strs;
+    for (const auto &range : ranges) {
+        if (!range.isValid()) {
+            strs << QStringLiteral("invalid");
+        } else {
+            strs << QStringLiteral("%1:%2-%3:%4").arg(range.start().line())
+                                                 .arg(range.start().column())
+                                                 .arg(range.end().line())
+                                                 .arg(range.end().column());
+        }
+    }
+    return strs;
+}
+
+void TestViSearchHelper::testSearchText_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QList<int>>("range");
+    QTest::addColumn<bool>("backward");
+    QTest::addColumn<QStringList>("expectedRanges");
+
+    // Text:
+    // foo bar foo
+    // baz foo
+    // foo
+
+    QTest::newRow("forward") << "foo" << QList<int>{0, 0, 2, 3} << false
+                             << QStringList{"0:0-0:3"};
+    QTest::newRow("forward from start column") << "foo" << QList<int>{0, 1, 2, 3} << false
+                                               << QStringList{"0:8-0:11"};
+    QTest::newRow("forward next line") << "foo" << QList<int>{0, 9, 2, 3} << false
+                                       << QStringList{"1:4-1:7"};
+    QTest::newRow("forward cut by end column") << "foo" << QList<int>{1, 0, 1, 6} << false
+                                               << QStringList{"invalid"};
+    QTest::newRow("forward end beyond document") << "foo" << QList<int>{2, 1, 10, 0} << false
+                                                 << QStringList{"invalid"};
+    QTest::newRow("forward end line beyond document") << "o" << QList<int>{2, 1, 10, 0} << false
+                                                      << QStringList{"2:1-2:2"};
+
+    // Backward search returns the last match before the cursor at the range end.
+    QTest::newRow("backward") << "foo" << QList<int>{0, 0, 2, 3} << true
+                              << QStringList{"2:0-2:3"};
+    QTest::newRow("backward before cursor") << "foo" << QList<int>{0, 0, 2, 2} << true
+                                            << QStringList{"1:4-1:7"};
+    QTest::newRow("backward last in line") << "foo" << QList<int>{0, 0, 1, 3} << true
+                                           << QStringList{"0:8-0:11"};
+    QTest::newRow("backward cut by end column") << "foo" << QList<int>{0, 0, 0, 10} << true
+                                                << QStringList{"0:0-0:3"};
+    QTest::newRow("backward cut by start column") << "foo" << QList<int>{0, 1, 0, 10} << true
+                                                   << QStringList{"invalid"};
+    QTest::newRow("backward zero length") << "$" << QList<int>{0, 0, 1, 3} << true
+                                          << QStringList{"0:11-0:11"};
+
+    QTest::newRow("captures") << "(b)a(r|z)?(x)?" << QList<int>{0, 0, 2, 3} << false
+                              << QStringList{"0:4-0:7", "0:4-0:5", "0:6-0:7"};
+    QTest::newRow("unmatched capture") << "(b)a(x)?(r|z)" << QList<int>{0, 0, 2, 3} << false
+                                       << QStringList{"0:4-0:7", "0:4-0:5", "invalid", "0:6-0:7"};
+    QTest::newRow("invalid range") << "foo" << QList<int>{-1, -1, 2, 3} << false
+                                   << QStringList{"invalid"};
+    QTest::newRow("invalid pattern") << "(foo" << QList<int>{0, 0, 2, 3} << false
+                                     << QStringList{"invalid"};
+}
+
+void TestViSearchHelper::testSearchText()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QList<int>, range);
+    QFETCH(bool, backward);
+    QFETCH(QStringList, expectedRanges);
+
+    QTextDocument doc(QStringLiteral("foo bar foo\nbaz foo\nfoo"));
+    const QRegularExpression regExp(pattern);
+    const auto ranges = ViSearchHelper::searchText(&doc,
+                                                   KateViI::Range(range[0], range[1], range[2], range[3]),
+                                                   regExp,
+                                                   backward);
+    QCOMPARE(rangesToStrings(ranges), expectedRanges);
+}
+
+void TestViSearchHelper::testVimRegExpToQt_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("caseSensitive");
+    QTest::addColumn<QString>("expectedPattern");
+    QTest::addColumn<bool>("expectedCaseSensitive");
+
+    QTest::newRow("word boundaries") << "\\<foo\\>" << true << "\\bfoo\\b" << true;
+    QTest::newRow("ignore case") << "foo\\c" << true << "foo" << false;
+    QTest::newRow("match case") << "\\Cfoo" << false << "foo" << true;
+    QTest::newRow("others kept") << "a\\.b\\d+\\\\" << true << "a\\.b\\d+\\\\" << true;
+    QTest::newRow("trailing backslash") << "foo\\" << false << "foo\\" << false;
+}
+
+void TestViSearchHelper::testVimRegExpToQt()
+{
+    QFETCH(QString, pattern);
+    QFETCH(bool, caseSensitive);
+    QFETCH(QString, expectedPattern);
+    QFETCH(bool, expectedCaseSensitive);
+
+    QCOMPARE(ViSearchHelper::vimRegExpToQt(pattern, caseSensitive), expectedPattern);
+    QCOMPARE(caseSensitive, expectedCaseSensitive);
+
+    // Word boundaries should not match within a word.
+    if (expectedPattern == QStringLiteral("\\bfoo\\b")) {
+        QTextDocument doc(QStringLiteral("foobar foo"));
+        const auto ranges = ViSearchHelper::searchText(&doc,
+                                                       KateViI::Range(0, 0, 0, 10),
+                                                       QRegularExpression(expectedPattern),
+                                                       false);
+        QCOMPARE(rangesToStrings(ranges), QStringList{"0:7-0:10"});
+    }
+}
+
+QTEST_MAIN(tests::TestViSearchHelper)
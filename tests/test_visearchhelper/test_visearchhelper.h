@@ -0,0 +1,22 @@
+#ifndef TESTS_TEST_VISEARCHHELPER_H
+#define TESTS_TEST_VISEARCHHELPER_H
+
+#include <QtTest>
+
+namespace tests
+{
+    class TestViSearchHelper : public QObject
+    {
+        Q_OBJECT
+    private slots:
+        // Check matches within the range in both directions, including the captures.
+        void testSearchText_data();
+        void testSearchText();
+
+        // Check the translation of \<, \>, \c and \C.
+        void testVimRegExpToQt_data();
+        void testVimRegExpToQt();
+    };
+} // ns tests
+
+#endif